@@ -3,9 +3,17 @@
 
 #include "renderDevice.hpp"
 #include "renderInstance.hpp"
+#include "image/frameWriter.hpp"
 #include "image/image.hpp"
+#include "image/mipGenerator.hpp"
+#include "image/textureContainer.hpp"
+#include "image/textureLoader.hpp"
+#include "image/textureStreamer.hpp"
+#include "pipeline/frameCapture.hpp"
 #include "query/queryPool.hpp"
 #include "descriptor/descriptorSetManager.hpp"
+#include "memory/defragmenter.hpp"
+#include "memory/streamLoader.hpp"
 
 #include <string>
 #include <vector>
@@ -2,26 +2,40 @@
 
 #include "renderDevice.hpp"
 
+#include <algorithm>
 #include <cstring>
 #include <iostream>
+#include <utility>
 #include <vulkan/vulkan_core.h>
 
 using namespace renderApi;
 
+namespace {
+
+	// Dirty ranges closer than this are sent as one, the bytes in between cost less than another region
+	constexpr size_t kDirtyMergeGap = 256;
+
+} // namespace
+
 Buffer::Buffer()
-	: gpu_(nullptr), buffer_(VK_NULL_HANDLE), memory_(VK_NULL_HANDLE), deviceAddress_(0), size_(0), type_(BufferType::VERTEX),
-	  usage_(BufferUsage::STATIC), memoryType_(BufferMemory::DEVICE_LOCAL), mappedPtr_(nullptr), persistentlyMapped_(false), transferFence_(VK_NULL_HANDLE) {}
+	: gpu_(nullptr), buffer_(VK_NULL_HANDLE), allocation_(), deviceAddress_(0), size_(0), type_(BufferType::VERTEX),
+	  usage_(BufferUsage::STATIC), memoryType_(BufferMemory::DEVICE_LOCAL), mappedPtr_(nullptr), persistentlyMapped_(false), generation_(0),
+	  addressPinned_(false), tracking_(false) {}
 
 Buffer::~Buffer() { destroy(); }
 
 Buffer::Buffer(Buffer&& other) noexcept
-	: gpu_(other.gpu_), buffer_(other.buffer_), memory_(other.memory_), deviceAddress_(other.deviceAddress_), size_(other.size_), type_(other.type_),
-	  usage_(other.usage_), memoryType_(other.memoryType_), mappedPtr_(other.mappedPtr_), persistentlyMapped_(other.persistentlyMapped_), transferFence_(other.transferFence_) {
+	: gpu_(other.gpu_), buffer_(other.buffer_), allocation_(other.allocation_), deviceAddress_(other.deviceAddress_), size_(other.size_), type_(other.type_),
+	  usage_(other.usage_), memoryType_(other.memoryType_), mappedPtr_(other.mappedPtr_), persistentlyMapped_(other.persistentlyMapped_), generation_(other.generation_),
+	  addressPinned_(other.addressPinned_), tracking_(other.tracking_), hostCopy_(std::move(other.hostCopy_)), dirtyRanges_(std::move(other.dirtyRanges_)),
+	  dirtyCopies_(std::move(other.dirtyCopies_)) {
+	registerOwner();
+	other.addressPinned_ = false;
+	other.tracking_	 = false;
 	other.buffer_	 = VK_NULL_HANDLE;
-	other.memory_	 = VK_NULL_HANDLE;
+	other.allocation_ = memory::AllocationInfo{};
 	other.mappedPtr_ = nullptr;
 	other.size_		 = 0;
-	other.transferFence_ = VK_NULL_HANDLE;
 }
 
 Buffer& Buffer::operator=(Buffer&& other) noexcept {
@@ -29,7 +43,7 @@ Buffer& Buffer::operator=(Buffer&& other) noexcept {
 		destroy();
 		gpu_				= other.gpu_;
 		buffer_				= other.buffer_;
-		memory_				= other.memory_;
+		allocation_			= other.allocation_;
 		deviceAddress_		= other.deviceAddress_;
 		size_				= other.size_;
 		type_				= other.type_;
@@ -37,12 +51,19 @@ Buffer& Buffer::operator=(Buffer&& other) noexcept {
 		memoryType_			= other.memoryType_;
 		mappedPtr_			= other.mappedPtr_;
 		persistentlyMapped_ = other.persistentlyMapped_;
-		transferFence_		= other.transferFence_;
+		generation_			= other.generation_;
+		addressPinned_		= other.addressPinned_;
+		tracking_			= other.tracking_;
+		hostCopy_			= std::move(other.hostCopy_);
+		dirtyRanges_		= std::move(other.dirtyRanges_);
+		dirtyCopies_		= std::move(other.dirtyCopies_);
+		registerOwner();
+		other.addressPinned_ = false;
+		other.tracking_		= false;
 		other.buffer_		= VK_NULL_HANDLE;
-		other.memory_		= VK_NULL_HANDLE;
+		other.allocation_	= memory::AllocationInfo{};
 		other.mappedPtr_	= nullptr;
 		other.size_			= 0;
-		other.transferFence_ = VK_NULL_HANDLE;
 	}
 	return *this;
 }
@@ -78,6 +99,11 @@ VkBufferUsageFlags Buffer::getVkUsageFlags() const {
 		flags |= VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
 	}
 
+	// Device local buffers can be moved by the defragmenter, which copies them into a new buffer
+	if (!(getMemoryFlags() & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)) {
+		flags |= VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	}
+
 	return flags;
 }
 
@@ -85,6 +111,9 @@ VkMemoryPropertyFlags Buffer::getMemoryFlags() const {
 	if (memoryType_ == BufferMemory::HOST_VISIBLE) {
 		return VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
 	}
+	if (memoryType_ == BufferMemory::HOST_READBACK) {
+		return VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+	}
 
 	switch (usage_) {
 	case BufferUsage::STATIC:
@@ -96,6 +125,10 @@ VkMemoryPropertyFlags Buffer::getMemoryFlags() const {
 	return VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
 }
 
+VkMemoryPropertyFlags Buffer::getPreferredMemoryFlags() const {
+	return memoryType_ == BufferMemory::HOST_READBACK ? VK_MEMORY_PROPERTY_HOST_CACHED_BIT : 0;
+}
+
 bool Buffer::create(device::GPU* gpu, size_t size, BufferType type, BufferUsage usage, BufferMemory memory) {
 	destroy();
 
@@ -109,16 +142,14 @@ bool Buffer::create(device::GPU* gpu, size_t size, BufferType type, BufferUsage
 		std::cerr << "GPU not initialized" << std::endl;
 		return false;
 	}
+	if (memoryType_ == BufferMemory::HOST_IMPORTED) {
+		std::cerr << "Host imported buffers are created with createFromHostPointer" << std::endl;
+		return false;
+	}
 
 	VkDevice vkDevice = gpu_->device;
 
-	VkBufferCreateInfo bufferInfo{};
-	bufferInfo.sType	   = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-	bufferInfo.size		   = size;
-	bufferInfo.usage	   = getVkUsageFlags();
-	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-	if (vkCreateBuffer(vkDevice, &bufferInfo, nullptr, &buffer_) != VK_SUCCESS) {
+	if (!createHandle(buffer_)) {
 		std::cerr << "Failed to create buffer" << std::endl;
 		return false;
 	}
@@ -126,28 +157,18 @@ bool Buffer::create(device::GPU* gpu, size_t size, BufferType type, BufferUsage
 	VkMemoryRequirements memRequirements;
 	vkGetBufferMemoryRequirements(vkDevice, buffer_, &memRequirements);
 
-	// Allocate memory
-	VkMemoryAllocateInfo allocInfo{};
-	allocInfo.sType			  = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize  = memRequirements.size;
-	allocInfo.memoryTypeIndex = device::findMemoryType(gpu->physicalDevice, memRequirements.memoryTypeBits, getMemoryFlags());
-
-	// Add device address allocation flag if needed
-	VkMemoryAllocateFlagsInfo flagsInfo{};
-	if (getVkUsageFlags() & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) {
-		flagsInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO;
-		flagsInfo.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT;
-		allocInfo.pNext = &flagsInfo;
-	}
-
-	if (vkAllocateMemory(vkDevice, &allocInfo, nullptr, &memory_) != VK_SUCCESS) {
+	// Sub-allocate from the GPU allocator; linear blocks are created with the device address flag
+	memory::MemoryCategory category = type_ == BufferType::STAGING ? memory::MemoryCategory::STAGING : memory::MemoryCategory::BUFFER;
+	if (!gpu_->allocator.allocate(memRequirements, getMemoryFlags(), getPreferredMemoryFlags(), memory::ResourceKind::LINEAR, allocation_, category)) {
 		std::cerr << "Failed to allocate buffer memory" << std::endl;
 		vkDestroyBuffer(vkDevice, buffer_, nullptr);
 		buffer_ = VK_NULL_HANDLE;
 		return false;
 	}
 
-	vkBindBufferMemory(vkDevice, buffer_, memory_, 0);
+	vkBindBufferMemory(vkDevice, buffer_, allocation_.memory, allocation_.offset);
+	registerOwner();
+	generation_++;
 
 	if (getVkUsageFlags() & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) {
 		VkBufferDeviceAddressInfo addressInfo{};
@@ -161,18 +182,177 @@ bool Buffer::create(device::GPU* gpu, size_t size, BufferType type, BufferUsage
 		persistentlyMapped_ = true;
 	}
 
-	VkFenceCreateInfo fenceInfo{};
-	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-	fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+	return true;
+}
+
+bool Buffer::createFromHostPointer(device::GPU* gpu, void* hostPointer, size_t size, BufferType type) {
+	destroy();
+
+	if (importHostPointer(gpu, hostPointer, size, type)) {
+		return true;
+	}
+
+	if (!create(gpu, size, type, BufferUsage::STATIC, BufferMemory::DEVICE_LOCAL)) {
+		return false;
+	}
+	return upload(hostPointer, size);
+}
+
+bool Buffer::importHostPointer(device::GPU* gpu, const void* hostPointer, size_t size, BufferType type) {
+	gpu_		= gpu;
+	size_		= size;
+	type_		= type;
+	usage_		= BufferUsage::STATIC;
+	memoryType_ = BufferMemory::HOST_IMPORTED;
+
+	if (!gpu_ || !gpu_->device || !gpu_->externalMemoryHostSupported || !hostPointer || size == 0) {
+		return false;
+	}
+
+	// Rounding the range out to whole alignment units would import memory the caller does not own
+	VkDeviceSize alignment = gpu_->minImportedHostPointerAlignment;
+	if (alignment == 0 || reinterpret_cast<uintptr_t>(hostPointer) % alignment != 0 || size % alignment != 0) {
+		return false;
+	}
+	void* importPtr = const_cast<void*>(hostPointer);
+
+	VkMemoryHostPointerPropertiesEXT pointerProperties{};
+	pointerProperties.sType = VK_STRUCTURE_TYPE_MEMORY_HOST_POINTER_PROPERTIES_EXT;
+	if (gpu_->getMemoryHostPointerProperties(gpu_->device, VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT, importPtr, &pointerProperties) !=
+		VK_SUCCESS) {
+		return false;
+	}
+
+	VkExternalMemoryBufferCreateInfo externalInfo{};
+	externalInfo.sType		 = VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_BUFFER_CREATE_INFO;
+	externalInfo.handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT;
 
-	if (vkCreateFence(vkDevice, &fenceInfo, nullptr, &transferFence_) != VK_SUCCESS) {
-		std::cerr << "Failed to create buffer fence" << std::endl;
-		transferFence_ = VK_NULL_HANDLE;
+	VkBuffer importedBuffer;
+	if (!createHandle(importedBuffer, &externalInfo)) {
+		return false;
+	}
+
+	VkMemoryRequirements memRequirements;
+	vkGetBufferMemoryRequirements(gpu_->device, importedBuffer, &memRequirements);
+
+	// Only coherent types, so the host side needs no flush or invalidate
+	VkPhysicalDeviceMemoryProperties memProperties;
+	vkGetPhysicalDeviceMemoryProperties(gpu_->physicalDevice, &memProperties);
+
+	uint32_t			  typeBits	= memRequirements.memoryTypeBits & pointerProperties.memoryTypeBits;
+	VkMemoryPropertyFlags required	= VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	uint32_t			  typeIndex = UINT32_MAX;
+	for (uint32_t i = 0; i < memProperties.memoryTypeCount && typeIndex == UINT32_MAX; i++) {
+		if ((typeBits & (1u << i)) && (memProperties.memoryTypes[i].propertyFlags & required) == required) {
+			typeIndex = i;
+		}
+	}
+
+	if (typeIndex == UINT32_MAX || memRequirements.size > size) {
+		vkDestroyBuffer(gpu_->device, importedBuffer, nullptr);
+		return false;
+	}
+
+	if (gpu_->hostImportCount.fetch_add(1) >= gpu_->maxHostImports) {
+		gpu_->hostImportCount--;
+		vkDestroyBuffer(gpu_->device, importedBuffer, nullptr);
+		return false;
 	}
 
+	VkImportMemoryHostPointerInfoEXT importInfo{};
+	importInfo.sType		= VK_STRUCTURE_TYPE_IMPORT_MEMORY_HOST_POINTER_INFO_EXT;
+	importInfo.handleType	= VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT;
+	importInfo.pHostPointer = importPtr;
+
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType			  = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.pNext			  = &importInfo;
+	allocInfo.allocationSize  = size;
+	allocInfo.memoryTypeIndex = typeIndex;
+
+	VkDeviceMemory memory;
+	if (vkAllocateMemory(gpu_->device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+		gpu_->hostImportCount--;
+		vkDestroyBuffer(gpu_->device, importedBuffer, nullptr);
+		return false;
+	}
+	if (vkBindBufferMemory(gpu_->device, importedBuffer, memory, 0) != VK_SUCCESS) {
+		vkFreeMemory(gpu_->device, memory, nullptr);
+		gpu_->hostImportCount--;
+		vkDestroyBuffer(gpu_->device, importedBuffer, nullptr);
+		return false;
+	}
+
+	// Not owned by the allocator: no block, so flush, invalidate, defragmentation and budgets skip it
+	buffer_						= importedBuffer;
+	allocation_					= memory::AllocationInfo{};
+	allocation_.memory			= memory;
+	allocation_.mappedData		= const_cast<void*>(hostPointer);
+	allocation_.offset			= 0;
+	allocation_.size			= size;
+	allocation_.memoryTypeIndex = typeIndex;
+	generation_++;
+
 	return true;
 }
 
+bool Buffer::createHandle(VkBuffer& outBuffer, const void* pNext) const {
+	VkBufferCreateInfo bufferInfo{};
+	bufferInfo.sType	   = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.pNext	   = pNext;
+	bufferInfo.size		   = size_;
+	bufferInfo.usage	   = getVkUsageFlags();
+	gpu_->setBufferSharing(bufferInfo);
+
+	if (vkCreateBuffer(gpu_->device, &bufferInfo, nullptr, &outBuffer) != VK_SUCCESS) {
+		outBuffer = VK_NULL_HANDLE;
+		return false;
+	}
+	return true;
+}
+
+bool Buffer::relocate(VkCommandBuffer cmd, VkBuffer& outNewBuffer, memory::AllocationInfo& outNewAllocation) {
+	if (!isValid() || mappedPtr_ || addressPinned_) return false;
+
+	VkBuffer newBuffer;
+	if (!createHandle(newBuffer)) return false;
+
+	VkMemoryRequirements memRequirements;
+	vkGetBufferMemoryRequirements(gpu_->device, newBuffer, &memRequirements);
+
+	memory::AllocationInfo newAllocation;
+	if (!gpu_->allocator.allocateMove(memRequirements, allocation_, newAllocation)) {
+		vkDestroyBuffer(gpu_->device, newBuffer, nullptr);
+		return false;
+	}
+	vkBindBufferMemory(gpu_->device, newBuffer, newAllocation.memory, newAllocation.offset);
+
+	VkBufferCopy copyRegion{};
+	copyRegion.size = size_;
+	vkCmdCopyBuffer(cmd, buffer_, newBuffer, 1, &copyRegion);
+
+	outNewBuffer	 = newBuffer;
+	outNewAllocation = newAllocation;
+	return true;
+}
+
+void Buffer::commitRelocation(VkBuffer& buffer, memory::AllocationInfo& allocation) {
+	// The old buffer stays alive until the copy has executed, but can no longer be picked for a move
+	gpu_->allocator.setOwner(allocation_, nullptr, memory::AllocationOwner::NONE);
+	std::swap(buffer_, buffer);
+	std::swap(allocation_, allocation);
+	gpu_->allocator.setOwner(allocation_, this, memory::AllocationOwner::BUFFER);
+
+	if (getVkUsageFlags() & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) {
+		VkBufferDeviceAddressInfo addressInfo{};
+		addressInfo.sType  = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
+		addressInfo.buffer = buffer_;
+		deviceAddress_	   = vkGetBufferDeviceAddress(gpu_->device, &addressInfo);
+	}
+
+	generation_++;
+}
+
 void Buffer::destroy() {
 	if (!gpu_ || buffer_ == VK_NULL_HANDLE) return;
 
@@ -182,35 +362,103 @@ void Buffer::destroy() {
 		unmap();
 	}
 
-	if (transferFence_ != VK_NULL_HANDLE) {
-		vkDestroyFence(vkDevice, transferFence_, nullptr);
-		transferFence_ = VK_NULL_HANDLE;
-	}
-
-	if (memory_ != VK_NULL_HANDLE) {
-		vkFreeMemory(vkDevice, memory_, nullptr);
-		memory_ = VK_NULL_HANDLE;
-	}
-
 	if (buffer_ != VK_NULL_HANDLE) {
 		vkDestroyBuffer(vkDevice, buffer_, nullptr);
 		buffer_ = VK_NULL_HANDLE;
 	}
 
+	if (memoryType_ == BufferMemory::HOST_IMPORTED) {
+		vkFreeMemory(vkDevice, allocation_.memory, nullptr);
+		gpu_->hostImportCount--;
+		allocation_ = memory::AllocationInfo{};
+	} else {
+		gpu_->allocator.free(allocation_);
+	}
+
 	size_				= 0;
 	mappedPtr_			= nullptr;
 	persistentlyMapped_ = false;
+	addressPinned_		= false;
+	tracking_			= false;
+	hostCopy_.clear();
+	dirtyRanges_.clear();
 }
 
-bool Buffer::resize(size_t newSize) {
+bool Buffer::resize(size_t newSize, bool deferRelease) {
 	if (!isValid()) return false;
+	if (newSize == size_) return true;
 
-	BufferType	 oldType  = type_;
-	BufferUsage	 oldUsage = usage_;
-	device::GPU* oldGpu	  = gpu_;
+	// The copy below reads what the device has
+	if (!flushDirty()) return false;
 
-	destroy();
-	return create(oldGpu, newSize, oldType, oldUsage);
+	Buffer resized;
+	if (!resized.create(gpu_, newSize, type_, usage_, memoryType_)) {
+		return false;
+	}
+
+	size_t keep = std::min(size_, newSize);
+	if (keep > 0 && usesHostVisibleMapping()) {
+		void* src = map();
+		void* dst = resized.map();
+		if (!src || !dst) return false;
+		invalidate(0, keep);
+		memcpy(dst, src, keep);
+		resized.flush(0, keep);
+	} else if (keep > 0) {
+		VkCommandBuffer cmd = gpu_->beginOneTimeCommands();
+
+		VkMemoryBarrier barrier{};
+		barrier.sType		  = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+		VkBufferCopy copyRegion{};
+		copyRegion.size = keep;
+		vkCmdCopyBuffer(cmd, buffer_, resized.buffer_, 1, &copyRegion);
+
+		gpu_->endOneTimeCommands(cmd);
+	}
+
+	// Take over the new handle; the old one is released now or once the queues are past it
+	VkBuffer			   oldBuffer	 = buffer_;
+	memory::AllocationInfo oldAllocation = allocation_;
+	gpu_->allocator.setOwner(oldAllocation, nullptr, memory::AllocationOwner::NONE);
+
+	buffer_				= resized.buffer_;
+	allocation_			= resized.allocation_;
+	deviceAddress_		= resized.deviceAddress_;
+	size_				= resized.size_;
+	mappedPtr_			= resized.mappedPtr_;
+	persistentlyMapped_ = resized.persistentlyMapped_;
+	registerOwner();
+	generation_++;
+	if (!hostCopy_.empty()) hostCopy_.resize(size_);
+
+	resized.buffer_		= VK_NULL_HANDLE;
+	resized.allocation_ = memory::AllocationInfo{};
+	resized.mappedPtr_	= nullptr;
+
+	if (deferRelease) {
+		gpu_->retireBuffer(oldBuffer, oldAllocation);
+	} else {
+		vkDestroyBuffer(gpu_->device, oldBuffer, nullptr);
+		gpu_->allocator.free(oldAllocation);
+	}
+
+	return true;
+}
+
+bool Buffer::reserve(size_t capacity, bool deferRelease) {
+	if (!isValid()) return false;
+	if (capacity <= size_) return true;
+
+	// Doubling keeps the cost of a sequence of appends linear in the final size
+	return resize(std::max(capacity, size_ * 2), deferRelease);
+}
+
+bool Buffer::usesHostVisibleMapping() const {
+	return usage_ == BufferUsage::DYNAMIC || usage_ == BufferUsage::STREAM || type_ == BufferType::STAGING || memoryType_ != BufferMemory::DEVICE_LOCAL;
 }
 
 bool Buffer::upload(const void* data, size_t size, size_t offset) {
@@ -220,38 +468,43 @@ bool Buffer::upload(const void* data, size_t size, size_t offset) {
 		return false;
 	}
 
-	const bool usesHostVisibleMapping = (usage_ == BufferUsage::DYNAMIC || usage_ == BufferUsage::STREAM || type_ == BufferType::STAGING);
-	if (!usesHostVisibleMapping && transferFence_ != VK_NULL_HANDLE) {
-		vkWaitForFences(gpu_->device, 1, &transferFence_, VK_TRUE, UINT64_MAX);
-		vkResetFences(gpu_->device, 1, &transferFence_);
+	if (tracking_) {
+		void* dst = mapTracked(offset, size);
+		if (!dst) return false;
+		memcpy(dst, data, size);
+		return true;
 	}
 
-	if (usesHostVisibleMapping) {
+	if (usesHostVisibleMapping()) {
 		void* dst = map();
 		if (!dst) return false;
 		memcpy(static_cast<char*>(dst) + offset, data, size);
+		flush(offset, size);
 		if (!persistentlyMapped_) unmap();
 		return true;
 	}
 
-	Buffer staging;
-	if (!staging.create(gpu_, size, BufferType::STAGING, BufferUsage::STREAM)) {
+	if (memory::UploadBatch* batch = gpu_->getUploadBatch()) {
+		return batch->upload(*this, data, size, offset);
+	}
+
+	memory::StagingAllocation staging = gpu_->stagingPool.acquire(size);
+	if (!staging.isValid()) {
 		return false;
 	}
 
-	void* dst = staging.map();
-	memcpy(dst, data, size);
-	staging.unmap();
+	memcpy(staging.data, data, size);
 
 	VkCommandBuffer cmd = gpu_->beginOneTimeCommands();
 
 	VkBufferCopy copyRegion{};
-	copyRegion.srcOffset = 0;
+	copyRegion.srcOffset = staging.offset;
 	copyRegion.dstOffset = offset;
 	copyRegion.size		 = size;
-	vkCmdCopyBuffer(cmd, staging.getHandle(), buffer_, 1, &copyRegion);
+	vkCmdCopyBuffer(cmd, staging.buffer, buffer_, 1, &copyRegion);
 
 	gpu_->endOneTimeCommands(cmd);
+	gpu_->stagingPool.release(staging);
 
 	return true;
 }
@@ -263,22 +516,22 @@ bool Buffer::download(void* data, size_t size, size_t offset) {
 		return false;
 	}
 
-	const bool usesHostVisibleMapping = (usage_ == BufferUsage::DYNAMIC || usage_ == BufferUsage::STREAM || type_ == BufferType::STAGING);
-	if (!usesHostVisibleMapping && transferFence_ != VK_NULL_HANDLE) {
-		vkWaitForFences(gpu_->device, 1, &transferFence_, VK_TRUE, UINT64_MAX);
-		vkResetFences(gpu_->device, 1, &transferFence_);
+	if (!hostCopy_.empty()) {
+		memcpy(data, hostCopy_.data() + offset, size);
+		return true;
 	}
 
-	if (usesHostVisibleMapping) {
+	if (usesHostVisibleMapping()) {
 		void* src = map();
 		if (!src) return false;
+		invalidate(offset, size);
 		memcpy(data, static_cast<char*>(src) + offset, size);
 		if (!persistentlyMapped_) unmap();
 		return true;
 	}
 
-	Buffer staging;
-	if (!staging.create(gpu_, size, BufferType::STAGING, BufferUsage::STREAM)) {
+	memory::StagingAllocation staging = gpu_->stagingPool.acquire(size, memory::StagingUsage::READBACK);
+	if (!staging.isValid()) {
 		return false;
 	}
 
@@ -286,15 +539,15 @@ bool Buffer::download(void* data, size_t size, size_t offset) {
 
 	VkBufferCopy copyRegion{};
 	copyRegion.srcOffset = offset;
-	copyRegion.dstOffset = 0;
+	copyRegion.dstOffset = staging.offset;
 	copyRegion.size		 = size;
-	vkCmdCopyBuffer(cmd, buffer_, staging.getHandle(), 1, &copyRegion);
+	vkCmdCopyBuffer(cmd, buffer_, staging.buffer, 1, &copyRegion);
 
 	gpu_->endOneTimeCommands(cmd);
 
-	void* src = staging.map();
-	memcpy(data, src, size);
-	staging.unmap();
+	gpu_->stagingPool.invalidate(staging);
+	memcpy(data, staging.data, size);
+	gpu_->stagingPool.release(staging);
 
 	return true;
 }
@@ -303,20 +556,198 @@ void* Buffer::map() {
 	if (!isValid()) return nullptr;
 	if (mappedPtr_) return mappedPtr_;
 
-	VkDevice vkDevice = gpu_->device;
-	if (vkMapMemory(vkDevice, memory_, 0, size_, 0, &mappedPtr_) != VK_SUCCESS) {
+	// Host visible blocks are persistently mapped by the allocator
+	mappedPtr_ = gpu_->allocator.mapMemory(allocation_);
+	if (!mappedPtr_) {
 		std::cerr << "Failed to map buffer memory" << std::endl;
 		return nullptr;
 	}
 	return mappedPtr_;
 }
 
+void Buffer::flush(size_t offset, size_t size) {
+	if (!isValid()) return;
+	gpu_->allocator.flush(allocation_, offset, size == SIZE_MAX ? VK_WHOLE_SIZE : size);
+}
+
+void Buffer::invalidate(size_t offset, size_t size) {
+	if (!isValid()) return;
+	gpu_->allocator.invalidate(allocation_, offset, size == SIZE_MAX ? VK_WHOLE_SIZE : size);
+}
+
 void Buffer::unmap() {
 	if (!isValid() || !mappedPtr_) return;
 
-	VkDevice vkDevice = gpu_->device;
-	vkUnmapMemory(vkDevice, memory_);
+	gpu_->allocator.unmapMemory(allocation_);
 	mappedPtr_ = nullptr;
 }
 
-VkDeviceAddress Buffer::getDeviceAddress() const { return deviceAddress_; }
+VkDeviceAddress Buffer::getDeviceAddress() const {
+	// The application may store the address anywhere, so the buffer must stay where it is
+	if (deviceAddress_ != 0 && !addressPinned_) {
+		addressPinned_ = true;
+		gpu_->allocator.setOwner(allocation_, nullptr, memory::AllocationOwner::NONE);
+	}
+	return deviceAddress_;
+}
+
+// Allocations with an owner are candidates for defragmentation moves
+void Buffer::registerOwner() {
+	if (!gpu_) return;
+	if (addressPinned_) {
+		gpu_->allocator.setOwner(allocation_, nullptr, memory::AllocationOwner::NONE);
+	} else {
+		gpu_->allocator.setOwner(allocation_, this, memory::AllocationOwner::BUFFER);
+	}
+}
+
+// ============================================================================
+// Dirty Range Tracking
+// ============================================================================
+
+bool Buffer::setDirtyTracking(bool enable) {
+	if (!isValid()) return false;
+	if (enable == tracking_) return true;
+
+	if (!enable) {
+		bool flushed = flushDirty();
+		tracking_	 = false;
+		hostCopy_.clear();
+		hostCopy_.shrink_to_fit();
+		return flushed;
+	}
+
+	if (!usesHostVisibleMapping()) {
+		// The host copy would hide what shaders write, and flushing it would overwrite that
+		if (type_ == BufferType::STORAGE) {
+			std::cerr << "Dirty tracking of device local storage buffers is not supported" << std::endl;
+			return false;
+		}
+		hostCopy_.resize(size_);
+		if (!download(hostCopy_.data(), size_)) {
+			hostCopy_.clear();
+			return false;
+		}
+	}
+
+	tracking_ = true;
+	return true;
+}
+
+void* Buffer::mapTracked(size_t offset, size_t size) {
+	if (!isValid() || !tracking_ || offset + size > size_) return nullptr;
+
+	char* base = hostCopy_.empty() ? static_cast<char*>(map()) : reinterpret_cast<char*>(hostCopy_.data());
+	if (!base) return nullptr;
+
+	markDirty(offset, size);
+	return base + offset;
+}
+
+void Buffer::markDirty(size_t offset, size_t size) {
+	if (!tracking_ || size == 0 || offset >= size_) return;
+
+	DirtyRange range{offset, std::min(offset + size, size_)};
+
+	// Absorb every range that overlaps or nearly touches the new one
+	auto first = std::lower_bound(
+			dirtyRanges_.begin(), dirtyRanges_.end(), range.begin, [](const DirtyRange& r, size_t begin) { return r.end + kDirtyMergeGap < begin; });
+	auto last = first;
+	while (last != dirtyRanges_.end() && last->begin <= range.end + kDirtyMergeGap) {
+		range.begin = std::min(range.begin, last->begin);
+		range.end	= std::max(range.end, last->end);
+		++last;
+	}
+
+	first = dirtyRanges_.erase(first, last);
+	dirtyRanges_.insert(first, range);
+}
+
+size_t Buffer::getDirtyBytes() const {
+	size_t bytes = 0;
+	for (const auto& range : dirtyRanges_) {
+		bytes += range.end - range.begin;
+	}
+	return bytes;
+}
+
+bool Buffer::flushDirty() {
+	if (dirtyRanges_.empty()) return true;
+
+	if (hostCopy_.empty()) {
+		return flushDirty(VK_NULL_HANDLE, memory::FrameAllocation{});
+	}
+
+	memory::StagingAllocation staging = gpu_->stagingPool.acquire(getDirtyBytes());
+	if (!staging.isValid()) {
+		return false;
+	}
+
+	memory::FrameAllocation source;
+	source.buffer = staging.buffer;
+	source.offset = staging.offset;
+	source.size	  = staging.size;
+	source.data	  = staging.data;
+
+	VkCommandBuffer cmd = gpu_->beginOneTimeCommands();
+	flushDirty(cmd, source);
+	gpu_->endOneTimeCommands(cmd);
+	gpu_->stagingPool.release(staging);
+
+	return true;
+}
+
+bool Buffer::flushDirty(VkCommandBuffer cmd, const memory::FrameAllocation& staging) {
+	if (dirtyRanges_.empty()) return true;
+
+	// Host visible memory is written in place, only non coherent memory needs a flush
+	if (hostCopy_.empty()) {
+		for (const auto& range : dirtyRanges_) {
+			flush(range.begin, range.end - range.begin);
+		}
+		dirtyRanges_.clear();
+		return true;
+	}
+
+	// What does not fit in staging stays dirty for the next flush; a blocking flush here would run
+	// its copies out of order with the work recorded into cmd
+	VkDeviceSize available = staging.isValid() ? staging.size : 0;
+	VkDeviceSize packed	   = 0;
+	size_t		 done	   = 0;
+	dirtyCopies_.clear();
+	for (auto& range : dirtyRanges_) {
+		if (packed == available) break;
+
+		size_t bytes = static_cast<size_t>(std::min<VkDeviceSize>(range.end - range.begin, available - packed));
+		memcpy(static_cast<char*>(staging.data) + packed, hostCopy_.data() + range.begin, bytes);
+
+		VkBufferCopy region{};
+		region.srcOffset = staging.offset + packed;
+		region.dstOffset = range.begin;
+		region.size		 = bytes;
+		dirtyCopies_.push_back(region);
+
+		packed += bytes;
+		range.begin += bytes;
+		if (range.begin != range.end) break;
+		done++;
+	}
+	dirtyRanges_.erase(dirtyRanges_.begin(), dirtyRanges_.begin() + done);
+
+	if (dirtyCopies_.empty()) return false;
+
+	// Earlier frames may still read the ranges being overwritten
+	VkMemoryBarrier barrier{};
+	barrier.sType		  = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+	vkCmdCopyBuffer(cmd, staging.buffer, buffer_, static_cast<uint32_t>(dirtyCopies_.size()), dirtyCopies_.data());
+
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+	return dirtyRanges_.empty();
+}
@@ -3,19 +3,34 @@
 
 #include "renderDevice.hpp"
 
+#include <cstdint>
 #include <cstring>
 #include <vector>
 #include <vulkan/vulkan_core.h>
 
+namespace renderApi::memory {
+	class Defragmenter;
+	class StreamLoader;
+	class TransferManager;
+	class UploadBatch;
+}
+
 namespace renderApi {
 
 	enum class BufferType { VERTEX, INDEX, UNIFORM, STORAGE, STAGING, TRANSFER_SRC, TRANSFER_DST };
 
 	enum class BufferUsage { STATIC, DYNAMIC, STREAM };
 
-	enum class BufferMemory { DEVICE_LOCAL, HOST_VISIBLE };
+	// HOST_READBACK prefers HOST_CACHED memory for fast host reads; it may not be coherent, see invalidate()
+	// HOST_IMPORTED buffers are backed by application memory, see createFromHostPointer()
+	enum class BufferMemory { DEVICE_LOCAL, HOST_VISIBLE, HOST_READBACK, HOST_IMPORTED };
 
 	class Buffer {
+		friend class memory::Defragmenter;
+		friend class memory::StreamLoader;
+		friend class memory::TransferManager;
+		friend class memory::UploadBatch;
+
 	  public:
 		Buffer();
 		~Buffer();
@@ -29,27 +44,69 @@ namespace renderApi {
 					   BufferType	type,
 					   BufferUsage	usage  = BufferUsage::STATIC,
 					   BufferMemory memory = BufferMemory::DEVICE_LOCAL);
+		// Imports hostPointer with VK_EXT_external_memory_host so the device reads the application's
+		// memory directly; it must stay allocated until the buffer is destroyed. hostPointer and size must
+		// be multiples of GPU::minImportedHostPointerAlignment. Without the extension, when they are not,
+		// or past GPU::maxHostImports, this falls back to a device local copy of the data. This is the
+		// only way to import: upload() always copies through staging.
+		bool	createFromHostPointer(device::GPU* context, void* hostPointer, size_t size, BufferType type);
 		void	destroy();
-		bool	resize(size_t newSize);
+		// Keeps the first min(old, new) bytes, copied on the GPU for device local buffers. The handle
+		// changes: descriptors notice it through getGeneration(), and the device address must be queried
+		// again. With deferRelease the old buffer lives on until the work already submitted on every
+		// queue finished, otherwise it is destroyed at once.
+		bool	resize(size_t newSize, bool deferRelease = false);
+		// Grows to at least capacity bytes, doubling the current size if that is larger
+		bool	reserve(size_t capacity, bool deferRelease = false);
 		bool	upload(const void* data, size_t size, size_t offset = 0);
 		bool	download(void* data, size_t size, size_t offset = 0);
 		void*	map();
 		void	unmap();
+		// Needed around direct access to the mapped pointer of non coherent memory: flush after host
+		// writes, invalidate before host reads of what the device wrote. upload/download do it.
+		void	flush(size_t offset = 0, size_t size = SIZE_MAX);
+		void	invalidate(size_t offset = 0, size_t size = SIZE_MAX);
 
 		template <typename T> bool update(const std::vector<T>& data) { return upload(data.data(), data.size() * sizeof(T)); }
 
+		// With dirty tracking, upload() and mapTracked() only record the ranges they write, and
+		// flushDirty() sends them to the device merged into as few copies (device local) or flushes
+		// (non coherent memory) as possible. Device local buffers keep a host copy of their contents
+		// for this, which download() then reads, so they must only be written by the host: enabling
+		// it fails for device local STORAGE buffers. GpuTask::execute() flushes the buffers it uses.
+		bool  setDirtyTracking(bool enable);
+		// The returned pointer may be written for the given range until the next flush
+		void* mapTracked(size_t offset, size_t size);
+		void  markDirty(size_t offset, size_t size);
+		// Submits and waits for the copies
+		bool  flushDirty();
+		// Records the copies into cmd, from staging that lives until cmd executed. When staging holds
+		// less than getDirtyBytes(), only what fits is copied and the rest stays dirty for the next
+		// flush; returns whether everything was copied.
+		bool  flushDirty(VkCommandBuffer cmd, const memory::FrameAllocation& staging);
+		bool  isDirtyTracking() const { return tracking_; }
+		bool  hasHostCopy() const { return !hostCopy_.empty(); }
+		bool  hasDirtyRanges() const { return !dirtyRanges_.empty(); }
+		size_t getDirtyBytes() const;
+		size_t getDirtyRangeCount() const { return dirtyRanges_.size(); }
+
 		VkBuffer		getHandle() const { return buffer_; }
-		VkDeviceMemory	getMemory() const { return memory_; }
+		VkDeviceMemory	getMemory() const { return allocation_.memory; }
+		VkDeviceSize	getMemoryOffset() const { return allocation_.offset; }
+		// Pins the buffer: once its address was handed out, the Defragmenter no longer moves it
 		VkDeviceAddress getDeviceAddress() const;
 		size_t			getSize() const { return size_; }
 		BufferType		getType() const { return type_; }
+		uint64_t		getGeneration() const { return generation_; }
 		bool			isValid() const { return buffer_ != VK_NULL_HANDLE; }
 		bool			isMapped() const { return mappedPtr_ != nullptr; }
+		bool			isCoherent() const { return !isValid() || gpu_->allocator.isCoherent(allocation_); }
+		bool			isHostImported() const { return isValid() && memoryType_ == BufferMemory::HOST_IMPORTED; }
 
 	  private:
 		device::GPU*	gpu_;
 		VkBuffer		buffer_;
-		VkDeviceMemory	memory_;
+		memory::AllocationInfo allocation_;
 		VkDeviceAddress deviceAddress_;
 		size_t			size_;
 		BufferType		type_;
@@ -57,10 +114,29 @@ namespace renderApi {
 		BufferMemory	memoryType_;
 		void*			mappedPtr_;
 		bool			persistentlyMapped_;
-		VkFence			transferFence_;
+		uint64_t		generation_; // Bumped whenever the handle changes, descriptors compare it to know when to rewrite
+		mutable bool	addressPinned_; // Set by getDeviceAddress(), keeps the Defragmenter from moving the buffer
+
+		struct DirtyRange {
+			size_t begin;
+			size_t end;
+		};
+		bool					tracking_;
+		std::vector<uint8_t>	hostCopy_;	  // Contents of a tracked device local buffer
+		std::vector<DirtyRange> dirtyRanges_; // Sorted, apart by more than kDirtyMergeGap
+		std::vector<VkBufferCopy> dirtyCopies_; // Scratch of flushDirty(), keeps its capacity across frames
 
 		VkBufferUsageFlags	  getVkUsageFlags() const;
 		VkMemoryPropertyFlags getMemoryFlags() const;
+		VkMemoryPropertyFlags getPreferredMemoryFlags() const;
+		bool				  usesHostVisibleMapping() const;
+		bool				  createHandle(VkBuffer& outBuffer, const void* pNext = nullptr) const;
+		void				  registerOwner();
+		bool				  importHostPointer(device::GPU* gpu, const void* hostPointer, size_t size, BufferType type);
+		// Records a copy into a new buffer placed by the allocator; commitRelocation() switches to it once
+		// the copy was submitted and hands back the old buffer, to release after the copy executed
+		bool				  relocate(VkCommandBuffer cmd, VkBuffer& outNewBuffer, memory::AllocationInfo& outNewAllocation);
+		void				  commitRelocation(VkBuffer& buffer, memory::AllocationInfo& allocation);
 	};
 
 	template <typename VertexType> Buffer createVertexBuffer(device::GPU* gpu, const std::vector<VertexType>& vertices) {
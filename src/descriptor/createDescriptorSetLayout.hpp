@@ -6,8 +6,10 @@
 
 namespace renderApi {
 	class Buffer;
+	enum class BufferType;
 }
 
+VkDescriptorType		bufferTypeToDescriptorType(renderApi::BufferType type);
 VkDescriptorSetLayout	createDescriptorSetLayoutFromBuffers(VkDevice device, const std::vector<renderApi::Buffer*>& buffers, const std::vector<VkShaderStageFlags>& stages);
 VkDescriptorSetLayout	createDescriptorSetLayout(VkDevice device, const std::vector<VkDescriptorSetLayoutBinding>& bindings);
 void					destroyDescriptorSetLayout(VkDevice device, VkDescriptorSetLayout layout);
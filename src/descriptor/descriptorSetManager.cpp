@@ -15,14 +15,15 @@
 using namespace renderApi::descriptor;
 
 DescriptorSet::DescriptorSet()
-	: gpu_(nullptr), descriptorSet_(VK_NULL_HANDLE), layout_(VK_NULL_HANDLE) {}
+	: gpu_(nullptr), descriptorSet_(VK_NULL_HANDLE), layout_(VK_NULL_HANDLE), writtenGeneration_(0) {}
 
 DescriptorSet::~DescriptorSet() {
 	destroy();
 }
 
 DescriptorSet::DescriptorSet(DescriptorSet&& other) noexcept
-	: gpu_(other.gpu_), descriptorSet_(other.descriptorSet_), layout_(other.layout_), bindings_(std::move(other.bindings_)) {
+	: gpu_(other.gpu_), descriptorSet_(other.descriptorSet_), layout_(other.layout_), bindings_(std::move(other.bindings_)),
+	  writtenGeneration_(other.writtenGeneration_) {
 	other.descriptorSet_ = VK_NULL_HANDLE;
 	other.layout_ = VK_NULL_HANDLE;
 }
@@ -34,6 +35,7 @@ DescriptorSet& DescriptorSet::operator=(DescriptorSet&& other) noexcept {
 		descriptorSet_ = other.descriptorSet_;
 		layout_ = other.layout_;
 		bindings_ = std::move(other.bindings_);
+		writtenGeneration_ = other.writtenGeneration_;
 		other.descriptorSet_ = VK_NULL_HANDLE;
 		other.layout_ = VK_NULL_HANDLE;
 	}
@@ -190,10 +192,6 @@ void DescriptorSet::update() {
 		return;
 	}
 
-	std::cout << "=== DescriptorSet::update() called ===" << std::endl;
-	std::cout << "  DescriptorSet handle: " << descriptorSet_ << std::endl;
-	std::cout << "  Number of bindings: " << bindings_.size() << std::endl;
-
 	std::vector<VkWriteDescriptorSet> writes;
 	std::vector<VkDescriptorBufferInfo> bufferInfos;
 	std::vector<VkDescriptorImageInfo> imageInfos;
@@ -203,8 +201,6 @@ void DescriptorSet::update() {
 	imageInfos.reserve(bindings_.size());
 
 	for (const auto& binding : bindings_) {
-		std::cout << "  Processing binding " << binding.binding << " (type=" << static_cast<int>(binding.type)
-		          << ", count=" << binding.count << ")" << std::endl;
 		VkWriteDescriptorSet write{};
 		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 		write.dstSet = descriptorSet_;
@@ -221,7 +217,6 @@ void DescriptorSet::update() {
 			bufferInfos.push_back(bufferInfo);
 			write.pBufferInfo = &bufferInfos.back();
 		} else if (!binding.textureArray.empty()) {
-			std::cout << "    Texture array with " << binding.textureArray.size() << " textures:" << std::endl;
 			size_t startIdx = imageInfos.size();
 			for (size_t i = 0; i < binding.textureArray.size(); ++i) {
 				auto* tex = binding.textureArray[i];
@@ -229,9 +224,6 @@ void DescriptorSet::update() {
 				imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 				imageInfo.imageView = tex->getImageView();
 				imageInfo.sampler = tex->getSamplerHandle();
-				std::cout << "      [" << i << "] imageView=" << imageInfo.imageView
-				          << " sampler=" << imageInfo.sampler
-				          << " isValid=" << (tex->isValid() ? "yes" : "NO") << std::endl;
 				imageInfos.push_back(imageInfo);
 			}
 			write.pImageInfo = &imageInfos[startIdx];
@@ -265,10 +257,31 @@ void DescriptorSet::update() {
 		writes.push_back(write);
 	}
 
-	std::cout << "  Calling vkUpdateDescriptorSets with " << writes.size() << " writes" << std::endl;
 	vkUpdateDescriptorSets(gpu_->device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
-	std::cout << "  vkUpdateDescriptorSets completed successfully" << std::endl;
-	std::cout << "=======================================" << std::endl;
+	writtenGeneration_ = getResourceGeneration();
+}
+
+uint64_t DescriptorSet::getResourceGeneration() const {
+	// Generations only ever grow, so their sum changes whenever any of them does
+	uint64_t generation = 0;
+	for (const auto& binding : bindings_) {
+		if (binding.buffer) {
+			generation += binding.buffer->getGeneration();
+		} else if (!binding.textureArray.empty()) {
+			for (const auto* texture : binding.textureArray) {
+				generation += texture->getGeneration();
+			}
+		} else if (binding.texture) {
+			generation += binding.texture->getGeneration();
+		} else if (binding.image) {
+			generation += binding.image->getGeneration();
+		}
+	}
+	return generation;
+}
+
+bool DescriptorSet::isOutdated() const {
+	return descriptorSet_ != VK_NULL_HANDLE && getResourceGeneration() != writtenGeneration_;
 }
 
 void DescriptorSet::destroy() {
@@ -345,6 +358,18 @@ void DescriptorSetManager::clearSets() {
 	setIndices_.clear();
 }
 
+bool DescriptorSetManager::isOutdated() const {
+	return std::any_of(sets_.begin(), sets_.end(), [](const DescriptorSet& set) { return set.isOutdated(); });
+}
+
+void DescriptorSetManager::refresh() {
+	for (auto& set : sets_) {
+		if (set.isOutdated()) {
+			set.update();
+		}
+	}
+}
+
 bool DescriptorSetManager::createPool() {
 	if (!gpu_ || !gpu_->device) {
 		std::cerr << "GPU not initialized" << std::endl;
@@ -467,11 +492,15 @@ std::vector<VkDescriptorSetLayout> DescriptorSetManager::getLayouts() const {
 
 std::vector<VkDescriptorSet> DescriptorSetManager::getDescriptorSets() const {
 	std::vector<VkDescriptorSet> descriptorSets;
-	descriptorSets.reserve(sets_.size());
+	getDescriptorSets(descriptorSets);
+	return descriptorSets;
+}
+
+void DescriptorSetManager::getDescriptorSets(std::vector<VkDescriptorSet>& sets) const {
+	sets.clear();
+	sets.reserve(sets_.size());
 
 	for (const auto& set : sets_) {
-		descriptorSets.push_back(set.getHandle());
+		sets.push_back(set.getHandle());
 	}
-
-	return descriptorSets;
 }
@@ -62,6 +62,9 @@ namespace renderApi::descriptor {
 		void update();
 		void destroy();
 
+		// True once a bound resource got a new handle (moved or recreated) since the last update()
+		bool isOutdated() const;
+
 		VkDescriptorSet		  getHandle() const { return descriptorSet_; }
 		VkDescriptorSetLayout getLayout() const { return layout_; }
 		bool				  isBuilt() const { return descriptorSet_ != VK_NULL_HANDLE; }
@@ -73,8 +76,10 @@ namespace renderApi::descriptor {
 		VkDescriptorSet					descriptorSet_;
 		VkDescriptorSetLayout			layout_;
 		std::vector<DescriptorBinding>	bindings_;
+		uint64_t						writtenGeneration_;
 
 		VkDescriptorType convertDescriptorType(DescriptorType type) const;
+		uint64_t		 getResourceGeneration() const;
 	};
 
 	class DescriptorSetManager {
@@ -95,9 +100,15 @@ namespace renderApi::descriptor {
 		bool build(device::GPU* gpu);
 		void destroy();
 
+		// Rewrite the sets whose resources changed handle; only call when no submitted work uses them
+		bool isOutdated() const;
+		void refresh();
+
 		// Get layouts for pipeline creation
 		std::vector<VkDescriptorSetLayout> getLayouts() const;
 		std::vector<VkDescriptorSet>	   getDescriptorSets() const;
+		// Same, into sets, whose storage is reused
+		void getDescriptorSets(std::vector<VkDescriptorSet>& sets) const;
 
 		uint32_t getSetCount() const { return static_cast<uint32_t>(sets_.size()); }
 		bool	 isBuilt() const { return pool_ != VK_NULL_HANDLE; }
@@ -6,6 +6,7 @@
 #include <future>
 #include <iostream>
 #include <stdexcept>
+#include <thread>
 #include <vector>
 #include <vulkan/vulkan_core.h>
 
@@ -98,21 +99,6 @@ VkPhysicalDevice renderApi::device::selectBestPhysicalDevice(VkInstance instance
 	return devices[0].device;
 }
 
-InitDeviceResult renderApi::device::finishDeviceInitialization(GPU& gpu) {
-	if (!gpu.device) return VK_CREATE_DEVICE_FAILED;
-
-	gpu.queueFamilies = findQueueFamilies(gpu.physicalDevice);
-
-	VkCommandPoolCreateInfo poolInfo{};
-	poolInfo.sType			  = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-	poolInfo.queueFamilyIndex = gpu.queueFamilies.graphicsFamily >= 0 ? gpu.queueFamilies.graphicsFamily : gpu.queueFamilies.computeFamily;
-	poolInfo.flags			  = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-
-	if (vkCreateCommandPool(gpu.device, &poolInfo, nullptr, &gpu.commandPool) != VK_SUCCESS) return VK_CREATE_DEVICE_FAILED;
-
-	return INIT_DEVICE_SUCCESS;
-}
-
 GPU::~GPU() {
 	running = false;
 
@@ -129,11 +115,13 @@ GPU::~GPU() {
 void GPU::cleanup() {
 	if (device) {
 		vkDeviceWaitIdle(device);
+		releaseRetired(true);
 
-		if (commandPool) {
-			vkDestroyCommandPool(device, commandPool, nullptr);
-			commandPool = VK_NULL_HANDLE;
-		}
+		oneTimeCommands.destroy();
+
+		transfers.cleanup();
+		stagingPool.cleanup();
+		allocator.cleanup();
 
 		vkDestroyDevice(device, nullptr);
 		device = VK_NULL_HANDLE;
@@ -147,15 +135,34 @@ void GPU::cleanup() {
 	instance	   = VK_NULL_HANDLE;
 }
 
+void GPU::setBufferSharing(VkBufferCreateInfo& info) const {
+	bool shared				   = bufferQueueFamilyCount > 1;
+	info.sharingMode		   = shared ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+	info.queueFamilyIndexCount = shared ? bufferQueueFamilyCount : 0;
+	info.pQueueFamilyIndices   = shared ? bufferQueueFamilies : nullptr;
+}
+
 VkCommandBuffer GPU::beginOneTimeCommands() {
-	VkCommandBufferAllocateInfo allocInfo{};
-	allocInfo.sType				 = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-	allocInfo.level				 = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-	allocInfo.commandPool		 = commandPool;
-	allocInfo.commandBufferCount = 1;
+	// Whatever the caller records may depend on the collected uploads
+	if (renderApi::memory::UploadBatch* batch = getUploadBatch(); batch && !batch->isEmpty()) {
+		batch->submit();
+	}
+
+	// Held until endOneTimeCommands() waited for the commands
+	lockUploads();
 
 	VkCommandBuffer commandBuffer;
-	vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer);
+	{
+		// Once none is pending, every buffer handed out so far has completed and the pool is reset at once
+		std::lock_guard<std::mutex> lock(oneTimeMutex);
+		if (oneTimePending == 0) oneTimeCommands.beginFrame(0);
+		commandBuffer = oneTimeCommands.allocate();
+		if (commandBuffer == VK_NULL_HANDLE) {
+			unlockUploads();
+			return VK_NULL_HANDLE;
+		}
+		oneTimePending++;
+	}
 
 	VkCommandBufferBeginInfo beginInfo{};
 	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -184,7 +191,118 @@ void GPU::endOneTimeCommands(VkCommandBuffer commandBuffer) {
 		vkQueueWaitIdle(queue);
 	}
 
-	vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
+	{
+		std::lock_guard<std::mutex> lock(oneTimeMutex);
+		oneTimePending--;
+	}
+	unlockUploads();
+}
+
+void GPU::lockUploads() {
+	std::unique_lock<std::mutex> lock(uploadMutex);
+	uploadCondition.wait(lock, [this] { return !relocating; });
+	activeUploads++;
+}
+
+void GPU::unlockUploads() {
+	std::lock_guard<std::mutex> lock(uploadMutex);
+	activeUploads--;
+}
+
+bool GPU::tryLockRelocation() {
+	std::lock_guard<std::mutex> lock(uploadMutex);
+	if (activeUploads > 0 || relocating) return false;
+	relocating = true;
+	return true;
+}
+
+void GPU::unlockRelocation() {
+	{
+		std::lock_guard<std::mutex> lock(uploadMutex);
+		relocating = false;
+	}
+	uploadCondition.notify_all();
+}
+
+renderApi::memory::UploadBatch GPU::beginUploadBatch() { return renderApi::memory::UploadBatch(this); }
+
+renderApi::memory::UploadBatch* GPU::getUploadBatch() {
+	std::lock_guard<std::mutex> lock(uploadBatchMutex);
+	auto						it = uploadBatches.find(std::this_thread::get_id());
+	return it != uploadBatches.end() ? it->second : nullptr;
+}
+
+void GPU::retireBuffer(VkBuffer buffer, const memory::AllocationInfo& allocation) {
+	RetiredResource retired;
+	retired.buffer	   = buffer;
+	retired.allocation = allocation;
+	retire(std::move(retired));
+}
+
+void GPU::retireImage(VkImage image, VkImageView view, const memory::AllocationInfo& allocation) {
+	RetiredResource retired;
+	retired.image	   = image;
+	retired.view	   = view;
+	retired.allocation = allocation;
+	retire(std::move(retired));
+}
+
+void GPU::retire(RetiredResource&& retired) {
+	VkFenceCreateInfo fenceInfo{};
+	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+	{
+		// An empty submission signals its fence once everything submitted before it on the queue completed
+		std::lock_guard<std::mutex> lock(queueMutex);
+		std::vector<VkQueue>		queues;
+		for (const auto* family : {&graphicsQueues, &computeQueues, &transferQueues}) {
+			for (VkQueue queue : *family) {
+				if (std::find(queues.begin(), queues.end(), queue) != queues.end()) continue;
+				queues.push_back(queue);
+
+				VkFence fence;
+				if (vkCreateFence(device, &fenceInfo, nullptr, &fence) != VK_SUCCESS) continue;
+				if (vkQueueSubmit(queue, 0, nullptr, fence) != VK_SUCCESS) {
+					vkDestroyFence(device, fence, nullptr);
+					vkQueueWaitIdle(queue);
+					continue;
+				}
+				retired.fences.push_back(fence);
+			}
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(retiredMutex);
+		retiredResources.push_back(std::move(retired));
+	}
+
+	releaseRetired();
+}
+
+void GPU::releaseRetired(bool wait) {
+	std::lock_guard<std::mutex> lock(retiredMutex);
+
+	auto it = retiredResources.begin();
+	while (it != retiredResources.end()) {
+		if (!it->fences.empty()) {
+			if (wait) {
+				vkWaitForFences(device, static_cast<uint32_t>(it->fences.size()), it->fences.data(), VK_TRUE, UINT64_MAX);
+			} else if (vkWaitForFences(device, static_cast<uint32_t>(it->fences.size()), it->fences.data(), VK_TRUE, 0) != VK_SUCCESS) {
+				++it;
+				continue;
+			}
+		}
+
+		for (VkFence fence : it->fences) {
+			vkDestroyFence(device, fence, nullptr);
+		}
+		if (it->buffer != VK_NULL_HANDLE) vkDestroyBuffer(device, it->buffer, nullptr);
+		if (it->view != VK_NULL_HANDLE) vkDestroyImageView(device, it->view, nullptr);
+		if (it->image != VK_NULL_HANDLE) vkDestroyImage(device, it->image, nullptr);
+		allocator.free(it->allocation);
+		it = retiredResources.erase(it);
+	}
 }
 
 VkQueue GPU::getPresentQueue() {
@@ -2,13 +2,21 @@
 #define RENDER_DEVICE_HPP
 
 #include "../gpuTask/gpuTask.hpp"
+#include "../memory/commandAllocator.hpp"
+#include "../memory/memoryAllocator.hpp"
+#include "../memory/stagingPool.hpp"
+#include "../memory/transferManager.hpp"
+#include "../memory/uploadBatch.hpp"
 #include "../utils/utils.hpp"
 
 #include <atomic>
+#include <condition_variable>
 #include <cstdint>
 #include <future>
 #include <mutex>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 #include <vulkan/vulkan_core.h>
 
@@ -55,6 +63,14 @@ namespace renderApi::device {
 		int presentFamily  = -1;
 	};
 
+	struct RetiredResource {
+		VkBuffer			   buffer = VK_NULL_HANDLE;
+		VkImage				   image  = VK_NULL_HANDLE;
+		VkImageView			   view	  = VK_NULL_HANDLE;
+		memory::AllocationInfo allocation;
+		std::vector<VkFence>   fences; // One per queue, signaled once the work submitted before retirement finished
+	};
+
 	struct GPU {
 		VkInstance								  instance		 = VK_NULL_HANDLE;
 		VkPhysicalDevice						  physicalDevice = VK_NULL_HANDLE;
@@ -64,7 +80,12 @@ namespace renderApi::device {
 		std::vector<VkQueue>					  transferQueues;
 		std::vector<VkQueue>					  presentQueues;
 		QueueFamilies							  queueFamilies;
-		VkCommandPool							  commandPool = VK_NULL_HANDLE;
+		memory::CommandAllocator				  oneTimeCommands; // beginOneTimeCommands(), guarded by oneTimeMutex
+		uint32_t								  oneTimePending = 0;
+		std::mutex								  oneTimeMutex;
+		memory::MemoryAllocator					  allocator;
+		memory::StagingPool						  stagingPool;
+		memory::TransferManager					  transfers;
 		std::atomic<bool>						  running	  = false;
 		std::future<gpuLoopThreadResult>		  finishCode;
 		std::vector<renderApi::gpuTask::GpuTask*> GpuTasks;
@@ -72,8 +93,33 @@ namespace renderApi::device {
 		std::mutex								  queueMutex;
 		std::string								  name;
 		std::atomic_bool						  renderEnabled = true;
+		// Outermost active batch of each thread
+		std::unordered_map<std::thread::id, memory::UploadBatch*> uploadBatches;
+		std::mutex												   uploadBatchMutex;
+		// See lockUploads()
+		std::mutex								  uploadMutex;
+		std::condition_variable					  uploadCondition;
+		uint32_t								  activeUploads = 0;
+		bool									  relocating	= false;
+		std::vector<RetiredResource>			  retiredResources;
+		std::mutex								  retiredMutex;
+
+		bool meshShaderSupported		   = false;
+		bool memoryBudgetSupported		   = false;
+		bool textureCompressionBCSupported = false; // BC1-BC7 formats can be sampled
+		bool storageWriteWithoutFormatSupported = false; // Storage images can be written without a format qualifier
+
+		// With a dedicated transfer queue, buffers are shared between it and the graphics family
+		uint32_t bufferQueueFamilies[2] = {0, 0};
+		uint32_t bufferQueueFamilyCount = 0;
 
-		bool meshShaderSupported = false;
+		// VK_EXT_external_memory_host: host allocations aligned to minImportedHostPointerAlignment can back buffers.
+		// Each import is a device memory allocation, so at most maxHostImports live at once.
+		bool									externalMemoryHostSupported		= false;
+		VkDeviceSize							minImportedHostPointerAlignment = 0;
+		PFN_vkGetMemoryHostPointerPropertiesEXT getMemoryHostPointerProperties	= nullptr;
+		uint32_t								maxHostImports					= 0;
+		std::atomic<uint32_t>					hostImportCount{0};
 
 		~GPU();
 		void			cleanup();
@@ -81,6 +127,28 @@ namespace renderApi::device {
 		void			endOneTimeCommands(VkCommandBuffer commandBuffer);
 		VkQueue			getPresentQueue();
 
+		// Uploads of the calling thread are collected until the returned batch goes out of scope
+		memory::UploadBatch	 beginUploadBatch();
+		// Active batch of the calling thread, or nullptr
+		memory::UploadBatch* getUploadBatch();
+
+		// Everything recording the current handles of resources holds an upload from recording until
+		// the commands executed, and the defragmenter only relocates while none is held. Holds nest,
+		// so a thread holding one never waits, and may be released from another thread.
+		void lockUploads();
+		void unlockUploads();
+		// Fails while an upload is held; lockUploads() waits until unlockRelocation()
+		bool tryLockRelocation();
+		void unlockRelocation();
+
+		// Sharing mode of every buffer: CONCURRENT across bufferQueueFamilies when there are two
+		void setBufferSharing(VkBufferCreateInfo& info) const;
+
+		// Destroy the resource once the work submitted so far on every queue has finished
+		void retireBuffer(VkBuffer buffer, const memory::AllocationInfo& allocation);
+		void retireImage(VkImage image, VkImageView view, const memory::AllocationInfo& allocation);
+		void releaseRetired(bool wait = false);
+
 		// Getters for ImGui integration
 		VkInstance getInstance() const { return instance; }
 		VkPhysicalDevice getPhysicalDevice() const { return physicalDevice; }
@@ -89,12 +157,27 @@ namespace renderApi::device {
 		uint32_t getGraphicsQueueFamilyIndex() const { return queueFamilies.graphicsFamily; }
 		VkCommandBuffer beginSingleTimeCommands() { return beginOneTimeCommands(); }
 		void endSingleTimeCommands(VkCommandBuffer cmd) { endOneTimeCommands(cmd); }
+
+	  private:
+		void retire(RetiredResource&& retired);
+	};
+
+	// Holds an upload of the GPU for the scope
+	class UploadLock {
+	  public:
+		explicit UploadLock(GPU* gpu) : gpu_(gpu) { gpu_->lockUploads(); }
+		~UploadLock() { gpu_->unlockUploads(); }
+
+		UploadLock(const UploadLock&)			 = delete;
+		UploadLock& operator=(const UploadLock&) = delete;
+
+	  private:
+		GPU* gpu_;
 	};
 
 	gpuLoopThreadResult				gpuThreadLoop(renderApi::device::GPU& gpu);
 	std::vector<PhysicalDeviceInfo> enumeratePhysicalDevices(VkInstance instance);
 	VkPhysicalDevice				selectBestPhysicalDevice(VkInstance instance);
-	InitDeviceResult				finishDeviceInitialization(GPU& gpu);
 	QueueFamilies					findQueueFamilies(VkPhysicalDevice device);
 	uint32_t						findMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties);
 	bool							queueSupportsPresentation(VkPhysicalDevice physicalDevice, uint32_t familyIndex, VkSurfaceKHR surface);
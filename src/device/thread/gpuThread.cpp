@@ -9,8 +9,11 @@
 using namespace renderApi::device;
 
 gpuLoopThreadResult renderApi::device::gpuThreadLoop(GPU& gpu) {
+	// Kept across iterations so that the loop doesn't allocate every frame
+	std::vector<renderApi::gpuTask::GpuTask*> tasksToWait;
+
 	while (gpu.running) {
-		std::vector<renderApi::gpuTask::GpuTask*> tasksToWait;
+		tasksToWait.clear();
 
 		{
 			std::lock_guard<std::mutex> lock(gpu.GpuTasksMutex);
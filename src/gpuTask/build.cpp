@@ -7,15 +7,19 @@
 #include "query/queryPool.hpp"
 #include "renderDevice.hpp"
 
+#include <algorithm>
 #include <exception>
 #include <iostream>
 #include <memory>
+#include <thread>
 #include <vector>
 #include <vulkan/vulkan.h>
 #include <vulkan/vulkan_core.h>
 
 using namespace renderApi::gpuTask;
 
+static constexpr VkDeviceSize kDefaultFrameMemorySize = 64 * 1024;
+
 bool GpuTask::build(uint32_t renderWidth, uint32_t renderHeight) {
 	if (isBuilt_) {
 		return true;
@@ -26,14 +30,56 @@ bool GpuTask::build(uint32_t renderWidth, uint32_t renderHeight) {
 		return false;
 	}
 
+	if (!transientBindings_.empty() || frameMemorySize_ > 0) {
+		// Leave room for every transient binding plus its worst-case alignment padding
+		VkDeviceSize required = 0;
+		for (auto& binding : transientBindings_) {
+			required += binding.range + 256;
+			binding.slice	= memory::FrameAllocation{};
+			binding.written = false;
+		}
+
+		VkDeviceSize bytesPerFrame = std::max(frameMemorySize_ > 0 ? frameMemorySize_ : kDefaultFrameMemorySize, required);
+
+		frameAllocator_ = std::make_unique<memory::FrameAllocator>();
+		if (!frameAllocator_->create(gpu_, bytesPerFrame, maxFramesInFlight_)) {
+			std::cerr << "Failed to create frame allocator" << std::endl;
+			frameAllocator_.reset();
+			return false;
+		}
+		dynamicOffsets_.assign(transientBindings_.size(), 0);
+		frameMemoryBegun_ = false;
+	}
+
 	if (useDescriptorManager_ && descriptorManager_) {
 		if (!descriptorManager_->build(gpu_)) {
 			std::cerr << "Failed to build descriptor manager" << std::endl;
 			return false;
 		}
-	} else if (!buffers_.empty()) {
+	} else if (!buffers_.empty() || !transientBindings_.empty()) {
 		try {
-			descriptorSetLayout_ = createDescriptorSetLayoutFromBuffers(gpu_->device, buffers_, bufferStages_);
+			if (transientBindings_.empty()) {
+				descriptorSetLayout_ = createDescriptorSetLayoutFromBuffers(gpu_->device, buffers_, bufferStages_);
+			} else {
+				std::vector<VkDescriptorSetLayoutBinding> bindings;
+				for (size_t i = 0; i < buffers_.size(); ++i) {
+					VkDescriptorSetLayoutBinding binding{};
+					binding.binding			= static_cast<uint32_t>(i);
+					binding.descriptorType	= bufferTypeToDescriptorType(buffers_[i]->getType());
+					binding.descriptorCount = 1;
+					binding.stageFlags		= bufferStages_[i];
+					bindings.push_back(binding);
+				}
+				for (size_t i = 0; i < transientBindings_.size(); ++i) {
+					VkDescriptorSetLayoutBinding binding{};
+					binding.binding			= static_cast<uint32_t>(buffers_.size() + i);
+					binding.descriptorType	= transientBindings_[i].type;
+					binding.descriptorCount = 1;
+					binding.stageFlags		= transientBindings_[i].stageFlags;
+					bindings.push_back(binding);
+				}
+				descriptorSetLayout_ = createDescriptorSetLayout(gpu_->device, bindings);
+			}
 		} catch (const std::exception& e) {
 			std::cerr << "Failed to create descriptor set layout: " << e.what() << std::endl;
 			return false;
@@ -41,8 +87,10 @@ bool GpuTask::build(uint32_t renderWidth, uint32_t renderHeight) {
 
 		std::vector<VkDescriptorPoolSize> poolSizes;
 
-		uint32_t storageBufferCount = 0;
-		uint32_t uniformBufferCount = 0;
+		uint32_t storageBufferCount		   = 0;
+		uint32_t uniformBufferCount		   = 0;
+		uint32_t dynamicStorageBufferCount = 0;
+		uint32_t dynamicUniformBufferCount = 0;
 
 		for (auto* buffer : buffers_) {
 			if (buffer->getType() == BufferType::STORAGE) {
@@ -52,12 +100,26 @@ bool GpuTask::build(uint32_t renderWidth, uint32_t renderHeight) {
 			}
 		}
 
+		for (const auto& binding : transientBindings_) {
+			if (binding.type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC) {
+				dynamicStorageBufferCount++;
+			} else {
+				dynamicUniformBufferCount++;
+			}
+		}
+
 		if (storageBufferCount > 0) {
 			poolSizes.push_back({VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, storageBufferCount});
 		}
 		if (uniformBufferCount > 0) {
 			poolSizes.push_back({VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, uniformBufferCount});
 		}
+		if (dynamicStorageBufferCount > 0) {
+			poolSizes.push_back({VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, dynamicStorageBufferCount});
+		}
+		if (dynamicUniformBufferCount > 0) {
+			poolSizes.push_back({VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, dynamicUniformBufferCount});
+		}
 
 		VkDescriptorPoolCreateInfo poolInfo{};
 		poolInfo.sType		   = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
@@ -85,36 +147,41 @@ bool GpuTask::build(uint32_t renderWidth, uint32_t renderHeight) {
 			return false;
 		}
 
+		writeBufferDescriptors();
+
 		std::vector<VkWriteDescriptorSet>	descriptorWrites;
 		std::vector<VkDescriptorBufferInfo> bufferInfos;
-		bufferInfos.reserve(buffers_.size());
+		bufferInfos.reserve(transientBindings_.size());
 
-		for (size_t i = 0; i < buffers_.size(); ++i) {
+		for (size_t i = 0; i < transientBindings_.size(); ++i) {
 			VkDescriptorBufferInfo bufferInfo{};
-			bufferInfo.buffer = buffers_[i]->getHandle();
+			bufferInfo.buffer = frameAllocator_->getHandle();
 			bufferInfo.offset = 0;
-			bufferInfo.range  = buffers_[i]->getSize();
+			bufferInfo.range  = transientBindings_[i].range;
 			bufferInfos.push_back(bufferInfo);
 
 			VkWriteDescriptorSet descriptorWrite{};
 			descriptorWrite.sType			= VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 			descriptorWrite.dstSet			= descriptorSet_;
-			descriptorWrite.dstBinding		= static_cast<uint32_t>(i);
+			descriptorWrite.dstBinding		= static_cast<uint32_t>(buffers_.size() + i);
 			descriptorWrite.dstArrayElement = 0;
-			descriptorWrite.descriptorType =
-					(buffers_[i]->getType() == BufferType::STORAGE) ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+			descriptorWrite.descriptorType	= transientBindings_[i].type;
 			descriptorWrite.descriptorCount = 1;
 			descriptorWrite.pBufferInfo		= &bufferInfos.back();
 
 			descriptorWrites.push_back(descriptorWrite);
 		}
 
-		vkUpdateDescriptorSets(gpu_->device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+		if (!descriptorWrites.empty()) {
+			vkUpdateDescriptorSets(gpu_->device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+		}
 	}
 
+	uint32_t queueFamily = static_cast<uint32_t>(!graphicsPipelines_.empty() ? gpu_->queueFamilies.graphicsFamily : gpu_->queueFamilies.computeFamily);
+
 	VkCommandPoolCreateInfo cmdPoolInfo{};
 	cmdPoolInfo.sType			 = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-	cmdPoolInfo.queueFamilyIndex = !graphicsPipelines_.empty() ? gpu_->queueFamilies.graphicsFamily : gpu_->queueFamilies.computeFamily;
+	cmdPoolInfo.queueFamilyIndex = queueFamily;
 	cmdPoolInfo.flags			 = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 
 	if (vkCreateCommandPool(gpu_->device, &cmdPoolInfo, nullptr, &commandPool_) != VK_SUCCESS) {
@@ -123,37 +190,28 @@ bool GpuTask::build(uint32_t renderWidth, uint32_t renderHeight) {
 		return false;
 	}
 
-	commandBuffers_.resize(maxFramesInFlight_);
-
-	VkCommandBufferAllocateInfo cmdAllocInfo{};
-	cmdAllocInfo.sType				= VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-	cmdAllocInfo.commandPool		= commandPool_;
-	cmdAllocInfo.level				= VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-	cmdAllocInfo.commandBufferCount = maxFramesInFlight_;
-
-	if (vkAllocateCommandBuffers(gpu_->device, &cmdAllocInfo, commandBuffers_.data()) != VK_SUCCESS) {
-		std::cerr << "Failed to allocate command buffers" << std::endl;
+	// Primaries are allocated as frames get recorded
+	if (!commandAllocator_.create(gpu_, queueFamily, maxFramesInFlight_)) {
+		std::cerr << "Failed to create command allocator" << std::endl;
 		destroy();
 		return false;
 	}
-
-	std::cout << "GpuTask: Allocated " << maxFramesInFlight_ << " primary command buffers" << std::endl;
+	commandBuffers_.assign(maxFramesInFlight_, VK_NULL_HANDLE);
+	recordedStates_.clear();
 
 	if (graphicsPipelines_.size() > 1 && !useCustomRecording_) {
-		std::cout << "GpuTask: Multiple pipelines detected (" << graphicsPipelines_.size() << "), creating secondary command buffers automatically..."
-				  << std::endl;
-
-		for (size_t i = 0; i < graphicsPipelines_.size(); ++i) {
-			std::string		bufferName		= "pipeline_" + std::to_string(i);
-			VkCommandBuffer secondaryBuffer = createSecondaryCommandBuffer(bufferName);
-			if (secondaryBuffer == VK_NULL_HANDLE) {
-				std::cerr << "Failed to create secondary command buffer for pipeline " << i << std::endl;
-				destroy();
-				return false;
-			}
+		uint32_t threads = recordingThreads_;
+		if (threads == 0) {
+			threads = std::min(std::max(std::thread::hardware_concurrency(), 1u), static_cast<uint32_t>(graphicsPipelines_.size()));
+		}
+		if (!recorder_.create(gpu_, queueFamily, maxFramesInFlight_, threads)) {
+			std::cerr << "Failed to create the secondary command buffer recorder" << std::endl;
+			destroy();
+			return false;
 		}
 
-		std::cout << "GpuTask: Created " << graphicsPipelines_.size() << " secondary command buffers (one per pipeline)" << std::endl;
+		std::cout << "GpuTask: Multiple pipelines detected (" << graphicsPipelines_.size() << "), recording their secondary command buffers on "
+				  << threads << " threads" << std::endl;
 	}
 
 	VkFenceCreateInfo fenceInfo{};
@@ -203,6 +261,45 @@ bool GpuTask::build(uint32_t renderWidth, uint32_t renderHeight) {
 	return true;
 }
 
+void GpuTask::writeBufferDescriptors() {
+	std::vector<VkWriteDescriptorSet>	descriptorWrites;
+	std::vector<VkDescriptorBufferInfo> bufferInfos;
+	bufferInfos.reserve(buffers_.size());
+
+	for (size_t i = 0; i < buffers_.size(); ++i) {
+		VkDescriptorBufferInfo bufferInfo{};
+		bufferInfo.buffer = buffers_[i]->getHandle();
+		bufferInfo.offset = 0;
+		bufferInfo.range  = buffers_[i]->getSize();
+		bufferInfos.push_back(bufferInfo);
+
+		VkWriteDescriptorSet descriptorWrite{};
+		descriptorWrite.sType			= VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrite.dstSet			= descriptorSet_;
+		descriptorWrite.dstBinding		= static_cast<uint32_t>(i);
+		descriptorWrite.dstArrayElement = 0;
+		descriptorWrite.descriptorType =
+				(buffers_[i]->getType() == BufferType::STORAGE) ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		descriptorWrite.descriptorCount = 1;
+		descriptorWrite.pBufferInfo		= &bufferInfos.back();
+
+		descriptorWrites.push_back(descriptorWrite);
+	}
+
+	if (!descriptorWrites.empty()) {
+		vkUpdateDescriptorSets(gpu_->device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+	}
+	bufferGeneration_ = getBufferGeneration();
+}
+
+uint64_t GpuTask::getBufferGeneration() const {
+	uint64_t generation = 0;
+	for (auto* buffer : buffers_) {
+		generation += buffer->getGeneration();
+	}
+	return generation;
+}
+
 void GpuTask::destroy() {
 	if (!gpu_ || !gpu_->device) {
 		return;
@@ -219,11 +316,21 @@ void GpuTask::destroy() {
 		queryPool_->destroy();
 	}
 
+	frameAllocator_.reset();
+	dynamicOffsets_.clear();
+	frameMemoryBegun_ = false;
+
 	if (fence_ != VK_NULL_HANDLE && gpu_ && gpu_->device) {
 		vkDestroyFence(gpu_->device, fence_, nullptr);
 		fence_ = VK_NULL_HANDLE;
 	}
 
+	recorder_.destroy();
+	drawnPipelines_.clear();
+	jobStates_.clear();
+	primaryState_ = StateTracker();
+	recordedSecondaries_.clear();
+
 	if (!secondaryCommandBuffers_.empty() && commandPool_ != VK_NULL_HANDLE) {
 		std::vector<VkCommandBuffer> buffersToFree;
 		for (const auto& scb : secondaryCommandBuffers_) {
@@ -237,10 +344,9 @@ void GpuTask::destroy() {
 		secondaryCommandBuffers_.clear();
 	}
 
-	if (!commandBuffers_.empty() && commandPool_ != VK_NULL_HANDLE && gpu_ && gpu_->device) {
-		vkFreeCommandBuffers(gpu_->device, commandPool_, static_cast<uint32_t>(commandBuffers_.size()), commandBuffers_.data());
-		commandBuffers_.clear();
-	}
+	commandAllocator_.destroy();
+	commandBuffers_.clear();
+	recordedStates_.clear();
 
 	if (commandPool_ != VK_NULL_HANDLE && gpu_ && gpu_->device) {
 		vkDestroyCommandPool(gpu_->device, commandPool_, nullptr);
@@ -7,7 +7,10 @@
 #include "query/queryPool.hpp"
 #include "renderDevice.hpp"
 
+#include <algorithm>
+#include <array>
 #include <cstdint>
+#include <cstring>
 #include <iostream>
 #include <memory>
 #include <mutex>
@@ -39,16 +42,325 @@ using namespace renderApi::gpuTask;
 
 static PFN_vkCmdDrawMeshTasksEXT vkCmdDrawMeshTasksEXT_fn = nullptr;
 
+// Color, then depth attachment of the graphics pipelines' render pass
+static const std::array<VkClearValue, 2> kClearValues = [] {
+	std::array<VkClearValue, 2> values{};
+	values[0].color		   = {{0.2f, 0.2f, 0.2f, 1.0f}};
+	values[1].depthStencil = {1.0f, 0};
+	return values;
+}();
+
+void GpuTask::refreshDescriptors() {
+	bool managerOutdated = useDescriptorManager_ && descriptorManager_ && descriptorManager_->isOutdated();
+	bool setOutdated	 = descriptorSet_ != VK_NULL_HANDLE && getBufferGeneration() != bufferGeneration_;
+	if (!managerOutdated && !setOutdated) return;
+
+	// A bound resource was moved or recreated; the frames still in flight read the old descriptors
+	std::vector<VkFence> fences;
+	if (fence_ != VK_NULL_HANDLE) {
+		fences.push_back(fence_);
+	}
+	for (auto& pipeline : graphicsPipelines_) {
+		for (VkFence fence : pipeline->inFlightFences_) {
+			if (fence != VK_NULL_HANDLE) fences.push_back(fence);
+		}
+	}
+	if (!fences.empty()) {
+		vkWaitForFences(gpu_->device, static_cast<uint32_t>(fences.size()), fences.data(), VK_TRUE, UINT64_MAX);
+	}
+
+	if (managerOutdated) {
+		descriptorManager_->refresh();
+	}
+	if (setOutdated) {
+		writeBufferDescriptors();
+	}
+	// Updating a set invalidates the command buffers it is bound in
+	invalidateRecording();
+}
+
+void GpuTask::flushDirtyBuffers(VkCommandBuffer cmd) {
+	auto flush = [&](Buffer* buffer) {
+		if (!buffer || !buffer->hasDirtyRanges()) return;
+
+		// Staged in this frame's partition, which is not reused before the frame completed. What does
+		// not fit stays dirty and goes with a later frame.
+		memory::FrameAllocation staging;
+		if (frameAllocator_ && buffer->hasHostCopy()) {
+			VkDeviceSize alignment = frameAllocator_->getMinAlignment();
+			VkDeviceSize used	   = (frameAllocator_->getUsed() + alignment - 1) / alignment * alignment;
+			VkDeviceSize available = frameAllocator_->getFrameSize() > used ? frameAllocator_->getFrameSize() - used : 0;
+			VkDeviceSize size	   = std::min<VkDeviceSize>(buffer->getDirtyBytes(), available);
+			if (size > 0) staging = frameAllocator_->allocate(size);
+		}
+		buffer->flushDirty(cmd, staging);
+	};
+
+	for (Buffer* buffer : buffers_) flush(buffer);
+	for (Buffer* buffer : vertexBuffers_) flush(buffer);
+	flush(indexBuffer_);
+}
+
+uint64_t GpuTask::getRecordingKey(uint32_t imageIndex, bool usesSwapchain) const {
+	// Handles and generations of everything the recording refers to without the task noticing a change
+	uint64_t key = 14695981039346656037ull;
+	auto	 mix = [&](uint64_t value) { key = (key ^ value) * 1099511628211ull; };
+
+	for (Buffer* buffer : buffers_) mix(buffer ? buffer->getGeneration() : 0);
+	for (Buffer* buffer : vertexBuffers_) mix(buffer ? buffer->getGeneration() : 0);
+	mix(indexBuffer_ ? indexBuffer_->getGeneration() : 0);
+	mix((uint64_t)descriptorSet_);
+	mix(queryPool_ && queryPool_->isValid() ? 1 : 0);
+
+	for (const auto& pipeline : pipelines_) {
+		mix((uint64_t)pipeline->getPipeline());
+		mix(pipeline->isEnabled() ? 1 : 0);
+		mix(pipeline->workgroupSizeX_);
+		mix(pipeline->workgroupSizeY_);
+		mix(pipeline->workgroupSizeZ_);
+	}
+	for (const auto& pipeline : graphicsPipelines_) {
+		mix((uint64_t)pipeline->getPipeline());
+		mix(pipeline->isEnabled() ? 1 : 0);
+	}
+	if (!graphicsPipelines_.empty()) {
+		mix(usesSwapchain ? (uint64_t)graphicsPipelines_[0]->getSwapchainFramebuffer(imageIndex) : (uint64_t)graphicsPipelines_[0]->getFramebuffer());
+		mix(graphicsPipelines_[0]->getWidth());
+		mix(graphicsPipelines_[0]->getHeight());
+	}
+	return key;
+}
+
+bool GpuTask::hasDirtyBuffers() const {
+	for (Buffer* buffer : buffers_) {
+		if (buffer && buffer->hasDirtyRanges()) return true;
+	}
+	for (Buffer* buffer : vertexBuffers_) {
+		if (buffer && buffer->hasDirtyRanges()) return true;
+	}
+	return indexBuffer_ && indexBuffer_->hasDirtyRanges();
+}
+
+void GpuTask::prepareBindArrays() {
+	if (useDescriptorManager_ && descriptorManager_) {
+		descriptorManager_->getDescriptorSets(boundSets_);
+	} else {
+		boundSets_.clear();
+	}
+
+	vertexHandles_.clear();
+	for (Buffer* buffer : vertexBuffers_) {
+		vertexHandles_.push_back(buffer->getHandle());
+	}
+	vertexOffsets_.assign(vertexHandles_.size(), 0);
+}
+
+void GpuTask::recordPipelineDraw(StateTracker& state, GraphicsPipeline* pipeline) const {
+	VkCommandBuffer commandBuffer = state.getCommandBuffer();
+
+	state.bindPipeline(VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->getPipeline());
+
+	// Filled by prepareBindArrays() before the jobs started
+	if (!vertexHandles_.empty()) {
+		state.bindVertexBuffers(0, static_cast<uint32_t>(vertexHandles_.size()), vertexHandles_.data(), vertexOffsets_.data());
+	}
+
+	if (indexBuffer_ != nullptr) {
+		state.bindIndexBuffer(indexBuffer_->getHandle(), 0, indexType_);
+	}
+
+	if (useDescriptorManager_ && descriptorManager_) {
+		if (!boundSets_.empty()) {
+			state.bindDescriptorSets(VK_PIPELINE_BIND_POINT_GRAPHICS,
+									 pipeline->getLayout(),
+									 0,
+									 static_cast<uint32_t>(boundSets_.size()),
+									 boundSets_.data(),
+									 0,
+									 nullptr);
+		}
+	} else if (descriptorSet_ != VK_NULL_HANDLE) {
+		state.bindDescriptorSets(VK_PIPELINE_BIND_POINT_GRAPHICS,
+								 pipeline->getLayout(),
+								 0,
+								 1,
+								 &descriptorSet_,
+								 static_cast<uint32_t>(dynamicOffsets_.size()),
+								 dynamicOffsets_.data());
+	}
+
+	for (const auto& pc : pushConstants_) {
+		state.pushConstants(pipeline->getLayout(), pc.stageFlags, pc.offset, pc.size, pc.data.data());
+	}
+
+	if (pipeline->isUsingMeshShader()) {
+		if (meshTaskCountX_ > 0 || meshTaskCountY_ > 0 || meshTaskCountZ_ > 0) {
+			if (vkCmdDrawMeshTasksEXT_fn) {
+				vkCmdDrawMeshTasksEXT_fn(commandBuffer, meshTaskCountX_, meshTaskCountY_, meshTaskCountZ_);
+			} else {
+				std::cerr << "GpuTask: Mesh shader function not available" << std::endl;
+			}
+		} else {
+			std::cerr << "GpuTask: Mesh shader pipeline used but no task count set." << std::endl;
+		}
+	} else if (indexBuffer_ != nullptr) {
+		vkCmdDrawIndexed(commandBuffer, indexCount_, instanceCount_, firstIndex_, vertexOffset_, firstInstance_);
+	} else {
+		vkCmdDraw(commandBuffer, vertexCount_, instanceCount_, firstVertex_, firstInstance_);
+	}
+}
+
+VkRenderPassBeginInfo GpuTask::makeRenderPassBeginInfo(uint32_t imageIndex, bool usesSwapchain) const {
+	const GraphicsPipeline& pipeline = *graphicsPipelines_[0];
+
+	VkRenderPassBeginInfo renderPassInfo{};
+	renderPassInfo.sType			 = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+	renderPassInfo.renderPass		 = pipeline.getRenderPass();
+	renderPassInfo.framebuffer		 = usesSwapchain ? pipeline.getSwapchainFramebuffer(imageIndex) : pipeline.getFramebuffer();
+	renderPassInfo.renderArea.offset = {0, 0};
+	renderPassInfo.renderArea.extent = {pipeline.getWidth(), pipeline.getHeight()};
+	renderPassInfo.clearValueCount	 = static_cast<uint32_t>(kClearValues.size());
+	renderPassInfo.pClearValues		 = kClearValues.data();
+	return renderPassInfo;
+}
+
+void GpuTask::recordCommands(VkCommandBuffer commandBuffer, uint32_t imageIndex, bool usesSwapchain) {
+	// What was recorded before only copies and resets, none of which the tracker cares about
+	primaryState_.reset(commandBuffer);
+
+	if (useCustomRecording_ && !recordingCallbacks_.empty()) {
+		for (const auto& callback : recordingCallbacks_) {
+			callback(primaryState_, currentFrame_, imageIndex);
+		}
+	} else if (!graphicsPipelines_.empty() && !recorder_.isValid()) {
+		VkRenderPassBeginInfo renderPassInfo = makeRenderPassBeginInfo(imageIndex, usesSwapchain);
+		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+		prepareBindArrays();
+		for (auto& pipeline : graphicsPipelines_) {
+			if (pipeline->isEnabled()) recordPipelineDraw(primaryState_, pipeline.get());
+		}
+
+		if (!renderPassCallbacks_.empty()) {
+			for (const auto& callback : renderPassCallbacks_) {
+				callback(primaryState_, currentFrame_, imageIndex);
+			}
+		}
+
+		vkCmdEndRenderPass(commandBuffer);
+	} else if (!graphicsPipelines_.empty() && recorder_.isValid()) {
+		VkRenderPassBeginInfo renderPassInfo = makeRenderPassBeginInfo(imageIndex, usesSwapchain);
+
+		VkCommandBufferInheritanceInfo inheritanceInfo{};
+		inheritanceInfo.sType		= VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+		inheritanceInfo.renderPass	= renderPassInfo.renderPass;
+		inheritanceInfo.subpass		= 0;
+		inheritanceInfo.framebuffer = renderPassInfo.framebuffer;
+
+		drawnPipelines_.clear();
+		for (auto& pipeline : graphicsPipelines_) {
+			if (pipeline->isEnabled()) drawnPipelines_.push_back(pipeline.get());
+		}
+		prepareBindArrays();
+
+		// One secondary per thread for the pipelines, so that the binds they share are dropped within
+		// each, then one per render pass callback
+		uint32_t pipelineJobs = std::min(static_cast<uint32_t>(drawnPipelines_.size()), recorder_.getThreadCount());
+		uint32_t jobCount	  = pipelineJobs + static_cast<uint32_t>(renderPassCallbacks_.size());
+		if (jobStates_.size() < jobCount) jobStates_.resize(jobCount);
+
+		// Jobs only read the task's state; each one records its own secondary on whichever thread is free
+		recorder_.record(currentFrame_,
+						 inheritanceInfo,
+						 jobCount,
+						 [this, pipelineJobs, imageIndex](VkCommandBuffer cmd, uint32_t index) {
+							 StateTracker& state = jobStates_[index];
+							 state.reset(cmd);
+							 if (index < pipelineJobs) {
+								 size_t count = drawnPipelines_.size();
+								 for (size_t i = index * count / pipelineJobs; i < (index + 1) * count / pipelineJobs; ++i) {
+									 recordPipelineDraw(state, drawnPipelines_[i]);
+								 }
+							 } else {
+								 renderPassCallbacks_[index - pipelineJobs](state, currentFrame_, imageIndex);
+							 }
+						 },
+						 recordedSecondaries_);
+
+		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+		if (!recordedSecondaries_.empty()) {
+			vkCmdExecuteCommands(commandBuffer, static_cast<uint32_t>(recordedSecondaries_.size()), recordedSecondaries_.data());
+		}
+		vkCmdEndRenderPass(commandBuffer);
+	} else if (!pipelines_.empty() && !useCustomRecording_) {
+		if (useDescriptorManager_ && descriptorManager_) {
+			descriptorManager_->getDescriptorSets(boundSets_);
+			if (!boundSets_.empty() && !pipelines_.empty()) {
+				primaryState_.bindDescriptorSets(VK_PIPELINE_BIND_POINT_COMPUTE,
+												 pipelines_[0]->getLayout(),
+												 0,
+												 static_cast<uint32_t>(boundSets_.size()),
+												 boundSets_.data(),
+												 0,
+												 nullptr);
+			}
+		} else if (descriptorSet_ != VK_NULL_HANDLE) {
+			primaryState_.bindDescriptorSets(VK_PIPELINE_BIND_POINT_COMPUTE,
+											 pipelines_.empty() ? VK_NULL_HANDLE : pipelines_[0]->getLayout(),
+											 0,
+											 1,
+											 &descriptorSet_,
+											 static_cast<uint32_t>(dynamicOffsets_.size()),
+											 dynamicOffsets_.data());
+		}
+
+		for (auto& pipeline : pipelines_) {
+			if (pipeline->isEnabled()) {
+				primaryState_.bindPipeline(VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->getPipeline());
+
+				for (const auto& pc : pushConstants_) {
+					primaryState_.pushConstants(pipeline->getLayout(), pc.stageFlags, pc.offset, pc.size, pc.data.data());
+				}
+
+				vkCmdDispatch(commandBuffer, pipeline->workgroupSizeX_, pipeline->workgroupSizeY_, pipeline->workgroupSizeZ_);
+			}
+		}
+	}
+}
+
 void GpuTask::execute() {
 	if (!isBuilt_ || !gpu_ || !gpu_->device) {
 		std::cerr << "GpuTask not built" << std::endl;
 		return;
 	}
 
+	std::lock_guard<std::mutex> executionLock(executionMutex_);
+
 	if (!vkCmdDrawMeshTasksEXT_fn && gpu_->meshShaderSupported) {
 		vkCmdDrawMeshTasksEXT_fn = (PFN_vkCmdDrawMeshTasksEXT)vkGetDeviceProcAddr(gpu_->device, "vkCmdDrawMeshTasksEXT");
 	}
 
+	// Buffers replaced by Buffer::resize(..., true) whose last users have finished
+	gpu_->releaseRetired();
+	refreshDescriptors();
+
+	if (frameAllocator_) {
+		beginFrameMemory();
+		for (size_t i = 0; i < transientBindings_.size(); ++i) {
+			TransientBinding& binding = transientBindings_[i];
+			if (!binding.written && binding.slice.isValid()) {
+				// Carry last frame's contents forward; that slice stays untouched until its own slot is recycled
+				memory::FrameAllocation slice = frameAllocator_->allocate(binding.range);
+				if (slice.isValid()) {
+					memcpy(slice.data, binding.slice.data, binding.range);
+					binding.slice = slice;
+				}
+			}
+			binding.written	   = true;
+			dynamicOffsets_[i] = static_cast<uint32_t>(binding.slice.offset);
+		}
+	}
+
 	uint32_t imageIndex	   = 0;
 	bool	 usesSwapchain = false;
 
@@ -98,255 +410,85 @@ void GpuTask::execute() {
 		}
 	}
 
-	VkCommandBuffer commandBuffer = commandBuffers_[currentFrame_];
-
-	vkResetCommandBuffer(commandBuffer, 0);
-
-	VkCommandBufferBeginInfo beginInfo{};
-	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-
-	if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
-		std::cerr << "Failed to begin command buffer" << std::endl;
-		return;
-	}
-
-	if (queryPool_ && queryPool_->isValid()) {
-		queryPool_->reset(commandBuffer);
+	// Work that differs from frame to frame can't be replayed, and makes the recording single use
+	uint64_t	   transferWait	  = transferWait_.exchange(0);
+	ReadbackRing*  readback		  = !usesSwapchain && !graphicsPipelines_.empty() ? graphicsPipelines_[0]->getReadback() : nullptr;
+	bool		   useSecondaries = !(useCustomRecording_ && !recordingCallbacks_.empty()) && !graphicsPipelines_.empty() && recorder_.isValid();
+	// Uploads are handed over to one queue family, which a compute task on another one cannot record
+	// the acquire for: it waits for them on the host instead, where wait() submits the acquire
+	bool	 usesCompute	= graphicsPipelines_.empty() && !gpu_->computeQueues.empty();
+	uint32_t submitFamily	= static_cast<uint32_t>(usesCompute ? gpu_->queueFamilies.computeFamily : gpu_->queueFamilies.graphicsFamily);
+	if (transferWait != 0 && gpu_->transfers.transfersOwnership() && submitFamily != gpu_->transfers.getOwnerFamily()) {
+		gpu_->transfers.wait(memory::TransferTicket{transferWait});
+		transferWait = 0;
 	}
 
-	if (useCustomRecording_ && !recordingCallbacks_.empty()) {
-		for (const auto& callback : recordingCallbacks_) {
-			callback(commandBuffer, currentFrame_, imageIndex);
-		}
-	} else if (!graphicsPipelines_.empty() && secondaryCommandBuffers_.empty()) {
-		std::vector<VkClearValue> clearValues(2);
-		clearValues[0].color		= {{0.2f, 0.2f, 0.2f, 1.0f}};
-		clearValues[1].depthStencil = {1.0f, 0};
-
-		VkRenderPassBeginInfo renderPassInfo{};
-		renderPassInfo.sType	  = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-		renderPassInfo.renderPass = graphicsPipelines_[0]->getRenderPass();
-		if (usesSwapchain) {
-			renderPassInfo.framebuffer = graphicsPipelines_[0]->getSwapchainFramebuffer(imageIndex);
-		} else {
-			renderPassInfo.framebuffer = graphicsPipelines_[0]->getFramebuffer();
-		}
-		renderPassInfo.renderArea.offset = {0, 0};
-		renderPassInfo.renderArea.extent = {graphicsPipelines_[0]->getWidth(), graphicsPipelines_[0]->getHeight()};
-		renderPassInfo.clearValueCount	 = static_cast<uint32_t>(clearValues.size());
-		renderPassInfo.pClearValues		 = clearValues.data();
-
-		if (useDescriptorManager_ && descriptorManager_) {
-			auto descriptorSets = descriptorManager_->getDescriptorSets();
-			auto layouts		= descriptorManager_->getLayouts();
-			if (!descriptorSets.empty() && !graphicsPipelines_.empty()) {
-				vkCmdBindDescriptorSets(commandBuffer,
-										VK_PIPELINE_BIND_POINT_GRAPHICS,
-										graphicsPipelines_[0]->getLayout(),
-										0,
-										static_cast<uint32_t>(descriptorSets.size()),
-										descriptorSets.data(),
-										0,
-										nullptr);
-			}
-		} else if (!buffers_.empty()) {
-			vkCmdBindDescriptorSets(
-					commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipelines_[0]->getLayout(), 0, 1, &descriptorSet_, 0, nullptr);
-		}
-
-		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+	bool replayable = replay_ && transferWait == 0 && !readback && !useSecondaries && !hasDirtyBuffers();
 
-		if (!vertexBuffers_.empty()) {
-			std::vector<VkBuffer>	  vkBuffers(vertexBuffers_.size());
-			std::vector<VkDeviceSize> offsets(vertexBuffers_.size(), 0);
-			for (size_t i = 0; i < vertexBuffers_.size(); ++i) {
-				vkBuffers[i] = vertexBuffers_[i]->getHandle();
-			}
-			vkCmdBindVertexBuffers(commandBuffer, 0, static_cast<uint32_t>(vkBuffers.size()), vkBuffers.data(), offsets.data());
-		}
-
-		if (indexBuffer_ != nullptr) {
-			vkCmdBindIndexBuffer(commandBuffer, indexBuffer_->getHandle(), 0, indexType_);
-		}
-
-		for (auto& pipeline : graphicsPipelines_) {
-			if (pipeline->isEnabled()) {
-				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->getPipeline());
+	if (recordedStates_.size() != commandBuffers_.size()) recordedStates_.assign(commandBuffers_.size(), RecordedState{});
+	RecordedState& recorded = recordedStates_[currentFrame_];
+	uint64_t	   key		= replayable ? getRecordingKey(imageIndex, usesSwapchain) : 0;
+	bool		   replayed = replayable && recorded.version == recordVersion_ && recorded.key == key && recorded.dynamicOffsets == dynamicOffsets_;
 
-				for (const auto& pc : pushConstants_) {
-					vkCmdPushConstants(commandBuffer, pipeline->getLayout(), pc.stageFlags, pc.offset, pc.size, pc.data.data());
-				}
+	uint64_t		readbackValue = 0;
+	VkCommandBuffer commandBuffer = commandBuffers_[currentFrame_];
 
-				if (pipeline->isUsingMeshShader()) {
-					if (meshTaskCountX_ > 0 || meshTaskCountY_ > 0 || meshTaskCountZ_ > 0) {
-						if (vkCmdDrawMeshTasksEXT_fn) {
-							vkCmdDrawMeshTasksEXT_fn(commandBuffer, meshTaskCountX_, meshTaskCountY_, meshTaskCountZ_);
-						} else {
-							std::cerr << "GpuTask: Mesh shader function not available" << std::endl;
-						}
-					} else {
-						std::cerr << "GpuTask: Mesh shader pipeline used but no task count set. Call setMeshTaskCount() or use classic draw."
-								  << std::endl;
-					}
-				} else if (indexBuffer_ != nullptr) {
-					vkCmdDrawIndexed(commandBuffer, indexCount_, instanceCount_, firstIndex_, vertexOffset_, firstInstance_);
-				} else {
-					vkCmdDraw(commandBuffer, vertexCount_, instanceCount_, firstVertex_, firstInstance_);
-				}
-			}
+	// A submission that does not happen leaves the transfer wait and the acquires to the next one
+	auto abandonTransferWait = [&]() {
+		if (transferWait == 0) return;
+		waitForTransfer(memory::TransferTicket{transferWait});
+		gpu_->transfers.endWait(commandBuffer, false);
+	};
+
+	if (!replayed) {
+		// The slot's fence was waited on above: everything recorded from its pool last time is done
+		commandAllocator_.beginFrame(currentFrame_);
+		commandBuffer				   = commandAllocator_.allocate();
+		commandBuffers_[currentFrame_] = commandBuffer;
+		if (commandBuffer == VK_NULL_HANDLE) {
+			recorded.version = 0;
+			abandonTransferWait();
+			return;
 		}
 
-		if (!renderPassCallbacks_.empty()) {
-			for (const auto& callback : renderPassCallbacks_) {
-				callback(commandBuffer, currentFrame_, imageIndex);
-			}
-		}
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = replayable ? 0 : VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
-		vkCmdEndRenderPass(commandBuffer);
-	} else if (!graphicsPipelines_.empty() && !secondaryCommandBuffers_.empty()) {
-		std::vector<VkClearValue> clearValues(2);
-		clearValues[0].color		= {{0.2f, 0.2f, 0.2f, 1.0f}};
-		clearValues[1].depthStencil = {1.0f, 0};
-
-		VkRenderPassBeginInfo renderPassInfo{};
-		renderPassInfo.sType	  = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-		renderPassInfo.renderPass = graphicsPipelines_[0]->getRenderPass();
-		if (usesSwapchain) {
-			renderPassInfo.framebuffer = graphicsPipelines_[0]->getSwapchainFramebuffer(imageIndex);
-		} else {
-			renderPassInfo.framebuffer = graphicsPipelines_[0]->getFramebuffer();
+		if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+			std::cerr << "Failed to begin command buffer" << std::endl;
+			recorded.version = 0;
+			abandonTransferWait();
+			return;
 		}
-		renderPassInfo.renderArea.offset = {0, 0};
-		renderPassInfo.renderArea.extent = {graphicsPipelines_[0]->getWidth(), graphicsPipelines_[0]->getHeight()};
-		renderPassInfo.clearValueCount	 = static_cast<uint32_t>(clearValues.size());
-		renderPassInfo.pClearValues		 = clearValues.data();
-
-		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
-
-		std::vector<VkCommandBuffer> secondariesToExecute;
 
-		for (size_t pipelineIdx = 0; pipelineIdx < graphicsPipelines_.size(); ++pipelineIdx) {
-			std::string bufferName = "pipeline_" + std::to_string(pipelineIdx);
-
-			VkCommandBuffer secondaryBuffer = VK_NULL_HANDLE;
-			for (const auto& scb : secondaryCommandBuffers_) {
-				if (scb.name == bufferName && scb.enabled) {
-					secondaryBuffer = scb.buffer;
-					break;
-				}
-			}
-
-			if (secondaryBuffer != VK_NULL_HANDLE) {
-				VkCommandBufferInheritanceInfo inheritanceInfo{};
-				inheritanceInfo.sType	   = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
-				inheritanceInfo.renderPass = graphicsPipelines_[0]->getRenderPass();
-				inheritanceInfo.subpass	   = 0;
-				inheritanceInfo.framebuffer =
-						usesSwapchain ? graphicsPipelines_[0]->getSwapchainFramebuffer(imageIndex) : graphicsPipelines_[0]->getFramebuffer();
-
-				VkCommandBufferBeginInfo beginInfo{};
-				beginInfo.sType			   = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-				beginInfo.flags			   = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-				beginInfo.pInheritanceInfo = &inheritanceInfo;
-
-				vkResetCommandBuffer(secondaryBuffer, 0);
-				if (vkBeginCommandBuffer(secondaryBuffer, &beginInfo) == VK_SUCCESS) {
-					auto* pipeline = graphicsPipelines_[pipelineIdx].get();
-
-					if (pipeline->isEnabled()) {
-						vkCmdBindPipeline(secondaryBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->getPipeline());
-
-						if (!vertexBuffers_.empty()) {
-							std::vector<VkBuffer>	  vkBuffers(vertexBuffers_.size());
-							std::vector<VkDeviceSize> offsets(vertexBuffers_.size(), 0);
-							for (size_t i = 0; i < vertexBuffers_.size(); ++i) {
-								vkBuffers[i] = vertexBuffers_[i]->getHandle();
-							}
-							vkCmdBindVertexBuffers(secondaryBuffer, 0, static_cast<uint32_t>(vkBuffers.size()), vkBuffers.data(), offsets.data());
-						}
-
-						if (indexBuffer_ != nullptr) {
-							vkCmdBindIndexBuffer(secondaryBuffer, indexBuffer_->getHandle(), 0, indexType_);
-						}
-
-						if (!buffers_.empty()) {
-							vkCmdBindDescriptorSets(
-									secondaryBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->getLayout(), 0, 1, &descriptorSet_, 0, nullptr);
-						}
-
-						for (const auto& pc : pushConstants_) {
-							vkCmdPushConstants(secondaryBuffer, pipeline->getLayout(), pc.stageFlags, pc.offset, pc.size, pc.data.data());
-						}
-
-						if (pipeline->isUsingMeshShader()) {
-							if (meshTaskCountX_ > 0 || meshTaskCountY_ > 0 || meshTaskCountZ_ > 0) {
-								if (vkCmdDrawMeshTasksEXT_fn) {
-									vkCmdDrawMeshTasksEXT_fn(secondaryBuffer, meshTaskCountX_, meshTaskCountY_, meshTaskCountZ_);
-								} else {
-									std::cerr << "GpuTask: Mesh shader function not available" << std::endl;
-								}
-							} else {
-								std::cerr << "GpuTask: Mesh shader pipeline used but no task count set." << std::endl;
-							}
-						} else if (indexBuffer_ != nullptr) {
-							vkCmdDrawIndexed(secondaryBuffer, indexCount_, instanceCount_, firstIndex_, vertexOffset_, firstInstance_);
-						} else {
-							vkCmdDraw(secondaryBuffer, vertexCount_, instanceCount_, firstVertex_, firstInstance_);
-						}
-					}
-
-					vkEndCommandBuffer(secondaryBuffer);
-					secondariesToExecute.push_back(secondaryBuffer);
-				}
-			}
+		// Ownership of the uploads waited on is acquired here, before anything reads them
+		if (transferWait != 0) {
+			gpu_->transfers.prepareWait(commandBuffer, submitFamily, transferWait);
 		}
 
-		if (!secondariesToExecute.empty()) {
-			vkCmdExecuteCommands(commandBuffer, static_cast<uint32_t>(secondariesToExecute.size()), secondariesToExecute.data());
-		}
+		flushDirtyBuffers(commandBuffer);
 
-		vkCmdEndRenderPass(commandBuffer);
-	} else if (!pipelines_.empty() && !useCustomRecording_) {
-		if (useDescriptorManager_ && descriptorManager_) {
-			auto descriptorSets = descriptorManager_->getDescriptorSets();
-			if (!descriptorSets.empty() && !pipelines_.empty()) {
-				vkCmdBindDescriptorSets(commandBuffer,
-										VK_PIPELINE_BIND_POINT_COMPUTE,
-										pipelines_[0]->getLayout(),
-										0,
-										static_cast<uint32_t>(descriptorSets.size()),
-										descriptorSets.data(),
-										0,
-										nullptr);
-			}
-		} else if (!buffers_.empty()) {
-			vkCmdBindDescriptorSets(commandBuffer,
-									VK_PIPELINE_BIND_POINT_COMPUTE,
-									pipelines_.empty() ? VK_NULL_HANDLE : pipelines_[0]->getLayout(),
-									0,
-									1,
-									&descriptorSet_,
-									0,
-									nullptr);
+		if (queryPool_ && queryPool_->isValid()) {
+			queryPool_->reset(commandBuffer);
 		}
 
-		for (auto& pipeline : pipelines_) {
-			if (pipeline->isEnabled()) {
-				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->getPipeline());
+		recordCommands(commandBuffer, imageIndex, usesSwapchain);
 
-				for (const auto& pc : pushConstants_) {
-					vkCmdPushConstants(commandBuffer, pipeline->getLayout(), pc.stageFlags, pc.offset, pc.size, pc.data.data());
-				}
+		// The offscreen output is read back from this frame's own command buffer
+		readbackValue = readback ? readback->record(commandBuffer, graphicsPipelines_[0]->getColorImage()) : 0;
 
-				vkCmdDispatch(commandBuffer, pipeline->workgroupSizeX_, pipeline->workgroupSizeY_, pipeline->workgroupSizeZ_);
-			}
+		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+			std::cerr << "Failed to end command buffer" << std::endl;
+			recorded.version = 0;
+			if (readbackValue != 0) readback->cancel(readbackValue);
+			abandonTransferWait();
+			return;
 		}
-	}
 
-	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
-		std::cerr << "Failed to end command buffer" << std::endl;
-		return;
+		recorded.version = replayable ? recordVersion_ : 0;
+		recorded.key	 = key;
+		if (replayable) recorded.dynamicOffsets = dynamicOffsets_;
 	}
 
 	VkSubmitInfo submitInfo{};
@@ -374,49 +516,78 @@ void GpuTask::execute() {
 
 	if (queue == VK_NULL_HANDLE) {
 		std::cerr << "Failed to submit queue: no available graphics or compute queue" << std::endl;
+		if (readbackValue != 0) readback->cancel(readbackValue);
+		abandonTransferWait();
 		return;
 	}
 
+	VkResult submitResult;
 	{
 		std::lock_guard<std::mutex> lock(gpu_->queueMutex);
 
-		VkSemaphore			 waitSemaphore	 = VK_NULL_HANDLE;
+		VkSemaphore			 waitSemaphores[2];
+		VkPipelineStageFlags waitStages[2];
+		uint64_t			 waitValues[2]	 = {0, 0};
+		uint32_t			 waitCount		 = 0;
 		VkSemaphore			 signalSemaphore = VK_NULL_HANDLE;
-		VkPipelineStageFlags waitStage		 = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		VkSemaphore			 signalSemaphores[2];
+		uint64_t			 signalValues[2] = {0, 0};
+		uint32_t			 signalCount	 = 0;
 
 		if (usesSwapchain) {
 			// Wait on the acquire semaphore (from current frame)
 			// Signal the render finished semaphore (specific to this swapchain image)
-			waitSemaphore	= graphicsPipelines_[0]->getImageAvailableSemaphore();
+			waitSemaphores[waitCount] = graphicsPipelines_[0]->getImageAvailableSemaphore();
+			waitStages[waitCount]	  = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+			waitCount++;
+
 			signalSemaphore = graphicsPipelines_[0]->getRenderFinishedSemaphore(imageIndex);
 
-			submitInfo.waitSemaphoreCount = 1;
-			submitInfo.pWaitSemaphores	  = &waitSemaphore;
-			submitInfo.pWaitDstStageMask  = &waitStage;
+			signalSemaphores[signalCount] = signalSemaphore;
+			signalCount++;
+		}
 
-			submitInfo.signalSemaphoreCount = 1;
-			submitInfo.pSignalSemaphores	= &signalSemaphore;
-		} else {
-			submitInfo.waitSemaphoreCount	= 0;
-			submitInfo.pWaitSemaphores		= nullptr;
-			submitInfo.pWaitDstStageMask	= nullptr;
-			submitInfo.signalSemaphoreCount = 0;
-			submitInfo.pSignalSemaphores	= nullptr;
+		// Uploads are waited on by the GPU; values of binary semaphores in the list are ignored
+		if (transferWait != 0) {
+			waitSemaphores[waitCount] = gpu_->transfers.getSemaphore();
+			waitStages[waitCount]	  = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+			waitValues[waitCount]	  = transferWait;
+			waitCount++;
+		}
+
+		if (readbackValue != 0) {
+			signalSemaphores[signalCount] = readback->getSemaphore();
+			signalValues[signalCount]	  = readbackValue;
+			signalCount++;
+		}
+
+		VkTimelineSemaphoreSubmitInfo timelineInfo{};
+		if (transferWait != 0 || readbackValue != 0) {
+			timelineInfo.sType					   = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+			timelineInfo.waitSemaphoreValueCount   = waitCount;
+			timelineInfo.pWaitSemaphoreValues	   = waitValues;
+			timelineInfo.signalSemaphoreValueCount = signalCount;
+			timelineInfo.pSignalSemaphoreValues	   = signalValues;
+			submitInfo.pNext					   = &timelineInfo;
 		}
 
+		submitInfo.waitSemaphoreCount	= waitCount;
+		submitInfo.pWaitSemaphores		= waitCount > 0 ? waitSemaphores : nullptr;
+		submitInfo.pWaitDstStageMask	= waitCount > 0 ? waitStages : nullptr;
+		submitInfo.signalSemaphoreCount = signalCount;
+		submitInfo.pSignalSemaphores	= signalCount > 0 ? signalSemaphores : nullptr;
+
 		VkFence submitFence = usesSwapchain ? graphicsPipelines_[0]->getInFlightFence() : fence_;
 
 		if (!usesSwapchain && submitFence != VK_NULL_HANDLE) {
 			vkResetFences(gpu_->device, 1, &submitFence);
 		}
 
-		VkResult submitResult = vkQueueSubmit(queue, 1, &submitInfo, submitFence);
+		submitResult = vkQueueSubmit(queue, 1, &submitInfo, submitFence);
 		if (submitResult != VK_SUCCESS) {
 			std::cerr << "Failed to submit queue: " << submitResult << std::endl;
-			return;
-		}
-
-		if (usesSwapchain) {
+			if (readbackValue != 0) readback->cancel(readbackValue);
+		} else if (usesSwapchain) {
 			VkSwapchainKHR swapchain = graphicsPipelines_[0]->getSwapchain();
 
 			VkPresentInfoKHR presentInfo{};
@@ -441,5 +612,17 @@ void GpuTask::execute() {
 		}
 	}
 
+	// Outside queueMutex, which the TransferManager takes under its own lock
+	if (submitResult != VK_SUCCESS) {
+		abandonTransferWait();
+		return;
+	}
+	if (transferWait != 0) gpu_->transfers.endWait(commandBuffer, true);
+
 	currentFrame_ = (currentFrame_ + 1) % maxFramesInFlight_;
+
+	frameMemoryBegun_ = false;
+	for (auto& binding : transientBindings_) {
+		binding.written = false;
+	}
 }
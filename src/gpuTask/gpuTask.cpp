@@ -59,24 +59,37 @@ void GpuTask::setIndexBuffer(Buffer* buffer, VkIndexType indexType) {
 }
 
 void GpuTask::setDrawParams(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance) {
+	// Setting the same values every frame keeps a replayed recording valid
+	if (vertexCount == vertexCount_ && instanceCount == instanceCount_ && firstVertex == firstVertex_ && firstInstance == firstInstance_) return;
+
 	vertexCount_   = vertexCount;
 	instanceCount_ = instanceCount;
 	firstVertex_   = firstVertex;
 	firstInstance_ = firstInstance;
+	invalidateRecording();
 }
 
 void GpuTask::setIndexedDrawParams(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t vertexOffset, uint32_t firstInstance) {
+	if (indexCount == indexCount_ && instanceCount == instanceCount_ && firstIndex == firstIndex_ &&
+		static_cast<uint32_t>(vertexOffset) == vertexOffset_ && firstInstance == firstInstance_) {
+		return;
+	}
+
 	indexCount_	   = indexCount;
 	instanceCount_ = instanceCount;
 	firstIndex_	   = firstIndex;
 	vertexOffset_  = vertexOffset;
 	firstInstance_ = firstInstance;
+	invalidateRecording();
 }
 
 void GpuTask::setMeshTaskCount(uint32_t x, uint32_t y, uint32_t z) {
+	if (x == meshTaskCountX_ && y == meshTaskCountY_ && z == meshTaskCountZ_) return;
+
 	meshTaskCountX_ = x;
 	meshTaskCountY_ = y;
 	meshTaskCountZ_ = z;
+	invalidateRecording();
 }
 
 void GpuTask::removeBuffer(Buffer* buffer) {
@@ -103,24 +116,160 @@ void GpuTask::clearBuffers() {
 }
 
 void GpuTask::pushConstants(VkShaderStageFlags stageFlags, uint32_t offset, uint32_t size, const void* data) {
-	PushConstantData pcData;
-	pcData.stageFlags = stageFlags;
-	pcData.offset	  = offset;
-	pcData.size		  = size;
+	// Reuse the previous storage so that per-frame updates do not reallocate
+	pushConstants_.resize(1);
+
+	PushConstantData& pcData = pushConstants_[0];
+	if (pcData.stageFlags == stageFlags && pcData.offset == offset && pcData.size == size && pcData.data.size() == size &&
+		memcmp(pcData.data.data(), data, size) == 0) {
+		return;
+	}
+
+	pcData.stageFlags		 = stageFlags;
+	pcData.offset			 = offset;
+	pcData.size				 = size;
 	pcData.data.resize(size);
 	memcpy(pcData.data.data(), data, size);
+	invalidateRecording();
+}
+
+void GpuTask::waitForTransfer(memory::TransferTicket ticket) {
+	uint64_t current = transferWait_.load();
+	while (ticket.value > current && !transferWait_.compare_exchange_weak(current, ticket.value)) {
+	}
+}
+
+uint32_t GpuTask::addTransientBuffer(BufferType type, VkDeviceSize range, VkShaderStageFlags stageFlags) {
+	if (isBuilt_) {
+		std::cerr << "Cannot add transient buffer to built GPU task. Call destroy() first." << std::endl;
+		return UINT32_MAX;
+	}
+	if (type != BufferType::UNIFORM && type != BufferType::STORAGE) {
+		std::cerr << "GpuTask: Transient buffers must be UNIFORM or STORAGE" << std::endl;
+		return UINT32_MAX;
+	}
+
+	TransientBinding binding{};
+	binding.type	   = type == BufferType::UNIFORM ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+	binding.range	   = range;
+	binding.stageFlags = stageFlags;
+	transientBindings_.push_back(binding);
+
+	return static_cast<uint32_t>(transientBindings_.size() - 1);
+}
+
+void GpuTask::setFrameMemorySize(VkDeviceSize bytesPerFrame) {
+	if (isBuilt_) {
+		std::cerr << "Cannot resize frame memory of built GPU task. Call destroy() first." << std::endl;
+		return;
+	}
+	frameMemorySize_ = bytesPerFrame;
+}
+
+void GpuTask::beginFrameMemory() {
+	if (frameMemoryBegun_ || !frameAllocator_) return;
+
+	// The partition of this frame slot was last used maxFramesInFlight_ executes ago; the fence
+	// guarding the slot has to signal before its slices can be handed out again.
+	VkFence fence = fence_;
+	if (!graphicsPipelines_.empty() && graphicsPipelines_[0]->getSwapchain() != VK_NULL_HANDLE) {
+		fence = graphicsPipelines_[0]->getInFlightFence();
+	}
+	if (fence != VK_NULL_HANDLE) {
+		vkWaitForFences(gpu_->device, 1, &fence, VK_TRUE, UINT64_MAX);
+	}
 
-	pushConstants_.clear();
-	pushConstants_.push_back(pcData);
+	frameAllocator_->beginFrame(currentFrame_);
+	frameMemoryBegun_ = true;
 }
 
-void GpuTask::addRecordingCallback(RecordingCallback callback) { recordingCallbacks_.push_back(callback); }
+memory::FrameAllocation GpuTask::allocateFrameMemory(VkDeviceSize size, VkDeviceSize alignment) {
+	if (!isBuilt_ || !frameAllocator_) {
+		std::cerr << "GpuTask: Frame memory requires a built task with transient buffers or setFrameMemorySize()" << std::endl;
+		return memory::FrameAllocation{};
+	}
+
+	beginFrameMemory();
+	return frameAllocator_->allocate(size, alignment);
+}
+
+void* GpuTask::mapTransientBuffer(uint32_t index) {
+	if (index >= transientBindings_.size()) {
+		std::cerr << "GpuTask: Invalid transient buffer index " << index << std::endl;
+		return nullptr;
+	}
 
-void GpuTask::clearRecordingCallbacks() { recordingCallbacks_.clear(); }
+	TransientBinding& binding = transientBindings_[index];
+	if (!binding.written) {
+		memory::FrameAllocation slice = allocateFrameMemory(binding.range);
+		if (!slice.isValid()) return nullptr;
 
-void GpuTask::addRenderPassCallback(RecordingCallback callback) { renderPassCallbacks_.push_back(callback); }
+		binding.slice	= slice;
+		binding.written = true;
+	}
+	return binding.slice.data;
+}
 
-void GpuTask::clearRenderPassCallbacks() { renderPassCallbacks_.clear(); }
+bool GpuTask::setTransientBuffer(uint32_t index, const void* data, VkDeviceSize size) {
+	if (index < transientBindings_.size() && size > transientBindings_[index].range) {
+		std::cerr << "GpuTask: Transient buffer data larger than its range" << std::endl;
+		return false;
+	}
+
+	void* dst = mapTransientBuffer(index);
+	if (!dst) return false;
+
+	memcpy(dst, data, size);
+	return true;
+}
+
+void GpuTask::addRecordingCallback(RecordingCallback callback) {
+	// Whatever the callback binds is unknown to the tracker
+	addTrackedRecordingCallback([callback](StateTracker& state, uint32_t frameIndex, uint32_t imageIndex) {
+		callback(state.getCommandBuffer(), frameIndex, imageIndex);
+		state.invalidate();
+	});
+}
+
+void GpuTask::addTrackedRecordingCallback(TrackedRecordingCallback callback) {
+	recordingCallbacks_.push_back(std::move(callback));
+	invalidateRecording();
+}
+
+void GpuTask::clearRecordingCallbacks() {
+	recordingCallbacks_.clear();
+	invalidateRecording();
+}
+
+void GpuTask::addRenderPassCallback(RecordingCallback callback) {
+	addTrackedRenderPassCallback([callback](StateTracker& state, uint32_t frameIndex, uint32_t imageIndex) {
+		callback(state.getCommandBuffer(), frameIndex, imageIndex);
+		state.invalidate();
+	});
+}
+
+void GpuTask::addTrackedRenderPassCallback(TrackedRecordingCallback callback) {
+	renderPassCallbacks_.push_back(std::move(callback));
+	invalidateRecording();
+}
+
+uint64_t GpuTask::getDroppedCommandCount() const {
+	uint64_t dropped = primaryState_.getDroppedCount();
+	for (const StateTracker& state : jobStates_) {
+		dropped += state.getDroppedCount();
+	}
+	return dropped;
+}
+
+void GpuTask::clearRenderPassCallbacks() {
+	renderPassCallbacks_.clear();
+	invalidateRecording();
+}
+
+void GpuTask::setReplay(bool replay) {
+	replay_ = replay;
+	invalidateRecording();
+}
 
 void GpuTask::beginDefaultRenderPass(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
 	if (graphicsPipelines_.empty()) {
@@ -153,7 +302,10 @@ descriptor::DescriptorSetManager* GpuTask::getDescriptorManager() {
 	return descriptorManager_.get();
 }
 
-void GpuTask::enableDescriptorManager(bool enable) { useDescriptorManager_ = enable; }
+void GpuTask::enableDescriptorManager(bool enable) {
+	useDescriptorManager_ = enable;
+	invalidateRecording();
+}
 
 query::QueryPool* GpuTask::createQueryPool(uint32_t queryCount) {
 	if (!queryPool_) {
@@ -177,6 +329,7 @@ ComputePipeline* GpuTask::createComputePipeline(const std::string& name) {
 GraphicsPipeline* GpuTask::createGraphicsPipeline(const std::string& name) {
 	auto  pipeline = std::make_unique<GraphicsPipeline>(gpu_, name);
 	auto* ptr	   = pipeline.get();
+	ptr->executionMutex_ = &executionMutex_;
 	graphicsPipelines_.push_back(std::move(pipeline));
 	return ptr;
 }
@@ -1,9 +1,16 @@
 #ifndef GPUTASK_HPP
 #define GPUTASK_HPP
 
+#include "../memory/commandAllocator.hpp"
+#include "../memory/frameAllocator.hpp"
+#include "../memory/transferManager.hpp"
+#include "parallelRecorder.hpp"
+#include "stateTracker.hpp"
+
 #include <atomic>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 #include <vulkan/vulkan_core.h>
@@ -35,6 +42,8 @@ namespace renderApi::gpuTask {
 
 	  public:
 		using RecordingCallback = std::function<void(VkCommandBuffer, uint32_t frameIndex, uint32_t imageIndex)>;
+		// Records through the task's state tracker, which drops binds of what is already bound
+		using TrackedRecordingCallback = std::function<void(StateTracker& state, uint32_t frameIndex, uint32_t imageIndex)>;
 
 	  private:
 		std::string	 name_;
@@ -49,8 +58,11 @@ namespace renderApi::gpuTask {
 
 		std::unique_ptr<query::QueryPool> queryPool_;
 
-		VkCommandPool				 commandPool_ = VK_NULL_HANDLE;
-		std::vector<VkCommandBuffer> commandBuffers_;
+		// Primaries come from one pool per frame slot, reset in bulk when the slot comes round again.
+		// Named secondaries are recorded once and kept, so they have a pool of their own.
+		memory::CommandAllocator	 commandAllocator_;
+		std::vector<VkCommandBuffer> commandBuffers_; // Last primary recorded in each frame slot
+		VkCommandPool				 commandPool_		= VK_NULL_HANDLE;
 		VkFence						 fence_				= VK_NULL_HANDLE;
 		uint32_t					 currentFrame_		= 0;
 		uint32_t					 maxFramesInFlight_ = 3;
@@ -62,12 +74,53 @@ namespace renderApi::gpuTask {
 		};
 		std::vector<SecondaryCommandBuffer> secondaryCommandBuffers_;
 
-		std::vector<RecordingCallback> recordingCallbacks_;
-		std::vector<RecordingCallback> renderPassCallbacks_;
-		bool						   useCustomRecording_ = false;
+		// Draws of several graphics pipelines are recorded in parallel, one secondary per pipeline
+		ParallelRecorder			   recorder_;
+		uint32_t					   recordingThreads_ = 0;
+		std::vector<GraphicsPipeline*> drawnPipelines_; // Enabled pipelines, split between the first jobs
+		std::vector<VkCommandBuffer>   recordedSecondaries_;
+
+		StateTracker			  primaryState_;
+		std::vector<StateTracker> jobStates_; // One per secondary recorded in parallel
+
+		// Scratch filled by every recording; it keeps its capacity, so a steady frame allocates nothing
+		std::vector<VkDescriptorSet> boundSets_;
+		std::vector<VkBuffer>		 vertexHandles_;
+		std::vector<VkDeviceSize>	 vertexOffsets_;
+
+		std::vector<TrackedRecordingCallback> recordingCallbacks_;
+		std::vector<TrackedRecordingCallback> renderPassCallbacks_;
+		bool								  useCustomRecording_ = false;
+
+		// Replay: what each frame slot's command buffer was recorded with
+		struct RecordedState {
+			uint64_t			  version = 0; // recordVersion_ at the time, 0 when it can't be replayed
+			uint64_t			  key	  = 0; // getRecordingKey()
+			std::vector<uint32_t> dynamicOffsets;
+		};
+		std::vector<RecordedState> recordedStates_;
+		uint64_t				   recordVersion_ = 1; // Bumped by every change to what gets recorded
+		bool					   replay_		  = false;
+
+		std::atomic<uint64_t> transferWait_ = 0; // Transfer timeline value the next submission waits on
 
 		std::vector<Buffer*>			buffers_;
 		std::vector<VkShaderStageFlags> bufferStages_;
+		uint64_t						bufferGeneration_ = 0; // Sum of buffer generations when descriptorSet_ was written
+
+		// Per-frame data bound as dynamic uniform/storage buffers after the regular buffers
+		struct TransientBinding {
+			VkDescriptorType		type;
+			VkDeviceSize			range;
+			VkShaderStageFlags		stageFlags;
+			memory::FrameAllocation slice;
+			bool					written = false;
+		};
+		std::vector<TransientBinding>			transientBindings_;
+		std::vector<uint32_t>					dynamicOffsets_;
+		std::unique_ptr<memory::FrameAllocator> frameAllocator_;
+		VkDeviceSize							frameMemorySize_  = 0;
+		bool									frameMemoryBegun_ = false;
 
 		std::vector<Buffer*> vertexBuffers_;
 		Buffer*				 indexBuffer_	= nullptr;
@@ -99,6 +152,21 @@ namespace renderApi::gpuTask {
 		std::atomic_bool enabled_	  = true;
 		bool autoExecute_ = false;
 
+		// Held for the whole of execute(); the graphics pipelines take it to change their readback
+		std::mutex executionMutex_;
+
+		void	 beginFrameMemory();
+		void	 flushDirtyBuffers(VkCommandBuffer cmd);
+		void	 writeBufferDescriptors();
+		void	 refreshDescriptors();
+		uint64_t getBufferGeneration() const;
+		uint64_t getRecordingKey(uint32_t imageIndex, bool usesSwapchain) const;
+		bool	 hasDirtyBuffers() const;
+		VkRenderPassBeginInfo makeRenderPassBeginInfo(uint32_t imageIndex, bool usesSwapchain) const;
+		void	 recordCommands(VkCommandBuffer commandBuffer, uint32_t imageIndex, bool usesSwapchain);
+		void	 recordPipelineDraw(StateTracker& state, GraphicsPipeline* pipeline) const;
+		void	 prepareBindArrays();
+
 	  public:
 		GpuTask(const std::string& name, device::GPU* gpu);
 		~GpuTask();
@@ -118,13 +186,55 @@ namespace renderApi::gpuTask {
 
 		void pushConstants(VkShaderStageFlags stageFlags, uint32_t offset, uint32_t size, const void* data);
 
+		// The next execute() waits on the GPU for the upload to complete instead of the host blocking
+		void waitForTransfer(memory::TransferTicket ticket);
+
+		// Transient buffers live in the task's frame allocator. Binding number is buffer count + index.
+		// A transient buffer that is not written during a frame keeps its previous contents.
+		uint32_t				addTransientBuffer(BufferType type, VkDeviceSize range, VkShaderStageFlags stageFlags = VK_SHADER_STAGE_COMPUTE_BIT);
+		void*					mapTransientBuffer(uint32_t index);
+		bool					setTransientBuffer(uint32_t index, const void* data, VkDeviceSize size);
+		memory::FrameAllocation allocateFrameMemory(VkDeviceSize size, VkDeviceSize alignment = 0);
+		void					setFrameMemorySize(VkDeviceSize bytesPerFrame);
+		memory::FrameAllocator* getFrameAllocator() const { return frameAllocator_.get(); }
+		const std::vector<uint32_t>& getDynamicOffsets() const { return dynamicOffsets_; }
+
+		// Commands recorded by plain callbacks make the tracker forget what it knew was bound; tracked
+		// callbacks record through the StateTracker, which keeps it
 		void addRecordingCallback(RecordingCallback callback);
+		void addTrackedRecordingCallback(TrackedRecordingCallback callback);
 		void clearRecordingCallbacks();
 		void addRenderPassCallback(RecordingCallback callback);
+		void addTrackedRenderPassCallback(TrackedRecordingCallback callback);
 		void clearRenderPassCallbacks();
-		void setUseCustomRecording(bool useCustom) { useCustomRecording_ = useCustom; }
+
+		// Bind and push constant commands the state trackers found redundant and left out, since
+		// build(). Call from the thread running execute().
+		uint64_t getDroppedCommandCount() const;
+		void setUseCustomRecording(bool useCustom) {
+			useCustomRecording_ = useCustom;
+			invalidateRecording();
+		}
 		bool isUsingCustomRecording() const { return useCustomRecording_; }
 
+		// Tasks with several graphics pipelines record their draws, split in one secondary command
+		// buffer per thread, and each render pass callback into a secondary of its own, on up to count
+		// threads, the thread calling execute() included. Render pass callbacks then run concurrently
+		// with each other on those threads. 0 picks one thread per core. Takes effect at the next build().
+		void	 setRecordingThreads(uint32_t count) { recordingThreads_ = count; }
+		uint32_t getRecordingThreads() const { return recorder_.isValid() ? recorder_.getThreadCount() : 0; }
+
+		// Replay mode records each frame slot's command buffer once and resubmits it as is while nothing
+		// it depends on changed. The setters of the task, pipeline enable toggles and rebuilds, resized
+		// buffers and new dynamic offsets all cause a new recording. Recording callbacks only run then,
+		// so they must record the same commands until invalidateRecording() is called. Frames that
+		// flush dirty buffers, wait on transfers or read back the output are recorded as usual, and
+		// so are tasks drawing through secondary command buffers. Updating a descriptor set of the
+		// descriptor manager by hand also calls for invalidateRecording().
+		void setReplay(bool replay);
+		bool isReplay() const { return replay_; }
+		void invalidateRecording() { recordVersion_++; }
+
 		void beginDefaultRenderPass(VkCommandBuffer commandBuffer, uint32_t imageIndex);
 		void endDefaultRenderPass(VkCommandBuffer commandBuffer);
 
@@ -135,6 +245,7 @@ namespace renderApi::gpuTask {
 		VkCommandBuffer createSecondaryCommandBuffer(const std::string& name);
 		void			recordSecondaryCommandBuffer(const std::string& name, RecordingCallback callback);
 		void			executeSecondaryCommandBuffers(VkCommandBuffer primaryCmd);
+		// "pipeline_<index>" names a graphics pipeline, whose setEnabled() it forwards to
 		void			enableSecondaryCommandBuffer(const std::string& name, bool enable = true);
 		void			destroySecondaryCommandBuffer(const std::string& name);
 
@@ -0,0 +1,141 @@
+#include "parallelRecorder.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+using namespace renderApi::gpuTask;
+
+// ============================================================================
+// ParallelRecorder Implementation
+// ============================================================================
+
+ParallelRecorder::ParallelRecorder()
+	: batch_(0), pending_(0), stopping_(false), nextJob_(0), inheritance_{}, job_(nullptr), jobCount_(0), results_(nullptr) {}
+
+ParallelRecorder::~ParallelRecorder() { destroy(); }
+
+bool ParallelRecorder::create(device::GPU* gpu, uint32_t queueFamily, uint32_t frameSlots, uint32_t threadCount) {
+	destroy();
+
+	if (threadCount == 0) {
+		std::cerr << "ParallelRecorder: Invalid thread count" << std::endl;
+		return false;
+	}
+
+	for (uint32_t thread = 0; thread < threadCount; ++thread) {
+		auto allocator = std::make_unique<memory::CommandAllocator>();
+		if (!allocator->create(gpu, queueFamily, frameSlots)) {
+			destroy();
+			return false;
+		}
+		allocators_.push_back(std::move(allocator));
+	}
+
+	stopping_ = false;
+	for (uint32_t thread = 1; thread < threadCount; ++thread) {
+		workers_.emplace_back(&ParallelRecorder::workerLoop, this, thread);
+	}
+	return true;
+}
+
+void ParallelRecorder::destroy() {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stopping_ = true;
+	}
+	batchReady_.notify_all();
+	for (auto& worker : workers_) {
+		worker.join();
+	}
+	workers_.clear();
+	batch_ = 0;
+
+	allocators_.clear();
+}
+
+void ParallelRecorder::record(uint32_t								slot,
+							  const VkCommandBufferInheritanceInfo& inheritance,
+							  uint32_t								jobCount,
+							  const Job&							job,
+							  std::vector<VkCommandBuffer>&			secondaries) {
+	secondaries.assign(jobCount, VK_NULL_HANDLE);
+	if (allocators_.empty() || jobCount == 0) return;
+
+	// Nothing recorded from the slot's pools is pending any more; the workers are idle between batches
+	for (auto& allocator : allocators_) {
+		allocator->beginFrame(slot);
+	}
+
+	inheritance_ = inheritance;
+	job_		 = &job;
+	jobCount_	 = jobCount;
+	results_	 = &secondaries;
+	nextJob_	 = 0;
+
+	// A single job isn't worth waking anybody
+	uint32_t helpers = static_cast<uint32_t>(std::min<size_t>(workers_.size(), jobCount - 1));
+	if (helpers > 0) {
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			pending_ = static_cast<uint32_t>(workers_.size());
+			batch_++;
+		}
+		batchReady_.notify_all();
+	}
+
+	runJobs(0);
+
+	if (helpers > 0) {
+		std::unique_lock<std::mutex> lock(mutex_);
+		batchDone_.wait(lock, [&]() { return pending_ == 0; });
+	}
+
+	job_	 = nullptr;
+	results_ = nullptr;
+	secondaries.erase(std::remove(secondaries.begin(), secondaries.end(), VK_NULL_HANDLE), secondaries.end());
+}
+
+void ParallelRecorder::runJobs(uint32_t thread) {
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType			   = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags			   = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	beginInfo.pInheritanceInfo = &inheritance_;
+
+	for (size_t index = nextJob_++; index < jobCount_; index = nextJob_++) {
+		VkCommandBuffer cmd = allocators_[thread]->allocate(VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+		if (cmd == VK_NULL_HANDLE) continue;
+
+		if (vkBeginCommandBuffer(cmd, &beginInfo) != VK_SUCCESS) {
+			std::cerr << "ParallelRecorder: Failed to begin secondary command buffer" << std::endl;
+			continue;
+		}
+		(*job_)(cmd, static_cast<uint32_t>(index));
+		if (vkEndCommandBuffer(cmd) != VK_SUCCESS) {
+			std::cerr << "ParallelRecorder: Failed to end secondary command buffer" << std::endl;
+			continue;
+		}
+		// Every job writes its own element
+		(*results_)[index] = cmd;
+	}
+}
+
+void ParallelRecorder::workerLoop(uint32_t thread) {
+	uint64_t seen = 0;
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			batchReady_.wait(lock, [&]() { return stopping_ || batch_ != seen; });
+			if (stopping_) return;
+			seen = batch_;
+		}
+
+		runJobs(thread);
+
+		bool last;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			last = --pending_ == 0;
+		}
+		if (last) batchDone_.notify_one();
+	}
+}
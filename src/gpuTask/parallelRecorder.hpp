@@ -0,0 +1,78 @@
+#ifndef PARALLEL_RECORDER_HPP
+#define PARALLEL_RECORDER_HPP
+
+#include "../memory/commandAllocator.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+namespace renderApi::device {
+	struct GPU;
+}
+
+namespace renderApi::gpuTask {
+
+	// Records secondary command buffers on several threads. Every thread, the caller of record()
+	// included, owns a CommandAllocator with one pool per frame slot, so no pool is ever touched by
+	// two threads and a slot's buffers are recycled by resetting its pools once the frame that used
+	// them completed.
+	//
+	// record() hands the job indices out to whichever thread is free and returns when all of them
+	// are recorded, in index order, ready for vkCmdExecuteCommands(). Jobs run concurrently and must
+	// only record into the command buffer they are given. Once the pools hold enough buffers, a
+	// frame allocates nothing.
+	class ParallelRecorder {
+	  public:
+		using Job = std::function<void(VkCommandBuffer cmd, uint32_t index)>;
+
+		ParallelRecorder();
+		~ParallelRecorder();
+
+		ParallelRecorder(const ParallelRecorder&)			 = delete;
+		ParallelRecorder& operator=(const ParallelRecorder&) = delete;
+
+		// threadCount counts the caller: 1 records everything on the calling thread
+		bool create(device::GPU* gpu, uint32_t queueFamily, uint32_t frameSlots, uint32_t threadCount);
+		void destroy();
+
+		// The previous submission of the slot must have completed. Buffers whose job failed to
+		// begin or end are left out of secondaries.
+		void record(uint32_t							  slot,
+					const VkCommandBufferInheritanceInfo& inheritance,
+					uint32_t							  jobCount,
+					const Job&							  job,
+					std::vector<VkCommandBuffer>&		  secondaries);
+
+		uint32_t getThreadCount() const { return static_cast<uint32_t>(workers_.size()) + 1; }
+		bool	 isValid() const { return !allocators_.empty(); }
+
+	  private:
+		std::vector<std::unique_ptr<memory::CommandAllocator>> allocators_; // Thread 0 is the caller
+		std::vector<std::thread>							   workers_;
+
+		std::mutex						mutex_;
+		std::condition_variable			batchReady_;
+		std::condition_variable			batchDone_;
+		uint64_t						batch_;		// Bumped by every record() that wakes the workers
+		uint32_t						pending_;	// Workers still in the current batch
+		bool							stopping_;
+		std::atomic<size_t>				nextJob_;
+		VkCommandBufferInheritanceInfo	inheritance_;
+		const Job*						job_;
+		uint32_t						jobCount_;
+		std::vector<VkCommandBuffer>*	results_;
+
+		void runJobs(uint32_t thread);
+		void workerLoop(uint32_t thread);
+	};
+
+} // namespace renderApi::gpuTask
+
+#endif
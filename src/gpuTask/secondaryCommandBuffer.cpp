@@ -116,6 +116,20 @@ void GpuTask::enableSecondaryCommandBuffer(const std::string& name, bool enable)
 			return;
 		}
 	}
+
+	// Multi-pipeline tasks used to create one secondary per pipeline, named "pipeline_<index>"; they
+	// are now recorded per pipeline, so those names enable or disable the pipeline itself
+	static const std::string kPipelinePrefix = "pipeline_";
+	if (name.size() > kPipelinePrefix.size() && name.size() - kPipelinePrefix.size() <= 9 && name.compare(0, kPipelinePrefix.size(), kPipelinePrefix) == 0 &&
+		name.find_first_not_of("0123456789", kPipelinePrefix.size()) == std::string::npos) {
+		size_t index = std::stoul(name.substr(kPipelinePrefix.size()));
+		if (index < graphicsPipelines_.size()) {
+			graphicsPipelines_[index]->setEnabled(enable);
+			std::cout << "GpuTask: Pipeline " << index << " " << (enable ? "enabled" : "disabled") << std::endl;
+			return;
+		}
+	}
+
 	std::cerr << "GpuTask: Secondary command buffer '" << name << "' not found" << std::endl;
 }
 
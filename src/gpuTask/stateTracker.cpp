@@ -0,0 +1,214 @@
+#include "stateTracker.hpp"
+
+#include <cstring>
+
+using namespace renderApi::gpuTask;
+
+// ============================================================================
+// StateTracker Implementation
+// ============================================================================
+
+StateTracker::StateTracker(VkCommandBuffer commandBuffer) : recorded_(0), dropped_(0) { reset(commandBuffer); }
+
+void StateTracker::reset(VkCommandBuffer commandBuffer) {
+	commandBuffer_ = commandBuffer;
+	invalidate();
+}
+
+void StateTracker::invalidate() {
+	graphics_	 = BindPointState{};
+	compute_	 = BindPointState{};
+	vertexMask_	 = 0;
+	indexBuffer_ = VK_NULL_HANDLE;
+	indexOffset_ = 0;
+	indexType_	 = VK_INDEX_TYPE_UINT32;
+	pushLayout_	 = VK_NULL_HANDLE;
+	memset(pushStages_, 0, sizeof(pushStages_));
+	viewportMask_ = 0;
+	scissorMask_  = 0;
+}
+
+StateTracker::BindPointState* StateTracker::getBindPoint(VkPipelineBindPoint bindPoint) {
+	if (bindPoint == VK_PIPELINE_BIND_POINT_GRAPHICS) return &graphics_;
+	if (bindPoint == VK_PIPELINE_BIND_POINT_COMPUTE) return &compute_;
+	return nullptr;
+}
+
+void StateTracker::bindPipeline(VkPipelineBindPoint bindPoint, VkPipeline pipeline) {
+	BindPointState* state = getBindPoint(bindPoint);
+	if (state && state->pipeline == pipeline) {
+		dropped_++;
+		return;
+	}
+
+	vkCmdBindPipeline(commandBuffer_, bindPoint, pipeline);
+	recorded_++;
+	if (!state) return;
+
+	state->pipeline = pipeline;
+	// The new pipeline's static state replaces whatever was set dynamically
+	if (bindPoint == VK_PIPELINE_BIND_POINT_GRAPHICS) {
+		viewportMask_ = 0;
+		scissorMask_  = 0;
+	}
+}
+
+void StateTracker::bindDescriptorSets(VkPipelineBindPoint	 bindPoint,
+									  VkPipelineLayout		 layout,
+									  uint32_t				 firstSet,
+									  uint32_t				 setCount,
+									  const VkDescriptorSet* sets,
+									  uint32_t				 dynamicOffsetCount,
+									  const uint32_t*		 dynamicOffsets) {
+	BindPointState* state = getBindPoint(bindPoint);
+
+	// Splitting dynamic offsets between sets takes their layouts: with offsets, only single sets are tracked
+	bool trackable = state && firstSet + setCount <= kMaxDescriptorSets && (setCount == 1 || dynamicOffsetCount == 0) &&
+					 dynamicOffsetCount <= kMaxDynamicOffsets;
+
+	if (trackable && state->layout == layout) {
+		bool same = true;
+		for (uint32_t i = 0; i < setCount && same; ++i) {
+			const BoundSet& bound = state->sets[firstSet + i];
+			same = bound.set != VK_NULL_HANDLE && bound.set == sets[i] && bound.dynamicOffsetCount == dynamicOffsetCount &&
+				   (dynamicOffsetCount == 0 || memcmp(bound.dynamicOffsets, dynamicOffsets, dynamicOffsetCount * sizeof(uint32_t)) == 0);
+		}
+		if (same) {
+			dropped_++;
+			return;
+		}
+	}
+
+	vkCmdBindDescriptorSets(commandBuffer_, bindPoint, layout, firstSet, setCount, sets, dynamicOffsetCount, dynamicOffsets);
+	recorded_++;
+	if (!state) return;
+
+	// Sets bound through another layout may have been disturbed
+	if (state->layout != layout || !trackable) {
+		for (BoundSet& bound : state->sets) bound = BoundSet{};
+		state->layout = trackable ? layout : VK_NULL_HANDLE;
+	}
+	if (!trackable) return;
+
+	for (uint32_t i = 0; i < setCount; ++i) {
+		BoundSet& bound			 = state->sets[firstSet + i];
+		bound.set				 = sets[i];
+		bound.dynamicOffsetCount = dynamicOffsetCount;
+		if (dynamicOffsetCount > 0) memcpy(bound.dynamicOffsets, dynamicOffsets, dynamicOffsetCount * sizeof(uint32_t));
+	}
+}
+
+void StateTracker::bindVertexBuffers(uint32_t firstBinding, uint32_t bindingCount, const VkBuffer* buffers, const VkDeviceSize* offsets) {
+	bool trackable = firstBinding + bindingCount <= kMaxVertexBindings;
+	if (trackable && bindingCount > 0) {
+		bool same = true;
+		for (uint32_t i = 0; i < bindingCount && same; ++i) {
+			uint32_t binding = firstBinding + i;
+			same = (vertexMask_ >> binding & 1) != 0 && vertexBuffers_[binding] == buffers[i] && vertexOffsets_[binding] == offsets[i];
+		}
+		if (same) {
+			dropped_++;
+			return;
+		}
+	}
+
+	vkCmdBindVertexBuffers(commandBuffer_, firstBinding, bindingCount, buffers, offsets);
+	recorded_++;
+
+	for (uint32_t i = 0; i < bindingCount && firstBinding + i < kMaxVertexBindings; ++i) {
+		vertexBuffers_[firstBinding + i] = buffers[i];
+		vertexOffsets_[firstBinding + i] = offsets[i];
+		vertexMask_ |= 1u << (firstBinding + i);
+	}
+}
+
+void StateTracker::bindIndexBuffer(VkBuffer buffer, VkDeviceSize offset, VkIndexType indexType) {
+	if (buffer != VK_NULL_HANDLE && indexBuffer_ == buffer && indexOffset_ == offset && indexType_ == indexType) {
+		dropped_++;
+		return;
+	}
+
+	vkCmdBindIndexBuffer(commandBuffer_, buffer, offset, indexType);
+	recorded_++;
+
+	indexBuffer_ = buffer;
+	indexOffset_ = offset;
+	indexType_	 = indexType;
+}
+
+void StateTracker::pushConstants(VkPipelineLayout layout, VkShaderStageFlags stageFlags, uint32_t offset, uint32_t size, const void* data) {
+	// Offsets and sizes are multiples of 4
+	uint32_t first	   = offset / 4;
+	uint32_t count	   = size / 4;
+	bool	 trackable = offset % 4 == 0 && size % 4 == 0 && first + count <= kPushWords;
+
+	if (trackable && layout == pushLayout_ && count > 0) {
+		bool same = memcmp(&pushWords_[first], data, size) == 0;
+		for (uint32_t i = 0; i < count && same; ++i) {
+			same = pushStages_[first + i] == stageFlags;
+		}
+		if (same) {
+			dropped_++;
+			return;
+		}
+	}
+
+	vkCmdPushConstants(commandBuffer_, layout, stageFlags, offset, size, data);
+	recorded_++;
+
+	if (layout != pushLayout_) {
+		memset(pushStages_, 0, sizeof(pushStages_));
+		pushLayout_ = layout;
+	}
+	if (trackable) {
+		memcpy(&pushWords_[first], data, size);
+		for (uint32_t i = 0; i < count; ++i) pushStages_[first + i] = stageFlags;
+	} else {
+		// Words beyond what is tracked may overlap the tracked ones through other stages
+		memset(pushStages_, 0, sizeof(pushStages_));
+	}
+}
+
+void StateTracker::setViewport(uint32_t firstViewport, uint32_t viewportCount, const VkViewport* viewports) {
+	bool trackable = firstViewport + viewportCount <= kMaxViewports;
+	if (trackable && viewportCount > 0) {
+		bool same = true;
+		for (uint32_t i = 0; i < viewportCount && same; ++i) {
+			same = (viewportMask_ >> (firstViewport + i) & 1) != 0 && memcmp(&viewports_[firstViewport + i], &viewports[i], sizeof(VkViewport)) == 0;
+		}
+		if (same) {
+			dropped_++;
+			return;
+		}
+	}
+
+	vkCmdSetViewport(commandBuffer_, firstViewport, viewportCount, viewports);
+	recorded_++;
+
+	for (uint32_t i = 0; i < viewportCount && firstViewport + i < kMaxViewports; ++i) {
+		viewports_[firstViewport + i] = viewports[i];
+		viewportMask_ |= 1u << (firstViewport + i);
+	}
+}
+
+void StateTracker::setScissor(uint32_t firstScissor, uint32_t scissorCount, const VkRect2D* scissors) {
+	bool trackable = firstScissor + scissorCount <= kMaxViewports;
+	if (trackable && scissorCount > 0) {
+		bool same = true;
+		for (uint32_t i = 0; i < scissorCount && same; ++i) {
+			same = (scissorMask_ >> (firstScissor + i) & 1) != 0 && memcmp(&scissors_[firstScissor + i], &scissors[i], sizeof(VkRect2D)) == 0;
+		}
+		if (same) {
+			dropped_++;
+			return;
+		}
+	}
+
+	vkCmdSetScissor(commandBuffer_, firstScissor, scissorCount, scissors);
+	recorded_++;
+
+	for (uint32_t i = 0; i < scissorCount && firstScissor + i < kMaxViewports; ++i) {
+		scissors_[firstScissor + i] = scissors[i];
+		scissorMask_ |= 1u << (firstScissor + i);
+	}
+}
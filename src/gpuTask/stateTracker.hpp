@@ -0,0 +1,88 @@
+#ifndef STATE_TRACKER_HPP
+#define STATE_TRACKER_HPP
+
+#include <cstdint>
+#include <vulkan/vulkan_core.h>
+
+namespace renderApi::gpuTask {
+
+	// Records bind, push constant and dynamic state commands into a command buffer, dropping the
+	// ones that would set what is already set. It only knows what went through it: after recording
+	// anything directly into the command buffer, call invalidate().
+	//
+	// Filtering is conservative. Descriptor sets and push constants only match when they were set
+	// through the same pipeline layout handle, binding a different pipeline forgets the viewports
+	// and scissors, and push constants past kMaxPushConstantBytes are always recorded.
+	class StateTracker {
+	  public:
+		static constexpr uint32_t kMaxDescriptorSets	= 8;
+		static constexpr uint32_t kMaxVertexBindings	= 16;
+		static constexpr uint32_t kMaxViewports			= 16;
+		static constexpr uint32_t kMaxPushConstantBytes	= 256;
+		static constexpr uint32_t kMaxDynamicOffsets	= 16; // Per set
+
+		explicit StateTracker(VkCommandBuffer commandBuffer = VK_NULL_HANDLE);
+
+		// Starts over on commandBuffer, which has nothing bound yet; the counters keep going
+		void reset(VkCommandBuffer commandBuffer);
+		// Forgets everything that is bound, after commands were recorded around the tracker
+		void invalidate();
+
+		void bindPipeline(VkPipelineBindPoint bindPoint, VkPipeline pipeline);
+		void bindDescriptorSets(VkPipelineBindPoint	   bindPoint,
+								VkPipelineLayout	   layout,
+								uint32_t			   firstSet,
+								uint32_t			   setCount,
+								const VkDescriptorSet* sets,
+								uint32_t			   dynamicOffsetCount = 0,
+								const uint32_t*		   dynamicOffsets	  = nullptr);
+		void bindVertexBuffers(uint32_t firstBinding, uint32_t bindingCount, const VkBuffer* buffers, const VkDeviceSize* offsets);
+		void bindIndexBuffer(VkBuffer buffer, VkDeviceSize offset, VkIndexType indexType);
+		void pushConstants(VkPipelineLayout layout, VkShaderStageFlags stageFlags, uint32_t offset, uint32_t size, const void* data);
+		void setViewport(uint32_t firstViewport, uint32_t viewportCount, const VkViewport* viewports);
+		void setScissor(uint32_t firstScissor, uint32_t scissorCount, const VkRect2D* scissors);
+
+		VkCommandBuffer getCommandBuffer() const { return commandBuffer_; }
+		uint64_t		getRecordedCount() const { return recorded_; }
+		uint64_t		getDroppedCount() const { return dropped_; }
+
+	  private:
+		struct BoundSet {
+			VkDescriptorSet	set				   = VK_NULL_HANDLE;
+			uint32_t		dynamicOffsetCount = 0;
+			uint32_t		dynamicOffsets[kMaxDynamicOffsets];
+		};
+
+		struct BindPointState {
+			VkPipeline		 pipeline = VK_NULL_HANDLE;
+			VkPipelineLayout layout	  = VK_NULL_HANDLE; // Of the bound sets
+			BoundSet		 sets[kMaxDescriptorSets];
+		};
+
+		static constexpr uint32_t kPushWords = kMaxPushConstantBytes / 4;
+
+		VkCommandBuffer	   commandBuffer_;
+		BindPointState	   graphics_;
+		BindPointState	   compute_;
+		VkBuffer		   vertexBuffers_[kMaxVertexBindings];
+		VkDeviceSize	   vertexOffsets_[kMaxVertexBindings];
+		uint32_t		   vertexMask_; // Bindings known to be set
+		VkBuffer		   indexBuffer_;
+		VkDeviceSize	   indexOffset_;
+		VkIndexType		   indexType_;
+		VkPipelineLayout   pushLayout_;
+		uint32_t		   pushWords_[kPushWords];
+		VkShaderStageFlags pushStages_[kPushWords]; // 0: word never pushed through pushLayout_
+		VkViewport		   viewports_[kMaxViewports];
+		VkRect2D		   scissors_[kMaxViewports];
+		uint32_t		   viewportMask_;
+		uint32_t		   scissorMask_;
+		uint64_t		   recorded_;
+		uint64_t		   dropped_;
+
+		BindPointState* getBindPoint(VkPipelineBindPoint bindPoint);
+	};
+
+} // namespace renderApi::gpuTask
+
+#endif
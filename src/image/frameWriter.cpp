@@ -0,0 +1,740 @@
+#include "frameWriter.hpp"
+
+#include "buffer/buffer.hpp"
+#include "readbackRing.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+	#include <immintrin.h>
+	#if defined(__SSSE3__) || defined(_MSC_VER)
+		#define FRAME_WRITER_SSSE3
+		#define FRAME_WRITER_SSSE3_TARGET
+	#elif defined(__GNUC__) || defined(__clang__)
+		// Built for baseline x86-64: compile the SSSE3 path anyway and pick it at run time
+		#define FRAME_WRITER_SSSE3
+		#define FRAME_WRITER_SSSE3_TARGET __attribute__((target("ssse3")))
+		#define FRAME_WRITER_SSSE3_RUNTIME
+	#endif
+#elif defined(__ARM_NEON)
+	#include <arm_neon.h>
+#endif
+
+using namespace renderApi;
+
+namespace {
+
+	constexpr uint32_t kBytesPerPixel = 4;
+
+	bool isBGRA(VkFormat format, bool& bgra) {
+		switch (format) {
+		case VK_FORMAT_R8G8B8A8_UNORM:
+		case VK_FORMAT_R8G8B8A8_SRGB:
+			bgra = false;
+			return true;
+		case VK_FORMAT_B8G8R8A8_UNORM:
+		case VK_FORMAT_B8G8R8A8_SRGB:
+			bgra = true;
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	// Gathers rows rowPitch bytes apart into a tightly packed copy
+	void copyPixels(const void* pixels, uint32_t width, uint32_t height, uint32_t rowPitch, std::vector<uint8_t>& out) {
+		size_t rowSize = static_cast<size_t>(width) * kBytesPerPixel;
+		out.resize(rowSize * height);
+
+		const uint8_t* src = static_cast<const uint8_t*>(pixels);
+		if (rowPitch == 0 || rowPitch == rowSize) {
+			memcpy(out.data(), src, out.size());
+			return;
+		}
+		for (uint32_t y = 0; y < height; y++) {
+			memcpy(out.data() + y * rowSize, src + static_cast<size_t>(y) * rowPitch, rowSize);
+		}
+	}
+
+	// ========================================================================
+	// RGBA to RGB
+	// ========================================================================
+
+#ifdef FRAME_WRITER_SSSE3
+	bool hasSSSE3() {
+	#ifdef FRAME_WRITER_SSSE3_RUNTIME
+		static const bool supported = __builtin_cpu_supports("ssse3");
+		return supported;
+	#else
+		return true;
+	#endif
+	}
+
+	// Loads 16 pixels before storing their 48 bytes, so dst may trail src in place
+	FRAME_WRITER_SSSE3_TARGET size_t convertToRGBSSSE3(const uint8_t* src, uint8_t* dst, size_t count, bool bgra) {
+		const __m128i mask = bgra ? _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1)
+								  : _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+		size_t i = 0;
+		for (; i + 16 <= count; i += 16) {
+			__m128i a = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4)), mask);
+			__m128i b = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4 + 16)), mask);
+			__m128i c = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4 + 32)), mask);
+			__m128i d = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4 + 48)), mask);
+
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 3), _mm_or_si128(a, _mm_slli_si128(b, 12)));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 3 + 16), _mm_or_si128(_mm_srli_si128(b, 4), _mm_slli_si128(c, 8)));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 3 + 32), _mm_or_si128(_mm_srli_si128(c, 8), _mm_slli_si128(d, 4)));
+		}
+		return i;
+	}
+#endif
+
+	// ========================================================================
+	// PNG
+	// ========================================================================
+
+	class BitWriter {
+	  public:
+		explicit BitWriter(std::vector<uint8_t>& out) : out_(out), bits_(0), count_(0) {}
+
+		// LSB first, as deflate packs everything but Huffman codes
+		void put(uint32_t value, uint32_t length) {
+			bits_ |= static_cast<uint64_t>(value) << count_;
+			count_ += length;
+			while (count_ >= 8) {
+				out_.push_back(static_cast<uint8_t>(bits_));
+				bits_ >>= 8;
+				count_ -= 8;
+			}
+		}
+
+		void flush() {
+			if (count_ > 0) out_.push_back(static_cast<uint8_t>(bits_));
+			bits_  = 0;
+			count_ = 0;
+		}
+
+	  private:
+		std::vector<uint8_t>& out_;
+		uint64_t			  bits_;
+		uint32_t			  count_;
+	};
+
+	constexpr uint16_t kLengthBase[29]	= {3,  4,  5,  6,  7,  8,  9,  10, 11,	13,	 15,  17,  19,	23, 27,
+										   31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+	constexpr uint8_t  kLengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+	constexpr uint16_t kDistBase[30]	= {1,	2,	 3,	  4,   5,	7,	  9,	13,	  17,	25,	  33,	49,	  65,	97,	   129,
+										   193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+	constexpr uint8_t  kDistExtra[30]	= {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+	constexpr uint32_t kWindowSize	= 32768;
+	constexpr uint32_t kHashBits	= 15;
+	constexpr uint32_t kMinMatch	= 3;
+	constexpr uint32_t kMaxMatch	= 258;
+	constexpr uint32_t kMaxChain	= 8;
+
+	uint32_t reverseBits(uint32_t code, uint32_t length) {
+		uint32_t reversed = 0;
+		for (uint32_t i = 0; i < length; i++) {
+			reversed = (reversed << 1) | ((code >> i) & 1);
+		}
+		return reversed;
+	}
+
+	// Codes of the fixed Huffman table (RFC 1951 3.2.6), bit reversed for BitWriter
+	struct FixedCodes {
+		std::array<uint16_t, 288> litCode{};
+		std::array<uint8_t, 288>  litLength{};
+		std::array<uint8_t, 30>	  distCode{};
+		std::array<uint8_t, 259>  lengthSymbol{}; // Index into kLengthBase by match length
+
+		FixedCodes() {
+			for (uint32_t symbol = 0; symbol < 288; symbol++) {
+				uint32_t code, length;
+				if (symbol < 144) {
+					code = 0x30 + symbol, length = 8;
+				} else if (symbol < 256) {
+					code = 0x190 + symbol - 144, length = 9;
+				} else if (symbol < 280) {
+					code = symbol - 256, length = 7;
+				} else {
+					code = 0xC0 + symbol - 280, length = 8;
+				}
+				litCode[symbol]	  = static_cast<uint16_t>(reverseBits(code, length));
+				litLength[symbol] = static_cast<uint8_t>(length);
+			}
+			for (uint32_t symbol = 0; symbol < 30; symbol++) {
+				distCode[symbol] = static_cast<uint8_t>(reverseBits(symbol, 5));
+			}
+			for (uint32_t symbol = 0; symbol < 29; symbol++) {
+				uint32_t end = symbol + 1 < 29 ? kLengthBase[symbol + 1] : kMaxMatch + 1;
+				for (uint32_t length = kLengthBase[symbol]; length < end; length++) {
+					lengthSymbol[length] = static_cast<uint8_t>(symbol);
+				}
+			}
+		}
+	};
+
+	const FixedCodes& getFixedCodes() {
+		static const FixedCodes codes;
+		return codes;
+	}
+
+	uint32_t getDistSymbol(uint32_t distance) {
+		return static_cast<uint32_t>(std::upper_bound(std::begin(kDistBase), std::end(kDistBase), distance) - std::begin(kDistBase)) - 1;
+	}
+
+	uint32_t hash3(const uint8_t* p) {
+		uint32_t value = static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) | (static_cast<uint32_t>(p[2]) << 16);
+		return (value * 2654435761u) >> (32 - kHashBits);
+	}
+
+	// One fixed Huffman block with hash chain LZ77: no table to build or send, which suits frames
+	// written at interactive rates better than the last percent of ratio
+	void deflate(const uint8_t* data, size_t size, std::vector<uint8_t>& out) {
+		const FixedCodes& codes = getFixedCodes();
+		BitWriter		  writer(out);
+		writer.put(1, 1); // BFINAL
+		writer.put(1, 2); // BTYPE fixed Huffman
+
+		std::vector<int32_t> head(size_t(1) << kHashBits, -1);
+		std::vector<int32_t> prev(kWindowSize, -1);
+
+		auto insert = [&](size_t pos) {
+			uint32_t hash			   = hash3(data + pos);
+			prev[pos & (kWindowSize - 1)] = head[hash];
+			head[hash]				   = static_cast<int32_t>(pos);
+		};
+
+		size_t pos = 0;
+		while (pos < size) {
+			uint32_t bestLength = 0;
+			uint32_t bestDist	= 0;
+
+			if (pos + kMinMatch <= size) {
+				uint32_t maxLength = static_cast<uint32_t>(std::min<size_t>(kMaxMatch, size - pos));
+				int32_t	 candidate = head[hash3(data + pos)];
+				for (uint32_t chain = 0; chain < kMaxChain && candidate >= 0; chain++) {
+					size_t dist = pos - static_cast<size_t>(candidate);
+					if (dist > kWindowSize) break;
+
+					const uint8_t* a	  = data + candidate;
+					const uint8_t* b	  = data + pos;
+					uint32_t	   length = 0;
+					while (length < maxLength && a[length] == b[length]) length++;
+					if (length > bestLength) {
+						bestLength = length;
+						bestDist   = static_cast<uint32_t>(dist);
+						if (length == maxLength) break;
+					}
+					candidate = prev[candidate & (kWindowSize - 1)];
+				}
+				insert(pos);
+			}
+
+			if (bestLength < kMinMatch) {
+				writer.put(codes.litCode[data[pos]], codes.litLength[data[pos]]);
+				pos++;
+				continue;
+			}
+
+			uint32_t lengthSymbol = codes.lengthSymbol[bestLength];
+			writer.put(codes.litCode[257 + lengthSymbol], codes.litLength[257 + lengthSymbol]);
+			writer.put(bestLength - kLengthBase[lengthSymbol], kLengthExtra[lengthSymbol]);
+
+			uint32_t distSymbol = getDistSymbol(bestDist);
+			writer.put(codes.distCode[distSymbol], 5);
+			writer.put(bestDist - kDistBase[distSymbol], kDistExtra[distSymbol]);
+
+			for (size_t end = pos + bestLength, next = pos + 1; next < end; next++) {
+				if (next + kMinMatch <= size) insert(next);
+			}
+			pos += bestLength;
+		}
+
+		writer.put(codes.litCode[256], codes.litLength[256]);
+		writer.flush();
+	}
+
+	uint32_t adler32(const uint8_t* data, size_t size) {
+		uint32_t a = 1, b = 0;
+		while (size > 0) {
+			// Largest run that can't overflow b before the modulo
+			size_t run = std::min<size_t>(size, 5552);
+			for (size_t i = 0; i < run; i++) {
+				a += data[i];
+				b += a;
+			}
+			a %= 65521;
+			b %= 65521;
+			data += run;
+			size -= run;
+		}
+		return (b << 16) | a;
+	}
+
+	uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0) {
+		static const auto table = []() {
+			std::array<uint32_t, 256> values{};
+			for (uint32_t i = 0; i < 256; i++) {
+				uint32_t c = i;
+				for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+				values[i] = c;
+			}
+			return values;
+		}();
+
+		crc = ~crc;
+		for (size_t i = 0; i < size; i++) crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+		return ~crc;
+	}
+
+	void putBE32(std::vector<uint8_t>& out, uint32_t value) {
+		out.push_back(static_cast<uint8_t>(value >> 24));
+		out.push_back(static_cast<uint8_t>(value >> 16));
+		out.push_back(static_cast<uint8_t>(value >> 8));
+		out.push_back(static_cast<uint8_t>(value));
+	}
+
+	void putChunk(std::vector<uint8_t>& out, const char* type, const uint8_t* data, size_t size) {
+		putBE32(out, static_cast<uint32_t>(size));
+		size_t start = out.size();
+		out.insert(out.end(), type, type + 4);
+		if (size > 0) out.insert(out.end(), data, data + size);
+		putBE32(out, crc32(out.data() + start, size + 4));
+	}
+
+	uint8_t paeth(int a, int b, int c) {
+		int p  = a + b - c;
+		int pa = std::abs(p - a);
+		int pb = std::abs(p - b);
+		int pc = std::abs(p - c);
+		if (pa <= pb && pa <= pc) return static_cast<uint8_t>(a);
+		return static_cast<uint8_t>(pb <= pc ? b : c);
+	}
+
+	// Filters every row with whichever of the five PNG filters gives the smallest sum of absolute
+	// values, the heuristic libpng uses
+	void filterRows(const uint8_t* rgb, uint32_t width, uint32_t height, std::vector<uint8_t>& out) {
+		size_t rowSize = static_cast<size_t>(width) * 3;
+		out.resize((rowSize + 1) * height);
+
+		std::array<std::vector<uint8_t>, 5> candidates;
+		for (auto& candidate : candidates) candidate.resize(rowSize);
+		std::vector<uint8_t> zeroRow(rowSize, 0);
+
+		for (uint32_t y = 0; y < height; y++) {
+			const uint8_t* row	 = rgb + y * rowSize;
+			const uint8_t* above = y > 0 ? row - rowSize : zeroRow.data();
+
+			for (size_t x = 0; x < rowSize; x++) {
+				int left	  = x >= 3 ? row[x - 3] : 0;
+				int upperLeft = x >= 3 ? above[x - 3] : 0;
+				candidates[0][x] = row[x];
+				candidates[1][x] = static_cast<uint8_t>(row[x] - left);
+				candidates[2][x] = static_cast<uint8_t>(row[x] - above[x]);
+				candidates[3][x] = static_cast<uint8_t>(row[x] - ((left + above[x]) >> 1));
+				candidates[4][x] = static_cast<uint8_t>(row[x] - paeth(left, above[x], upperLeft));
+			}
+
+			uint32_t bestFilter = 0;
+			uint64_t bestSum	= UINT64_MAX;
+			for (uint32_t filter = 0; filter < 5; filter++) {
+				uint64_t sum = 0;
+				for (uint8_t value : candidates[filter]) sum += static_cast<uint64_t>(std::abs(static_cast<int8_t>(value)));
+				if (sum < bestSum) {
+					bestSum	   = sum;
+					bestFilter = filter;
+				}
+			}
+
+			uint8_t* dst = out.data() + y * (rowSize + 1);
+			dst[0]		 = static_cast<uint8_t>(bestFilter);
+			memcpy(dst + 1, candidates[bestFilter].data(), rowSize);
+		}
+	}
+
+	void encodePNG(const uint8_t* rgb, uint32_t width, uint32_t height, std::vector<uint8_t>& scratch, std::vector<uint8_t>& out) {
+		static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+		out.assign(signature, signature + 8);
+
+		std::vector<uint8_t> header;
+		putBE32(header, width);
+		putBE32(header, height);
+		header.insert(header.end(), {8, 2, 0, 0, 0}); // 8-bit RGB, deflate, adaptive filters, no interlace
+		putChunk(out, "IHDR", header.data(), header.size());
+
+		filterRows(rgb, width, height, scratch);
+
+		std::vector<uint8_t> zlib = {0x78, 0x01};
+		zlib.reserve(scratch.size() / 2);
+		deflate(scratch.data(), scratch.size(), zlib);
+		putBE32(zlib, adler32(scratch.data(), scratch.size()));
+
+		putChunk(out, "IDAT", zlib.data(), zlib.size());
+		putChunk(out, "IEND", nullptr, 0);
+	}
+
+	// ========================================================================
+	// QOI
+	// ========================================================================
+
+	void encodeQOI(const uint8_t* rgb, uint32_t width, uint32_t height, std::vector<uint8_t>& out) {
+		size_t count = static_cast<size_t>(width) * height;
+		out.clear();
+		out.reserve(14 + count * 4 + 8);
+		out.insert(out.end(), {'q', 'o', 'i', 'f'});
+		putBE32(out, width);
+		putBE32(out, height);
+		out.push_back(3); // RGB
+		out.push_back(0); // sRGB with linear alpha
+
+		std::array<uint32_t, 64> index{};
+		uint8_t					 pr = 0, pg = 0, pb = 0;
+		uint32_t				 run = 0;
+
+		for (size_t i = 0; i < count; i++) {
+			uint8_t r = rgb[i * 3], g = rgb[i * 3 + 1], b = rgb[i * 3 + 2];
+			if (r == pr && g == pg && b == pb) {
+				if (++run == 62) {
+					out.push_back(static_cast<uint8_t>(0xC0 | (run - 1)));
+					run = 0;
+				}
+				continue;
+			}
+			if (run > 0) {
+				out.push_back(static_cast<uint8_t>(0xC0 | (run - 1)));
+				run = 0;
+			}
+
+			uint32_t packed = r | (g << 8) | (b << 16) | (0xFFu << 24);
+			uint32_t slot	= (r * 3 + g * 5 + b * 7 + 255 * 11) % 64;
+			if (index[slot] == packed) {
+				out.push_back(static_cast<uint8_t>(slot));
+			} else {
+				index[slot] = packed;
+
+				int dr = static_cast<int8_t>(r - pr);
+				int dg = static_cast<int8_t>(g - pg);
+				int db = static_cast<int8_t>(b - pb);
+				int rg = dr - dg;
+				int bg = db - dg;
+				if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+					out.push_back(static_cast<uint8_t>(0x40 | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2)));
+				} else if (dg >= -32 && dg <= 31 && rg >= -8 && rg <= 7 && bg >= -8 && bg <= 7) {
+					out.push_back(static_cast<uint8_t>(0x80 | (dg + 32)));
+					out.push_back(static_cast<uint8_t>((rg + 8) << 4 | (bg + 8)));
+				} else {
+					out.insert(out.end(), {0xFE, r, g, b});
+				}
+			}
+			pr = r, pg = g, pb = b;
+		}
+		if (run > 0) out.push_back(static_cast<uint8_t>(0xC0 | (run - 1)));
+		out.insert(out.end(), {0, 0, 0, 0, 0, 0, 0, 1});
+	}
+
+	// ========================================================================
+	// Output
+	// ========================================================================
+
+	// Converts pixels in place and writes the file in one go; scratch and encoded are reused
+	bool encodeFrame(const std::string&	   path,
+					 std::vector<uint8_t>& pixels,
+					 uint32_t			   width,
+					 uint32_t			   height,
+					 FrameEncoding		   encoding,
+					 bool				   bgra,
+					 std::vector<uint8_t>& scratch,
+					 std::vector<uint8_t>& encoded) {
+		size_t count = static_cast<size_t>(width) * height;
+		convertToRGB(pixels.data(), pixels.data(), count, bgra);
+
+		const uint8_t* data = pixels.data();
+		size_t		   size = count * 3;
+		std::string	   header;
+		switch (encoding) {
+		case FrameEncoding::PPM:
+			header = "P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+			break;
+		case FrameEncoding::PNG:
+			encodePNG(pixels.data(), width, height, scratch, encoded);
+			data = encoded.data();
+			size = encoded.size();
+			break;
+		case FrameEncoding::QOI:
+			encodeQOI(pixels.data(), width, height, encoded);
+			data = encoded.data();
+			size = encoded.size();
+			break;
+		}
+
+		std::ofstream file(path, std::ios::binary);
+		if (!file.is_open()) {
+			std::cerr << "FrameWriter: Failed to open file " << path << std::endl;
+			return false;
+		}
+		file.write(header.data(), static_cast<std::streamsize>(header.size()));
+		file.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(size));
+		if (!file) {
+			std::cerr << "FrameWriter: Failed to write " << path << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+} // namespace
+
+// ============================================================================
+// Free Functions
+// ============================================================================
+
+FrameEncoding renderApi::getFrameEncoding(const std::string& path) {
+	size_t dot = path.find_last_of('.');
+	if (dot == std::string::npos) return FrameEncoding::PPM;
+
+	std::string extension = path.substr(dot + 1);
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+	if (extension == "png") return FrameEncoding::PNG;
+	if (extension == "qoi") return FrameEncoding::QOI;
+	return FrameEncoding::PPM;
+}
+
+void renderApi::convertToRGB(const uint8_t* src, uint8_t* dst, size_t count, bool bgra) {
+	size_t i = 0;
+#if defined(FRAME_WRITER_SSSE3)
+	if (hasSSSE3()) i = convertToRGBSSSE3(src, dst, count, bgra);
+#elif defined(__ARM_NEON)
+	for (; i + 16 <= count; i += 16) {
+		uint8x16x4_t rgba = vld4q_u8(src + i * 4);
+		uint8x16x3_t rgb;
+		rgb.val[0] = bgra ? rgba.val[2] : rgba.val[0];
+		rgb.val[1] = rgba.val[1];
+		rgb.val[2] = bgra ? rgba.val[0] : rgba.val[2];
+		vst3q_u8(dst + i * 3, rgb);
+	}
+#endif
+
+	uint32_t red  = bgra ? 2 : 0;
+	uint32_t blue = bgra ? 0 : 2;
+	for (; i < count; i++) {
+		uint8_t r	   = src[i * 4 + red];
+		uint8_t g	   = src[i * 4 + 1];
+		uint8_t b	   = src[i * 4 + blue];
+		dst[i * 3]	   = r;
+		dst[i * 3 + 1] = g;
+		dst[i * 3 + 2] = b;
+	}
+}
+
+bool renderApi::writeFrame(const std::string& path,
+						   const void*		  pixels,
+						   uint32_t			  width,
+						   uint32_t			  height,
+						   FrameEncoding	  encoding,
+						   VkFormat			  format,
+						   uint32_t			  rowPitch) {
+	bool bgra;
+	if (!pixels || width == 0 || height == 0 || !isBGRA(format, bgra)) {
+		std::cerr << "FrameWriter: Frames must be non empty R8G8B8A8 or B8G8R8A8 pixels" << std::endl;
+		return false;
+	}
+
+	std::vector<uint8_t> copy, scratch, encoded;
+	copyPixels(pixels, width, height, rowPitch, copy);
+	return encodeFrame(path, copy, width, height, encoding, bgra, scratch, encoded);
+}
+
+// ============================================================================
+// FrameWriter Implementation
+// ============================================================================
+
+FrameWriter::FrameWriter() : queued_(0), active_(0), written_(0), dropped_(0), failed_(0), stopping_(false) {}
+
+FrameWriter::~FrameWriter() { destroy(); }
+
+bool FrameWriter::create(const FrameWriterInfo& info) {
+	destroy();
+
+	if (info.maxQueuedFrames == 0) {
+		std::cerr << "FrameWriter: maxQueuedFrames must be at least 1" << std::endl;
+		return false;
+	}
+	info_	  = info;
+	stopping_ = false;
+	written_  = 0;
+	dropped_  = 0;
+	failed_	  = 0;
+
+	uint32_t threadCount = info.threadCount > 0 ? info.threadCount : std::max(1u, std::thread::hardware_concurrency() / 2);
+	for (uint32_t i = 0; i < threadCount; i++) {
+		workers_.emplace_back(&FrameWriter::workerLoop, this);
+	}
+	return true;
+}
+
+void FrameWriter::destroy() {
+	if (workers_.empty()) return;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stopping_ = true;
+	}
+	jobReady_.notify_all();
+	jobDone_.notify_all();
+	for (auto& worker : workers_) worker.join();
+	workers_.clear();
+	spare_.clear();
+}
+
+bool FrameWriter::reserve(Job& job) {
+	std::unique_lock<std::mutex> lock(mutex_);
+	if (stopping_) return false;
+
+	if (queued_ >= info_.maxQueuedFrames) {
+		if (!info_.blockWhenFull) {
+			dropped_++;
+			return false;
+		}
+		jobDone_.wait(lock, [&]() { return stopping_ || queued_ < info_.maxQueuedFrames; });
+		if (stopping_) return false;
+	}
+
+	queued_++;
+	if (!spare_.empty()) {
+		job.pixels = std::move(spare_.back());
+		spare_.pop_back();
+	}
+	return true;
+}
+
+void FrameWriter::enqueue(Job&& job) {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		jobs_.push_back(std::move(job));
+	}
+	jobReady_.notify_one();
+}
+
+bool FrameWriter::submit(const std::string& path,
+						 const void*		pixels,
+						 uint32_t			width,
+						 uint32_t			height,
+						 FrameEncoding		encoding,
+						 VkFormat			format,
+						 uint32_t			rowPitch) {
+	if (!isValid()) {
+		std::cerr << "FrameWriter: Not created" << std::endl;
+		return false;
+	}
+
+	Job job;
+	if (!pixels || width == 0 || height == 0 || !isBGRA(format, job.bgra)) {
+		std::cerr << "FrameWriter: Frames must be non empty R8G8B8A8 or B8G8R8A8 pixels" << std::endl;
+		return false;
+	}
+	if (!reserve(job)) return false;
+
+	// The only work done on the calling thread
+	copyPixels(pixels, width, height, rowPitch, job.pixels);
+	job.path	 = path;
+	job.width	 = width;
+	job.height	 = height;
+	job.encoding = encoding;
+	enqueue(std::move(job));
+	return true;
+}
+
+bool FrameWriter::submit(const std::string& path, Buffer& buffer, uint32_t width, uint32_t height, FrameEncoding encoding, VkFormat format) {
+	size_t expectedSize = static_cast<size_t>(width) * height * kBytesPerPixel;
+	if (!buffer.isValid() || buffer.getSize() < expectedSize) {
+		std::cerr << "FrameWriter: Buffer is invalid or smaller than the frame" << std::endl;
+		return false;
+	}
+
+	bool  wasMapped = buffer.isMapped();
+	void* data		= buffer.map();
+	if (!data) return false;
+	buffer.invalidate(0, expectedSize);
+
+	bool submitted = submit(path, data, width, height, encoding, format);
+	if (!wasMapped) buffer.unmap();
+	return submitted;
+}
+
+bool FrameWriter::submit(const std::string& path, const gpuTask::ReadbackFrame& frame, FrameEncoding encoding) {
+	if (frame.size < static_cast<VkDeviceSize>(frame.width) * frame.height * kBytesPerPixel) {
+		std::cerr << "FrameWriter: Readback frame is smaller than its extent" << std::endl;
+		return false;
+	}
+	return submit(path, frame.data, frame.width, frame.height, encoding, frame.format);
+}
+
+void FrameWriter::wait() {
+	std::unique_lock<std::mutex> lock(mutex_);
+	jobDone_.wait(lock, [&]() { return queued_ == 0 && active_ == 0; });
+}
+
+uint64_t FrameWriter::getWrittenFrames() const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return written_;
+}
+
+uint64_t FrameWriter::getDroppedFrames() const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return dropped_;
+}
+
+uint64_t FrameWriter::getFailedFrames() const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return failed_;
+}
+
+void FrameWriter::workerLoop() {
+	std::vector<uint8_t> scratch, encoded;
+
+	for (;;) {
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			// Frames still being copied are enqueued before stopping lets the worker go
+			jobReady_.wait(lock, [&]() { return !jobs_.empty() || (stopping_ && queued_ == 0); });
+			if (jobs_.empty()) return;
+
+			job = std::move(jobs_.front());
+			jobs_.pop_front();
+			queued_--;
+			active_++;
+			// The other workers only wait for this when stopping
+			if (stopping_ && queued_ == 0) jobReady_.notify_all();
+		}
+		jobDone_.notify_all();
+
+		bool success = encodeFrame(job.path, job.pixels, job.width, job.height, job.encoding, job.bgra, scratch, encoded);
+
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			active_--;
+			if (success) {
+				written_++;
+			} else {
+				failed_++;
+			}
+			if (spare_.size() < info_.maxQueuedFrames) spare_.push_back(std::move(job.pixels));
+		}
+		jobDone_.notify_all();
+	}
+}
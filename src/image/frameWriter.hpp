@@ -0,0 +1,122 @@
+#ifndef FRAME_WRITER_HPP
+#define FRAME_WRITER_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+namespace renderApi {
+
+	class Buffer;
+
+	namespace gpuTask {
+		struct ReadbackFrame;
+	}
+
+	enum class FrameEncoding {
+		PPM, // Raw binary RGB, fastest to write
+		PNG, // Deflate with fixed Huffman codes, a fraction of the PPM size
+		QOI	 // Run/delta encoded, nearly as fast as PPM and often as small as PNG
+	};
+
+	// From the extension of path (.ppm, .png, .qoi); PPM when it is none of them
+	FrameEncoding getFrameEncoding(const std::string& path);
+
+	// Drops the alpha byte of count pixels, swapping red and blue when bgra is set. Runs 16 pixels
+	// at a time with SSSE3 or NEON when the CPU has them. dst may be src: the conversion works in place.
+	void convertToRGB(const uint8_t* src, uint8_t* dst, size_t count, bool bgra = false);
+
+	// Encodes and writes a frame on the calling thread. Pixels are R8G8B8A8 or B8G8R8A8 (format),
+	// rowPitch bytes apart (0: tightly packed); alpha is dropped.
+	bool writeFrame(const std::string& path,
+					const void*		   pixels,
+					uint32_t		   width,
+					uint32_t		   height,
+					FrameEncoding	   encoding,
+					VkFormat		   format	= VK_FORMAT_R8G8B8A8_UNORM,
+					uint32_t		   rowPitch = 0);
+
+	struct FrameWriterInfo {
+		uint32_t threadCount	 = 0;	  // 0: half the cores, at least one
+		uint32_t maxQueuedFrames = 8;	  // Frames copied and waiting for a worker
+		bool	 blockWhenFull	 = false; // Wait for room instead of dropping the frame
+	};
+
+	// Writes frames to disk on worker threads so that the render loop only pays for one copy of the
+	// pixels. Submitted frames are converted, encoded and written in one bulk write each; frames may
+	// finish out of order when there are several threads. Pixel storage is recycled between frames.
+	//
+	// When maxQueuedFrames are waiting, submit() drops the frame and returns false, unless
+	// blockWhenFull is set. submit() and wait() may be called from any thread.
+	class FrameWriter {
+	  public:
+		FrameWriter();
+		~FrameWriter();
+
+		FrameWriter(const FrameWriter&)			   = delete;
+		FrameWriter& operator=(const FrameWriter&) = delete;
+
+		bool create(const FrameWriterInfo& info = {});
+		// Writes every queued frame first
+		void destroy();
+
+		// Copies the pixels, R8G8B8A8 or B8G8R8A8 rowPitch bytes apart (0: tightly packed)
+		bool submit(const std::string& path,
+					const void*		   pixels,
+					uint32_t		   width,
+					uint32_t		   height,
+					FrameEncoding	   encoding,
+					VkFormat		   format	= VK_FORMAT_R8G8B8A8_UNORM,
+					uint32_t		   rowPitch = 0);
+		// Maps the host visible buffer for the time of the copy
+		bool submit(const std::string& path, Buffer& buffer, uint32_t width, uint32_t height, FrameEncoding encoding,
+					VkFormat format = VK_FORMAT_R8G8B8A8_UNORM);
+		// From a ReadbackRing callback or poll(): the copy is made before returning
+		bool submit(const std::string& path, const gpuTask::ReadbackFrame& frame, FrameEncoding encoding);
+
+		// Blocks until every submitted frame is written
+		void wait();
+
+		uint64_t getWrittenFrames() const;
+		uint64_t getDroppedFrames() const;
+		uint64_t getFailedFrames() const;
+		bool	 isValid() const { return !workers_.empty(); }
+
+	  private:
+		struct Job {
+			std::string			 path;
+			std::vector<uint8_t> pixels;
+			uint32_t			 width	  = 0;
+			uint32_t			 height	  = 0;
+			FrameEncoding		 encoding = FrameEncoding::PPM;
+			bool				 bgra	  = false;
+		};
+
+		FrameWriterInfo					  info_;
+		std::vector<std::thread>		  workers_;
+		mutable std::mutex				  mutex_;
+		std::condition_variable			  jobReady_;
+		std::condition_variable			  jobDone_;
+		std::deque<Job>					  jobs_;
+		std::vector<std::vector<uint8_t>> spare_;  // Pixel storage of written frames
+		uint32_t						  queued_;	// Frames being copied or waiting for a worker
+		uint32_t						  active_;	// Frames being encoded
+		uint64_t						  written_;
+		uint64_t						  dropped_;
+		uint64_t						  failed_;
+		bool							  stopping_;
+
+		bool reserve(Job& job);
+		void enqueue(Job&& job);
+		void workerLoop();
+	};
+
+} // namespace renderApi
+
+#endif
@@ -1,34 +1,297 @@
 #include "image.hpp"
 
 #include "buffer/buffer.hpp"
+#include "textureLoader.hpp"
 #include "renderDevice.hpp"
 
 #include <algorithm>
 #include <cmath>
 #include <cstring>
 #include <iostream>
+#include <utility>
+#include <vector>
 #include <vulkan/vulkan_core.h>
 
 using namespace renderApi;
 
+// ============================================================================
+// Format Helpers
+// ============================================================================
+
+FormatBlock renderApi::getFormatBlock(VkFormat format) {
+	// One entry per compatibility class of the specification. Depth and stencil formats give the
+	// size a buffer copy of their depth aspect uses, except for S8 which only has stencil. D16_S8
+	// and D32_S8 copy each aspect with a different size and are not listed, nor are ETC2, EAC and
+	// ASTC, which the device features checked by findSupportedFormat() don't cover.
+	switch (format) {
+	// 8 bit
+	case VK_FORMAT_R4G4_UNORM_PACK8:
+	case VK_FORMAT_R8_UNORM:
+	case VK_FORMAT_R8_SNORM:
+	case VK_FORMAT_R8_USCALED:
+	case VK_FORMAT_R8_SSCALED:
+	case VK_FORMAT_R8_UINT:
+	case VK_FORMAT_R8_SINT:
+	case VK_FORMAT_R8_SRGB:
+	case VK_FORMAT_S8_UINT:
+		return {1, 1, 1};
+	// 16 bit
+	case VK_FORMAT_R4G4B4A4_UNORM_PACK16:
+	case VK_FORMAT_B4G4R4A4_UNORM_PACK16:
+	case VK_FORMAT_R5G6B5_UNORM_PACK16:
+	case VK_FORMAT_B5G6R5_UNORM_PACK16:
+	case VK_FORMAT_R5G5B5A1_UNORM_PACK16:
+	case VK_FORMAT_B5G5R5A1_UNORM_PACK16:
+	case VK_FORMAT_A1R5G5B5_UNORM_PACK16:
+	case VK_FORMAT_R8G8_UNORM:
+	case VK_FORMAT_R8G8_SNORM:
+	case VK_FORMAT_R8G8_USCALED:
+	case VK_FORMAT_R8G8_SSCALED:
+	case VK_FORMAT_R8G8_UINT:
+	case VK_FORMAT_R8G8_SINT:
+	case VK_FORMAT_R8G8_SRGB:
+	case VK_FORMAT_R16_UNORM:
+	case VK_FORMAT_R16_SNORM:
+	case VK_FORMAT_R16_USCALED:
+	case VK_FORMAT_R16_SSCALED:
+	case VK_FORMAT_R16_UINT:
+	case VK_FORMAT_R16_SINT:
+	case VK_FORMAT_R16_SFLOAT:
+	case VK_FORMAT_D16_UNORM:
+		return {1, 1, 2};
+	// 24 bit
+	case VK_FORMAT_R8G8B8_UNORM:
+	case VK_FORMAT_R8G8B8_SNORM:
+	case VK_FORMAT_R8G8B8_USCALED:
+	case VK_FORMAT_R8G8B8_SSCALED:
+	case VK_FORMAT_R8G8B8_UINT:
+	case VK_FORMAT_R8G8B8_SINT:
+	case VK_FORMAT_R8G8B8_SRGB:
+	case VK_FORMAT_B8G8R8_UNORM:
+	case VK_FORMAT_B8G8R8_SNORM:
+	case VK_FORMAT_B8G8R8_USCALED:
+	case VK_FORMAT_B8G8R8_SSCALED:
+	case VK_FORMAT_B8G8R8_UINT:
+	case VK_FORMAT_B8G8R8_SINT:
+	case VK_FORMAT_B8G8R8_SRGB:
+		return {1, 1, 3};
+	// 32 bit
+	case VK_FORMAT_R8G8B8A8_UNORM:
+	case VK_FORMAT_R8G8B8A8_SNORM:
+	case VK_FORMAT_R8G8B8A8_USCALED:
+	case VK_FORMAT_R8G8B8A8_SSCALED:
+	case VK_FORMAT_R8G8B8A8_UINT:
+	case VK_FORMAT_R8G8B8A8_SINT:
+	case VK_FORMAT_R8G8B8A8_SRGB:
+	case VK_FORMAT_B8G8R8A8_UNORM:
+	case VK_FORMAT_B8G8R8A8_SNORM:
+	case VK_FORMAT_B8G8R8A8_USCALED:
+	case VK_FORMAT_B8G8R8A8_SSCALED:
+	case VK_FORMAT_B8G8R8A8_UINT:
+	case VK_FORMAT_B8G8R8A8_SINT:
+	case VK_FORMAT_B8G8R8A8_SRGB:
+	case VK_FORMAT_A8B8G8R8_UNORM_PACK32:
+	case VK_FORMAT_A8B8G8R8_SNORM_PACK32:
+	case VK_FORMAT_A8B8G8R8_USCALED_PACK32:
+	case VK_FORMAT_A8B8G8R8_SSCALED_PACK32:
+	case VK_FORMAT_A8B8G8R8_UINT_PACK32:
+	case VK_FORMAT_A8B8G8R8_SINT_PACK32:
+	case VK_FORMAT_A8B8G8R8_SRGB_PACK32:
+	case VK_FORMAT_A2R10G10B10_UNORM_PACK32:
+	case VK_FORMAT_A2R10G10B10_SNORM_PACK32:
+	case VK_FORMAT_A2R10G10B10_USCALED_PACK32:
+	case VK_FORMAT_A2R10G10B10_SSCALED_PACK32:
+	case VK_FORMAT_A2R10G10B10_UINT_PACK32:
+	case VK_FORMAT_A2R10G10B10_SINT_PACK32:
+	case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+	case VK_FORMAT_A2B10G10R10_SNORM_PACK32:
+	case VK_FORMAT_A2B10G10R10_USCALED_PACK32:
+	case VK_FORMAT_A2B10G10R10_SSCALED_PACK32:
+	case VK_FORMAT_A2B10G10R10_UINT_PACK32:
+	case VK_FORMAT_A2B10G10R10_SINT_PACK32:
+	case VK_FORMAT_R16G16_UNORM:
+	case VK_FORMAT_R16G16_SNORM:
+	case VK_FORMAT_R16G16_USCALED:
+	case VK_FORMAT_R16G16_SSCALED:
+	case VK_FORMAT_R16G16_UINT:
+	case VK_FORMAT_R16G16_SINT:
+	case VK_FORMAT_R16G16_SFLOAT:
+	case VK_FORMAT_R32_UINT:
+	case VK_FORMAT_R32_SINT:
+	case VK_FORMAT_R32_SFLOAT:
+	case VK_FORMAT_B10G11R11_UFLOAT_PACK32:
+	case VK_FORMAT_E5B9G9R9_UFLOAT_PACK32:
+	case VK_FORMAT_X8_D24_UNORM_PACK32:
+	case VK_FORMAT_D32_SFLOAT:
+	case VK_FORMAT_D24_UNORM_S8_UINT:
+		return {1, 1, 4};
+	// 48 bit
+	case VK_FORMAT_R16G16B16_UNORM:
+	case VK_FORMAT_R16G16B16_SNORM:
+	case VK_FORMAT_R16G16B16_USCALED:
+	case VK_FORMAT_R16G16B16_SSCALED:
+	case VK_FORMAT_R16G16B16_UINT:
+	case VK_FORMAT_R16G16B16_SINT:
+	case VK_FORMAT_R16G16B16_SFLOAT:
+		return {1, 1, 6};
+	// 64 bit
+	case VK_FORMAT_R16G16B16A16_UNORM:
+	case VK_FORMAT_R16G16B16A16_SNORM:
+	case VK_FORMAT_R16G16B16A16_USCALED:
+	case VK_FORMAT_R16G16B16A16_SSCALED:
+	case VK_FORMAT_R16G16B16A16_UINT:
+	case VK_FORMAT_R16G16B16A16_SINT:
+	case VK_FORMAT_R16G16B16A16_SFLOAT:
+	case VK_FORMAT_R32G32_UINT:
+	case VK_FORMAT_R32G32_SINT:
+	case VK_FORMAT_R32G32_SFLOAT:
+	case VK_FORMAT_R64_UINT:
+	case VK_FORMAT_R64_SINT:
+	case VK_FORMAT_R64_SFLOAT:
+		return {1, 1, 8};
+	// 96 bit
+	case VK_FORMAT_R32G32B32_UINT:
+	case VK_FORMAT_R32G32B32_SINT:
+	case VK_FORMAT_R32G32B32_SFLOAT:
+		return {1, 1, 12};
+	// 128 bit
+	case VK_FORMAT_R32G32B32A32_UINT:
+	case VK_FORMAT_R32G32B32A32_SINT:
+	case VK_FORMAT_R32G32B32A32_SFLOAT:
+	case VK_FORMAT_R64G64_UINT:
+	case VK_FORMAT_R64G64_SINT:
+	case VK_FORMAT_R64G64_SFLOAT:
+		return {1, 1, 16};
+	// 192 bit
+	case VK_FORMAT_R64G64B64_UINT:
+	case VK_FORMAT_R64G64B64_SINT:
+	case VK_FORMAT_R64G64B64_SFLOAT:
+		return {1, 1, 24};
+	// 256 bit
+	case VK_FORMAT_R64G64B64A64_UINT:
+	case VK_FORMAT_R64G64B64A64_SINT:
+	case VK_FORMAT_R64G64B64A64_SFLOAT:
+		return {1, 1, 32};
+	// BC1, BC4
+	case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+	case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+	case VK_FORMAT_BC4_UNORM_BLOCK:
+	case VK_FORMAT_BC4_SNORM_BLOCK:
+		return {4, 4, 8};
+	// BC2, BC3, BC5, BC6H, BC7
+	case VK_FORMAT_BC2_UNORM_BLOCK:
+	case VK_FORMAT_BC2_SRGB_BLOCK:
+	case VK_FORMAT_BC3_UNORM_BLOCK:
+	case VK_FORMAT_BC3_SRGB_BLOCK:
+	case VK_FORMAT_BC5_UNORM_BLOCK:
+	case VK_FORMAT_BC5_SNORM_BLOCK:
+	case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+	case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+	case VK_FORMAT_BC7_UNORM_BLOCK:
+	case VK_FORMAT_BC7_SRGB_BLOCK:
+		return {4, 4, 16};
+	default:
+		return {1, 1, 0};
+	}
+}
+
+VkFormat renderApi::getLinearFormat(VkFormat format) {
+	switch (format) {
+	case VK_FORMAT_R8_SRGB:
+		return VK_FORMAT_R8_UNORM;
+	case VK_FORMAT_R8G8B8A8_SRGB:
+		return VK_FORMAT_R8G8B8A8_UNORM;
+	case VK_FORMAT_B8G8R8A8_SRGB:
+		return VK_FORMAT_B8G8R8A8_UNORM;
+	default:
+		return format;
+	}
+}
+
+bool renderApi::isCompressedFormat(VkFormat format) {
+	FormatBlock block = getFormatBlock(format);
+	return block.width > 1 || block.height > 1;
+}
+
+VkDeviceSize renderApi::getMipLevelSize(VkFormat format, uint32_t width, uint32_t height, uint32_t depth, uint32_t mipLevel) {
+	FormatBlock block	= getFormatBlock(format);
+	uint32_t	levelW	= std::max(1u, width >> mipLevel);
+	uint32_t	levelH	= std::max(1u, height >> mipLevel);
+	uint32_t	levelD	= std::max(1u, depth >> mipLevel);
+	VkDeviceSize blocksX = (levelW + block.width - 1) / block.width;
+	VkDeviceSize blocksY = (levelH + block.height - 1) / block.height;
+	return blocksX * blocksY * levelD * block.size;
+}
+
+bool renderApi::isCopyInBounds(const VkBufferImageCopy& copy, const FormatBlock& block, VkDeviceSize size) {
+	if (block.size == 0 || copy.bufferOffset >= size) return false;
+
+	uint32_t rowTexels	 = copy.bufferRowLength != 0 ? copy.bufferRowLength : copy.imageExtent.width;
+	uint32_t sliceTexels = copy.bufferImageHeight != 0 ? copy.bufferImageHeight : copy.imageExtent.height;
+	if (rowTexels < copy.imageExtent.width || sliceTexels < copy.imageExtent.height) return false;
+
+	VkDeviceSize rowPitch	  = (static_cast<VkDeviceSize>(rowTexels) + block.width - 1) / block.width * block.size;
+	VkDeviceSize sliceRows	  = (static_cast<VkDeviceSize>(sliceTexels) + block.height - 1) / block.height;
+	VkDeviceSize lastRowBytes = (static_cast<VkDeviceSize>(copy.imageExtent.width) + block.width - 1) / block.width * block.size;
+	VkDeviceSize rows		  = (static_cast<VkDeviceSize>(copy.imageExtent.height) + block.height - 1) / block.height;
+	VkDeviceSize slices		  = static_cast<VkDeviceSize>(copy.imageExtent.depth) * copy.imageSubresource.layerCount;
+
+	// Subtracts each part from what is left instead of adding them up, which could overflow
+	VkDeviceSize available = size - copy.bufferOffset;
+	if (lastRowBytes > available) return false;
+	available -= lastRowBytes;
+
+	if (rows > 1) {
+		if (rows - 1 > available / rowPitch) return false;
+		available -= (rows - 1) * rowPitch;
+	}
+	if (slices > 1) {
+		if (sliceRows > available / rowPitch) return false;
+		VkDeviceSize slicePitch = sliceRows * rowPitch;
+		if (slices - 1 > available / slicePitch) return false;
+	}
+	return true;
+}
+
+VkFormat renderApi::findSupportedFormat(device::GPU* gpu, const std::vector<VkFormat>& candidates, VkFormatFeatureFlags features) {
+	if (!gpu || !gpu->physicalDevice) return VK_FORMAT_UNDEFINED;
+
+	for (VkFormat format : candidates) {
+		// Without the feature the device reports no support for BC formats anyway, but be explicit
+		if (isCompressedFormat(format) && !gpu->textureCompressionBCSupported) continue;
+
+		VkFormatProperties properties;
+		vkGetPhysicalDeviceFormatProperties(gpu->physicalDevice, format, &properties);
+		if ((properties.optimalTilingFeatures & features) == features) {
+			return format;
+		}
+	}
+	return VK_FORMAT_UNDEFINED;
+}
+
 // ============================================================================
 // Image Implementation
 // ============================================================================
 
 Image::Image()
-	: gpu_(nullptr), image_(VK_NULL_HANDLE), imageView_(VK_NULL_HANDLE), memory_(VK_NULL_HANDLE), format_(VK_FORMAT_UNDEFINED), width_(0),
+	: gpu_(nullptr), image_(VK_NULL_HANDLE), imageView_(VK_NULL_HANDLE), allocation_(), format_(VK_FORMAT_UNDEFINED), width_(0),
 	  height_(0), depth_(0), mipLevels_(1), arrayLayers_(1), type_(ImageType::IMAGE_2D), usage_(ImageUsage::TEXTURE),
-	  currentLayout_(ImageLayout::UNDEFINED), aspectMask_(VK_IMAGE_ASPECT_COLOR_BIT) {}
+	  currentLayout_(ImageLayout::UNDEFINED), aspectMask_(VK_IMAGE_ASPECT_COLOR_BIT), samples_(VK_SAMPLE_COUNT_1_BIT), computeMipmaps_(false),
+	  generation_(0) {}
 
 Image::~Image() { destroy(); }
 
 Image::Image(Image&& other) noexcept
-	: gpu_(other.gpu_), image_(other.image_), imageView_(other.imageView_), memory_(other.memory_), format_(other.format_), width_(other.width_),
+	: gpu_(other.gpu_), image_(other.image_), imageView_(other.imageView_), allocation_(other.allocation_), format_(other.format_), width_(other.width_),
 	  height_(other.height_), depth_(other.depth_), mipLevels_(other.mipLevels_), arrayLayers_(other.arrayLayers_), type_(other.type_),
-	  usage_(other.usage_), currentLayout_(other.currentLayout_), aspectMask_(other.aspectMask_) {
+	  usage_(other.usage_), currentLayout_(other.currentLayout_), aspectMask_(other.aspectMask_), samples_(other.samples_), computeMipmaps_(other.computeMipmaps_),
+	  generation_(other.generation_) {
+	if (gpu_ && isRelocatable()) gpu_->allocator.setOwner(allocation_, this, memory::AllocationOwner::IMAGE);
 	other.image_	 = VK_NULL_HANDLE;
 	other.imageView_ = VK_NULL_HANDLE;
-	other.memory_	 = VK_NULL_HANDLE;
+	other.allocation_ = memory::AllocationInfo{};
 }
 
 Image& Image::operator=(Image&& other) noexcept {
@@ -37,7 +300,7 @@ Image& Image::operator=(Image&& other) noexcept {
 		gpu_		   = other.gpu_;
 		image_		   = other.image_;
 		imageView_	   = other.imageView_;
-		memory_		   = other.memory_;
+		allocation_	   = other.allocation_;
 		format_		   = other.format_;
 		width_		   = other.width_;
 		height_		   = other.height_;
@@ -48,10 +311,14 @@ Image& Image::operator=(Image&& other) noexcept {
 		usage_		   = other.usage_;
 		currentLayout_ = other.currentLayout_;
 		aspectMask_	   = other.aspectMask_;
+		samples_	   = other.samples_;
+		computeMipmaps_ = other.computeMipmaps_;
+		generation_	   = other.generation_;
+		if (gpu_ && isRelocatable()) gpu_->allocator.setOwner(allocation_, this, memory::AllocationOwner::IMAGE);
 
 		other.image_	 = VK_NULL_HANDLE;
 		other.imageView_ = VK_NULL_HANDLE;
-		other.memory_	 = VK_NULL_HANDLE;
+		other.allocation_ = memory::AllocationInfo{};
 	}
 	return *this;
 }
@@ -61,7 +328,7 @@ VkImageUsageFlags Image::getVkUsageFlags() const {
 
 	switch (usage_) {
 	case ImageUsage::TEXTURE:
-		flags = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		flags = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
 		break;
 	case ImageUsage::RENDER_TARGET:
 		flags = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
@@ -84,6 +351,9 @@ VkImageUsageFlags Image::getVkUsageFlags() const {
 		break;
 	}
 
+	// Storage writes of the levels by MipGenerator
+	if (computeMipmaps_) flags |= VK_IMAGE_USAGE_STORAGE_BIT;
+
 	return flags;
 }
 
@@ -129,6 +399,8 @@ bool Image::create(device::GPU* gpu, const ImageCreateInfo& info) {
 	arrayLayers_ = info.arrayLayers;
 	type_		 = info.type;
 	usage_		 = info.usage;
+	samples_	 = info.samples;
+	computeMipmaps_ = info.computeMipmaps;
 	aspectMask_	 = getAspectMask();
 
 	if (!gpu_ || !gpu_->device) {
@@ -136,6 +408,77 @@ bool Image::create(device::GPU* gpu, const ImageCreateInfo& info) {
 		return false;
 	}
 
+	// Sizes often come from files; out of range ones are undefined behavior in vkCreateImage
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(gpu_->physicalDevice, &properties);
+	uint32_t maxDimension = type_ == ImageType::IMAGE_1D   ? properties.limits.maxImageDimension1D
+						  : type_ == ImageType::IMAGE_3D ? properties.limits.maxImageDimension3D
+						  : type_ == ImageType::CUBE	   ? properties.limits.maxImageDimensionCube
+														   : properties.limits.maxImageDimension2D;
+	uint32_t maxLevels	  = 1;
+	for (uint32_t largest = std::max({width_, height_, depth_}); largest > 1; largest >>= 1) {
+		maxLevels++;
+	}
+	if (width_ == 0 || height_ == 0 || depth_ == 0 || std::max({width_, height_, depth_}) > maxDimension || mipLevels_ == 0 ||
+		mipLevels_ > maxLevels || arrayLayers_ == 0 || arrayLayers_ > properties.limits.maxImageArrayLayers) {
+		std::cerr << "Image: " << width_ << "x" << height_ << "x" << depth_ << " with " << mipLevels_ << " mips and " << arrayLayers_
+				  << " layers exceeds the device limits" << std::endl;
+		return false;
+	}
+
+	if (!createHandle(image_)) {
+		std::cerr << "Failed to create image" << std::endl;
+		return false;
+	}
+
+	VkMemoryRequirements memRequirements;
+	vkGetImageMemoryRequirements(gpu_->device, image_, &memRequirements);
+
+	memory::MemoryCategory category = memory::MemoryCategory::IMAGE;
+	if (usage_ == ImageUsage::RENDER_TARGET || usage_ == ImageUsage::DEPTH_STENCIL) {
+		category = memory::MemoryCategory::RENDER_TARGET;
+	}
+	if (!gpu_->allocator.allocate(memRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, memory::ResourceKind::OPTIMAL, allocation_, category)) {
+		std::cerr << "Failed to allocate image memory" << std::endl;
+		vkDestroyImage(gpu_->device, image_, nullptr);
+		image_ = VK_NULL_HANDLE;
+		return false;
+	}
+
+	vkBindImageMemory(gpu_->device, image_, allocation_.memory, allocation_.offset);
+
+	if (!createView(image_, imageView_)) {
+		std::cerr << "Failed to create image view" << std::endl;
+		destroy();
+		return false;
+	}
+
+	if (isRelocatable()) {
+		gpu_->allocator.setOwner(allocation_, this, memory::AllocationOwner::IMAGE);
+	}
+	generation_++;
+
+	currentLayout_ = ImageLayout::UNDEFINED;
+
+	if (info.generateMipmaps && mipLevels_ > 1) {
+		if (isCompressedFormat(format_)) {
+			std::cerr << "Image: Compressed formats can't generate mipmaps, upload every level instead" << std::endl;
+		}
+		transitionLayout(ImageLayout::TRANSFER_DST);
+	}
+
+	return true;
+}
+
+VkDeviceSize Image::getDataSize() const {
+	VkDeviceSize size = 0;
+	for (uint32_t level = 0; level < mipLevels_; level++) {
+		size += getMipLevelSize(format_, width_, height_, depth_, level) * arrayLayers_;
+	}
+	return size;
+}
+
+bool Image::createHandle(VkImage& outImage) const {
 	VkImageType imageType = VK_IMAGE_TYPE_2D;
 	switch (type_) {
 	case ImageType::IMAGE_1D:
@@ -163,32 +506,22 @@ bool Image::create(device::GPU* gpu, const ImageCreateInfo& info) {
 	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 	imageInfo.usage		   = getVkUsageFlags();
 	imageInfo.sharingMode   = VK_SHARING_MODE_EXCLUSIVE;
-	imageInfo.samples	   = info.samples;
+	imageInfo.samples	   = samples_;
 	imageInfo.flags		   = (type_ == ImageType::CUBE) ? VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT : 0;
 
-	if (vkCreateImage(gpu_->device, &imageInfo, nullptr, &image_) != VK_SUCCESS) {
-		std::cerr << "Failed to create image" << std::endl;
-		return false;
+	// sRGB formats can't be storage images: the levels are written through a UNORM view
+	if (computeMipmaps_ && getLinearFormat(format_) != format_) {
+		imageInfo.flags |= VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT | VK_IMAGE_CREATE_EXTENDED_USAGE_BIT;
 	}
 
-	VkMemoryRequirements memRequirements;
-	vkGetImageMemoryRequirements(gpu_->device, image_, &memRequirements);
-
-	VkMemoryAllocateInfo allocInfo{};
-	allocInfo.sType			 = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memRequirements.size;
-	allocInfo.memoryTypeIndex =
-			device::findMemoryType(gpu_->physicalDevice, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-	if (vkAllocateMemory(gpu_->device, &allocInfo, nullptr, &memory_) != VK_SUCCESS) {
-		std::cerr << "Failed to allocate image memory" << std::endl;
-		vkDestroyImage(gpu_->device, image_, nullptr);
-		image_ = VK_NULL_HANDLE;
+	if (vkCreateImage(gpu_->device, &imageInfo, nullptr, &outImage) != VK_SUCCESS) {
+		outImage = VK_NULL_HANDLE;
 		return false;
 	}
+	return true;
+}
 
-	vkBindImageMemory(gpu_->device, image_, memory_, 0);
-
+bool Image::createView(VkImage image, VkImageView& outView) const {
 	VkImageViewType viewType = VK_IMAGE_VIEW_TYPE_2D;
 	switch (type_) {
 	case ImageType::IMAGE_1D:
@@ -207,7 +540,7 @@ bool Image::create(device::GPU* gpu, const ImageCreateInfo& info) {
 
 	VkImageViewCreateInfo viewInfo{};
 	viewInfo.sType							= VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-	viewInfo.image							= image_;
+	viewInfo.image							= image;
 	viewInfo.viewType						= viewType;
 	viewInfo.format							= format_;
 	viewInfo.subresourceRange.aspectMask	= aspectMask_;
@@ -216,21 +549,124 @@ bool Image::create(device::GPU* gpu, const ImageCreateInfo& info) {
 	viewInfo.subresourceRange.baseArrayLayer = 0;
 	viewInfo.subresourceRange.layerCount	= arrayLayers_;
 
-	if (vkCreateImageView(gpu_->device, &viewInfo, nullptr, &imageView_) != VK_SUCCESS) {
-		std::cerr << "Failed to create image view" << std::endl;
-		destroy();
+	if (vkCreateImageView(gpu_->device, &viewInfo, nullptr, &outView) != VK_SUCCESS) {
+		outView = VK_NULL_HANDLE;
 		return false;
 	}
+	return true;
+}
 
-	currentLayout_ = ImageLayout::UNDEFINED;
+bool Image::isRelocatable() const {
+	VkImageUsageFlags required = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	return (getVkUsageFlags() & required) == required;
+}
 
-	if (info.generateMipmaps && mipLevels_ > 1) {
-		transitionLayout(ImageLayout::TRANSFER_DST);
+bool Image::relocate(VkCommandBuffer cmd, VkImage& outNewImage, VkImageView& outNewView, memory::AllocationInfo& outNewAllocation) {
+	if (!isValid() || !isRelocatable()) return false;
+
+	VkImage newImage;
+	if (!createHandle(newImage)) return false;
+
+	VkMemoryRequirements memRequirements;
+	vkGetImageMemoryRequirements(gpu_->device, newImage, &memRequirements);
+
+	memory::AllocationInfo newAllocation;
+	if (!gpu_->allocator.allocateMove(memRequirements, allocation_, newAllocation)) {
+		vkDestroyImage(gpu_->device, newImage, nullptr);
+		return false;
+	}
+	vkBindImageMemory(gpu_->device, newImage, newAllocation.memory, newAllocation.offset);
+
+	VkImageView newView;
+	if (!createView(newImage, newView)) {
+		vkDestroyImage(gpu_->device, newImage, nullptr);
+		gpu_->allocator.free(newAllocation);
+		return false;
+	}
+
+	// An image that was never written has no contents to carry over
+	if (currentLayout_ != ImageLayout::UNDEFINED) {
+		VkImageMemoryBarrier barriers[2]{};
+		for (auto& barrier : barriers) {
+			barrier.sType							= VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			barrier.srcQueueFamilyIndex				= VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex				= VK_QUEUE_FAMILY_IGNORED;
+			barrier.subresourceRange.aspectMask		= aspectMask_;
+			barrier.subresourceRange.baseMipLevel	= 0;
+			barrier.subresourceRange.levelCount		= mipLevels_;
+			barrier.subresourceRange.baseArrayLayer = 0;
+			barrier.subresourceRange.layerCount		= arrayLayers_;
+		}
+		barriers[0].image		  = image_;
+		barriers[0].oldLayout	  = convertLayout(currentLayout_);
+		barriers[0].newLayout	  = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		barriers[0].srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+		barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		barriers[1].image		  = newImage;
+		barriers[1].oldLayout	  = VK_IMAGE_LAYOUT_UNDEFINED;
+		barriers[1].newLayout	  = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barriers[1].srcAccessMask = 0;
+		barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 2, barriers);
+
+		std::vector<VkImageCopy> regions(mipLevels_);
+		for (uint32_t mip = 0; mip < mipLevels_; mip++) {
+			VkImageCopy& region					 = regions[mip];
+			region.srcSubresource.aspectMask	 = aspectMask_;
+			region.srcSubresource.mipLevel		 = mip;
+			region.srcSubresource.baseArrayLayer = 0;
+			region.srcSubresource.layerCount	 = arrayLayers_;
+			region.dstSubresource				 = region.srcSubresource;
+			region.extent.width					 = std::max(1u, width_ >> mip);
+			region.extent.height				 = std::max(1u, height_ >> mip);
+			region.extent.depth					 = type_ == ImageType::IMAGE_3D ? std::max(1u, depth_ >> mip) : depth_;
+		}
+		vkCmdCopyImage(cmd,
+					   image_,
+					   VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+					   newImage,
+					   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+					   static_cast<uint32_t>(regions.size()),
+					   regions.data());
+
+		barriers[1].oldLayout	  = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barriers[1].newLayout	  = convertLayout(currentLayout_);
+		barriers[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barriers[1].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &barriers[1]);
 	}
 
+	outNewImage		 = newImage;
+	outNewView		 = newView;
+	outNewAllocation = newAllocation;
 	return true;
 }
 
+void Image::commitRelocation(VkImage& image, VkImageView& view, memory::AllocationInfo& allocation) {
+	gpu_->allocator.setOwner(allocation_, nullptr, memory::AllocationOwner::NONE);
+	std::swap(image_, image);
+	std::swap(imageView_, view);
+	std::swap(allocation_, allocation);
+	gpu_->allocator.setOwner(allocation_, this, memory::AllocationOwner::IMAGE);
+
+	generation_++;
+}
+
+void Image::replace(Image&& replacement) {
+	uint64_t generation = generation_;
+
+	if (image_ != VK_NULL_HANDLE) {
+		if (isRelocatable()) gpu_->allocator.setOwner(allocation_, nullptr, memory::AllocationOwner::NONE);
+		gpu_->retireImage(image_, imageView_, allocation_);
+		image_		= VK_NULL_HANDLE;
+		imageView_	= VK_NULL_HANDLE;
+		allocation_ = memory::AllocationInfo{};
+	}
+
+	*this		= std::move(replacement);
+	generation_ = std::max(generation_, generation) + 1;
+}
+
 void Image::destroy() {
 	if (!gpu_ || !gpu_->device) return;
 
@@ -244,10 +680,7 @@ void Image::destroy() {
 		image_ = VK_NULL_HANDLE;
 	}
 
-	if (memory_ != VK_NULL_HANDLE) {
-		vkFreeMemory(gpu_->device, memory_, nullptr);
-		memory_ = VK_NULL_HANDLE;
-	}
+	gpu_->allocator.free(allocation_);
 }
 
 void Image::transitionLayout(VkCommandBuffer cmd, ImageLayout newLayout) {
@@ -335,24 +768,144 @@ bool Image::uploadData(const void* data, size_t size) {
 	return uploadDataStaged(data, size);
 }
 
+bool Image::getCopyRegions(const std::vector<ImageRegion>& regions, VkDeviceSize sourceSize, std::vector<VkBufferImageCopy>& outCopies) const {
+	outCopies.clear();
+	outCopies.reserve(regions.size());
+
+	FormatBlock block = getFormatBlock(format_);
+	if (block.size == 0) {
+		std::cerr << "Image: Upload regions need a format of known texel size" << std::endl;
+		return false;
+	}
+
+	for (const auto& region : regions) {
+		if (region.mipLevel >= mipLevels_ || region.layerCount == 0 || region.baseArrayLayer + region.layerCount > arrayLayers_ ||
+			region.bufferOffset >= sourceSize) {
+			std::cerr << "Image: Invalid upload region for mip " << region.mipLevel << ", layer " << region.baseArrayLayer << std::endl;
+			return false;
+		}
+
+		VkBufferImageCopy copy{};
+		copy.bufferOffset					 = region.bufferOffset;
+		copy.bufferRowLength				 = region.rowLength;
+		copy.bufferImageHeight				 = region.imageHeight;
+		copy.imageSubresource.aspectMask	 = aspectMask_;
+		copy.imageSubresource.mipLevel		 = region.mipLevel;
+		copy.imageSubresource.baseArrayLayer = region.baseArrayLayer;
+		copy.imageSubresource.layerCount	 = region.layerCount;
+		copy.imageOffset					 = region.offset;
+		copy.imageExtent					 = region.extent;
+
+		uint32_t levelW = std::max(1u, width_ >> region.mipLevel);
+		uint32_t levelH = std::max(1u, height_ >> region.mipLevel);
+		uint32_t levelD = std::max(1u, depth_ >> region.mipLevel);
+		if (copy.imageExtent.width == 0 || copy.imageExtent.height == 0 || copy.imageExtent.depth == 0) {
+			copy.imageExtent = {levelW, levelH, levelD};
+		}
+
+		if (copy.imageOffset.x < 0 || copy.imageOffset.y < 0 || copy.imageOffset.z < 0 ||
+			static_cast<uint64_t>(copy.imageOffset.x) + copy.imageExtent.width > levelW ||
+			static_cast<uint64_t>(copy.imageOffset.y) + copy.imageExtent.height > levelH ||
+			static_cast<uint64_t>(copy.imageOffset.z) + copy.imageExtent.depth > levelD) {
+			std::cerr << "Image: Upload region for mip " << region.mipLevel << " lies outside the level" << std::endl;
+			return false;
+		}
+
+		// Compressed copies work on whole blocks, except for the ones cut by the edge of the level
+		if (block.width > 1 || block.height > 1) {
+			bool aligned = copy.imageOffset.x % block.width == 0 && copy.imageOffset.y % block.height == 0 &&
+						   copy.bufferRowLength % block.width == 0 && copy.bufferImageHeight % block.height == 0 &&
+						   copy.bufferOffset % block.size == 0 &&
+						   (copy.imageExtent.width % block.width == 0 || copy.imageOffset.x + copy.imageExtent.width == levelW) &&
+						   (copy.imageExtent.height % block.height == 0 || copy.imageOffset.y + copy.imageExtent.height == levelH);
+			if (!aligned) {
+				std::cerr << "Image: Upload region for mip " << region.mipLevel << " is not aligned to " << block.width << "x" << block.height
+						  << " blocks" << std::endl;
+				return false;
+			}
+		}
+
+		if (!isCopyInBounds(copy, block, sourceSize)) {
+			std::cerr << "Image: Upload region for mip " << region.mipLevel << ", layer " << region.baseArrayLayer << " reads past the "
+					  << sourceSize << " source bytes" << std::endl;
+			return false;
+		}
+		outCopies.push_back(copy);
+	}
+
+	return !outCopies.empty();
+}
+
+bool Image::uploadRegions(const void* data, size_t size, const std::vector<ImageRegion>& regions) {
+	if (!isValid() || !data || size == 0) return false;
+
+	std::vector<VkBufferImageCopy> copies;
+	if (!getCopyRegions(regions, size, copies)) return false;
+
+	if (memory::UploadBatch* batch = gpu_->getUploadBatch()) {
+		return batch->upload(*this, data, size, copies);
+	}
+
+	memory::StagingAllocation staging = gpu_->stagingPool.acquire(size);
+	if (!staging.isValid()) {
+		return false;
+	}
+
+	memcpy(staging.data, data, size);
+	for (auto& copy : copies) {
+		copy.bufferOffset += staging.offset;
+	}
+
+	VkCommandBuffer cmd = gpu_->beginOneTimeCommands();
+
+	transitionLayout(cmd, ImageLayout::TRANSFER_DST);
+	vkCmdCopyBufferToImage(cmd, staging.buffer, image_, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(copies.size()), copies.data());
+	transitionLayout(cmd, ImageLayout::SHADER_READ_ONLY);
+
+	gpu_->endOneTimeCommands(cmd);
+	gpu_->stagingPool.release(staging);
+
+	return true;
+}
+
 bool Image::uploadDataStaged(const void* data, size_t size) {
 	if (!isValid() || !data) return false;
 
-	Buffer staging;
-	if (!staging.create(gpu_, size, BufferType::STAGING, BufferUsage::STREAM)) {
+	VkDeviceSize levelSize = getMipLevelSize(format_, width_, height_, depth_, 0) * arrayLayers_;
+	if (levelSize > 0 && size < levelSize) {
+		std::cerr << "Image: Upload of " << size << " bytes is smaller than mip level 0 (" << levelSize << " bytes)" << std::endl;
 		return false;
 	}
 
-	void* mapped = staging.map();
-	memcpy(mapped, data, size);
-	staging.unmap();
+	if (mipLevels_ > 1 && levelSize > 0 && size >= getDataSize()) {
+		std::vector<ImageRegion> regions(mipLevels_);
+		VkDeviceSize			 offset = 0;
+		for (uint32_t level = 0; level < mipLevels_; level++) {
+			regions[level].bufferOffset = offset;
+			regions[level].mipLevel		= level;
+			regions[level].layerCount	= arrayLayers_;
+			offset += getMipLevelSize(format_, width_, height_, depth_, level) * arrayLayers_;
+		}
+		return uploadRegions(data, size, regions);
+	}
+
+	if (memory::UploadBatch* batch = gpu_->getUploadBatch()) {
+		return batch->upload(*this, data, size);
+	}
+
+	memory::StagingAllocation staging = gpu_->stagingPool.acquire(size);
+	if (!staging.isValid()) {
+		return false;
+	}
+
+	memcpy(staging.data, data, size);
 
 	VkCommandBuffer cmd = gpu_->beginOneTimeCommands();
 
 	transitionLayout(cmd, ImageLayout::TRANSFER_DST);
 
 	VkBufferImageCopy region{};
-	region.bufferOffset						= 0;
+	region.bufferOffset						= staging.offset;
 	region.bufferRowLength					= 0;
 	region.bufferImageHeight				= 0;
 	region.imageSubresource.aspectMask		= aspectMask_;
@@ -362,11 +915,12 @@ bool Image::uploadDataStaged(const void* data, size_t size) {
 	region.imageOffset						= {0, 0, 0};
 	region.imageExtent						= {width_, height_, depth_};
 
-	vkCmdCopyBufferToImage(cmd, staging.getHandle(), image_, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+	vkCmdCopyBufferToImage(cmd, staging.buffer, image_, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
 
 	transitionLayout(cmd, ImageLayout::SHADER_READ_ONLY);
 
 	gpu_->endOneTimeCommands(cmd);
+	gpu_->stagingPool.release(staging);
 
 	return true;
 }
@@ -375,6 +929,18 @@ void Image::generateMipmaps() {
 	if (mipLevels_ <= 1) return;
 
 	VkCommandBuffer cmd = gpu_->beginOneTimeCommands();
+	generateMipmaps(cmd);
+	gpu_->endOneTimeCommands(cmd);
+}
+
+void Image::generateMipmaps(VkCommandBuffer cmd) {
+	if (mipLevels_ <= 1) return;
+
+	if (isCompressedFormat(format_)) {
+		std::cerr << "Image: Compressed formats can't generate mipmaps" << std::endl;
+		transitionLayout(cmd, ImageLayout::SHADER_READ_ONLY);
+		return;
+	}
 
 	VkImageMemoryBarrier barrier{};
 	barrier.sType							= VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -458,8 +1024,6 @@ void Image::generateMipmaps() {
 
 	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
 
-	gpu_->endOneTimeCommands(cmd);
-
 	currentLayout_ = ImageLayout::SHADER_READ_ONLY;
 }
 
@@ -507,6 +1071,22 @@ void Image::copyFromBuffer(const Buffer& buffer) {
 	gpu_->endOneTimeCommands(cmd);
 }
 
+bool Image::copyFromBuffer(const Buffer& buffer, const std::vector<ImageRegion>& regions) {
+	if (!isValid() || !buffer.isValid()) return false;
+
+	std::vector<VkBufferImageCopy> copies;
+	if (!getCopyRegions(regions, buffer.getSize(), copies)) return false;
+
+	VkCommandBuffer cmd = gpu_->beginOneTimeCommands();
+
+	transitionLayout(cmd, ImageLayout::TRANSFER_DST);
+	vkCmdCopyBufferToImage(cmd, buffer.getHandle(), image_, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(copies.size()), copies.data());
+	transitionLayout(cmd, ImageLayout::SHADER_READ_ONLY);
+
+	gpu_->endOneTimeCommands(cmd);
+	return true;
+}
+
 // ============================================================================
 // Sampler Implementation
 // ============================================================================
@@ -624,12 +1204,16 @@ bool Texture::create(device::GPU* gpu, const ImageCreateInfo& imageInfo, const S
 }
 
 bool Texture::createFromFile(device::GPU* gpu, const char* filename, bool generateMipmaps) {
-	// TODO: Implement image loading from file (stb_image, etc.)
-	std::cerr << "Texture::createFromFile not yet implemented" << std::endl;
-	(void)gpu;
-	(void)filename;
-	(void)generateMipmaps;
-	return false;
+	destroy();
+	if (!filename) return false;
+
+	std::vector<Texture> loaded = loadTextures(gpu, {filename}, generateMipmaps, false, 1);
+	if (loaded.empty() || !loaded[0].isValid()) {
+		return false;
+	}
+
+	*this = std::move(loaded[0]);
+	return true;
 }
 
 void Texture::destroy() {
@@ -638,3 +1222,50 @@ void Texture::destroy() {
 }
 
 bool Texture::uploadData(const void* data, size_t size) { return image_.uploadData(data, size); }
+
+// ============================================================================
+// Helper Functions
+// ============================================================================
+
+Texture renderApi::createTexture2D(device::GPU* gpu, uint32_t width, uint32_t height, VkFormat format, const void* data, size_t dataSize, bool generateMipmaps) {
+	ImageCreateInfo imageInfo{};
+	imageInfo.width	 = width;
+	imageInfo.height = height;
+	imageInfo.format = format;
+	imageInfo.usage	 = ImageUsage::TEXTURE;
+	imageInfo.type	 = ImageType::IMAGE_2D;
+
+	uint32_t fullChain = static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
+	if (isCompressedFormat(format)) {
+		if (findSupportedFormat(gpu, {format}) == VK_FORMAT_UNDEFINED) {
+			std::cerr << "createTexture2D: Compressed format " << format << " is not supported by the device" << std::endl;
+			return Texture{};
+		}
+
+		// Blocks can't be blitted: keep the levels the data brings
+		imageInfo.mipLevels = 1;
+		if (data) {
+			VkDeviceSize used = getMipLevelSize(format, width, height, 1, 0);
+			while (imageInfo.mipLevels < fullChain) {
+				VkDeviceSize next = getMipLevelSize(format, width, height, 1, imageInfo.mipLevels);
+				if (used + next > dataSize) break;
+				used += next;
+				imageInfo.mipLevels++;
+			}
+		}
+	} else {
+		imageInfo.generateMipmaps = generateMipmaps;
+		imageInfo.mipLevels		  = generateMipmaps ? fullChain : 1;
+	}
+
+	SamplerCreateInfo samplerInfo{};
+	samplerInfo.enableAnisotropy = true;
+	samplerInfo.maxAnisotropy	 = 16.0f;
+
+	Texture texture;
+	texture.create(gpu, imageInfo, samplerInfo);
+	if (data) {
+		texture.uploadData(data, dataSize);
+	}
+	return texture;
+}
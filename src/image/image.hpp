@@ -5,11 +5,21 @@
 
 #include <cmath>
 #include <cstdint>
+#include <vector>
 #include <vulkan/vulkan_core.h>
 
+namespace renderApi::memory {
+	class Defragmenter;
+	class StreamLoader;
+	class TransferManager;
+	class UploadBatch;
+}
+
 namespace renderApi {
 
 	class Buffer;
+	class MipGenerator;
+	class TextureStreamer;
 
 	enum class ImageType { IMAGE_1D, IMAGE_2D, IMAGE_3D, CUBE };
 
@@ -45,9 +55,50 @@ namespace renderApi {
 		ImageUsage	usage			= ImageUsage::TEXTURE;
 		VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
 		bool		generateMipmaps = false;
+		bool		computeMipmaps	= false; // Lets MipGenerator write the levels (storage usage)
+	};
+
+	// Part of one mip level read from a source buffer or array. Row length and image height are in
+	// texels like in VkBufferImageCopy, 0 meaning tightly packed; a zero extent covers the whole level.
+	struct ImageRegion {
+		VkDeviceSize bufferOffset	= 0;
+		uint32_t	 rowLength		= 0;
+		uint32_t	 imageHeight	= 0;
+		uint32_t	 mipLevel		= 0;
+		uint32_t	 baseArrayLayer = 0;
+		uint32_t	 layerCount		= 1;
+		VkOffset3D	 offset			= {0, 0, 0};
+		VkExtent3D	 extent			= {0, 0, 0};
+	};
+
+	// Texel block of a format: 1x1 texel for uncompressed formats, 4x4 for BC. Size is 0 for unknown formats.
+	struct FormatBlock {
+		uint32_t width	= 1;
+		uint32_t height = 1;
+		uint32_t size	= 0;
 	};
 
+	FormatBlock getFormatBlock(VkFormat format);
+	bool		isCompressedFormat(VkFormat format);
+	// The UNORM format sharing the layout of an sRGB format, the format itself otherwise
+	VkFormat	getLinearFormat(VkFormat format);
+	// Tightly packed size of one layer of a mip level, rounded up to whole blocks
+	VkDeviceSize getMipLevelSize(VkFormat format, uint32_t width, uint32_t height, uint32_t depth, uint32_t mipLevel);
+	// Whether the bytes a buffer to image copy reads, from its buffer offset to its last block, lie
+	// within the first size bytes of the buffer. The rows of a slice are bufferRowLength texels apart
+	// and the slices (depth, then layers) bufferImageHeight rows apart, both rounded up to whole blocks.
+	bool		isCopyInBounds(const VkBufferImageCopy& copy, const FormatBlock& block, VkDeviceSize size);
+	// First candidate usable with features in optimal tiling, VK_FORMAT_UNDEFINED if none is
+	VkFormat findSupportedFormat(device::GPU* gpu, const std::vector<VkFormat>& candidates, VkFormatFeatureFlags features = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
+
 	class Image {
+		friend class MipGenerator;
+		friend class TextureStreamer;
+		friend class memory::Defragmenter;
+		friend class memory::StreamLoader;
+		friend class memory::TransferManager;
+		friend class memory::UploadBatch;
+
 	  public:
 		Image();
 		~Image();
@@ -61,33 +112,45 @@ namespace renderApi {
 		void destroy();
 
 		bool uploadData(const void* data, size_t size);
+		// Data is level 0 of every layer, or the whole mip chain level after level when it is large
+		// enough for it. Compressed formats are sized in blocks.
 		bool uploadDataStaged(const void* data, size_t size);
+		// Any number of mips and layers in one staging allocation, copy command and pair of barriers.
+		// Region offsets are relative to data. Leaves the image in SHADER_READ_ONLY layout.
+		bool uploadRegions(const void* data, size_t size, const std::vector<ImageRegion>& regions);
 
 		void transitionLayout(VkCommandBuffer cmd, ImageLayout newLayout);
 		void transitionLayout(ImageLayout newLayout);
 
+		// Every level must be in TRANSFER_DST layout with level 0 written; all end up SHADER_READ_ONLY.
+		// Compressed formats can't be blitted and must come with their mips.
 		void generateMipmaps();
+		void generateMipmaps(VkCommandBuffer cmd);
 
 		void copyToBuffer(Buffer& buffer);
 		void copyFromBuffer(const Buffer& buffer);
+		bool copyFromBuffer(const Buffer& buffer, const std::vector<ImageRegion>& regions);
 
 		VkImage		  getHandle() const { return image_; }
 		VkImageView	  getView() const { return imageView_; }
-		VkDeviceMemory getMemory() const { return memory_; }
+		VkDeviceMemory getMemory() const { return allocation_.memory; }
 		VkFormat	  getFormat() const { return format_; }
 		uint32_t	  getWidth() const { return width_; }
 		uint32_t	  getHeight() const { return height_; }
 		uint32_t	  getDepth() const { return depth_; }
 		uint32_t	  getMipLevels() const { return mipLevels_; }
 		uint32_t	  getArrayLayers() const { return arrayLayers_; }
+		// Bytes of every mip level of every layer, tightly packed
+		VkDeviceSize  getDataSize() const;
 		ImageLayout	  getCurrentLayout() const { return currentLayout_; }
+		uint64_t	  getGeneration() const { return generation_; }
 		bool		  isValid() const { return image_ != VK_NULL_HANDLE; }
 
 	  private:
 		device::GPU*	gpu_;
 		VkImage			image_;
 		VkImageView		imageView_;
-		VkDeviceMemory	memory_;
+		memory::AllocationInfo allocation_;
 		VkFormat		format_;
 		uint32_t		width_;
 		uint32_t		height_;
@@ -98,10 +161,22 @@ namespace renderApi {
 		ImageUsage		usage_;
 		ImageLayout		currentLayout_;
 		VkImageAspectFlags aspectMask_;
+		VkSampleCountFlagBits samples_;
+		bool			computeMipmaps_;
+		uint64_t		generation_; // Bumped whenever the handle or view changes
 
 		VkImageUsageFlags getVkUsageFlags() const;
 		VkImageAspectFlags getAspectMask() const;
 		VkImageLayout	  convertLayout(ImageLayout layout) const;
+		bool			  createHandle(VkImage& outImage) const;
+		bool			  createView(VkImage image, VkImageView& outView) const;
+		bool			  isRelocatable() const;
+		bool			  getCopyRegions(const std::vector<ImageRegion>& regions, VkDeviceSize sourceSize, std::vector<VkBufferImageCopy>& outCopies) const;
+		// Same as Buffer::relocate and Buffer::commitRelocation
+		bool			  relocate(VkCommandBuffer cmd, VkImage& outNewImage, VkImageView& outNewView, memory::AllocationInfo& outNewAllocation);
+		void			  commitRelocation(VkImage& image, VkImageView& view, memory::AllocationInfo& allocation);
+		// Takes the handles of replacement and retires the current ones until the GPU is done with them
+		void			  replace(Image&& replacement);
 	};
 
 	enum class FilterMode { NEAREST, LINEAR };
@@ -162,6 +237,7 @@ namespace renderApi {
 		Sampler&  getSampler() { return sampler_; }
 		VkImageView getImageView() const { return image_.getView(); }
 		VkSampler getSamplerHandle() const { return sampler_.getHandle(); }
+		uint64_t  getGeneration() const { return image_.getGeneration(); }
 		bool	  isValid() const { return image_.isValid() && sampler_.isValid(); }
 
 	  private:
@@ -183,33 +259,15 @@ namespace renderApi {
 		return image;
 	}
 
-	inline Texture createTexture2D(device::GPU*			gpu,
-								   uint32_t				width,
-								   uint32_t				height,
-								   VkFormat				format,
-								   const void*			data,
-								   size_t				dataSize,
-								   bool					generateMipmaps = false) {
-		ImageCreateInfo imageInfo{};
-		imageInfo.width				= width;
-		imageInfo.height			= height;
-		imageInfo.format			= format;
-		imageInfo.usage				= ImageUsage::TEXTURE;
-		imageInfo.type				= ImageType::IMAGE_2D;
-		imageInfo.generateMipmaps	= generateMipmaps;
-		imageInfo.mipLevels			= generateMipmaps ? static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1 : 1;
-
-		SamplerCreateInfo samplerInfo{};
-		samplerInfo.enableAnisotropy = true;
-		samplerInfo.maxAnisotropy	 = 16.0f;
-
-		Texture texture;
-		texture.create(gpu, imageInfo, samplerInfo);
-		if (data) {
-			texture.uploadData(data, dataSize);
-		}
-		return texture;
-	}
+	// Compressed formats must be supported by the device and can't generate mips: data then holds
+	// as many levels as it has room for, level 0 first. Pick the format with findSupportedFormat.
+	Texture createTexture2D(device::GPU* gpu,
+							uint32_t	 width,
+							uint32_t	 height,
+							VkFormat	 format,
+							const void*	 data,
+							size_t		 dataSize,
+							bool		 generateMipmaps = false);
 
 } // namespace renderApi
 
@@ -0,0 +1,345 @@
+#include "mipGenerator.hpp"
+
+#include "pipeline/computePipeline.hpp"
+#include "renderDevice.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+using namespace renderApi;
+
+namespace {
+
+	// Built from src/image/shaders/mipDownsample.comp
+	const uint32_t kDownsampleSpirv[] =
+#include "mipDownsample.comp.spv.inc"
+		;
+
+	constexpr uint32_t kSetsPerPool	 = 64;
+	constexpr uint32_t kTileSize	 = 32; // First level texels written by one workgroup, per axis
+
+	struct PushConstants {
+		int32_t	 sourceWidth;
+		int32_t	 sourceHeight;
+		uint32_t levelCount;
+		uint32_t filterMode;
+		uint32_t srgb;
+	};
+
+} // namespace
+
+// ============================================================================
+// MipGenerator Implementation
+// ============================================================================
+
+MipGenerator::MipGenerator() : gpu_(nullptr), setLayout_(VK_NULL_HANDLE), activePool_(0) {}
+
+MipGenerator::~MipGenerator() { destroy(); }
+
+bool MipGenerator::create(device::GPU* gpu) {
+	destroy();
+
+	if (!gpu || !gpu->device) {
+		std::cerr << "MipGenerator: GPU not initialized" << std::endl;
+		return false;
+	}
+	if (!gpu->storageWriteWithoutFormatSupported) {
+		std::cerr << "MipGenerator: shaderStorageImageWriteWithoutFormat is not supported" << std::endl;
+		return false;
+	}
+	gpu_ = gpu;
+
+	VkDescriptorSetLayoutBinding bindings[2]{};
+	bindings[0].binding			= 0;
+	bindings[0].descriptorType	= VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+	bindings[0].descriptorCount = 1;
+	bindings[0].stageFlags		= VK_SHADER_STAGE_COMPUTE_BIT;
+	bindings[1].binding			= 1;
+	bindings[1].descriptorType	= VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	bindings[1].descriptorCount = kMaxLevelsPerDispatch;
+	bindings[1].stageFlags		= VK_SHADER_STAGE_COMPUTE_BIT;
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType		= VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = 2;
+	layoutInfo.pBindings	= bindings;
+
+	if (vkCreateDescriptorSetLayout(gpu_->device, &layoutInfo, nullptr, &setLayout_) != VK_SUCCESS) {
+		std::cerr << "MipGenerator: Failed to create descriptor set layout" << std::endl;
+		setLayout_ = VK_NULL_HANDLE;
+		return false;
+	}
+
+	auto pipeline = std::make_unique<gpuTask::ComputePipeline>(gpu_, "mipDownsample");
+	pipeline->setShader(std::vector<uint32_t>(std::begin(kDownsampleSpirv), std::end(kDownsampleSpirv)));
+	pipeline->setWorkgroupSize(16, 16);
+	pipeline->addPushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants));
+	if (!pipeline->build(setLayout_)) {
+		destroy();
+		return false;
+	}
+	pipeline_ = std::move(pipeline);
+
+	return true;
+}
+
+void MipGenerator::destroy() {
+	if (!gpu_) return;
+
+	reset();
+	for (VkDescriptorPool pool : pools_) {
+		vkDestroyDescriptorPool(gpu_->device, pool, nullptr);
+	}
+	pools_.clear();
+	activePool_ = 0;
+
+	pipeline_.reset();
+	if (setLayout_ != VK_NULL_HANDLE) {
+		vkDestroyDescriptorSetLayout(gpu_->device, setLayout_, nullptr);
+		setLayout_ = VK_NULL_HANDLE;
+	}
+	gpu_ = nullptr;
+}
+
+VkDescriptorSet MipGenerator::allocateSet() {
+	for (; activePool_ <= pools_.size(); activePool_++) {
+		if (activePool_ == pools_.size()) {
+			VkDescriptorPoolSize sizes[2]{};
+			sizes[0].type			 = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+			sizes[0].descriptorCount = kSetsPerPool;
+			sizes[1].type			 = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			sizes[1].descriptorCount = kSetsPerPool * kMaxLevelsPerDispatch;
+
+			VkDescriptorPoolCreateInfo poolInfo{};
+			poolInfo.sType		   = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+			poolInfo.flags		   = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+			poolInfo.maxSets	   = kSetsPerPool;
+			poolInfo.poolSizeCount = 2;
+			poolInfo.pPoolSizes	   = sizes;
+
+			VkDescriptorPool pool;
+			if (vkCreateDescriptorPool(gpu_->device, &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+				std::cerr << "MipGenerator: Failed to create descriptor pool" << std::endl;
+				return VK_NULL_HANDLE;
+			}
+			pools_.push_back(pool);
+		}
+
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType				 = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool	 = pools_[activePool_];
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts		 = &setLayout_;
+
+		VkDescriptorSet set;
+		if (vkAllocateDescriptorSets(gpu_->device, &allocInfo, &set) == VK_SUCCESS) {
+			sets_.push_back(set);
+			setPools_.push_back(activePool_);
+			return set;
+		}
+	}
+	return VK_NULL_HANDLE;
+}
+
+VkImageView MipGenerator::createLevelView(const Image& image, uint32_t level, VkFormat format) {
+	// Cube faces are plain layers here
+	VkImageViewCreateInfo viewInfo{};
+	viewInfo.sType							 = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewInfo.image							 = image.image_;
+	viewInfo.viewType						 = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+	viewInfo.format							 = format;
+	viewInfo.subresourceRange.aspectMask	 = VK_IMAGE_ASPECT_COLOR_BIT;
+	viewInfo.subresourceRange.baseMipLevel	 = level;
+	viewInfo.subresourceRange.levelCount	 = 1;
+	viewInfo.subresourceRange.baseArrayLayer = 0;
+	viewInfo.subresourceRange.layerCount	 = image.arrayLayers_;
+
+	VkImageView view;
+	if (vkCreateImageView(gpu_->device, &viewInfo, nullptr, &view) != VK_SUCCESS) {
+		return VK_NULL_HANDLE;
+	}
+	views_.push_back(view);
+	return view;
+}
+
+bool MipGenerator::record(VkCommandBuffer cmd, Image& image, MipFilter filter) {
+	if (!isValid() || !image.isValid()) return false;
+
+	if (image.mipLevels_ <= 1) {
+		image.transitionLayout(cmd, ImageLayout::SHADER_READ_ONLY);
+		return true;
+	}
+	if (!image.computeMipmaps_) {
+		std::cerr << "MipGenerator: Image was not created with computeMipmaps" << std::endl;
+		return false;
+	}
+	if (image.type_ == ImageType::IMAGE_3D || isCompressedFormat(image.format_)) {
+		std::cerr << "MipGenerator: 3D and compressed images are not supported" << std::endl;
+		return false;
+	}
+
+	VkFormat storageFormat = getLinearFormat(image.format_);
+	if (findSupportedFormat(gpu_, {storageFormat}, VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT) == VK_FORMAT_UNDEFINED) {
+		std::cerr << "MipGenerator: Format " << storageFormat << " can't be a storage image" << std::endl;
+		return false;
+	}
+
+	// Level 0 is sampled, the others are written and read back in GENERAL layout
+	VkImageMemoryBarrier barriers[2]{};
+	for (auto& barrier : barriers) {
+		barrier.sType						= VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.image						= image.image_;
+		barrier.srcQueueFamilyIndex			= VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex			= VK_QUEUE_FAMILY_IGNORED;
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.layerCount = image.arrayLayers_;
+	}
+	barriers[0].subresourceRange.levelCount	  = 1;
+	barriers[0].oldLayout					  = image.convertLayout(image.currentLayout_);
+	barriers[0].newLayout					  = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barriers[0].srcAccessMask				  = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	barriers[0].dstAccessMask				  = VK_ACCESS_SHADER_READ_BIT;
+	barriers[1].subresourceRange.baseMipLevel = 1;
+	barriers[1].subresourceRange.levelCount	  = image.mipLevels_ - 1;
+	barriers[1].oldLayout					  = VK_IMAGE_LAYOUT_UNDEFINED;
+	barriers[1].newLayout					  = VK_IMAGE_LAYOUT_GENERAL;
+	barriers[1].srcAccessMask				  = 0;
+	barriers[1].dstAccessMask				  = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0,
+						 nullptr, 0, nullptr, 2, barriers);
+
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_->getPipeline());
+
+	uint32_t levelsPerDispatch = filter == MipFilter::KAISER ? 1 : kMaxLevelsPerDispatch;
+	for (uint32_t base = 0; base + 1 < image.mipLevels_;) {
+		uint32_t levelCount = std::min(levelsPerDispatch, image.mipLevels_ - 1 - base);
+
+		if (base > 0) {
+			// The last level written becomes the source
+			VkMemoryBarrier memoryBarrier{};
+			memoryBarrier.sType			= VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0,
+								 nullptr);
+		}
+
+		VkDescriptorSet set	   = allocateSet();
+		VkImageView		source = createLevelView(image, base, image.format_);
+		if (set == VK_NULL_HANDLE || source == VK_NULL_HANDLE) {
+			std::cerr << "MipGenerator: Failed to create descriptors" << std::endl;
+			return false;
+		}
+
+		VkDescriptorImageInfo sourceInfo{};
+		sourceInfo.imageView   = source;
+		sourceInfo.imageLayout = base == 0 ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL;
+
+		// Unused slots repeat the last level so that every descriptor is valid
+		VkDescriptorImageInfo levelInfos[kMaxLevelsPerDispatch]{};
+		for (uint32_t i = 0; i < kMaxLevelsPerDispatch; i++) {
+			if (i < levelCount) {
+				levelInfos[i].imageView = createLevelView(image, base + 1 + i, storageFormat);
+				if (levelInfos[i].imageView == VK_NULL_HANDLE) {
+					std::cerr << "MipGenerator: Failed to create level view" << std::endl;
+					return false;
+				}
+			} else {
+				levelInfos[i].imageView = levelInfos[levelCount - 1].imageView;
+			}
+			levelInfos[i].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+		}
+
+		VkWriteDescriptorSet writes[2]{};
+		writes[0].sType			  = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[0].dstSet		  = set;
+		writes[0].dstBinding	  = 0;
+		writes[0].descriptorCount = 1;
+		writes[0].descriptorType  = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+		writes[0].pImageInfo	  = &sourceInfo;
+		writes[1].sType			  = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[1].dstSet		  = set;
+		writes[1].dstBinding	  = 1;
+		writes[1].descriptorCount = kMaxLevelsPerDispatch;
+		writes[1].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		writes[1].pImageInfo	  = levelInfos;
+		vkUpdateDescriptorSets(gpu_->device, 2, writes, 0, nullptr);
+
+		PushConstants constants{};
+		constants.sourceWidth  = static_cast<int32_t>(std::max(1u, image.width_ >> base));
+		constants.sourceHeight = static_cast<int32_t>(std::max(1u, image.height_ >> base));
+		constants.levelCount   = levelCount;
+		constants.filterMode   = filter == MipFilter::KAISER ? 1 : 0;
+		constants.srgb		   = storageFormat != image.format_ ? 1 : 0;
+
+		VkPipelineLayout layout = pipeline_->getLayout();
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, layout, 0, 1, &set, 0, nullptr);
+		vkCmdPushConstants(cmd, layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+
+		uint32_t firstWidth	 = std::max(1u, image.width_ >> (base + 1));
+		uint32_t firstHeight = std::max(1u, image.height_ >> (base + 1));
+		vkCmdDispatch(cmd, (firstWidth + kTileSize - 1) / kTileSize, (firstHeight + kTileSize - 1) / kTileSize, image.arrayLayers_);
+
+		base += levelCount;
+	}
+
+	barriers[1].oldLayout	  = VK_IMAGE_LAYOUT_GENERAL;
+	barriers[1].newLayout	  = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barriers[1].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0,
+						 nullptr, 0, nullptr, 1, &barriers[1]);
+
+	image.currentLayout_ = ImageLayout::SHADER_READ_ONLY;
+	return true;
+}
+
+bool MipGenerator::generate(Image& image, MipFilter filter) {
+	if (!isValid()) return false;
+
+	size_t firstSet	 = sets_.size();
+	size_t firstView = views_.size();
+
+	VkCommandBuffer cmd = gpu_->beginOneTimeCommands();
+	bool			recorded = record(cmd, image, filter);
+	gpu_->endOneTimeCommands(cmd);
+
+	// Leave what was recorded by the caller for reset()
+	release(firstSet, firstView);
+	return recorded;
+}
+
+void MipGenerator::release(size_t firstSet, size_t firstView) {
+	for (size_t i = firstView; i < views_.size(); i++) {
+		vkDestroyImageView(gpu_->device, views_[i], nullptr);
+	}
+	views_.resize(firstView);
+
+	for (size_t i = firstSet; i < sets_.size(); i++) {
+		vkFreeDescriptorSets(gpu_->device, pools_[setPools_[i]], 1, &sets_[i]);
+	}
+	sets_.resize(firstSet);
+	setPools_.resize(firstSet);
+	activePool_ = firstSet > 0 ? setPools_.back() : 0;
+}
+
+void MipGenerator::reset() {
+	if (!gpu_) return;
+
+	for (VkImageView view : views_) {
+		vkDestroyImageView(gpu_->device, view, nullptr);
+	}
+	views_.clear();
+
+	for (VkDescriptorPool pool : pools_) {
+		vkResetDescriptorPool(gpu_->device, pool, 0);
+	}
+	sets_.clear();
+	setPools_.clear();
+	activePool_ = 0;
+}
@@ -0,0 +1,69 @@
+#ifndef MIP_GENERATOR_HPP
+#define MIP_GENERATOR_HPP
+
+#include "image.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+namespace renderApi::gpuTask {
+	class ComputePipeline;
+}
+
+namespace renderApi {
+
+	enum class MipFilter {
+		BOX,   // 2x2 average, up to six levels per dispatch
+		KAISER // 6x6 Kaiser windowed sinc, sharper, one level per dispatch
+	};
+
+	// Generates mip levels with a compute shader instead of a chain of blits: one dispatch writes up
+	// to six levels from shared memory, so the twelve levels under a 4096x4096 image take two dispatches.
+	// Works for formats that can't be blitted as long as they can be storage images, and averages
+	// sRGB images in linear space. Images must be created with ImageCreateInfo::computeMipmaps.
+	//
+	// record() only records, so the mips of many textures can go in one command buffer. The views
+	// and descriptor sets it uses live until reset(), to call once those command buffers completed.
+	// The box filter ignores the last row or column of odd sized levels.
+	class MipGenerator {
+	  public:
+		static constexpr uint32_t kMaxLevelsPerDispatch = 6;
+
+		MipGenerator();
+		~MipGenerator();
+
+		MipGenerator(const MipGenerator&)			 = delete;
+		MipGenerator& operator=(const MipGenerator&) = delete;
+
+		bool create(device::GPU* gpu);
+		void destroy();
+
+		// Level 0 must be written; every level ends up SHADER_READ_ONLY. cmd must support compute.
+		bool record(VkCommandBuffer cmd, Image& image, MipFilter filter = MipFilter::BOX);
+		// Records in a one-time command buffer and waits for it
+		bool generate(Image& image, MipFilter filter = MipFilter::BOX);
+		// Frees the views and descriptor sets of everything recorded so far
+		void reset();
+
+		bool isValid() const { return pipeline_ != nullptr; }
+
+	  private:
+		device::GPU*							  gpu_;
+		VkDescriptorSetLayout					  setLayout_;
+		std::unique_ptr<gpuTask::ComputePipeline> pipeline_;
+		std::vector<VkDescriptorPool>			  pools_;
+		size_t									  activePool_;
+		std::vector<VkDescriptorSet>			  sets_;
+		std::vector<size_t>						  setPools_; // Pool of each set
+		std::vector<VkImageView>				  views_;
+
+		VkDescriptorSet allocateSet();
+		VkImageView		createLevelView(const Image& image, uint32_t level, VkFormat format);
+		void			release(size_t firstSet, size_t firstView);
+	};
+
+} // namespace renderApi
+
+#endif
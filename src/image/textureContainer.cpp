@@ -0,0 +1,388 @@
+#include "textureContainer.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+using namespace renderApi;
+
+namespace {
+
+	const uint8_t kKtx2Identifier[12] = {0xab, 'K', 'T', 'X', ' ', '2', '0', 0xbb, '\r', '\n', 0x1a, '\n'};
+	const uint8_t kDdsMagic[4]		  = {'D', 'D', 'S', ' '};
+
+	constexpr size_t kKtx2HeaderSize	 = 80;
+	constexpr size_t kKtx2LevelEntrySize = 24;
+	constexpr size_t kDdsHeaderSize		 = 128; // Magic included
+	constexpr size_t kDdsDx10HeaderSize	 = 20;
+
+	// DDS flags
+	constexpr uint32_t kDdsFlagDepth		 = 0x800000;
+	constexpr uint32_t kDdsPixelFourCC		 = 0x4;
+	constexpr uint32_t kDdsPixelRgb			 = 0x40;
+	constexpr uint32_t kDdsCaps2Cubemap		 = 0x200;
+	constexpr uint32_t kDdsCaps2Volume		 = 0x200000;
+	constexpr uint32_t kDx10MiscTextureCube	 = 0x4;
+	constexpr uint32_t kDx10Dimension3D		 = 4;
+
+	// Above what any device supports, only there to bound the loops over levels and layers
+	constexpr uint32_t kMaxDimension   = 32768;
+	constexpr uint32_t kMaxArrayLayers = 8192;
+
+	uint32_t read32(const uint8_t* data) {
+		uint32_t value;
+		memcpy(&value, data, sizeof(value));
+		return value;
+	}
+
+	uint64_t read64(const uint8_t* data) {
+		uint64_t value;
+		memcpy(&value, data, sizeof(value));
+		return value;
+	}
+
+	constexpr uint32_t fourCC(char a, char b, char c, char d) {
+		return static_cast<uint32_t>(a) | (static_cast<uint32_t>(b) << 8) | (static_cast<uint32_t>(c) << 16) | (static_cast<uint32_t>(d) << 24);
+	}
+
+	VkFormat fromDxgiFormat(uint32_t dxgiFormat) {
+		switch (dxgiFormat) {
+		case 2:
+			return VK_FORMAT_R32G32B32A32_SFLOAT;
+		case 10:
+			return VK_FORMAT_R16G16B16A16_SFLOAT;
+		case 28:
+			return VK_FORMAT_R8G8B8A8_UNORM;
+		case 29:
+			return VK_FORMAT_R8G8B8A8_SRGB;
+		case 70:
+		case 71:
+			return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+		case 72:
+			return VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+		case 73:
+		case 74:
+			return VK_FORMAT_BC2_UNORM_BLOCK;
+		case 75:
+			return VK_FORMAT_BC2_SRGB_BLOCK;
+		case 76:
+		case 77:
+			return VK_FORMAT_BC3_UNORM_BLOCK;
+		case 78:
+			return VK_FORMAT_BC3_SRGB_BLOCK;
+		case 79:
+		case 80:
+			return VK_FORMAT_BC4_UNORM_BLOCK;
+		case 81:
+			return VK_FORMAT_BC4_SNORM_BLOCK;
+		case 82:
+		case 83:
+			return VK_FORMAT_BC5_UNORM_BLOCK;
+		case 84:
+			return VK_FORMAT_BC5_SNORM_BLOCK;
+		case 87:
+			return VK_FORMAT_B8G8R8A8_UNORM;
+		case 91:
+			return VK_FORMAT_B8G8R8A8_SRGB;
+		case 94:
+		case 95:
+			return VK_FORMAT_BC6H_UFLOAT_BLOCK;
+		case 96:
+			return VK_FORMAT_BC6H_SFLOAT_BLOCK;
+		case 97:
+		case 98:
+			return VK_FORMAT_BC7_UNORM_BLOCK;
+		case 99:
+			return VK_FORMAT_BC7_SRGB_BLOCK;
+		default:
+			return VK_FORMAT_UNDEFINED;
+		}
+	}
+
+	VkFormat fromDdsPixelFormat(const uint8_t* pixelFormat) {
+		uint32_t flags = read32(pixelFormat + 4);
+
+		if (flags & kDdsPixelFourCC) {
+			switch (read32(pixelFormat + 8)) {
+			case fourCC('D', 'X', 'T', '1'):
+				return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+			case fourCC('D', 'X', 'T', '2'):
+			case fourCC('D', 'X', 'T', '3'):
+				return VK_FORMAT_BC2_UNORM_BLOCK;
+			case fourCC('D', 'X', 'T', '4'):
+			case fourCC('D', 'X', 'T', '5'):
+				return VK_FORMAT_BC3_UNORM_BLOCK;
+			case fourCC('A', 'T', 'I', '1'):
+			case fourCC('B', 'C', '4', 'U'):
+				return VK_FORMAT_BC4_UNORM_BLOCK;
+			case fourCC('B', 'C', '4', 'S'):
+				return VK_FORMAT_BC4_SNORM_BLOCK;
+			case fourCC('A', 'T', 'I', '2'):
+			case fourCC('B', 'C', '5', 'U'):
+				return VK_FORMAT_BC5_UNORM_BLOCK;
+			case fourCC('B', 'C', '5', 'S'):
+				return VK_FORMAT_BC5_SNORM_BLOCK;
+			default:
+				return VK_FORMAT_UNDEFINED;
+			}
+		}
+
+		if ((flags & kDdsPixelRgb) && read32(pixelFormat + 12) == 32) {
+			uint32_t redMask = read32(pixelFormat + 16);
+			if (redMask == 0x000000ff) return VK_FORMAT_R8G8B8A8_UNORM;
+			if (redMask == 0x00ff0000) return VK_FORMAT_B8G8R8A8_UNORM;
+		}
+		return VK_FORMAT_UNDEFINED;
+	}
+
+	constexpr size_t kMaxHeaderSize = 4096; // Headers and level index, for header only reads
+
+	// Reads the whole file, or only its first kMaxHeaderSize bytes
+	bool readFile(const std::string& path, bool headerOnly, std::vector<uint8_t>& out, uint64_t& fileSize) {
+		std::ifstream file(path, std::ios::binary | std::ios::ate);
+		if (!file.is_open()) return false;
+
+		std::streamsize size = file.tellg();
+		if (size <= 0) return false;
+		file.seekg(0);
+
+		fileSize = static_cast<uint64_t>(size);
+		if (headerOnly) size = std::min<std::streamsize>(size, kMaxHeaderSize);
+
+		out.resize(static_cast<size_t>(size));
+		return static_cast<bool>(file.read(reinterpret_cast<char*>(out.data()), size));
+	}
+
+	// Checks the counts read from a header before they size any loop or shift; layers include cube faces
+	bool checkDimensions(uint32_t width, uint32_t height, uint32_t depth, uint32_t mipLevels, uint64_t layers, std::string& error) {
+		if (width == 0 || height == 0 || depth == 0 || width > kMaxDimension || height > kMaxDimension || depth > kMaxDimension) {
+			error = "invalid dimensions " + std::to_string(width) + "x" + std::to_string(height) + "x" + std::to_string(depth);
+			return false;
+		}
+
+		// floor(log2(largest)) + 1
+		uint32_t maxLevels = 1;
+		for (uint32_t largest = std::max({width, height, depth}); largest > 1; largest >>= 1) {
+			maxLevels++;
+		}
+		if (mipLevels == 0 || mipLevels > maxLevels) {
+			error = std::to_string(mipLevels) + " mip levels for a largest dimension of " + std::to_string(std::max({width, height, depth}));
+			return false;
+		}
+
+		if (layers == 0 || layers > kMaxArrayLayers) {
+			error = "invalid layer count " + std::to_string(layers);
+			return false;
+		}
+		return true;
+	}
+
+	// Bytes of every layer of a level
+	VkDeviceSize getLevelSize(const TextureContainer& container, uint32_t level) {
+		return getMipLevelSize(container.format, container.width, container.height, container.depth, level) * container.arrayLayers;
+	}
+
+	bool parseKtx2(const std::vector<uint8_t>& file, uint64_t fileSize, bool headerOnly, TextureContainer& out, std::string& error) {
+		if (file.size() < kKtx2HeaderSize) {
+			error = "truncated KTX2 header";
+			return false;
+		}
+
+		const uint8_t* header		   = file.data() + sizeof(kKtx2Identifier);
+		uint32_t	   vkFormat		   = read32(header);
+		uint32_t	   pixelWidth	   = read32(header + 8);
+		uint32_t	   pixelHeight	   = read32(header + 12);
+		uint32_t	   pixelDepth	   = read32(header + 16);
+		uint32_t	   layerCount	   = read32(header + 20);
+		uint32_t	   faceCount	   = read32(header + 24);
+		uint32_t	   levelCount	   = read32(header + 28);
+		uint32_t	   supercompressed = read32(header + 32);
+
+		if (supercompressed != 0) {
+			error = "supercompressed KTX2 (BasisLZ, Zstandard, ZLIB) is not supported";
+			return false;
+		}
+		if (vkFormat == VK_FORMAT_UNDEFINED || getFormatBlock(static_cast<VkFormat>(vkFormat)).size == 0) {
+			error = "unsupported KTX2 format " + std::to_string(vkFormat);
+			return false;
+		}
+		if (faceCount != 1 && faceCount != 6) {
+			error = "invalid KTX2 face count " + std::to_string(faceCount);
+			return false;
+		}
+		uint64_t layers = static_cast<uint64_t>(std::max(1u, layerCount)) * faceCount;
+		if (!checkDimensions(pixelWidth, std::max(1u, pixelHeight), std::max(1u, pixelDepth), std::max(1u, levelCount), layers, error)) {
+			error = "KTX2 " + error;
+			return false;
+		}
+
+		out.format		= static_cast<VkFormat>(vkFormat);
+		out.width		= pixelWidth;
+		out.height		= std::max(1u, pixelHeight);
+		out.depth		= std::max(1u, pixelDepth);
+		out.mipLevels	= std::max(1u, levelCount); // 0 asks for the mips to be generated
+		out.arrayLayers = static_cast<uint32_t>(layers);
+		out.type		= faceCount == 6 ? ImageType::CUBE : pixelDepth > 0 ? ImageType::IMAGE_3D : pixelHeight > 0 ? ImageType::IMAGE_2D : ImageType::IMAGE_1D;
+
+		if (file.size() < kKtx2HeaderSize + out.mipLevels * kKtx2LevelEntrySize) {
+			error = "truncated KTX2 level index";
+			return false;
+		}
+
+		// Levels are stored smallest first; lay them out largest first, each level holding its layers and faces
+		VkDeviceSize total = 0;
+		for (uint32_t level = 0; level < out.mipLevels; level++) {
+			total += getLevelSize(out, level);
+		}
+		if (total > fileSize) {
+			error = "KTX2 levels exceed the file size";
+			return false;
+		}
+		if (!headerOnly) out.data.resize(total);
+		out.regions.clear();
+		out.fileOffsets.clear();
+
+		VkDeviceSize offset = 0;
+		for (uint32_t level = 0; level < out.mipLevels; level++) {
+			const uint8_t* entry	  = file.data() + kKtx2HeaderSize + level * kKtx2LevelEntrySize;
+			uint64_t	   byteOffset = read64(entry);
+			uint64_t	   byteLength = read64(entry + 8);
+			VkDeviceSize   levelSize  = getLevelSize(out, level);
+
+			if (byteLength < levelSize || byteOffset > fileSize || byteLength > fileSize - byteOffset) {
+				error = "KTX2 level " + std::to_string(level) + " is out of bounds";
+				return false;
+			}
+			if (!headerOnly) memcpy(out.data.data() + offset, file.data() + byteOffset, levelSize);
+			out.fileOffsets.push_back(byteOffset);
+
+			ImageRegion region;
+			region.bufferOffset = offset;
+			region.mipLevel		= level;
+			region.layerCount	= out.arrayLayers;
+			out.regions.push_back(region);
+			offset += levelSize;
+		}
+		return true;
+	}
+
+	bool parseDds(const std::vector<uint8_t>& file, uint64_t fileSize, bool headerOnly, TextureContainer& out, std::string& error) {
+		if (file.size() < kDdsHeaderSize) {
+			error = "truncated DDS header";
+			return false;
+		}
+
+		const uint8_t* header	  = file.data() + sizeof(kDdsMagic);
+		uint32_t	   flags	  = read32(header + 4);
+		uint32_t	   height	  = read32(header + 8);
+		uint32_t	   width	  = read32(header + 12);
+		uint32_t	   depth	  = read32(header + 20);
+		uint32_t	   mipCount	  = read32(header + 24);
+		const uint8_t* pixelFmt	  = header + 72;
+		uint32_t	   caps2	  = read32(header + 108);
+		size_t		   dataOffset = kDdsHeaderSize;
+
+		bool	 cube	   = (caps2 & kDdsCaps2Cubemap) != 0;
+		bool	 volume	   = (caps2 & kDdsCaps2Volume) != 0 && (flags & kDdsFlagDepth) != 0;
+		uint32_t arraySize = 1;
+
+		if ((read32(pixelFmt + 4) & kDdsPixelFourCC) && read32(pixelFmt + 8) == fourCC('D', 'X', '1', '0')) {
+			if (file.size() < kDdsHeaderSize + kDdsDx10HeaderSize) {
+				error = "truncated DDS DX10 header";
+				return false;
+			}
+			const uint8_t* dx10 = file.data() + kDdsHeaderSize;
+			out.format			= fromDxgiFormat(read32(dx10));
+			volume				= read32(dx10 + 4) == kDx10Dimension3D;
+			cube				= (read32(dx10 + 8) & kDx10MiscTextureCube) != 0;
+			arraySize			= std::max(1u, read32(dx10 + 12));
+			dataOffset += kDdsDx10HeaderSize;
+		} else {
+			out.format = fromDdsPixelFormat(pixelFmt);
+		}
+
+		if (out.format == VK_FORMAT_UNDEFINED) {
+			error = "unsupported DDS pixel format";
+			return false;
+		}
+		uint64_t layers = static_cast<uint64_t>(arraySize) * (cube ? 6 : 1);
+		if (!checkDimensions(width, height, volume ? std::max(1u, depth) : 1, std::max(1u, mipCount), layers, error)) {
+			error = "DDS " + error;
+			return false;
+		}
+
+		out.width		= width;
+		out.height		= height;
+		out.depth		= volume ? std::max(1u, depth) : 1;
+		out.mipLevels	= std::max(1u, mipCount);
+		out.arrayLayers = static_cast<uint32_t>(layers);
+		out.type		= cube ? ImageType::CUBE : volume ? ImageType::IMAGE_3D : ImageType::IMAGE_2D;
+
+		// Stored layer after layer, each with its whole mip chain
+		VkDeviceSize layerSize = 0;
+		for (uint32_t level = 0; level < out.mipLevels; level++) {
+			layerSize += getMipLevelSize(out.format, out.width, out.height, out.depth, level);
+		}
+		VkDeviceSize total = layerSize * out.arrayLayers;
+		if (fileSize - dataOffset < total) {
+			error = "truncated DDS data";
+			return false;
+		}
+
+		if (!headerOnly) out.data.assign(file.begin() + dataOffset, file.begin() + dataOffset + total);
+		out.regions.clear();
+		out.regions.reserve(static_cast<size_t>(out.arrayLayers) * out.mipLevels);
+		out.fileOffsets.clear();
+		out.fileOffsets.reserve(out.regions.capacity());
+
+		VkDeviceSize offset = 0;
+		for (uint32_t layer = 0; layer < out.arrayLayers; layer++) {
+			for (uint32_t level = 0; level < out.mipLevels; level++) {
+				ImageRegion region;
+				region.bufferOffset	  = offset;
+				region.mipLevel		  = level;
+				region.baseArrayLayer = layer;
+				region.layerCount	  = 1;
+				out.regions.push_back(region);
+				out.fileOffsets.push_back(dataOffset + offset);
+				offset += getMipLevelSize(out.format, out.width, out.height, out.depth, level);
+			}
+		}
+		return true;
+	}
+
+} // namespace
+
+bool renderApi::isTextureContainerFile(const std::string& path) {
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open()) return false;
+
+	uint8_t signature[sizeof(kKtx2Identifier)] = {};
+	file.read(reinterpret_cast<char*>(signature), sizeof(signature));
+	return memcmp(signature, kKtx2Identifier, sizeof(kKtx2Identifier)) == 0 || memcmp(signature, kDdsMagic, sizeof(kDdsMagic)) == 0;
+}
+
+bool renderApi::readTextureContainer(const std::string& path, TextureContainer& out, std::string& error, bool headerOnly) {
+	out = TextureContainer{};
+
+	std::vector<uint8_t> file;
+	uint64_t			 fileSize = 0;
+	if (!readFile(path, headerOnly, file, fileSize)) {
+		error = "can't read file";
+		return false;
+	}
+
+	if (file.size() >= sizeof(kKtx2Identifier) && memcmp(file.data(), kKtx2Identifier, sizeof(kKtx2Identifier)) == 0) {
+		return parseKtx2(file, fileSize, headerOnly, out, error);
+	}
+	if (file.size() >= sizeof(kDdsMagic) && memcmp(file.data(), kDdsMagic, sizeof(kDdsMagic)) == 0) {
+		return parseDds(file, fileSize, headerOnly, out, error);
+	}
+
+	error = "not a KTX2 or DDS file";
+	return false;
+}
@@ -0,0 +1,39 @@
+#ifndef TEXTURE_CONTAINER_HPP
+#define TEXTURE_CONTAINER_HPP
+
+#include "image.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+namespace renderApi {
+
+	// Every mip level and layer of a KTX2 or DDS file, kept in the stored format so that block
+	// compressed (BC1-BC7) data goes to the GPU as is. Regions point into data and cover it all;
+	// fileOffsets gives where the data of each region is in the file.
+	struct TextureContainer {
+		VkFormat				 format		 = VK_FORMAT_UNDEFINED;
+		ImageType				 type		 = ImageType::IMAGE_2D;
+		uint32_t				 width		 = 1;
+		uint32_t				 height		 = 1;
+		uint32_t				 depth		 = 1;
+		uint32_t				 mipLevels	 = 1;
+		uint32_t				 arrayLayers = 1; // Six per cube, faces included
+		std::vector<uint8_t>	 data;
+		std::vector<ImageRegion> regions;
+		std::vector<uint64_t>	 fileOffsets;
+	};
+
+	// Looks at the file signature only
+	bool isTextureContainerFile(const std::string& path);
+
+	// KTX2 without supercompression, and DDS with either a DX10 header or a legacy DXTn/ATIn/BCn or
+	// 32-bit RGBA pixel format. With headerOnly, data stays empty for the caller to read regions from
+	// the file later. On failure error says why.
+	bool readTextureContainer(const std::string& path, TextureContainer& out, std::string& error, bool headerOnly = false);
+
+} // namespace renderApi
+
+#endif
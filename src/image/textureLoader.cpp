@@ -0,0 +1,343 @@
+#include "textureLoader.hpp"
+
+#include "renderDevice.hpp"
+#include "textureContainer.hpp"
+
+// Workers decode in parallel, so stbi_failure_reason() must report their own failure
+#define STBI_THREAD_LOCAL thread_local
+#define STB_IMAGE_IMPLEMENTATION
+#include "../../external/stb_image.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+using namespace renderApi;
+
+namespace {
+
+	struct DecodedImage {
+		size_t			 index = 0;
+		TextureContainer texture; // stb images become one level of one layer
+		std::string		 error;
+	};
+
+	// Truncating float to half conversion; values past the half range become infinity
+	uint16_t toHalf(float value) {
+		uint32_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+
+		uint16_t sign	  = static_cast<uint16_t>((bits >> 16) & 0x8000);
+		int32_t	 exponent = static_cast<int32_t>((bits >> 23) & 0xff);
+		uint32_t mantissa = bits & 0x7fffff;
+
+		if (exponent == 0xff) return sign | 0x7c00 | (mantissa ? 0x200 : 0);
+
+		exponent += 15 - 127;
+		if (exponent >= 31) return sign | 0x7c00;
+		if (exponent <= 0) {
+			if (exponent < -10) return sign;
+			return sign | static_cast<uint16_t>((mantissa | 0x800000) >> (14 - exponent));
+		}
+		return sign | static_cast<uint16_t>(exponent << 10) | static_cast<uint16_t>(mantissa >> 13);
+	}
+
+	DecodedImage decode(const std::string& path, bool srgb) {
+		DecodedImage image;
+
+		// Pre-compressed textures keep their format and mips
+		if (isTextureContainerFile(path)) {
+			readTextureContainer(path, image.texture, image.error);
+			return image;
+		}
+
+		TextureContainer& texture = image.texture;
+		int				  width = 0, height = 0, channels = 0;
+
+		if (stbi_is_hdr(path.c_str())) {
+			float* data = stbi_loadf(path.c_str(), &width, &height, &channels, 4);
+			if (data) {
+				// Half floats: half the size, and linear filtering and blits are guaranteed for them
+				size_t count = static_cast<size_t>(width) * height * 4;
+				texture.data.resize(count * sizeof(uint16_t));
+				uint16_t* dst = reinterpret_cast<uint16_t*>(texture.data.data());
+				for (size_t i = 0; i < count; i++) {
+					dst[i] = toHalf(data[i]);
+				}
+				texture.format = VK_FORMAT_R16G16B16A16_SFLOAT;
+				stbi_image_free(data);
+			}
+		} else {
+			stbi_uc* data = stbi_load(path.c_str(), &width, &height, &channels, 4);
+			if (data) {
+				texture.data.assign(data, data + static_cast<size_t>(width) * height * 4);
+				texture.format = srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+				stbi_image_free(data);
+			}
+		}
+
+		if (texture.data.empty()) {
+			const char* reason = stbi_failure_reason();
+			image.error		   = reason ? reason : "unknown error";
+			return image;
+		}
+
+		texture.width  = static_cast<uint32_t>(width);
+		texture.height = static_cast<uint32_t>(height);
+		texture.regions.push_back(ImageRegion{});
+		return image;
+	}
+
+	// Records the upload and mip generation of each texture in its own command buffer and keeps a
+	// few of them in flight, so the GPU works while the next image is prepared
+	class TextureUploader {
+	  public:
+		static constexpr uint32_t kMaxInFlight = 4;
+
+		explicit TextureUploader(device::GPU* gpu) : gpu_(gpu), queue_(VK_NULL_HANDLE), commandPool_(VK_NULL_HANDLE), next_(0) {
+			// Blits need a graphics queue
+			if (gpu_->graphicsQueues.empty() || gpu_->queueFamilies.graphicsFamily < 0) return;
+
+			VkCommandPoolCreateInfo poolInfo{};
+			poolInfo.sType			  = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+			poolInfo.queueFamilyIndex = static_cast<uint32_t>(gpu_->queueFamilies.graphicsFamily);
+			poolInfo.flags			  = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+			if (vkCreateCommandPool(gpu_->device, &poolInfo, nullptr, &commandPool_) != VK_SUCCESS) {
+				commandPool_ = VK_NULL_HANDLE;
+				return;
+			}
+
+			for (auto& slot : slots_) {
+				VkCommandBufferAllocateInfo allocInfo{};
+				allocInfo.sType				 = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+				allocInfo.commandPool		 = commandPool_;
+				allocInfo.level				 = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+				allocInfo.commandBufferCount = 1;
+				vkAllocateCommandBuffers(gpu_->device, &allocInfo, &slot.commandBuffer);
+
+				VkFenceCreateInfo fenceInfo{};
+				fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+				vkCreateFence(gpu_->device, &fenceInfo, nullptr, &slot.fence);
+			}
+			queue_ = gpu_->graphicsQueues[0];
+		}
+
+		~TextureUploader() {
+			for (auto& slot : slots_) {
+				wait(slot);
+				if (slot.fence != VK_NULL_HANDLE) vkDestroyFence(gpu_->device, slot.fence, nullptr);
+			}
+			if (commandPool_ != VK_NULL_HANDLE) vkDestroyCommandPool(gpu_->device, commandPool_, nullptr);
+		}
+
+		bool isValid() const { return queue_ != VK_NULL_HANDLE; }
+
+		bool upload(Texture& texture, const TextureContainer& decoded, bool generateMipmaps) {
+			if (isCompressedFormat(decoded.format) && findSupportedFormat(gpu_, {decoded.format}) == VK_FORMAT_UNDEFINED) {
+				std::cerr << "loadTextures: Compressed format " << decoded.format << " is not supported by the device" << std::endl;
+				return false;
+			}
+
+			Slot& slot = slots_[next_];
+			next_	   = (next_ + 1) % kMaxInFlight;
+			wait(slot);
+
+			// Files that bring their own mips keep them; blocks and volumes can't be blitted. Blits rather
+			// than MipGenerator: its views and sets live until every command buffer recorded completed,
+			// while slots here stay in flight, and it needs storage image support for the format.
+			bool generate = generateMipmaps && decoded.mipLevels == 1 && !isCompressedFormat(decoded.format) && decoded.type != ImageType::IMAGE_3D;
+
+			ImageCreateInfo imageInfo{};
+			imageInfo.width		  = decoded.width;
+			imageInfo.height	  = decoded.height;
+			imageInfo.depth		  = decoded.depth;
+			imageInfo.arrayLayers = decoded.arrayLayers;
+			imageInfo.format	  = decoded.format;
+			imageInfo.usage		  = ImageUsage::TEXTURE;
+			imageInfo.type		  = decoded.type;
+			imageInfo.mipLevels	  = generate ? static_cast<uint32_t>(std::floor(std::log2(std::max(decoded.width, decoded.height)))) + 1 : decoded.mipLevels;
+
+			SamplerCreateInfo samplerInfo{};
+			samplerInfo.enableAnisotropy = true;
+			samplerInfo.maxAnisotropy	 = 16.0f;
+
+			if (!texture.create(gpu_, imageInfo, samplerInfo)) return false;
+
+			slot.staging = gpu_->stagingPool.acquire(decoded.data.size());
+			if (!slot.staging.isValid()) {
+				texture.destroy();
+				return false;
+			}
+			memcpy(slot.staging.data, decoded.data.data(), decoded.data.size());
+
+			std::vector<VkBufferImageCopy> copies;
+			copies.reserve(decoded.regions.size());
+			for (const auto& region : decoded.regions) {
+				VkBufferImageCopy copy{};
+				copy.bufferOffset					 = slot.staging.offset + region.bufferOffset;
+				copy.imageSubresource.aspectMask	 = VK_IMAGE_ASPECT_COLOR_BIT;
+				copy.imageSubresource.mipLevel		 = region.mipLevel;
+				copy.imageSubresource.baseArrayLayer = region.baseArrayLayer;
+				copy.imageSubresource.layerCount	 = region.layerCount;
+				copy.imageExtent					 = {std::max(1u, decoded.width >> region.mipLevel), std::max(1u, decoded.height >> region.mipLevel),
+														std::max(1u, decoded.depth >> region.mipLevel)};
+				copies.push_back(copy);
+			}
+
+			VkCommandBufferBeginInfo beginInfo{};
+			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+			// Held until wait() saw the fence, so the defragmenter leaves the image alone meanwhile
+			gpu_->lockUploads();
+
+			VkCommandBuffer cmd = slot.commandBuffer;
+			vkResetCommandBuffer(cmd, 0);
+			vkBeginCommandBuffer(cmd, &beginInfo);
+
+			Image& image = texture.getImage();
+			image.transitionLayout(cmd, ImageLayout::TRANSFER_DST);
+
+			vkCmdCopyBufferToImage(cmd, slot.staging.buffer, image.getHandle(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(copies.size()),
+								   copies.data());
+
+			if (generate) {
+				image.generateMipmaps(cmd);
+			} else {
+				image.transitionLayout(cmd, ImageLayout::SHADER_READ_ONLY);
+			}
+
+			vkEndCommandBuffer(cmd);
+
+			VkSubmitInfo submitInfo{};
+			submitInfo.sType			  = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+			submitInfo.commandBufferCount = 1;
+			submitInfo.pCommandBuffers	  = &cmd;
+
+			std::lock_guard<std::mutex> lock(gpu_->queueMutex);
+			if (vkQueueSubmit(queue_, 1, &submitInfo, slot.fence) != VK_SUCCESS) {
+				gpu_->unlockUploads();
+				gpu_->stagingPool.release(slot.staging);
+				slot.staging = memory::StagingAllocation{};
+				texture.destroy();
+				return false;
+			}
+			slot.pending = true;
+			return true;
+		}
+
+	  private:
+		struct Slot {
+			VkCommandBuffer			  commandBuffer = VK_NULL_HANDLE;
+			VkFence					  fence			= VK_NULL_HANDLE;
+			memory::StagingAllocation staging;
+			bool					  pending = false;
+		};
+
+		device::GPU*					gpu_;
+		VkQueue							queue_;
+		VkCommandPool					commandPool_;
+		std::array<Slot, kMaxInFlight>	slots_;
+		uint32_t						next_;
+
+		// The fence is owned here, so the staging chunk goes back to the pool as idle
+		void wait(Slot& slot) {
+			if (slot.pending) {
+				vkWaitForFences(gpu_->device, 1, &slot.fence, VK_TRUE, UINT64_MAX);
+				vkResetFences(gpu_->device, 1, &slot.fence);
+				slot.pending = false;
+				gpu_->unlockUploads();
+			}
+			if (slot.staging.isValid()) {
+				gpu_->stagingPool.release(slot.staging);
+				slot.staging = memory::StagingAllocation{};
+			}
+		}
+	};
+
+} // namespace
+
+std::vector<Texture> renderApi::loadTextures(device::GPU* gpu, const std::vector<std::string>& paths, bool generateMipmaps, bool srgb, uint32_t threadCount) {
+	std::vector<Texture> textures(paths.size());
+	if (!gpu || !gpu->device || paths.empty()) return textures;
+
+	TextureUploader uploader(gpu);
+	if (!uploader.isValid()) {
+		std::cerr << "loadTextures: No graphics queue to upload with" << std::endl;
+		return textures;
+	}
+
+	// Decodes that started and were not uploaded yet; workers stop there so memory stays bounded
+	// when decoding outpaces the uploads
+	constexpr size_t kMaxPending = 2 * TextureUploader::kMaxInFlight;
+
+	std::mutex				 mutex;
+	std::condition_variable	 decodedReady;
+	std::condition_variable	 decodedTaken;
+	std::deque<DecodedImage> decoded;
+	size_t					 pending = 0;
+	std::atomic<size_t>		 nextPath{0};
+
+	uint32_t workerCount = threadCount > 0 ? threadCount : std::max(1u, std::thread::hardware_concurrency());
+	workerCount			 = static_cast<uint32_t>(std::min<size_t>(workerCount, paths.size()));
+
+	std::vector<std::thread> workers;
+	workers.reserve(workerCount);
+	for (uint32_t i = 0; i < workerCount; i++) {
+		workers.emplace_back([&]() {
+			for (size_t index = nextPath++; index < paths.size(); index = nextPath++) {
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					decodedTaken.wait(lock, [&]() { return pending < kMaxPending; });
+					pending++;
+				}
+
+				DecodedImage image = decode(paths[index], srgb);
+				image.index		   = index;
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					decoded.push_back(std::move(image));
+				}
+				decodedReady.notify_one();
+			}
+		});
+	}
+
+	// Upload in order of completion while the workers keep decoding
+	for (size_t uploaded = 0; uploaded < paths.size(); uploaded++) {
+		DecodedImage image;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			decodedReady.wait(lock, [&]() { return !decoded.empty(); });
+			image = std::move(decoded.front());
+			decoded.pop_front();
+			pending--;
+		}
+		decodedTaken.notify_one();
+
+		if (!image.error.empty()) {
+			std::cerr << "loadTextures: Failed to load " << paths[image.index] << ": " << image.error << std::endl;
+			continue;
+		}
+		if (!uploader.upload(textures[image.index], image.texture, generateMipmaps)) {
+			std::cerr << "loadTextures: Failed to upload " << paths[image.index] << std::endl;
+		}
+	}
+
+	for (auto& worker : workers) {
+		worker.join();
+	}
+
+	return textures;
+}
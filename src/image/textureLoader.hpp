@@ -0,0 +1,29 @@
+#ifndef TEXTURE_LOADER_HPP
+#define TEXTURE_LOADER_HPP
+
+#include "image.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace renderApi {
+
+	// Loads every file supported by stb_image, and KTX2/DDS files, into a Texture, in the order of
+	// paths. Files are decoded on threadCount worker threads (0: one per core) while the calling
+	// thread uploads the ones already decoded and generates their mips, with several uploads in
+	// flight on the GPU. The workers stay at most a few images ahead of the uploads.
+	//
+	// 8-bit images become VK_FORMAT_R8G8B8A8_UNORM (or _SRGB), HDR images VK_FORMAT_R16G16B16A16_SFLOAT.
+	// KTX2/DDS files keep their format, BC1-BC7 included, along with their mips, layers and faces;
+	// mips are only generated for uncompressed files holding a single level.
+	// A file that fails to load leaves an invalid Texture at its index.
+	std::vector<Texture> loadTextures(device::GPU*					  gpu,
+									  const std::vector<std::string>& paths,
+									  bool							  generateMipmaps = true,
+									  bool							  srgb			  = false,
+									  uint32_t						  threadCount	  = 0);
+
+} // namespace renderApi
+
+#endif
@@ -0,0 +1,476 @@
+#include "textureStreamer.hpp"
+
+#include "renderDevice.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+using namespace renderApi;
+
+namespace {
+
+	// Levels being read or waiting for an upload slot
+	constexpr uint32_t kMaxPendingLoads = TextureStreamer::kMaxUploads * 2;
+
+} // namespace
+
+// ============================================================================
+// TextureStreamer Implementation
+// ============================================================================
+
+TextureStreamer::TextureStreamer()
+	: gpu_(nullptr), queue_(VK_NULL_HANDLE), commandPool_(VK_NULL_HANDLE), residentBytes_(0), pendingGrowth_(0), pendingShrink_(0),
+	  stopping_(false) {}
+
+TextureStreamer::~TextureStreamer() { destroy(); }
+
+bool TextureStreamer::create(device::GPU* gpu, const TextureStreamerInfo& info) {
+	destroy();
+
+	if (!gpu || !gpu->device) {
+		std::cerr << "TextureStreamer: GPU not initialized" << std::endl;
+		return false;
+	}
+	if (gpu->graphicsQueues.empty() || gpu->queueFamilies.graphicsFamily < 0) {
+		std::cerr << "TextureStreamer: No graphics queue to upload with" << std::endl;
+		return false;
+	}
+	gpu_  = gpu;
+	info_ = info;
+
+	VkCommandPoolCreateInfo poolInfo{};
+	poolInfo.sType			  = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.queueFamilyIndex = static_cast<uint32_t>(gpu_->queueFamilies.graphicsFamily);
+	poolInfo.flags			  = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+	if (vkCreateCommandPool(gpu_->device, &poolInfo, nullptr, &commandPool_) != VK_SUCCESS) {
+		std::cerr << "TextureStreamer: Failed to create command pool" << std::endl;
+		commandPool_ = VK_NULL_HANDLE;
+		return false;
+	}
+
+	for (auto& upload : uploads_) {
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType				 = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool		 = commandPool_;
+		allocInfo.level				 = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandBufferCount = 1;
+
+		VkFenceCreateInfo fenceInfo{};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+		if (vkAllocateCommandBuffers(gpu_->device, &allocInfo, &upload.commandBuffer) != VK_SUCCESS ||
+			vkCreateFence(gpu_->device, &fenceInfo, nullptr, &upload.fence) != VK_SUCCESS) {
+			std::cerr << "TextureStreamer: Failed to create upload slots" << std::endl;
+			destroy();
+			return false;
+		}
+	}
+	queue_ = gpu_->graphicsQueues[0];
+
+	stopping_ = false;
+	worker_	  = std::thread(&TextureStreamer::workerLoop, this);
+	return true;
+}
+
+void TextureStreamer::destroy() {
+	if (worker_.joinable()) {
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			stopping_ = true;
+		}
+		requestReady_.notify_all();
+		worker_.join();
+	}
+	requests_.clear();
+	completed_.clear();
+
+	if (!gpu_) return;
+
+	for (auto& upload : uploads_) {
+		if (upload.pending) {
+			vkWaitForFences(gpu_->device, 1, &upload.fence, VK_TRUE, UINT64_MAX);
+			upload.pending = false;
+			gpu_->unlockUploads();
+		}
+		if (upload.staging.isValid()) {
+			gpu_->stagingPool.release(upload.staging);
+			upload.staging = memory::StagingAllocation{};
+		}
+		upload.image.destroy();
+		if (upload.fence != VK_NULL_HANDLE) vkDestroyFence(gpu_->device, upload.fence, nullptr);
+		upload.fence		 = VK_NULL_HANDLE;
+		upload.commandBuffer = VK_NULL_HANDLE;
+	}
+	if (commandPool_ != VK_NULL_HANDLE) {
+		vkDestroyCommandPool(gpu_->device, commandPool_, nullptr);
+		commandPool_ = VK_NULL_HANDLE;
+	}
+
+	entries_.clear();
+	residentBytes_ = 0;
+	pendingGrowth_ = 0;
+	pendingShrink_ = 0;
+	queue_		   = VK_NULL_HANDLE;
+	gpu_		   = nullptr;
+}
+
+VkDeviceSize TextureStreamer::getLevelBytes(const Entry& entry, uint32_t level) const {
+	const TextureContainer& header = entry.header;
+	return getMipLevelSize(header.format, header.width, header.height, header.depth, level) * header.arrayLayers;
+}
+
+VkDeviceSize TextureStreamer::getChainBytes(const Entry& entry, uint32_t topLevel) const {
+	VkDeviceSize bytes = 0;
+	for (uint32_t level = topLevel; level < entry.header.mipLevels; level++) {
+		bytes += getLevelBytes(entry, level);
+	}
+	return bytes;
+}
+
+ImageCreateInfo TextureStreamer::getImageInfo(const Entry& entry, uint32_t topLevel) const {
+	const TextureContainer& header = entry.header;
+
+	ImageCreateInfo info{};
+	info.width		 = std::max(1u, header.width >> topLevel);
+	info.height		 = std::max(1u, header.height >> topLevel);
+	info.depth		 = std::max(1u, header.depth >> topLevel);
+	info.mipLevels	 = header.mipLevels - topLevel;
+	info.arrayLayers = header.arrayLayers;
+	info.format		 = header.format;
+	info.type		 = header.type;
+	info.usage		 = ImageUsage::TEXTURE;
+	return info;
+}
+
+bool TextureStreamer::readLevels(LevelData& levels) const {
+	const Entry&			entry  = *levels.entry;
+	const TextureContainer& header = entry.header;
+
+	std::ifstream file(entry.path, std::ios::binary);
+	if (!file.is_open()) return false;
+
+	levels.data.resize(getChainBytes(entry, levels.topLevel));
+	levels.regions.clear();
+
+	VkDeviceSize offset = 0;
+	for (size_t i = 0; i < header.regions.size(); i++) {
+		ImageRegion region = header.regions[i];
+		if (region.mipLevel < levels.topLevel) continue;
+
+		VkDeviceSize size = getMipLevelSize(header.format, header.width, header.height, header.depth, region.mipLevel) * region.layerCount;
+		file.seekg(static_cast<std::streamoff>(header.fileOffsets[i]));
+		if (!file.read(reinterpret_cast<char*>(levels.data.data() + offset), static_cast<std::streamsize>(size))) return false;
+
+		region.bufferOffset = offset;
+		region.mipLevel -= levels.topLevel;
+		levels.regions.push_back(region);
+		offset += size;
+	}
+	return true;
+}
+
+TextureStreamer::TextureId TextureStreamer::add(const std::string& path, const SamplerCreateInfo& samplerInfo) {
+	if (!isValid()) return kInvalidTexture;
+
+	auto		entry = std::make_unique<Entry>();
+	std::string error;
+	if (!readTextureContainer(path, entry->header, error, true)) {
+		std::cerr << "TextureStreamer: Failed to read " << path << ": " << error << std::endl;
+		return kInvalidTexture;
+	}
+
+	const TextureContainer& header = entry->header;
+	if (isCompressedFormat(header.format) && findSupportedFormat(gpu_, {header.format}) == VK_FORMAT_UNDEFINED) {
+		std::cerr << "TextureStreamer: Format of " << path << " is not supported by the device" << std::endl;
+		return kInvalidTexture;
+	}
+
+	uint32_t tailLevel = 0;
+	while (tailLevel + 1 < header.mipLevels && std::max(header.width >> tailLevel, header.height >> tailLevel) > info_.tailSize) {
+		tailLevel++;
+	}
+
+	entry->id			 = static_cast<TextureId>(entries_.size());
+	entry->path			 = path;
+	entry->tailLevel	 = tailLevel;
+	entry->residentLevel = tailLevel;
+
+	LevelData levels;
+	levels.entry	= entry.get();
+	levels.topLevel = tailLevel;
+	if (!readLevels(levels)) {
+		std::cerr << "TextureStreamer: Failed to read the levels of " << path << std::endl;
+		return kInvalidTexture;
+	}
+
+	if (!entry->texture.create(gpu_, getImageInfo(*entry, tailLevel), samplerInfo) ||
+		!entry->texture.getImage().uploadRegions(levels.data.data(), levels.data.size(), levels.regions)) {
+		std::cerr << "TextureStreamer: Failed to upload " << path << std::endl;
+		return kInvalidTexture;
+	}
+
+	residentBytes_ += levels.data.size();
+	entries_.push_back(std::move(entry));
+	return entries_.back()->id;
+}
+
+void TextureStreamer::setPriority(TextureId id, float priority) {
+	if (id < entries_.size()) entries_[id]->priority = priority;
+}
+
+void TextureStreamer::setScreenSize(TextureId id, float pixels) {
+	if (id >= entries_.size()) return;
+
+	Entry&	 entry = *entries_[id];
+	uint32_t size  = std::max(entry.header.width, entry.header.height);
+	if (pixels <= 0.0f || pixels >= static_cast<float>(size)) {
+		entry.wantedLevel = 0;
+		return;
+	}
+	uint32_t level	  = static_cast<uint32_t>(std::floor(std::log2(static_cast<float>(size) / pixels)));
+	entry.wantedLevel = std::min(level, entry.tailLevel);
+}
+
+Texture* TextureStreamer::getTexture(TextureId id) { return id < entries_.size() ? &entries_[id]->texture : nullptr; }
+
+uint32_t TextureStreamer::getResidentLevel(TextureId id) const { return id < entries_.size() ? entries_[id]->residentLevel : kNoLevel; }
+
+bool TextureStreamer::isUnderPressure() const {
+	for (const auto& heap : gpu_->allocator.getHeapBudgets()) {
+		if (heap.deviceLocal && heap.budget > 0 && static_cast<float>(heap.usage) > static_cast<float>(heap.budget) * info_.pressureRatio) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void TextureStreamer::trackPending(const Entry& entry, uint32_t topLevel, bool add) {
+	VkDeviceSize  current = getChainBytes(entry, entry.residentLevel);
+	VkDeviceSize  next	  = getChainBytes(entry, topLevel);
+	VkDeviceSize& total	  = next > current ? pendingGrowth_ : pendingShrink_;
+	VkDeviceSize  delta	  = next > current ? next - current : current - next;
+	total				  = add ? total + delta : total - delta;
+}
+
+void TextureStreamer::request(TextureId id, uint32_t topLevel) {
+	Entry& entry	   = *entries_[id];
+	entry.pendingLevel = topLevel;
+	trackPending(entry, topLevel, true);
+
+	LevelData levels;
+	levels.entry	= &entry;
+	levels.topLevel = topLevel;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		requests_.push_back(std::move(levels));
+	}
+	requestReady_.notify_one();
+}
+
+void TextureStreamer::workerLoop() {
+	for (;;) {
+		LevelData levels;
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			requestReady_.wait(lock, [&]() { return stopping_ || !requests_.empty(); });
+			if (stopping_) return;
+			levels = std::move(requests_.front());
+			requests_.pop_front();
+		}
+
+		levels.failed = !readLevels(levels);
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		completed_.push_back(std::move(levels));
+	}
+}
+
+void TextureStreamer::update() {
+	if (!isValid()) return;
+
+	finishUploads(false);
+	startUploads();
+	evict();
+	loadLevels();
+}
+
+void TextureStreamer::finishUploads(bool wait) {
+	for (auto& upload : uploads_) {
+		if (!upload.pending) continue;
+		if (wait) {
+			vkWaitForFences(gpu_->device, 1, &upload.fence, VK_TRUE, UINT64_MAX);
+		} else if (vkGetFenceStatus(gpu_->device, upload.fence) != VK_SUCCESS) {
+			continue;
+		}
+		vkResetFences(gpu_->device, 1, &upload.fence);
+		upload.pending = false;
+		gpu_->unlockUploads();
+
+		// The fence is ours, so the staging chunk is idle
+		gpu_->stagingPool.release(upload.staging);
+		upload.staging = memory::StagingAllocation{};
+
+		Entry& entry = *entries_[upload.id];
+		trackPending(entry, upload.topLevel, false);
+
+		entry.texture.getImage().replace(std::move(upload.image));
+		residentBytes_		= residentBytes_ - getChainBytes(entry, entry.residentLevel) + getChainBytes(entry, upload.topLevel);
+		entry.residentLevel = upload.topLevel;
+		entry.pendingLevel	= kNoLevel;
+	}
+}
+
+void TextureStreamer::startUploads() {
+	for (auto& upload : uploads_) {
+		if (upload.pending) continue;
+
+		LevelData levels;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			if (completed_.empty()) return;
+			levels = std::move(completed_.front());
+			completed_.pop_front();
+		}
+
+		Entry& entry = *entries_[levels.entry->id];
+		if (levels.failed || !upload.image.create(gpu_, getImageInfo(entry, levels.topLevel))) {
+			std::cerr << "TextureStreamer: Failed to load level " << levels.topLevel << " of " << entry.path << std::endl;
+			trackPending(entry, levels.topLevel, false);
+			entry.pendingLevel = kNoLevel;
+			continue;
+		}
+
+		upload.staging = gpu_->stagingPool.acquire(levels.data.size());
+		if (!upload.staging.isValid()) {
+			// Try again next frame
+			upload.image.destroy();
+			std::lock_guard<std::mutex> lock(mutex_);
+			completed_.push_front(std::move(levels));
+			return;
+		}
+		memcpy(upload.staging.data, levels.data.data(), levels.data.size());
+
+		std::vector<VkBufferImageCopy> copies;
+		copies.reserve(levels.regions.size());
+		for (const auto& region : levels.regions) {
+			VkBufferImageCopy copy{};
+			copy.bufferOffset					 = upload.staging.offset + region.bufferOffset;
+			copy.imageSubresource.aspectMask	 = VK_IMAGE_ASPECT_COLOR_BIT;
+			copy.imageSubresource.mipLevel		 = region.mipLevel;
+			copy.imageSubresource.baseArrayLayer = region.baseArrayLayer;
+			copy.imageSubresource.layerCount	 = region.layerCount;
+			copy.imageExtent					 = {std::max(1u, upload.image.getWidth() >> region.mipLevel),
+													std::max(1u, upload.image.getHeight() >> region.mipLevel),
+													std::max(1u, upload.image.getDepth() >> region.mipLevel)};
+			copies.push_back(copy);
+		}
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		// Held while the upload is pending; the defragmenter could move the new image otherwise
+		gpu_->lockUploads();
+
+		VkCommandBuffer cmd = upload.commandBuffer;
+		vkResetCommandBuffer(cmd, 0);
+		vkBeginCommandBuffer(cmd, &beginInfo);
+		upload.image.transitionLayout(cmd, ImageLayout::TRANSFER_DST);
+		vkCmdCopyBufferToImage(cmd, upload.staging.buffer, upload.image.getHandle(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+							   static_cast<uint32_t>(copies.size()), copies.data());
+		upload.image.transitionLayout(cmd, ImageLayout::SHADER_READ_ONLY);
+		vkEndCommandBuffer(cmd);
+
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType			  = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers	  = &cmd;
+
+		VkResult result;
+		{
+			std::lock_guard<std::mutex> lock(gpu_->queueMutex);
+			result = vkQueueSubmit(queue_, 1, &submitInfo, upload.fence);
+		}
+		if (result != VK_SUCCESS) {
+			std::cerr << "TextureStreamer: Failed to submit the upload of " << entry.path << std::endl;
+			gpu_->unlockUploads();
+			gpu_->stagingPool.release(upload.staging);
+			upload.staging = memory::StagingAllocation{};
+			upload.image.destroy();
+			trackPending(entry, levels.topLevel, false);
+			entry.pendingLevel = kNoLevel;
+			continue;
+		}
+
+		upload.id		= entry.id;
+		upload.topLevel = levels.topLevel;
+		upload.pending	= true;
+	}
+}
+
+void TextureStreamer::evict() {
+	VkDeviceSize projected = residentBytes_ + pendingGrowth_ - std::min(residentBytes_ + pendingGrowth_, pendingShrink_);
+	bool		 pressure  = isUnderPressure();
+	if (projected <= info_.budget && !pressure) return;
+
+	std::vector<Entry*> candidates;
+	for (auto& entry : entries_) {
+		if (entry->pendingLevel == kNoLevel && entry->residentLevel < entry->tailLevel) candidates.push_back(entry.get());
+	}
+
+	// Levels finer than needed go first, then the least important textures
+	std::sort(candidates.begin(), candidates.end(), [](const Entry* a, const Entry* b) {
+		bool aFiner = a->residentLevel < a->wantedLevel;
+		bool bFiner = b->residentLevel < b->wantedLevel;
+		if (aFiner != bFiner) return aFiner;
+		return a->priority < b->priority;
+	});
+
+	for (Entry* entry : candidates) {
+		if (!pressure && projected <= info_.budget) break;
+
+		projected -= std::min(projected, getLevelBytes(*entry, entry->residentLevel));
+		request(entry->id, entry->residentLevel + 1);
+
+		// Heap usage only drops once the old image is retired: one level per frame
+		pressure = false;
+	}
+}
+
+void TextureStreamer::loadLevels() {
+	if (isUnderPressure()) return;
+
+	uint32_t			pending = 0;
+	std::vector<Entry*> candidates;
+	for (auto& entry : entries_) {
+		if (entry->pendingLevel != kNoLevel) {
+			pending++;
+		} else if (entry->wantedLevel < entry->residentLevel) {
+			candidates.push_back(entry.get());
+		}
+	}
+
+	// Most important first, then the ones furthest from what they need
+	std::sort(candidates.begin(), candidates.end(), [](const Entry* a, const Entry* b) {
+		if (a->priority != b->priority) return a->priority > b->priority;
+		return a->residentLevel - a->wantedLevel > b->residentLevel - b->wantedLevel;
+	});
+
+	for (Entry* entry : candidates) {
+		if (pending >= kMaxPendingLoads) break;
+
+		VkDeviceSize growth = getLevelBytes(*entry, entry->residentLevel - 1);
+		if (residentBytes_ + pendingGrowth_ + growth > info_.budget + pendingShrink_) continue;
+
+		request(entry->id, entry->residentLevel - 1);
+		pending++;
+	}
+}
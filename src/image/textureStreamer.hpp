@@ -0,0 +1,145 @@
+#ifndef TEXTURE_STREAMER_HPP
+#define TEXTURE_STREAMER_HPP
+
+#include "image.hpp"
+#include "stagingPool.hpp"
+#include "textureContainer.hpp"
+
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+namespace renderApi {
+
+	struct TextureStreamerInfo {
+		VkDeviceSize budget		   = 512ull * 1024 * 1024; // Device memory the streamed textures may use together
+		uint32_t	 tailSize	   = 128;				   // Levels this large or smaller are always resident
+		float		 pressureRatio = 0.9f;				   // Heap usage over budget that counts as memory pressure
+	};
+
+	// Streams the mip levels of KTX2/DDS textures so that large texture sets fit in device memory.
+	// add() loads the small levels of a texture right away; update() then loads finer levels in the
+	// background, highest priority first, as long as the budget allows, and evicts the finest levels
+	// of the least important textures when over budget or when the device heap is under pressure.
+	//
+	// A texture image only holds its resident levels: level 0 of the image is the finest resident
+	// level, so sampling never reaches a missing mip and evicted levels give their memory back. Each
+	// change of resident level swaps the image of the Texture, which bumps its generation so that
+	// descriptor sets pick up the new view; the old image is retired until the GPU is done with it.
+	// Levels are read from the file on a worker thread and the whole new chain is uploaded, so the
+	// old image is never touched while frames still sample it.
+	//
+	// Textures keep their address for the life of the streamer. add(), update() and the setters are
+	// called from the rendering thread.
+	class TextureStreamer {
+	  public:
+		using TextureId = uint32_t;
+
+		static constexpr TextureId kInvalidTexture = UINT32_MAX;
+		static constexpr uint32_t  kMaxUploads	   = 4;
+
+		TextureStreamer();
+		~TextureStreamer();
+
+		TextureStreamer(const TextureStreamer&)			   = delete;
+		TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+		bool create(device::GPU* gpu, const TextureStreamerInfo& info = {});
+		void destroy();
+
+		// Reads the header of a KTX2/DDS file and uploads its tail levels. Returns kInvalidTexture on failure.
+		TextureId add(const std::string& path, const SamplerCreateInfo& samplerInfo = {});
+
+		// Higher loads first and evicts last; 1 by default
+		void setPriority(TextureId id, float priority);
+		// Longest side of the texture on screen, in pixels: levels finer than needed are not loaded.
+		// 0 asks for the full resolution, which is the default.
+		void setScreenSize(TextureId id, float pixels);
+
+		// Once per frame: swaps in finished uploads, evicts over budget and starts new loads
+		void update();
+
+		Texture*	 getTexture(TextureId id);
+		// Finest resident level, in levels of the file
+		uint32_t	 getResidentLevel(TextureId id) const;
+		VkDeviceSize getResidentBytes() const { return residentBytes_; }
+		VkDeviceSize getBudget() const { return info_.budget; }
+		void		 setBudget(VkDeviceSize budget) { info_.budget = budget; }
+		bool		 isValid() const { return commandPool_ != VK_NULL_HANDLE; }
+
+	  private:
+		static constexpr uint32_t kNoLevel = UINT32_MAX;
+
+		struct Entry {
+			TextureId		 id = kInvalidTexture;
+			std::string		 path;
+			TextureContainer header;				// Data not loaded
+			Texture			 texture;
+			uint32_t		 residentLevel = 0;
+			uint32_t		 tailLevel	   = 0;		   // Levels from this one on are never evicted
+			uint32_t		 wantedLevel   = 0;
+			uint32_t		 pendingLevel  = kNoLevel; // Being read or uploaded
+			float			 priority	   = 1.0f;
+		};
+
+		// Levels from topLevel down to the smallest, read from the file
+		struct LevelData {
+			const Entry*			 entry	  = nullptr; // Only its path and header are read by the worker
+			uint32_t				 topLevel = 0;
+			std::vector<uint8_t>	 data;
+			std::vector<ImageRegion> regions; // Mip levels relative to topLevel
+			bool					 failed = false;
+		};
+
+		struct Upload {
+			VkCommandBuffer			  commandBuffer = VK_NULL_HANDLE;
+			VkFence					  fence			= VK_NULL_HANDLE;
+			memory::StagingAllocation staging;
+			TextureId				  id	   = kInvalidTexture;
+			uint32_t				  topLevel = 0;
+			Image					  image;
+			bool					  pending = false;
+		};
+
+		device::GPU*						gpu_;
+		TextureStreamerInfo					info_;
+		VkQueue								queue_;
+		VkCommandPool						commandPool_;
+		std::array<Upload, kMaxUploads>		uploads_;
+		std::vector<std::unique_ptr<Entry>> entries_;
+		VkDeviceSize						residentBytes_;
+		VkDeviceSize						pendingGrowth_; // Bytes the pending loads will add
+		VkDeviceSize						pendingShrink_; // Bytes the pending evictions will free
+
+		// Worker thread reading levels
+		std::thread			  worker_;
+		std::mutex			  mutex_;
+		std::condition_variable requestReady_;
+		std::deque<LevelData> requests_;
+		std::deque<LevelData> completed_;
+		bool				  stopping_;
+
+		VkDeviceSize getLevelBytes(const Entry& entry, uint32_t level) const;
+		VkDeviceSize getChainBytes(const Entry& entry, uint32_t topLevel) const;
+		ImageCreateInfo getImageInfo(const Entry& entry, uint32_t topLevel) const;
+		bool		 readLevels(LevelData& levels) const;
+		bool		 isUnderPressure() const;
+		void		 request(TextureId id, uint32_t topLevel);
+		void		 trackPending(const Entry& entry, uint32_t topLevel, bool add);
+		void		 finishUploads(bool wait);
+		void		 startUploads();
+		void		 evict();
+		void		 loadLevels();
+		void		 workerLoop();
+	};
+
+} // namespace renderApi
+
+#endif
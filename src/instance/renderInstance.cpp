@@ -103,13 +103,23 @@ InitDeviceResult RenderInstance::finishDeviceInitialization(GPU& gpu) {
 	if (!gpu.device) return VK_CREATE_DEVICE_FAILED;
 
 	gpu.queueFamilies = findQueueFamilies(gpu.physicalDevice);
+	uint32_t family	  = gpu.queueFamilies.graphicsFamily >= 0 ? gpu.queueFamilies.graphicsFamily : gpu.queueFamilies.computeFamily;
+
+	// Uploads on the transfer queue may write part of a buffer, which an ownership transfer would leave undefined elsewhere
+	gpu.bufferQueueFamilyCount = 0;
+	if (!gpu.transferQueues.empty() && gpu.queueFamilies.transferFamily >= 0 && static_cast<uint32_t>(gpu.queueFamilies.transferFamily) != family) {
+		gpu.bufferQueueFamilies[0] = family;
+		gpu.bufferQueueFamilies[1] = static_cast<uint32_t>(gpu.queueFamilies.transferFamily);
+		gpu.bufferQueueFamilyCount = 2;
+	}
+
+	if (!gpu.allocator.init(&gpu)) return VK_CREATE_DEVICE_FAILED;
 
-	VkCommandPoolCreateInfo poolInfo{};
-	poolInfo.sType			  = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-	poolInfo.queueFamilyIndex = gpu.queueFamilies.graphicsFamily >= 0 ? gpu.queueFamilies.graphicsFamily : gpu.queueFamilies.computeFamily;
-	poolInfo.flags			  = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+	// One-time commands complete before endOneTimeCommands() returns, so a single frame slot is enough
+	if (!gpu.oneTimeCommands.create(&gpu, family, 1)) return VK_CREATE_DEVICE_FAILED;
 
-	if (vkCreateCommandPool(gpu.device, &poolInfo, nullptr, &gpu.commandPool) != VK_SUCCESS) return VK_CREATE_DEVICE_FAILED;
+	if (!gpu.stagingPool.init(&gpu)) return VK_CREATE_DEVICE_FAILED;
+	if (!gpu.transfers.init(&gpu)) return VK_CREATE_DEVICE_FAILED;
 
 	return INIT_DEVICE_SUCCESS;
 }
@@ -218,6 +228,7 @@ InitDeviceResult RenderInstance::addGPU(const device::Config& config) {
 	VkPhysicalDeviceVulkan12Features vulkan12Features{};
 	vulkan12Features.sType				 = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
 	vulkan12Features.bufferDeviceAddress = VK_TRUE;
+	vulkan12Features.timelineSemaphore	 = VK_TRUE;
 	vulkan12Features.descriptorIndexing	 = VK_TRUE;
 	vulkan12Features.runtimeDescriptorArray = VK_TRUE;
 	vulkan12Features.descriptorBindingPartiallyBound = VK_TRUE;
@@ -229,8 +240,10 @@ InitDeviceResult RenderInstance::addGPU(const device::Config& config) {
 	meshShaderFeatures.meshShader = VK_FALSE;
 	meshShaderFeatures.taskShader = VK_FALSE;
 
-	bool	 meshShaderSupported = false;
-	uint32_t availableExtCount	 = 0;
+	bool	 meshShaderSupported		 = false;
+	bool	 memoryBudgetSupported		 = false;
+	bool	 externalMemoryHostSupported = false;
+	uint32_t availableExtCount			 = 0;
 	vkEnumerateDeviceExtensionProperties(gpu->physicalDevice, nullptr, &availableExtCount, nullptr);
 	std::vector<VkExtensionProperties> availableExts(availableExtCount);
 	vkEnumerateDeviceExtensionProperties(gpu->physicalDevice, nullptr, &availableExtCount, availableExts.data());
@@ -244,11 +257,25 @@ InitDeviceResult RenderInstance::addGPU(const device::Config& config) {
 			deviceExtensions.push_back(VK_EXT_MESH_SHADER_EXTENSION_NAME);
 			meshShaderSupported = true;
 		}
+		if (std::string(ext.extensionName) == VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) {
+			deviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+			memoryBudgetSupported = true;
+		}
+		if (std::string(ext.extensionName) == VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME) {
+			deviceExtensions.push_back(VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME);
+			externalMemoryHostSupported = true;
+		}
 	}
 
 	vulkan12Features.pNext = &meshShaderFeatures;
 
+	VkPhysicalDeviceFeatures supportedFeatures{};
+	vkGetPhysicalDeviceFeatures(gpu->physicalDevice, &supportedFeatures);
+
 	VkPhysicalDeviceFeatures  deviceFeatures{};
+	deviceFeatures.textureCompressionBC					 = supportedFeatures.textureCompressionBC;
+	deviceFeatures.shaderStorageImageWriteWithoutFormat = supportedFeatures.shaderStorageImageWriteWithoutFormat;
+
 	VkPhysicalDeviceFeatures2 deviceFeatures2{};
 	deviceFeatures2.sType	 = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
 	deviceFeatures2.pNext	 = &vulkan12Features;
@@ -268,7 +295,26 @@ InitDeviceResult RenderInstance::addGPU(const device::Config& config) {
 		return VK_CREATE_DEVICE_FAILED;
 	}
 
-	gpu->meshShaderSupported = meshShaderSupported && meshShaderFeatures.meshShader;
+	gpu->meshShaderSupported   = meshShaderSupported && meshShaderFeatures.meshShader;
+	gpu->memoryBudgetSupported = memoryBudgetSupported;
+	gpu->textureCompressionBCSupported = deviceFeatures.textureCompressionBC == VK_TRUE;
+	gpu->storageWriteWithoutFormatSupported = deviceFeatures.shaderStorageImageWriteWithoutFormat == VK_TRUE;
+	if (externalMemoryHostSupported) {
+		VkPhysicalDeviceExternalMemoryHostPropertiesEXT hostProperties{};
+		hostProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_MEMORY_HOST_PROPERTIES_EXT;
+
+		VkPhysicalDeviceProperties2 properties{};
+		properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+		properties.pNext = &hostProperties;
+		vkGetPhysicalDeviceProperties2(gpu->physicalDevice, &properties);
+
+		gpu->getMemoryHostPointerProperties =
+			(PFN_vkGetMemoryHostPointerPropertiesEXT)vkGetDeviceProcAddr(gpu->device, "vkGetMemoryHostPointerPropertiesEXT");
+		gpu->minImportedHostPointerAlignment = hostProperties.minImportedHostPointerAlignment;
+		gpu->externalMemoryHostSupported	 = gpu->getMemoryHostPointerProperties != nullptr;
+		// Leave most of the allocation count to the allocator's blocks
+		gpu->maxHostImports = properties.properties.limits.maxMemoryAllocationCount / 16;
+	}
 	if (meshShaderSupported) {
 		std::cout << "  Mesh Shader: " << (gpu->meshShaderSupported ? "supported" : "not supported by device") << std::endl;
 		if (!gpu->meshShaderSupported && meshShaderFeatures.taskShader) {
@@ -0,0 +1,96 @@
+#include "commandAllocator.hpp"
+
+#include "renderDevice.hpp"
+
+#include <iostream>
+#include <vulkan/vulkan_core.h>
+
+using namespace renderApi::memory;
+
+// ============================================================================
+// CommandAllocator Implementation
+// ============================================================================
+
+CommandAllocator::CommandAllocator() : gpu_(nullptr), frameIndex_(0) {}
+
+CommandAllocator::~CommandAllocator() { destroy(); }
+
+bool CommandAllocator::create(renderApi::device::GPU* gpu, uint32_t queueFamily, uint32_t frameCount) {
+	destroy();
+
+	if (!gpu || !gpu->device) {
+		std::cerr << "CommandAllocator: GPU not initialized" << std::endl;
+		return false;
+	}
+	if (frameCount == 0) {
+		std::cerr << "CommandAllocator: Invalid frame count" << std::endl;
+		return false;
+	}
+
+	gpu_ = gpu;
+
+	VkCommandPoolCreateInfo poolInfo{};
+	poolInfo.sType			  = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.queueFamilyIndex = queueFamily;
+	poolInfo.flags			  = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+	frames_.resize(frameCount);
+	for (FramePool& frame : frames_) {
+		if (vkCreateCommandPool(gpu_->device, &poolInfo, nullptr, &frame.pool) != VK_SUCCESS) {
+			std::cerr << "CommandAllocator: Failed to create command pool" << std::endl;
+			destroy();
+			return false;
+		}
+	}
+
+	frameIndex_ = 0;
+	return true;
+}
+
+void CommandAllocator::destroy() {
+	if (!gpu_ || !gpu_->device) return;
+
+	// Destroying a pool frees its command buffers
+	for (FramePool& frame : frames_) {
+		if (frame.pool != VK_NULL_HANDLE) vkDestroyCommandPool(gpu_->device, frame.pool, nullptr);
+	}
+	frames_.clear();
+	frameIndex_ = 0;
+}
+
+void CommandAllocator::beginFrame(uint32_t frameIndex) {
+	if (frames_.empty()) return;
+
+	frameIndex_		 = frameIndex % frames_.size();
+	FramePool& frame = frames_[frameIndex_];
+	if (frame.used[0] == 0 && frame.used[1] == 0) return;
+
+	// Keeps the pool's memory for the next recordings
+	vkResetCommandPool(gpu_->device, frame.pool, 0);
+	frame.used[0] = 0;
+	frame.used[1] = 0;
+}
+
+VkCommandBuffer CommandAllocator::allocate(VkCommandBufferLevel level) {
+	if (frames_.empty()) return VK_NULL_HANDLE;
+
+	FramePool&					  frame	  = frames_[frameIndex_];
+	size_t						  kind	  = level == VK_COMMAND_BUFFER_LEVEL_PRIMARY ? 0 : 1;
+	std::vector<VkCommandBuffer>& buffers = frame.buffers[kind];
+
+	if (frame.used[kind] == buffers.size()) {
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType				 = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool		 = frame.pool;
+		allocInfo.level				 = level;
+		allocInfo.commandBufferCount = 1;
+
+		VkCommandBuffer buffer = VK_NULL_HANDLE;
+		if (vkAllocateCommandBuffers(gpu_->device, &allocInfo, &buffer) != VK_SUCCESS) {
+			std::cerr << "CommandAllocator: Failed to allocate command buffer" << std::endl;
+			return VK_NULL_HANDLE;
+		}
+		buffers.push_back(buffer);
+	}
+	return buffers[frame.used[kind]++];
+}
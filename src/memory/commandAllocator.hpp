@@ -0,0 +1,52 @@
+#ifndef COMMAND_ALLOCATOR_HPP
+#define COMMAND_ALLOCATOR_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+namespace renderApi::device {
+	struct GPU;
+}
+
+namespace renderApi::memory {
+
+	// One transient command pool per frame in flight. Command buffers are handed out linearly from
+	// the current frame's pool and stay valid until beginFrame() comes back to that frame, which
+	// resets the whole pool at once; the caller must know the GPU is done with the frame that last
+	// used it. The buffers themselves are kept across resets, so a steady frame allocates nothing.
+	// Not thread safe: each recording thread needs its own allocator.
+	class CommandAllocator {
+	  public:
+		CommandAllocator();
+		~CommandAllocator();
+
+		CommandAllocator(const CommandAllocator&)			 = delete;
+		CommandAllocator& operator=(const CommandAllocator&) = delete;
+
+		bool create(device::GPU* gpu, uint32_t queueFamily, uint32_t frameCount);
+		void destroy();
+
+		void			beginFrame(uint32_t frameIndex);
+		VkCommandBuffer allocate(VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+
+		uint32_t getFrameIndex() const { return frameIndex_; }
+		uint32_t getFrameCount() const { return static_cast<uint32_t>(frames_.size()); }
+		bool	 isValid() const { return !frames_.empty(); }
+
+	  private:
+		struct FramePool {
+			VkCommandPool				 pool = VK_NULL_HANDLE;
+			std::vector<VkCommandBuffer> buffers[2]; // Primary, secondary
+			size_t						 used[2] = {0, 0};
+		};
+
+		device::GPU*		   gpu_;
+		std::vector<FramePool> frames_;
+		uint32_t			   frameIndex_;
+	};
+
+} // namespace renderApi::memory
+
+#endif
@@ -0,0 +1,325 @@
+#include "defragmenter.hpp"
+
+#include "buffer/buffer.hpp"
+#include "image/image.hpp"
+#include "renderDevice.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+using namespace renderApi::memory;
+
+namespace {
+
+	// Lets uploads proceed again once the step returned
+	struct RelocationLock {
+		renderApi::device::GPU* gpu;
+		~RelocationLock() { gpu->unlockRelocation(); }
+	};
+
+} // namespace
+
+// ============================================================================
+// Defragmenter Implementation
+// ============================================================================
+
+Defragmenter::Defragmenter()
+	: gpu_(nullptr), queue_(VK_NULL_HANDLE), commandPool_(VK_NULL_HANDLE), commandBuffer_(VK_NULL_HANDLE), fence_(VK_NULL_HANDLE), computeValue_(0),
+	  submitted_(false), complete_(false), maxBytesPerStep_(kDefaultMaxBytesPerStep) {}
+
+Defragmenter::~Defragmenter() { destroy(); }
+
+bool Defragmenter::create(renderApi::device::GPU* gpu) {
+	destroy();
+
+	if (!gpu || !gpu->device) {
+		std::cerr << "Defragmenter: GPU not initialized" << std::endl;
+		return false;
+	}
+
+	gpu_ = gpu;
+
+	// Copies go to the graphics queue so that they are ordered after the frames already submitted there
+	int family = gpu_->queueFamilies.graphicsFamily;
+	queue_	   = !gpu_->graphicsQueues.empty() ? gpu_->graphicsQueues[0] : VK_NULL_HANDLE;
+	if (queue_ == VK_NULL_HANDLE && !gpu_->computeQueues.empty()) {
+		family = gpu_->queueFamilies.computeFamily;
+		queue_ = gpu_->computeQueues[0];
+	}
+	if (queue_ == VK_NULL_HANDLE || family < 0) {
+		std::cerr << "Defragmenter: No graphics or compute queue" << std::endl;
+		return false;
+	}
+
+	VkCommandPoolCreateInfo poolInfo{};
+	poolInfo.sType			  = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.queueFamilyIndex = static_cast<uint32_t>(family);
+	poolInfo.flags			  = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+	if (vkCreateCommandPool(gpu_->device, &poolInfo, nullptr, &commandPool_) != VK_SUCCESS) {
+		std::cerr << "Defragmenter: Failed to create command pool" << std::endl;
+		commandPool_ = VK_NULL_HANDLE;
+		return false;
+	}
+
+	VkCommandBufferAllocateInfo allocInfo{};
+	allocInfo.sType				 = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.commandPool		 = commandPool_;
+	allocInfo.level				 = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandBufferCount = 1;
+
+	if (vkAllocateCommandBuffers(gpu_->device, &allocInfo, &commandBuffer_) != VK_SUCCESS) {
+		std::cerr << "Defragmenter: Failed to allocate command buffer" << std::endl;
+		commandBuffer_ = VK_NULL_HANDLE;
+		destroy();
+		return false;
+	}
+
+	VkFenceCreateInfo fenceInfo{};
+	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+	if (vkCreateFence(gpu_->device, &fenceInfo, nullptr, &fence_) != VK_SUCCESS) {
+		std::cerr << "Defragmenter: Failed to create fence" << std::endl;
+		fence_ = VK_NULL_HANDLE;
+		destroy();
+		return false;
+	}
+
+	VkSemaphoreTypeCreateInfo typeInfo{};
+	typeInfo.sType		   = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+	typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	typeInfo.initialValue  = 0;
+
+	VkSemaphoreCreateInfo semaphoreInfo{};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	semaphoreInfo.pNext = &typeInfo;
+
+	computeSemaphores_.assign(gpu_->computeQueues.size(), VK_NULL_HANDLE);
+	for (size_t i = 0; i < gpu_->computeQueues.size(); i++) {
+		if (gpu_->computeQueues[i] == queue_) continue;
+		if (vkCreateSemaphore(gpu_->device, &semaphoreInfo, nullptr, &computeSemaphores_[i]) != VK_SUCCESS) {
+			std::cerr << "Defragmenter: Failed to create timeline semaphore" << std::endl;
+			computeSemaphores_[i] = VK_NULL_HANDLE;
+			destroy();
+			return false;
+		}
+	}
+	computeValue_ = 0;
+
+	submitted_ = false;
+	complete_  = false;
+	stats_	   = DefragmentationStats{};
+	return true;
+}
+
+void Defragmenter::destroy() {
+	if (!gpu_ || !gpu_->device) return;
+
+	releaseRetired(true);
+
+	if (fence_ != VK_NULL_HANDLE) {
+		vkDestroyFence(gpu_->device, fence_, nullptr);
+		fence_ = VK_NULL_HANDLE;
+	}
+
+	for (VkSemaphore semaphore : computeSemaphores_) {
+		if (semaphore != VK_NULL_HANDLE) vkDestroySemaphore(gpu_->device, semaphore, nullptr);
+	}
+	computeSemaphores_.clear();
+
+	if (commandPool_ != VK_NULL_HANDLE) {
+		vkDestroyCommandPool(gpu_->device, commandPool_, nullptr);
+		commandPool_   = VK_NULL_HANDLE;
+		commandBuffer_ = VK_NULL_HANDLE;
+	}
+
+	skipped_.clear();
+	queue_ = VK_NULL_HANDLE;
+	gpu_   = nullptr;
+}
+
+bool Defragmenter::releaseRetired(bool wait) {
+	if (!submitted_) return true;
+
+	if (wait) {
+		vkWaitForFences(gpu_->device, 1, &fence_, VK_TRUE, UINT64_MAX);
+	} else if (vkGetFenceStatus(gpu_->device, fence_) != VK_SUCCESS) {
+		return false;
+	}
+
+	freeRetired();
+	submitted_ = false;
+	return true;
+}
+
+void Defragmenter::freeRetired() {
+	for (auto& retired : retired_) {
+		if (retired.view != VK_NULL_HANDLE) vkDestroyImageView(gpu_->device, retired.view, nullptr);
+		if (retired.image != VK_NULL_HANDLE) vkDestroyImage(gpu_->device, retired.image, nullptr);
+		if (retired.buffer != VK_NULL_HANDLE) vkDestroyBuffer(gpu_->device, retired.buffer, nullptr);
+		gpu_->allocator.free(retired.allocation);
+	}
+	retired_.clear();
+}
+
+uint32_t Defragmenter::step(float budgetMs) {
+	if (!isValid()) return 0;
+
+	// Keep a single batch in flight; its old copies are released as soon as it has executed
+	if (!releaseRetired(false)) return 0;
+
+	// Nothing may ever record the acquires of tickets nobody waits on; this records commands itself,
+	// so it runs before uploads are held off
+	gpu_->transfers.acquireCompleted();
+
+	// Uploads being recorded or in flight use the current handles. From here on new ones wait, so
+	// TransferManager work found idle stays idle until the moves were submitted.
+	if (!gpu_->tryLockRelocation()) return 0;
+	RelocationLock relocationLock{gpu_};
+	if (!gpu_->transfers.isIdle()) return 0;
+
+	auto start = std::chrono::steady_clock::now();
+
+	vkResetCommandBuffer(commandBuffer_, 0);
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	if (vkBeginCommandBuffer(commandBuffer_, &beginInfo) != VK_SUCCESS) {
+		std::cerr << "Defragmenter: Failed to begin command buffer" << std::endl;
+		return 0;
+	}
+
+	VkMemoryBarrier barrier{};
+	barrier.sType		  = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+	vkCmdPipelineBarrier(commandBuffer_, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+	// Allocations that cannot be placed elsewhere are only retried on the next step
+	skipped_.clear();
+
+	VkDeviceSize bytes	   = 0;
+	uint32_t	 moved	   = 0;
+	bool		 exhausted = false;
+
+	while (bytes < maxBytesPerStep_) {
+		std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+		if (elapsed.count() >= budgetMs) break;
+
+		void*			owner = nullptr;
+		AllocationOwner type  = AllocationOwner::NONE;
+		if (!gpu_->allocator.findMove(maxBytesPerStep_ - bytes, skipped_, owner, type)) {
+			exhausted = true;
+			break;
+		}
+
+		// Moved or not, the owner keeps its current allocation until the submit, so it is not picked again
+		skipped_.push_back(owner);
+
+		Retired retired;
+		retired.owner  = owner;
+		retired.type   = type;
+		bool relocated = false;
+		if (type == AllocationOwner::BUFFER) {
+			relocated = static_cast<Buffer*>(owner)->relocate(commandBuffer_, retired.buffer, retired.allocation);
+		} else if (type == AllocationOwner::IMAGE) {
+			relocated = static_cast<Image*>(owner)->relocate(commandBuffer_, retired.image, retired.view, retired.allocation);
+		}
+
+		if (!relocated) continue;
+
+		bytes += retired.allocation.size;
+		moved++;
+		retired_.push_back(retired);
+	}
+
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+	vkCmdPipelineBarrier(commandBuffer_, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+	if (vkEndCommandBuffer(commandBuffer_) != VK_SUCCESS) {
+		std::cerr << "Defragmenter: Failed to end command buffer" << std::endl;
+		freeRetired();
+		return 0;
+	}
+
+	complete_ = exhausted && moved == 0;
+	if (moved == 0) return 0;
+
+	std::vector<VkSemaphore>		  waitSemaphores;
+	std::vector<uint64_t>			  waitValues;
+	std::vector<VkPipelineStageFlags> waitStages;
+
+	VkTimelineSemaphoreSubmitInfo timelineInfo{};
+	timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType			  = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.pNext			  = &timelineInfo;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers	  = &commandBuffer_;
+
+	{
+		std::lock_guard<std::mutex> lock(gpu_->queueMutex);
+
+		// Work on a separate compute queue is not ordered by the barrier above. An empty batch on each
+		// of them signals its timeline behind that work, and the moves wait for it on the GPU.
+		computeValue_++;
+		for (size_t i = 0; i < computeSemaphores_.size(); i++) {
+			if (computeSemaphores_[i] == VK_NULL_HANDLE) continue;
+
+			VkTimelineSemaphoreSubmitInfo signalTimeline{};
+			signalTimeline.sType					 = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+			signalTimeline.signalSemaphoreValueCount = 1;
+			signalTimeline.pSignalSemaphoreValues	 = &computeValue_;
+
+			VkSubmitInfo signalInfo{};
+			signalInfo.sType				= VK_STRUCTURE_TYPE_SUBMIT_INFO;
+			signalInfo.pNext				= &signalTimeline;
+			signalInfo.signalSemaphoreCount = 1;
+			signalInfo.pSignalSemaphores	= &computeSemaphores_[i];
+
+			if (vkQueueSubmit(gpu_->computeQueues[i], 1, &signalInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+				vkQueueWaitIdle(gpu_->computeQueues[i]);
+				continue;
+			}
+			waitSemaphores.push_back(computeSemaphores_[i]);
+			waitValues.push_back(computeValue_);
+			waitStages.push_back(VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+		}
+
+		timelineInfo.waitSemaphoreValueCount = static_cast<uint32_t>(waitValues.size());
+		timelineInfo.pWaitSemaphoreValues	 = waitValues.data();
+		submitInfo.waitSemaphoreCount		 = static_cast<uint32_t>(waitSemaphores.size());
+		submitInfo.pWaitSemaphores			 = waitSemaphores.data();
+		submitInfo.pWaitDstStageMask		 = waitStages.data();
+
+		vkResetFences(gpu_->device, 1, &fence_);
+		if (vkQueueSubmit(queue_, 1, &submitInfo, fence_) != VK_SUCCESS) {
+			// The resources keep their current handles; the new ones were never used
+			std::cerr << "Defragmenter: Failed to submit moves" << std::endl;
+			freeRetired();
+			return 0;
+		}
+	}
+
+	// Resources switch to their new handles only now that the copies are on their way
+	for (auto& retired : retired_) {
+		if (retired.type == AllocationOwner::BUFFER) {
+			static_cast<Buffer*>(retired.owner)->commitRelocation(retired.buffer, retired.allocation);
+		} else {
+			static_cast<Image*>(retired.owner)->commitRelocation(retired.image, retired.view, retired.allocation);
+		}
+	}
+	submitted_ = true;
+
+	stats_.bytesMoved += bytes;
+	stats_.allocationsMoved += moved;
+	stats_.batches++;
+	return moved;
+}
@@ -0,0 +1,85 @@
+#ifndef DEFRAGMENTER_HPP
+#define DEFRAGMENTER_HPP
+
+#include "memoryAllocator.hpp"
+
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+namespace renderApi::device {
+	struct GPU;
+}
+
+namespace renderApi::memory {
+
+	struct DefragmentationStats {
+		VkDeviceSize bytesMoved		  = 0;
+		uint32_t	 allocationsMoved = 0;
+		uint32_t	 batches		  = 0;
+	};
+
+	// Compacts device local memory a little at a time. Each step() moves live Buffers and Images out
+	// of the least used block of a pool with GPU copies, swaps their handles, and releases the old
+	// copies once the batch has executed. GpuTasks and descriptor sets notice the new handles through
+	// Buffer/Image generations and rewrite their descriptors before their next use.
+	//
+	// step() must run on the thread that executes the GpuTasks, between two executes, and resources
+	// must not be destroyed from another thread while it runs. Mapped buffers are never moved, nor are
+	// buffers whose device address was queried, since a move would change it behind the application.
+	class Defragmenter {
+	  public:
+		static constexpr VkDeviceSize kDefaultMaxBytesPerStep = 64ull * 1024 * 1024;
+
+		Defragmenter();
+		~Defragmenter();
+
+		Defragmenter(const Defragmenter&)			 = delete;
+		Defragmenter& operator=(const Defragmenter&) = delete;
+
+		bool create(device::GPU* gpu);
+		void destroy();
+
+		// Records moves until budgetMs of CPU time or the byte limit is spent and submits them.
+		// Returns the number of allocations moved; nothing is recorded while the previous batch runs,
+		// while TransferManager work is pending, or while any upload is held (GPU::lockUploads).
+		uint32_t step(float budgetMs);
+
+		void						setMaxBytesPerStep(VkDeviceSize bytes) { maxBytesPerStep_ = bytes; }
+		bool						isComplete() const { return complete_; }
+		const DefragmentationStats& getStats() const { return stats_; }
+		bool						isValid() const { return commandBuffer_ != VK_NULL_HANDLE; }
+
+	  private:
+		// The new handles of a move until its copy was submitted, the old ones after
+		struct Retired {
+			void*			owner  = nullptr;
+			AllocationOwner type   = AllocationOwner::NONE;
+			VkBuffer		buffer = VK_NULL_HANDLE;
+			VkImage			image  = VK_NULL_HANDLE;
+			VkImageView		view   = VK_NULL_HANDLE;
+			AllocationInfo	allocation;
+		};
+
+		device::GPU*		 gpu_;
+		VkQueue				 queue_;
+		VkCommandPool		 commandPool_;
+		VkCommandBuffer		 commandBuffer_;
+		VkFence				 fence_;
+		// One timeline per compute queue other than queue_, signaled behind the work submitted there
+		std::vector<VkSemaphore> computeSemaphores_;
+		uint64_t				 computeValue_;
+		bool				 submitted_;
+		bool				 complete_;
+		VkDeviceSize		 maxBytesPerStep_;
+		std::vector<Retired> retired_;
+		std::vector<void*>	 skipped_;
+		DefragmentationStats stats_;
+
+		bool releaseRetired(bool wait);
+		void freeRetired();
+	};
+
+} // namespace renderApi::memory
+
+#endif
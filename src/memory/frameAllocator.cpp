@@ -0,0 +1,109 @@
+#include "frameAllocator.hpp"
+
+#include "renderDevice.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <vulkan/vulkan_core.h>
+
+using namespace renderApi::memory;
+
+namespace {
+
+	inline VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) { return (value + alignment - 1) & ~(alignment - 1); }
+
+} // namespace
+
+// ============================================================================
+// FrameAllocator Implementation
+// ============================================================================
+
+FrameAllocator::FrameAllocator()
+	: gpu_(nullptr), buffer_(VK_NULL_HANDLE), frameSize_(0), minAlignment_(1), head_(0), frameCount_(0), frameIndex_(0) {}
+
+FrameAllocator::~FrameAllocator() { destroy(); }
+
+bool FrameAllocator::create(renderApi::device::GPU* gpu, VkDeviceSize bytesPerFrame, uint32_t frameCount) {
+	destroy();
+
+	if (!gpu || !gpu->device) {
+		std::cerr << "FrameAllocator: GPU not initialized" << std::endl;
+		return false;
+	}
+	if (bytesPerFrame == 0 || frameCount == 0) {
+		std::cerr << "FrameAllocator: Invalid size" << std::endl;
+		return false;
+	}
+
+	gpu_ = gpu;
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(gpu_->physicalDevice, &properties);
+	minAlignment_ = std::max<VkDeviceSize>(
+			{properties.limits.minUniformBufferOffsetAlignment, properties.limits.minStorageBufferOffsetAlignment, VkDeviceSize(16)});
+
+	frameSize_	= alignUp(bytesPerFrame, minAlignment_);
+	frameCount_ = frameCount;
+
+	VkBufferUsageFlags usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+							   VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+	if (!gpu_->allocator.allocateBuffer(frameSize_ * frameCount_, usage, MemoryUsage::CPU_TO_GPU, buffer_, allocation_)) {
+		std::cerr << "FrameAllocator: Failed to allocate ring buffer" << std::endl;
+		buffer_ = VK_NULL_HANDLE;
+		return false;
+	}
+
+	if (!allocation_.mappedData) {
+		std::cerr << "FrameAllocator: Ring buffer is not host visible" << std::endl;
+		destroy();
+		return false;
+	}
+
+	head_		= 0;
+	frameIndex_ = 0;
+	return true;
+}
+
+void FrameAllocator::destroy() {
+	if (!gpu_ || !gpu_->device) return;
+
+	if (buffer_ != VK_NULL_HANDLE || allocation_.isValid()) {
+		gpu_->allocator.destroyBuffer(buffer_, allocation_);
+		buffer_ = VK_NULL_HANDLE;
+	}
+
+	frameSize_	= 0;
+	head_		= 0;
+	frameCount_ = 0;
+	frameIndex_ = 0;
+}
+
+void FrameAllocator::beginFrame(uint32_t frameIndex) {
+	if (frameCount_ == 0) return;
+
+	frameIndex_ = frameIndex % frameCount_;
+	head_		= 0;
+}
+
+FrameAllocation FrameAllocator::allocate(VkDeviceSize size, VkDeviceSize alignment) {
+	FrameAllocation result;
+	if (buffer_ == VK_NULL_HANDLE || size == 0) return result;
+
+	alignment			= std::max(alignment, minAlignment_);
+	VkDeviceSize offset = alignUp(head_, alignment);
+	if (offset + size > frameSize_) {
+		std::cerr << "FrameAllocator: Out of frame memory (" << offset + size << " / " << frameSize_ << " bytes)" << std::endl;
+		return result;
+	}
+	head_ = offset + size;
+
+	VkDeviceSize absoluteOffset = static_cast<VkDeviceSize>(frameIndex_) * frameSize_ + offset;
+
+	result.buffer = buffer_;
+	result.offset = absoluteOffset;
+	result.size	  = size;
+	result.data	  = static_cast<char*>(allocation_.mappedData) + absoluteOffset;
+	return result;
+}
@@ -0,0 +1,70 @@
+#ifndef FRAME_ALLOCATOR_HPP
+#define FRAME_ALLOCATOR_HPP
+
+#include "memoryAllocator.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <vulkan/vulkan_core.h>
+
+namespace renderApi::device {
+	struct GPU;
+}
+
+namespace renderApi::memory {
+
+	struct FrameAllocation {
+		VkBuffer	 buffer = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+		VkDeviceSize size	= 0;
+		void*		 data	= nullptr;
+
+		bool isValid() const { return data != nullptr; }
+	};
+
+	// Persistently mapped buffer split into one partition per frame in flight.
+	// Each partition is a bump allocator that is rewound by beginFrame(), once the
+	// caller knows the GPU is done with the frame that last used it.
+	class FrameAllocator {
+	  public:
+		FrameAllocator();
+		~FrameAllocator();
+
+		FrameAllocator(const FrameAllocator&)			 = delete;
+		FrameAllocator& operator=(const FrameAllocator&) = delete;
+
+		bool create(device::GPU* gpu, VkDeviceSize bytesPerFrame, uint32_t frameCount);
+		void destroy();
+
+		void			beginFrame(uint32_t frameIndex);
+		FrameAllocation allocate(VkDeviceSize size, VkDeviceSize alignment = 0);
+
+		template <typename T> FrameAllocation push(const T& value) {
+			FrameAllocation allocation = allocate(sizeof(T));
+			if (allocation.isValid()) {
+				std::memcpy(allocation.data, &value, sizeof(T));
+			}
+			return allocation;
+		}
+
+		VkBuffer	 getHandle() const { return buffer_; }
+		VkDeviceSize getFrameSize() const { return frameSize_; }
+		VkDeviceSize getUsed() const { return head_; }
+		VkDeviceSize getMinAlignment() const { return minAlignment_; }
+		uint32_t	 getFrameIndex() const { return frameIndex_; }
+		bool		 isValid() const { return buffer_ != VK_NULL_HANDLE; }
+
+	  private:
+		device::GPU*   gpu_;
+		VkBuffer	   buffer_;
+		AllocationInfo allocation_;
+		VkDeviceSize   frameSize_;
+		VkDeviceSize   minAlignment_;
+		VkDeviceSize   head_;
+		uint32_t	   frameCount_;
+		uint32_t	   frameIndex_;
+	};
+
+} // namespace renderApi::memory
+
+#endif
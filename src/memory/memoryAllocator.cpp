@@ -1,59 +1,913 @@
-// VMA Memory Allocator Implementation
-// Note: Full VMA integration requires including vk_mem_alloc.h
-// For now, this is a placeholder that will be implemented when VMA is added to the project
-
 #include "memoryAllocator.hpp"
+
 #include "renderDevice.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include <vulkan/vulkan_core.h>
 
 using namespace renderApi::memory;
 
-MemoryAllocator::MemoryAllocator() : gpu_(nullptr), allocator_(nullptr) {}
+namespace {
+
+	constexpr VkDeviceSize kLargeHeapThreshold = 1024ull * 1024 * 1024;
+	constexpr VkDeviceSize kLargeHeapBlockSize = 256ull * 1024 * 1024;
+	constexpr uint32_t	   kNoNode			   = UINT32_MAX;
+
+	inline uint32_t bitScanReverse(uint64_t value) { return 63u - static_cast<uint32_t>(__builtin_clzll(value)); }
+	inline uint32_t bitScanForward(uint64_t value) { return static_cast<uint32_t>(__builtin_ctzll(value)); }
+
+	inline VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) { return (value + alignment - 1) & ~(alignment - 1); }
+
+} // namespace
+
+// ============================================================================
+// MemoryBlock Implementation
+// ============================================================================
+
+bool MemoryBlock::create(VkDevice device, uint32_t memoryTypeIndex, VkDeviceSize size, bool hostVisible, bool deviceAddress, bool dedicated) {
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType			  = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize  = size;
+	allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+	VkMemoryAllocateFlagsInfo flagsInfo{};
+	if (deviceAddress) {
+		flagsInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO;
+		flagsInfo.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT;
+		allocInfo.pNext = &flagsInfo;
+	}
+
+	if (vkAllocateMemory(device, &allocInfo, nullptr, &memory_) != VK_SUCCESS) {
+		memory_ = VK_NULL_HANDLE;
+		return false;
+	}
+
+	if (hostVisible && vkMapMemory(device, memory_, 0, VK_WHOLE_SIZE, 0, &mapped_) != VK_SUCCESS) {
+		std::cerr << "MemoryBlock: Failed to map host visible block" << std::endl;
+		vkFreeMemory(device, memory_, nullptr);
+		memory_ = VK_NULL_HANDLE;
+		return false;
+	}
+
+	size_			 = size;
+	used_			 = 0;
+	memoryTypeIndex_ = memoryTypeIndex;
+	allocationCount_ = 0;
+	dedicated_		 = dedicated;
+
+	for (auto& heads : freeHeads_) {
+		heads.fill(kNoNode);
+	}
+	secondLevelBitmaps_.fill(0);
+	firstLevelBitmap_ = 0;
+
+	nodes_.clear();
+	unusedNodes_.clear();
+
+	uint32_t root		= newNode();
+	nodes_[root].offset = 0;
+	nodes_[root].size	= size;
+	insertFree(root);
+
+	return true;
+}
+
+void MemoryBlock::destroy(VkDevice device) {
+	if (memory_ == VK_NULL_HANDLE) return;
+
+	if (mapped_) {
+		vkUnmapMemory(device, memory_);
+		mapped_ = nullptr;
+	}
+
+	vkFreeMemory(device, memory_, nullptr);
+	memory_ = VK_NULL_HANDLE;
+
+	nodes_.clear();
+	unusedNodes_.clear();
+	size_			 = 0;
+	used_			 = 0;
+	allocationCount_ = 0;
+}
+
+uint32_t MemoryBlock::newNode() {
+	if (!unusedNodes_.empty()) {
+		uint32_t index = unusedNodes_.back();
+		unusedNodes_.pop_back();
+		nodes_[index] = Node{};
+		return index;
+	}
+	nodes_.emplace_back();
+	return static_cast<uint32_t>(nodes_.size() - 1);
+}
+
+void MemoryBlock::releaseNode(uint32_t index) { unusedNodes_.push_back(index); }
+
+void MemoryBlock::mapping(VkDeviceSize size, uint32_t& fl, uint32_t& sl) const {
+	if (size < (1ull << kSmallSizeLog2)) {
+		fl = 0;
+		sl = static_cast<uint32_t>(size >> (kSmallSizeLog2 - kSecondLevelLog2));
+		return;
+	}
+	uint32_t msb = bitScanReverse(size);
+	fl			 = std::min(msb - kSmallSizeLog2 + 1, kFirstLevelCount - 1);
+	sl			 = static_cast<uint32_t>(size >> (msb - kSecondLevelLog2)) ^ kSecondLevelCount;
+}
+
+void MemoryBlock::insertFree(uint32_t index) {
+	uint32_t fl, sl;
+	mapping(nodes_[index].size, fl, sl);
+
+	Node& node	  = nodes_[index];
+	node.free	  = true;
+	node.prevFree = kNoNode;
+	node.nextFree = freeHeads_[fl][sl];
+	if (node.nextFree != kNoNode) {
+		nodes_[node.nextFree].prevFree = index;
+	}
+	freeHeads_[fl][sl] = index;
+
+	firstLevelBitmap_ |= (1ull << fl);
+	secondLevelBitmaps_[fl] |= (1u << sl);
+}
+
+void MemoryBlock::removeFree(uint32_t index) {
+	uint32_t fl, sl;
+	mapping(nodes_[index].size, fl, sl);
+
+	Node& node = nodes_[index];
+	if (node.prevFree != kNoNode) {
+		nodes_[node.prevFree].nextFree = node.nextFree;
+	} else {
+		freeHeads_[fl][sl] = node.nextFree;
+	}
+	if (node.nextFree != kNoNode) {
+		nodes_[node.nextFree].prevFree = node.prevFree;
+	}
+	node.prevFree = kNoNode;
+	node.nextFree = kNoNode;
+	node.free	  = false;
+
+	if (freeHeads_[fl][sl] == kNoNode) {
+		secondLevelBitmaps_[fl] &= ~(1u << sl);
+		if (secondLevelBitmaps_[fl] == 0) {
+			firstLevelBitmap_ &= ~(1ull << fl);
+		}
+	}
+}
+
+uint32_t MemoryBlock::findFree(VkDeviceSize size) const {
+	// Round up to the next size class so that any range found is guaranteed to fit
+	if (size >= (1ull << kSmallSizeLog2)) {
+		size += (1ull << (bitScanReverse(size) - kSecondLevelLog2)) - 1;
+	} else {
+		size += (1ull << (kSmallSizeLog2 - kSecondLevelLog2)) - 1;
+	}
+
+	uint32_t fl, sl;
+	mapping(size, fl, sl);
+
+	uint32_t slMap = secondLevelBitmaps_[fl] & (~0u << sl);
+	if (slMap == 0) {
+		if (fl + 1 >= kFirstLevelCount) return kNoNode;
+		uint64_t flMap = firstLevelBitmap_ & (~0ull << (fl + 1));
+		if (flMap == 0) return kNoNode;
+		fl	  = bitScanForward(flMap);
+		slMap = secondLevelBitmaps_[fl];
+	}
+	sl = bitScanForward(slMap);
+
+	return freeHeads_[fl][sl];
+}
+
+bool MemoryBlock::allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& outOffset, uint32_t& outNode) {
+	if (memory_ == VK_NULL_HANDLE || size == 0) return false;
+	alignment = std::max<VkDeviceSize>(alignment, 1);
+
+	// A dedicated block holds one resource bound at offset 0, which satisfies any alignment. The
+	// size class search below would round the request past the block's only free range.
+	if (dedicated_) {
+		if (allocationCount_ != 0 || size > size_) return false;
+
+		uint32_t root = 0;
+		removeFree(root);
+		used_ += nodes_[root].size;
+		allocationCount_++;
 
-MemoryAllocator::~MemoryAllocator() {
-    cleanup();
+		outOffset = 0;
+		outNode	  = root;
+		return true;
+	}
+
+	uint32_t index = findFree(size + alignment - 1);
+	if (index == kNoNode) return false;
+
+	removeFree(index);
+
+	VkDeviceSize alignedOffset = alignUp(nodes_[index].offset, alignment);
+	VkDeviceSize padding	   = alignedOffset - nodes_[index].offset;
+
+	if (padding > 0) {
+		uint32_t front		 = newNode();
+		nodes_[front].offset = nodes_[index].offset;
+		nodes_[front].size	 = padding;
+		nodes_[front].prevPhys = nodes_[index].prevPhys;
+		nodes_[front].nextPhys = index;
+		if (nodes_[front].prevPhys != kNoNode) {
+			nodes_[nodes_[front].prevPhys].nextPhys = front;
+		}
+		nodes_[index].prevPhys = front;
+		nodes_[index].offset   = alignedOffset;
+		nodes_[index].size -= padding;
+		insertFree(front);
+	}
+
+	VkDeviceSize remainder = nodes_[index].size - size;
+	if (remainder > 0) {
+		uint32_t tail		   = newNode();
+		nodes_[tail].offset	   = alignedOffset + size;
+		nodes_[tail].size	   = remainder;
+		nodes_[tail].prevPhys  = index;
+		nodes_[tail].nextPhys  = nodes_[index].nextPhys;
+		if (nodes_[tail].nextPhys != kNoNode) {
+			nodes_[nodes_[tail].nextPhys].prevPhys = tail;
+		}
+		nodes_[index].nextPhys = tail;
+		nodes_[index].size	   = size;
+		insertFree(tail);
+	}
+
+	used_ += nodes_[index].size;
+	allocationCount_++;
+
+	outOffset = alignedOffset;
+	outNode	  = index;
+	return true;
+}
+
+void MemoryBlock::free(uint32_t index) {
+	if (index >= nodes_.size() || nodes_[index].free) return;
+
+	used_ -= nodes_[index].size;
+	allocationCount_--;
+	nodes_[index].owner		= nullptr;
+	nodes_[index].ownerType = AllocationOwner::NONE;
+
+	uint32_t prev = nodes_[index].prevPhys;
+	if (prev != kNoNode && nodes_[prev].free) {
+		removeFree(prev);
+		nodes_[prev].size += nodes_[index].size;
+		nodes_[prev].nextPhys = nodes_[index].nextPhys;
+		if (nodes_[prev].nextPhys != kNoNode) {
+			nodes_[nodes_[prev].nextPhys].prevPhys = prev;
+		}
+		releaseNode(index);
+		index = prev;
+	}
+
+	uint32_t next = nodes_[index].nextPhys;
+	if (next != kNoNode && nodes_[next].free) {
+		removeFree(next);
+		nodes_[index].size += nodes_[next].size;
+		nodes_[index].nextPhys = nodes_[next].nextPhys;
+		if (nodes_[index].nextPhys != kNoNode) {
+			nodes_[nodes_[index].nextPhys].prevPhys = index;
+		}
+		releaseNode(next);
+	}
+
+	insertFree(index);
+}
+
+void MemoryBlock::setOwner(uint32_t index, void* owner, AllocationOwner type) {
+	if (index >= nodes_.size() || nodes_[index].free) return;
+	nodes_[index].owner		= owner;
+	nodes_[index].ownerType = owner ? type : AllocationOwner::NONE;
+}
+
+bool MemoryBlock::findOwned(VkDeviceSize maxSize, const std::vector<void*>& skip, void*& outOwner, AllocationOwner& outType) const {
+	// Free and recycled nodes never carry an owner
+	for (const Node& node : nodes_) {
+		if (node.free || !node.owner || node.size > maxSize) continue;
+		if (std::find(skip.begin(), skip.end(), node.owner) != skip.end()) continue;
+		outOwner = node.owner;
+		outType	 = node.ownerType;
+		return true;
+	}
+	return false;
 }
 
+VkDeviceSize MemoryBlock::getLargestFreeRange() const {
+	if (firstLevelBitmap_ == 0) return 0;
+
+	uint32_t	 fl		 = bitScanReverse(firstLevelBitmap_);
+	uint32_t	 sl		 = bitScanReverse(secondLevelBitmaps_[fl]);
+	VkDeviceSize largest = 0;
+	for (uint32_t index = freeHeads_[fl][sl]; index != kNoNode; index = nodes_[index].nextFree) {
+		largest = std::max(largest, nodes_[index].size);
+	}
+	return largest;
+}
+
+// ============================================================================
+// MemoryAllocator Implementation
+// ============================================================================
+
+MemoryAllocator::MemoryAllocator() : gpu_(nullptr) {}
+
+MemoryAllocator::~MemoryAllocator() { cleanup(); }
+
 bool MemoryAllocator::init(renderApi::device::GPU* gpu) {
-    gpu_ = gpu;
-    // TODO: Initialize VMA allocator
-    std::cerr << "MemoryAllocator: VMA not yet integrated" << std::endl;
-    return false;
+	if (!gpu || !gpu->device) {
+		std::cerr << "MemoryAllocator: GPU not initialized" << std::endl;
+		return false;
+	}
+
+	gpu_ = gpu;
+	vkGetPhysicalDeviceMemoryProperties(gpu_->physicalDevice, &memoryProperties_);
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(gpu_->physicalDevice, &properties);
+	nonCoherentAtomSize_ = std::max<VkDeviceSize>(properties.limits.nonCoherentAtomSize, 1);
+
+	pools_.clear();
+	pools_.resize(memoryProperties_.memoryTypeCount * 2);
+	heapStats_.assign(memoryProperties_.memoryHeapCount, HeapStats{});
+	categoryBytes_.fill(0);
+	categoryCounts_.fill(0);
+	budgetDirtyHeaps_ = 0;
+
+	return true;
 }
 
 void MemoryAllocator::cleanup() {
-    // TODO: Destroy VMA allocator
-    allocator_ = nullptr;
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	if (!gpu_ || !gpu_->device) {
+		pools_.clear();
+		gpu_ = nullptr;
+		return;
+	}
+
+	for (auto& pool : pools_) {
+		for (auto& block : pool.blocks) {
+			if (!block->isEmpty()) {
+				std::cerr << "MemoryAllocator: Block of memory type " << block->getMemoryTypeIndex() << " destroyed with "
+						  << block->getAllocationCount() << " live allocations" << std::endl;
+			}
+			destroyBlock(*block);
+		}
+		pool.blocks.clear();
+	}
+	pools_.clear();
+	heapStats_.clear();
+	gpu_ = nullptr;
 }
 
-bool MemoryAllocator::allocateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, MemoryUsage memoryUsage,
-                                      VkBuffer& outBuffer, AllocationInfo& outAllocation) {
-    std::cerr << "MemoryAllocator::allocateBuffer not yet implemented" << std::endl;
-    return false;
+void MemoryAllocator::destroyBlock(MemoryBlock& block) {
+	uint32_t heapIndex = getHeapIndex(block.getMemoryTypeIndex());
+	heapStats_[heapIndex].blockBytes -= block.getSize();
+	budgetDirtyHeaps_ |= 1u << heapIndex;
+
+	block.destroy(gpu_->device);
 }
 
-void MemoryAllocator::destroyBuffer(VkBuffer buffer, const AllocationInfo& allocation) {
-    // TODO: Implement
+void MemoryAllocator::getMemoryFlags(MemoryUsage usage, VkMemoryPropertyFlags& required, VkMemoryPropertyFlags& preferred) {
+	preferred = 0;
+	switch (usage) {
+	case MemoryUsage::GPU_ONLY:
+		required = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+		break;
+	case MemoryUsage::CPU_ONLY:
+	case MemoryUsage::CPU_COPY:
+		required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+		break;
+	case MemoryUsage::CPU_TO_GPU:
+		required  = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+		preferred = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+		break;
+	case MemoryUsage::GPU_TO_CPU:
+		// Cached memory is often not coherent: readers must call invalidate()
+		required  = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+		preferred = VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+		break;
+	case MemoryUsage::GPU_LAZY:
+		required  = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+		preferred = VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+		break;
+	}
 }
 
-bool MemoryAllocator::allocateImage(const VkImageCreateInfo& imageInfo, MemoryUsage memoryUsage,
-                                     VkImage& outImage, AllocationInfo& outAllocation) {
-    std::cerr << "MemoryAllocator::allocateImage not yet implemented" << std::endl;
-    return false;
+VkDeviceSize MemoryAllocator::getBlockSize(uint32_t memoryTypeIndex) const {
+	if (preferredBlockSize_ != 0) return preferredBlockSize_;
+
+	uint32_t	 heapIndex = memoryProperties_.memoryTypes[memoryTypeIndex].heapIndex;
+	VkDeviceSize heapSize  = memoryProperties_.memoryHeaps[heapIndex].size;
+	return heapSize <= kLargeHeapThreshold ? heapSize / 8 : kLargeHeapBlockSize;
 }
 
-void MemoryAllocator::destroyImage(VkImage image, const AllocationInfo& allocation) {
-    // TODO: Implement
+bool MemoryAllocator::findMemoryTypeIndex(uint32_t typeBits, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred, uint32_t& outIndex) const {
+	for (int pass = 0; pass < 2; ++pass) {
+		VkMemoryPropertyFlags wanted = pass == 0 ? (required | preferred) : required;
+		for (uint32_t i = 0; i < memoryProperties_.memoryTypeCount; i++) {
+			if ((typeBits & (1u << i)) && (memoryProperties_.memoryTypes[i].propertyFlags & wanted) == wanted) {
+				outIndex = i;
+				return true;
+			}
+		}
+		if (preferred == 0) break;
+	}
+	return false;
 }
 
-void* MemoryAllocator::mapMemory(const AllocationInfo& allocation) {
-    return nullptr;
+bool MemoryAllocator::allocateFromType(uint32_t typeIndex, const VkMemoryRequirements& baseRequirements, ResourceKind kind, AllocationInfo& outAllocation) {
+	Pool&		 pool		 = getPool(typeIndex, kind);
+	VkDeviceSize blockSize	 = getBlockSize(typeIndex);
+	bool		 hostVisible = memoryProperties_.memoryTypes[typeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+
+	// Allocations in non coherent memory never share an atom, so flushing or invalidating one of
+	// them cannot touch the bytes of another
+	VkMemoryRequirements requirements = baseRequirements;
+	if (hostVisible && !isCoherentType(typeIndex)) {
+		requirements.alignment = std::max(requirements.alignment, nonCoherentAtomSize_);
+		requirements.size	   = alignUp(requirements.size, nonCoherentAtomSize_);
+	}
+
+	auto fill = [&](MemoryBlock* block, VkDeviceSize offset, uint32_t node) {
+		outAllocation.block			  = block;
+		outAllocation.memory		  = block->getMemory();
+		outAllocation.mappedData	  = block->getMappedData() ? static_cast<char*>(block->getMappedData()) + offset : nullptr;
+		outAllocation.offset		  = offset;
+		outAllocation.size			  = requirements.size;
+		outAllocation.memoryTypeIndex = typeIndex;
+		outAllocation.node			  = node;
+		outAllocation.kind			  = kind;
+	};
+
+	VkDeviceSize offset = 0;
+	uint32_t	 node	= kNoNode;
+
+	bool dedicated = requirements.size > blockSize / 2;
+	if (!dedicated) {
+		for (auto& block : pool.blocks) {
+			if (!block->isDedicated() && block->allocate(requirements.size, requirements.alignment, offset, node)) {
+				fill(block.get(), offset, node);
+				return true;
+			}
+		}
+	}
+
+	// Start small and grow each new block up to the preferred size, so that memory types used for
+	// a handful of resources do not reserve a full block up front.
+	VkDeviceSize newBlockSize = requirements.size;
+	if (!dedicated) {
+		VkDeviceSize largest = 0;
+		for (const auto& block : pool.blocks) {
+			if (!block->isDedicated()) largest = std::max(largest, block->getSize());
+		}
+		newBlockSize = largest == 0 ? blockSize / 8 : std::min(blockSize, largest * 2);
+		while (newBlockSize < requirements.size * 2 && newBlockSize < blockSize) {
+			newBlockSize *= 2;
+		}
+		newBlockSize = std::max(std::min(newBlockSize, blockSize), requirements.size);
+	}
+
+	// A fresh block only fits the request with room for its alignment and TLSF size class rounding;
+	// below that, a dedicated block of the exact size is tried instead
+	VkDeviceSize minBlockSize = (requirements.size + requirements.alignment) * 2;
+	if (!dedicated && newBlockSize < minBlockSize) {
+		dedicated	 = true;
+		newBlockSize = requirements.size;
+	}
+
+	auto block = std::make_unique<MemoryBlock>();
+	while (!block->create(gpu_->device, typeIndex, newBlockSize, hostVisible, kind == ResourceKind::LINEAR, dedicated)) {
+		if (dedicated) return false;
+		if (newBlockSize / 2 < minBlockSize) {
+			dedicated	 = true;
+			newBlockSize = requirements.size;
+		} else {
+			newBlockSize /= 2;
+		}
+	}
+
+	uint32_t heapIndex = getHeapIndex(typeIndex);
+	heapStats_[heapIndex].blockBytes += newBlockSize;
+	budgetDirtyHeaps_ |= 1u << heapIndex;
+
+	if (!block->allocate(requirements.size, requirements.alignment, offset, node)) {
+		destroyBlock(*block);
+		return false;
+	}
+
+	fill(block.get(), offset, node);
+	pool.blocks.push_back(std::move(block));
+	return true;
+}
+
+bool MemoryAllocator::allocate(const VkMemoryRequirements& requirements,
+							   VkMemoryPropertyFlags	   requiredFlags,
+							   VkMemoryPropertyFlags	   preferredFlags,
+							   ResourceKind				   kind,
+							   AllocationInfo&			   outAllocation,
+							   MemoryCategory			   category) {
+	if (!gpu_ || !gpu_->device) {
+		std::cerr << "MemoryAllocator: Not initialized" << std::endl;
+		return false;
+	}
+
+	bool allocated = false;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+
+		uint32_t typeBits = requirements.memoryTypeBits;
+		uint32_t typeIndex;
+		while (findMemoryTypeIndex(typeBits, requiredFlags, preferredFlags, typeIndex)) {
+			if (allocateFromType(typeIndex, requirements, kind, outAllocation)) {
+				allocated = true;
+				break;
+			}
+			typeBits &= ~(1u << typeIndex);
+		}
+
+		if (allocated) {
+			outAllocation.category = category;
+			heapStats_[getHeapIndex(outAllocation.memoryTypeIndex)].allocationBytes += outAllocation.size;
+			categoryBytes_[static_cast<size_t>(category)] += outAllocation.size;
+			categoryCounts_[static_cast<size_t>(category)]++;
+		}
+	}
+
+	if (!allocated) {
+		std::cerr << "MemoryAllocator: Failed to allocate " << requirements.size << " bytes" << std::endl;
+		return false;
+	}
+
+	checkBudget();
+	return true;
+}
+
+void MemoryAllocator::free(AllocationInfo& allocation) {
+	if (!allocation.block) return;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+
+		if (!gpu_ || !gpu_->device) {
+			allocation = AllocationInfo{};
+			return;
+		}
+
+		heapStats_[getHeapIndex(allocation.memoryTypeIndex)].allocationBytes -= allocation.size;
+		categoryBytes_[static_cast<size_t>(allocation.category)] -= allocation.size;
+		categoryCounts_[static_cast<size_t>(allocation.category)]--;
+
+		MemoryBlock* block = allocation.block;
+		block->free(allocation.node);
+
+		if (block->isEmpty()) {
+			Pool& pool = getPool(allocation.memoryTypeIndex, allocation.kind);
+			auto  it   = std::find_if(pool.blocks.begin(), pool.blocks.end(), [block](const auto& b) { return b.get() == block; });
+
+			// Keep a single empty block around per pool to avoid allocation churn
+			bool hasOtherEmpty = std::any_of(pool.blocks.begin(), pool.blocks.end(), [block](const auto& b) {
+				return b.get() != block && b->isEmpty() && !b->isDedicated();
+			});
+			if (it != pool.blocks.end() && (block->isDedicated() || hasOtherEmpty)) {
+				destroyBlock(*block);
+				pool.blocks.erase(it);
+			}
+		}
+
+		allocation = AllocationInfo{};
+	}
+
+	checkBudget();
+}
+
+bool MemoryAllocator::allocateBuffer(
+		VkDeviceSize size, VkBufferUsageFlags usage, MemoryUsage memoryUsage, VkBuffer& outBuffer, AllocationInfo& outAllocation, MemoryCategory category) {
+	if (!gpu_ || !gpu_->device) return false;
+
+	VkBufferCreateInfo bufferInfo{};
+	bufferInfo.sType	   = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size		   = size;
+	bufferInfo.usage	   = usage;
+	gpu_->setBufferSharing(bufferInfo);
+
+	if (vkCreateBuffer(gpu_->device, &bufferInfo, nullptr, &outBuffer) != VK_SUCCESS) {
+		std::cerr << "MemoryAllocator: Failed to create buffer" << std::endl;
+		return false;
+	}
+
+	VkMemoryRequirements requirements;
+	vkGetBufferMemoryRequirements(gpu_->device, outBuffer, &requirements);
+
+	VkMemoryPropertyFlags required, preferred;
+	getMemoryFlags(memoryUsage, required, preferred);
+
+	if (!allocate(requirements, required, preferred, ResourceKind::LINEAR, outAllocation, category)) {
+		vkDestroyBuffer(gpu_->device, outBuffer, nullptr);
+		outBuffer = VK_NULL_HANDLE;
+		return false;
+	}
+
+	vkBindBufferMemory(gpu_->device, outBuffer, outAllocation.memory, outAllocation.offset);
+	return true;
+}
+
+void MemoryAllocator::destroyBuffer(VkBuffer buffer, AllocationInfo& allocation) {
+	if (gpu_ && gpu_->device && buffer != VK_NULL_HANDLE) {
+		vkDestroyBuffer(gpu_->device, buffer, nullptr);
+	}
+	free(allocation);
+}
+
+bool MemoryAllocator::allocateImage(
+		const VkImageCreateInfo& imageInfo, MemoryUsage memoryUsage, VkImage& outImage, AllocationInfo& outAllocation, MemoryCategory category) {
+	if (!gpu_ || !gpu_->device) return false;
+
+	if (vkCreateImage(gpu_->device, &imageInfo, nullptr, &outImage) != VK_SUCCESS) {
+		std::cerr << "MemoryAllocator: Failed to create image" << std::endl;
+		return false;
+	}
+
+	VkMemoryRequirements requirements;
+	vkGetImageMemoryRequirements(gpu_->device, outImage, &requirements);
+
+	VkMemoryPropertyFlags required, preferred;
+	getMemoryFlags(memoryUsage, required, preferred);
+
+	ResourceKind kind = imageInfo.tiling == VK_IMAGE_TILING_LINEAR ? ResourceKind::LINEAR : ResourceKind::OPTIMAL;
+	if (!allocate(requirements, required, preferred, kind, outAllocation, category)) {
+		vkDestroyImage(gpu_->device, outImage, nullptr);
+		outImage = VK_NULL_HANDLE;
+		return false;
+	}
+
+	vkBindImageMemory(gpu_->device, outImage, outAllocation.memory, outAllocation.offset);
+	return true;
+}
+
+void MemoryAllocator::destroyImage(VkImage image, AllocationInfo& allocation) {
+	if (gpu_ && gpu_->device && image != VK_NULL_HANDLE) {
+		vkDestroyImage(gpu_->device, image, nullptr);
+	}
+	free(allocation);
+}
+
+void MemoryAllocator::setOwner(const AllocationInfo& allocation, void* owner, AllocationOwner type) {
+	if (!allocation.block) return;
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	allocation.block->setOwner(allocation.node, owner, type);
+}
+
+bool MemoryAllocator::findMove(VkDeviceSize maxSize, const std::vector<void*>& skip, void*& outOwner, AllocationOwner& outType) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (!gpu_ || !gpu_->device) return false;
+
+	for (uint32_t i = 0; i < pools_.size(); i++) {
+		// Mapped memory may be referenced by host pointers, only device local pools are compacted
+		if (memoryProperties_.memoryTypes[i / 2].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) continue;
+
+		// Empty the least used block into the others
+		MemoryBlock* source		= nullptr;
+		uint32_t	 liveBlocks = 0;
+		for (const auto& block : pools_[i].blocks) {
+			if (block->isDedicated() || block->isEmpty()) continue;
+			liveBlocks++;
+			if (!source || block->getUsed() < source->getUsed()) source = block.get();
+		}
+		if (liveBlocks < 2) continue;
+
+		if (source->findOwned(maxSize, skip, outOwner, outType)) return true;
+	}
+	return false;
+}
+
+bool MemoryAllocator::allocateMove(const VkMemoryRequirements& requirements, const AllocationInfo& source, AllocationInfo& outAllocation) {
+	if (!source.block) return false;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (!gpu_ || !gpu_->device) return false;
+		if (!(requirements.memoryTypeBits & (1u << source.memoryTypeIndex))) return false;
+
+		// Only fill blocks at least as used as the source, so moves always converge and never
+		// land in the spare empty block or create a new one
+		Pool&		 pool	= getPool(source.memoryTypeIndex, source.kind);
+		MemoryBlock* target = nullptr;
+		VkDeviceSize offset = 0;
+		uint32_t	 node	= kNoNode;
+		for (auto& block : pool.blocks) {
+			if (block.get() == source.block || block->isDedicated() || block->isEmpty()) continue;
+			if (block->getUsed() < source.block->getUsed()) continue;
+			if (block->allocate(requirements.size, requirements.alignment, offset, node)) {
+				target = block.get();
+				break;
+			}
+		}
+		if (!target) return false;
+
+		outAllocation.block			  = target;
+		outAllocation.memory		  = target->getMemory();
+		outAllocation.mappedData	  = nullptr;
+		outAllocation.offset		  = offset;
+		outAllocation.size			  = requirements.size;
+		outAllocation.memoryTypeIndex = source.memoryTypeIndex;
+		outAllocation.node			  = node;
+		outAllocation.kind			  = source.kind;
+		outAllocation.category		  = source.category;
+
+		heapStats_[getHeapIndex(outAllocation.memoryTypeIndex)].allocationBytes += outAllocation.size;
+		categoryBytes_[static_cast<size_t>(outAllocation.category)] += outAllocation.size;
+		categoryCounts_[static_cast<size_t>(outAllocation.category)]++;
+	}
+
+	checkBudget();
+	return true;
+}
+
+void* MemoryAllocator::mapMemory(const AllocationInfo& allocation) { return allocation.mappedData; }
+
+bool MemoryAllocator::isCoherent(const AllocationInfo& allocation) const { return !allocation.block || isCoherentType(allocation.memoryTypeIndex); }
+
+bool MemoryAllocator::getAtomRange(const AllocationInfo& allocation, VkDeviceSize offset, VkDeviceSize size, VkMappedMemoryRange& outRange) const {
+	if (!allocation.block || !allocation.mappedData || offset >= allocation.size) return false;
+
+	if (size == VK_WHOLE_SIZE || offset + size > allocation.size) size = allocation.size - offset;
+
+	VkDeviceSize begin = (allocation.offset + offset) / nonCoherentAtomSize_ * nonCoherentAtomSize_;
+	VkDeviceSize end   = std::min(alignUp(allocation.offset + offset + size, nonCoherentAtomSize_), allocation.block->getSize());
+
+	outRange		= VkMappedMemoryRange{};
+	outRange.sType	= VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+	outRange.memory = allocation.memory;
+	outRange.offset = begin;
+	outRange.size	= end - begin;
+	return true;
+}
+
+void MemoryAllocator::flush(const AllocationInfo& allocation, VkDeviceSize offset, VkDeviceSize size) {
+	if (isCoherent(allocation)) return;
+
+	VkMappedMemoryRange range;
+	if (getAtomRange(allocation, offset, size, range)) {
+		vkFlushMappedMemoryRanges(gpu_->device, 1, &range);
+	}
+}
+
+void MemoryAllocator::invalidate(const AllocationInfo& allocation, VkDeviceSize offset, VkDeviceSize size) {
+	if (isCoherent(allocation)) return;
+
+	VkMappedMemoryRange range;
+	if (getAtomRange(allocation, offset, size, range)) {
+		vkInvalidateMappedMemoryRanges(gpu_->device, 1, &range);
+	}
 }
 
 void MemoryAllocator::unmapMemory(const AllocationInfo& allocation) {
-    // TODO: Implement
+	// Host visible blocks are persistently mapped for their whole lifetime
+	(void)allocation;
+}
+
+std::vector<HeapBudget> MemoryAllocator::getHeapBudgets() const {
+	std::vector<HeapBudget> budgets;
+	if (!gpu_ || !gpu_->device) return budgets;
+
+	VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+	budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+	if (gpu_->memoryBudgetSupported) {
+		VkPhysicalDeviceMemoryProperties2 properties{};
+		properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+		properties.pNext = &budgetProperties;
+		vkGetPhysicalDeviceMemoryProperties2(gpu_->physicalDevice, &properties);
+	}
+
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	budgets.resize(memoryProperties_.memoryHeapCount);
+	for (uint32_t i = 0; i < memoryProperties_.memoryHeapCount; i++) {
+		HeapBudget& budget		= budgets[i];
+		budget.size				= memoryProperties_.memoryHeaps[i].size;
+		budget.deviceLocal		= memoryProperties_.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+		budget.blockBytes		= heapStats_[i].blockBytes;
+		budget.allocationBytes	= heapStats_[i].allocationBytes;
+
+		if (gpu_->memoryBudgetSupported) {
+			budget.budget = budgetProperties.heapBudget[i];
+			budget.usage  = budgetProperties.heapUsage[i];
+		} else {
+			// Without the extension only our own blocks are visible
+			budget.budget = budget.size / 10 * 8;
+			budget.usage  = budget.blockBytes;
+		}
+	}
+	return budgets;
+}
+
+VkDeviceSize MemoryAllocator::getCategoryBytes(MemoryCategory category) const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return category < MemoryCategory::COUNT ? categoryBytes_[static_cast<size_t>(category)] : 0;
+}
+
+uint32_t MemoryAllocator::getCategoryCount(MemoryCategory category) const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return category < MemoryCategory::COUNT ? categoryCounts_[static_cast<size_t>(category)] : 0;
+}
+
+void MemoryAllocator::setBudgetCallback(float threshold, BudgetCallback callback) {
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	budgetThreshold_ = threshold;
+	budgetCallback_	 = std::move(callback);
+	for (auto& heap : heapStats_) {
+		heap.overThreshold = false;
+	}
+	budgetDirtyHeaps_ = ~0u;
+}
+
+void MemoryAllocator::checkBudget() {
+	// Heaps that gained or lost a block are re-checked right away, all of them periodically, and the
+	// callback runs without the lock held so that it can free resources right away.
+	uint32_t	   dirty;
+	float		   threshold;
+	BudgetCallback callback;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (!budgetCallback_) return;
+
+		auto now = std::chrono::steady_clock::now();
+		if (now - lastBudgetPoll_ >= kBudgetPollInterval) {
+			lastBudgetPoll_	  = now;
+			budgetDirtyHeaps_ = ~0u;
+		}
+
+		dirty			  = budgetDirtyHeaps_;
+		budgetDirtyHeaps_ = 0;
+		if (dirty == 0) return;
+		threshold = budgetThreshold_;
+		callback  = budgetCallback_;
+	}
+
+	std::vector<HeapBudget> budgets = getHeapBudgets();
+	for (uint32_t i = 0; i < budgets.size(); i++) {
+		if (!(dirty & (1u << i)) || budgets[i].budget == 0) continue;
+
+		bool over = static_cast<double>(budgets[i].usage) >= static_cast<double>(budgets[i].budget) * threshold;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			if (i >= heapStats_.size() || heapStats_[i].overThreshold == over) continue;
+			heapStats_[i].overThreshold = over;
+		}
+
+		// Fire once when crossing upwards; dropping back below re-arms the callback
+		if (over) {
+			callback(i, budgets[i]);
+		}
+	}
 }
 
 void MemoryAllocator::printStats() const {
-    std::cout << "MemoryAllocator stats not yet implemented" << std::endl;
+	static const char* categoryNames[kCategoryCount] = {"buffers", "images", "render targets", "staging", "other"};
+
+	std::vector<HeapBudget> budgets = getHeapBudgets();
+
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	std::cout << "=== MemoryAllocator stats ===" << std::endl;
+	for (size_t i = 0; i < budgets.size(); ++i) {
+		const auto& budget = budgets[i];
+		std::cout << "  Heap " << i << (budget.deviceLocal ? " (device local)" : " (host)") << ": " << budget.usage / (1024 * 1024) << " / "
+				  << budget.budget / (1024 * 1024) << " MiB budget, " << budget.blockBytes / (1024 * 1024) << " MiB in blocks, "
+				  << budget.allocationBytes / (1024 * 1024) << " MiB allocated, heap " << budget.size / (1024 * 1024) << " MiB" << std::endl;
+	}
+	for (size_t i = 0; i < kCategoryCount; ++i) {
+		if (categoryCounts_[i] == 0) continue;
+		std::cout << "  " << categoryNames[i] << ": " << categoryCounts_[i] << " allocations, " << categoryBytes_[i] / 1024 << " KiB" << std::endl;
+	}
+	for (size_t i = 0; i < pools_.size(); ++i) {
+		const auto& pool = pools_[i];
+		if (pool.blocks.empty()) continue;
+
+		VkDeviceSize total = 0, used = 0;
+		uint32_t	 allocations = 0;
+		for (const auto& block : pool.blocks) {
+			total += block->getSize();
+			used += block->getUsed();
+			allocations += block->getAllocationCount();
+		}
+
+		std::cout << "  Memory type " << i / 2 << (i % 2 ? " (optimal)" : " (linear)") << ": " << pool.blocks.size() << " blocks, "
+				  << allocations << " allocations, " << used / 1024 << " / " << total / 1024 << " KiB used" << std::endl;
+	}
 }
@@ -1,16 +1,15 @@
 #ifndef MEMORY_ALLOCATOR_HPP
 #define MEMORY_ALLOCATOR_HPP
 
+#include <array>
+#include <chrono>
 #include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
 #include <vulkan/vulkan_core.h>
 
-// Forward declare VMA types to avoid including the full header here
-struct VmaAllocator_T;
-typedef VmaAllocator_T* VmaAllocator;
-
-struct VmaAllocation_T;
-typedef VmaAllocation_T* VmaAllocation;
-
 namespace renderApi::device {
 	struct GPU;
 }
@@ -21,16 +20,114 @@ namespace renderApi::memory {
 		GPU_ONLY,		// DEVICE_LOCAL, fastest GPU access
 		CPU_ONLY,		// HOST_VISIBLE | HOST_COHERENT, no GPU access
 		CPU_TO_GPU,		// Staging buffers: CPU writes, GPU reads
-		GPU_TO_CPU,		// Readback buffers: GPU writes, CPU reads
+		GPU_TO_CPU,		// Readback buffers: GPU writes, CPU reads; HOST_CACHED when available, may be non coherent
 		CPU_COPY,		// Frequent CPU writes, GPU reads
 		GPU_LAZY		// Lazily allocated GPU memory
 	};
 
+	// Linear (buffers, linear images) and optimal (tiled images) resources never share a block,
+	// which keeps them bufferImageGranularity apart without per-allocation padding.
+	enum class ResourceKind { LINEAR, OPTIMAL };
+
+	enum class MemoryCategory { BUFFER, IMAGE, RENDER_TARGET, STAGING, OTHER, COUNT };
+
+	// Object that owns an allocation and can move it to another place (see Defragmenter)
+	enum class AllocationOwner : uint8_t { NONE, BUFFER, IMAGE };
+
+	struct HeapBudget {
+		VkDeviceSize size			 = 0; // Heap size
+		VkDeviceSize budget			 = 0; // What this process can use (driver estimate, or 80% of the heap)
+		VkDeviceSize usage			 = 0; // What this process uses (driver report, or allocator blocks)
+		VkDeviceSize blockBytes		 = 0; // VkDeviceMemory owned by the allocator
+		VkDeviceSize allocationBytes = 0; // Bytes handed out from those blocks
+		bool		 deviceLocal	 = false;
+	};
+
+	using BudgetCallback = std::function<void(uint32_t heapIndex, const HeapBudget& budget)>;
+
+	class MemoryBlock;
+
 	struct AllocationInfo {
-		VmaAllocation allocation;
-		void*		  mappedData;
-		VkDeviceSize  offset;
-		VkDeviceSize  size;
+		MemoryBlock*   block		   = nullptr;
+		VkDeviceMemory memory		   = VK_NULL_HANDLE;
+		void*		   mappedData	   = nullptr;
+		VkDeviceSize   offset		   = 0;
+		VkDeviceSize   size			   = 0;
+		uint32_t	   memoryTypeIndex = 0;
+		uint32_t	   node			   = UINT32_MAX;
+		ResourceKind   kind			   = ResourceKind::LINEAR;
+		MemoryCategory category		   = MemoryCategory::OTHER;
+
+		bool isValid() const { return block != nullptr; }
+	};
+
+	// One VkDeviceMemory sub-allocated with a two-level segregated fit (TLSF) free list.
+	class MemoryBlock {
+	  public:
+		static constexpr uint32_t kSecondLevelLog2 = 4;
+		static constexpr uint32_t kSecondLevelCount = 1u << kSecondLevelLog2;
+		static constexpr uint32_t kSmallSizeLog2	= 8;
+		static constexpr uint32_t kFirstLevelCount	= 48;
+
+		MemoryBlock()  = default;
+		~MemoryBlock() = default;
+
+		MemoryBlock(const MemoryBlock&)			   = delete;
+		MemoryBlock& operator=(const MemoryBlock&) = delete;
+
+		bool create(VkDevice device, uint32_t memoryTypeIndex, VkDeviceSize size, bool hostVisible, bool deviceAddress, bool dedicated);
+		void destroy(VkDevice device);
+
+		bool allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& outOffset, uint32_t& outNode);
+		void free(uint32_t node);
+
+		void setOwner(uint32_t node, void* owner, AllocationOwner type);
+		bool findOwned(VkDeviceSize maxSize, const std::vector<void*>& skip, void*& outOwner, AllocationOwner& outType) const;
+
+		VkDeviceMemory getMemory() const { return memory_; }
+		void*		   getMappedData() const { return mapped_; }
+		VkDeviceSize   getSize() const { return size_; }
+		VkDeviceSize   getUsed() const { return used_; }
+		uint32_t	   getAllocationCount() const { return allocationCount_; }
+		uint32_t	   getMemoryTypeIndex() const { return memoryTypeIndex_; }
+		bool		   isEmpty() const { return allocationCount_ == 0; }
+		bool		   isDedicated() const { return dedicated_; }
+		VkDeviceSize   getLargestFreeRange() const;
+
+	  private:
+		struct Node {
+			VkDeviceSize	offset	  = 0;
+			VkDeviceSize	size	  = 0;
+			uint32_t		prevPhys  = UINT32_MAX;
+			uint32_t		nextPhys  = UINT32_MAX;
+			uint32_t		prevFree  = UINT32_MAX;
+			uint32_t		nextFree  = UINT32_MAX;
+			void*			owner	  = nullptr;
+			AllocationOwner ownerType = AllocationOwner::NONE;
+			bool			free	  = false;
+		};
+
+		VkDeviceMemory memory_			= VK_NULL_HANDLE;
+		void*		   mapped_			= nullptr;
+		VkDeviceSize   size_			= 0;
+		VkDeviceSize   used_			= 0;
+		uint32_t	   memoryTypeIndex_ = 0;
+		uint32_t	   allocationCount_ = 0;
+		bool		   dedicated_		= false;
+
+		std::vector<Node>	  nodes_;
+		std::vector<uint32_t> unusedNodes_;
+
+		uint64_t													  firstLevelBitmap_ = 0;
+		std::array<uint32_t, kFirstLevelCount>						  secondLevelBitmaps_{};
+		std::array<std::array<uint32_t, kSecondLevelCount>, kFirstLevelCount> freeHeads_{};
+
+		uint32_t newNode();
+		void	 releaseNode(uint32_t index);
+		void	 mapping(VkDeviceSize size, uint32_t& fl, uint32_t& sl) const;
+		void	 insertFree(uint32_t index);
+		void	 removeFree(uint32_t index);
+		uint32_t findFree(VkDeviceSize size) const;
 	};
 
 	class MemoryAllocator {
@@ -44,40 +141,111 @@ namespace renderApi::memory {
 		bool init(device::GPU* gpu);
 		void cleanup();
 
+		// Raw sub-allocation for resources created by the caller
+		bool allocate(const VkMemoryRequirements& requirements,
+					  VkMemoryPropertyFlags		  requiredFlags,
+					  VkMemoryPropertyFlags		  preferredFlags,
+					  ResourceKind				  kind,
+					  AllocationInfo&			  outAllocation,
+					  MemoryCategory			  category = MemoryCategory::OTHER);
+		void free(AllocationInfo& allocation);
+
 		// Buffer allocation
 		bool allocateBuffer(VkDeviceSize		 size,
 							VkBufferUsageFlags	 usage,
 							MemoryUsage			 memoryUsage,
 							VkBuffer&			 outBuffer,
-							AllocationInfo&		 outAllocation);
+							AllocationInfo&		 outAllocation,
+							MemoryCategory		 category = MemoryCategory::BUFFER);
 
-		void destroyBuffer(VkBuffer buffer, const AllocationInfo& allocation);
+		void destroyBuffer(VkBuffer buffer, AllocationInfo& allocation);
 
 		// Image allocation
 		bool allocateImage(const VkImageCreateInfo& imageInfo,
 						   MemoryUsage				memoryUsage,
 						   VkImage&					outImage,
-						   AllocationInfo&			outAllocation);
+						   AllocationInfo&			outAllocation,
+						   MemoryCategory			category = MemoryCategory::IMAGE);
 
-		void destroyImage(VkImage image, const AllocationInfo& allocation);
+		void destroyImage(VkImage image, AllocationInfo& allocation);
 
-		// Memory mapping
+		// Defragmentation: allocations registered with an owner can be moved out of the least used
+		// block of a device local pool into the other blocks of the same pool.
+		void setOwner(const AllocationInfo& allocation, void* owner, AllocationOwner type);
+		bool findMove(VkDeviceSize maxSize, const std::vector<void*>& skip, void*& outOwner, AllocationOwner& outType);
+		bool allocateMove(const VkMemoryRequirements& requirements, const AllocationInfo& source, AllocationInfo& outAllocation);
+
+		// Memory mapping (host-visible blocks stay persistently mapped)
 		void* mapMemory(const AllocationInfo& allocation);
 		void  unmapMemory(const AllocationInfo& allocation);
 
+		// Non coherent memory: make host writes visible to the device, or device writes visible to
+		// the host. The range is relative to the allocation and widened to nonCoherentAtomSize; both
+		// are no-ops on coherent memory.
+		bool		 isCoherent(const AllocationInfo& allocation) const;
+		void		 flush(const AllocationInfo& allocation, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
+		void		 invalidate(const AllocationInfo& allocation, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
+		VkDeviceSize getNonCoherentAtomSize() const { return nonCoherentAtomSize_; }
+
 		// Utility
-		bool isValid() const { return allocator_ != nullptr; }
+		bool isValid() const { return gpu_ != nullptr; }
+
+		void		 setBlockSize(VkDeviceSize size) { preferredBlockSize_ = size; }
+		VkDeviceSize getBlockSize(uint32_t memoryTypeIndex) const;
 
-		VmaAllocator getHandle() const { return allocator_; }
+		// Budget and stats
+		std::vector<HeapBudget> getHeapBudgets() const;
+		VkDeviceSize			getCategoryBytes(MemoryCategory category) const;
+		uint32_t				getCategoryCount(MemoryCategory category) const;
+		void					setBudgetCallback(float threshold, BudgetCallback callback);
+		// Budgets also change with other processes and driver residency decisions: every heap is re-read
+		// at most once per kBudgetPollInterval, from allocate(), free() and this, which a frame loop can
+		// call once per frame
+		void					pollBudget() { checkBudget(); }
+		void					printStats() const;
 
-		// Stats
-		void printStats() const;
+		static void getMemoryFlags(MemoryUsage usage, VkMemoryPropertyFlags& required, VkMemoryPropertyFlags& preferred);
 
 	  private:
-		device::GPU* gpu_;
-		VmaAllocator allocator_;
+		struct Pool {
+			std::vector<std::unique_ptr<MemoryBlock>> blocks;
+		};
+
+		struct HeapStats {
+			VkDeviceSize blockBytes		 = 0;
+			VkDeviceSize allocationBytes = 0;
+			bool		 overThreshold	 = false;
+		};
+
+		static constexpr size_t					   kCategoryCount	   = static_cast<size_t>(MemoryCategory::COUNT);
+		static constexpr std::chrono::milliseconds kBudgetPollInterval{100};
+
+		device::GPU*							 gpu_;
+		VkPhysicalDeviceMemoryProperties		 memoryProperties_{};
+		VkDeviceSize							 preferredBlockSize_ = 0;
+		VkDeviceSize							 nonCoherentAtomSize_ = 1;
+		std::vector<Pool>						 pools_; // memoryTypeCount * 2 (linear, optimal)
+		std::vector<HeapStats>					 heapStats_;
+		std::array<VkDeviceSize, kCategoryCount> categoryBytes_{};
+		std::array<uint32_t, kCategoryCount>	 categoryCounts_{};
+		float									 budgetThreshold_ = 0.9f;
+		BudgetCallback							 budgetCallback_;
+		uint32_t								 budgetDirtyHeaps_ = 0;
+		std::chrono::steady_clock::time_point	 lastBudgetPoll_{};
+		mutable std::mutex						 mutex_;
+
+		bool	 findMemoryTypeIndex(uint32_t typeBits, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred, uint32_t& outIndex) const;
+		bool	 allocateFromType(uint32_t typeIndex, const VkMemoryRequirements& baseRequirements, ResourceKind kind, AllocationInfo& outAllocation);
+		bool	 getAtomRange(const AllocationInfo& allocation, VkDeviceSize offset, VkDeviceSize size, VkMappedMemoryRange& outRange) const;
+		bool	 isCoherentType(uint32_t typeIndex) const {
+			return memoryProperties_.memoryTypes[typeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+		}
+		void	 destroyBlock(MemoryBlock& block);
+		void	 checkBudget();
+		uint32_t getHeapIndex(uint32_t typeIndex) const { return memoryProperties_.memoryTypes[typeIndex].heapIndex; }
+		Pool&	 getPool(uint32_t typeIndex, ResourceKind kind) { return pools_[typeIndex * 2 + (kind == ResourceKind::OPTIMAL ? 1 : 0)]; }
 	};
 
 } // namespace renderApi::memory
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,224 @@
+#include "stagingPool.hpp"
+
+#include "renderDevice.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+using namespace renderApi::memory;
+
+namespace {
+
+	inline VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) { return (value + alignment - 1) / alignment * alignment; }
+
+	VkDeviceSize getClassSize(VkDeviceSize size) {
+		if (size > StagingPool::kLargeChunkSize) return alignUp(size, StagingPool::kLargeChunkSize);
+
+		VkDeviceSize classSize = StagingPool::kMinChunkSize;
+		while (classSize < size) {
+			classSize *= 2;
+		}
+		return classSize;
+	}
+
+} // namespace
+
+// ============================================================================
+// StagingPool Implementation
+// ============================================================================
+
+StagingPool::StagingPool() : gpu_(nullptr), retainedBytes_(kDefaultRetainedBytes) {}
+
+StagingPool::~StagingPool() { cleanup(); }
+
+bool StagingPool::init(renderApi::device::GPU* gpu) {
+	if (!gpu || !gpu->device) {
+		std::cerr << "StagingPool: GPU not initialized" << std::endl;
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	gpu_ = gpu;
+	chunks_.clear();
+	return true;
+}
+
+void StagingPool::cleanup() {
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (!gpu_) return;
+
+	for (auto& chunk : chunks_) {
+		if (chunk.inUse) {
+			std::cerr << "StagingPool: Chunk of " << chunk.size << " bytes destroyed while in use" << std::endl;
+		}
+		destroyChunk(chunk);
+	}
+	chunks_.clear();
+	gpu_ = nullptr;
+}
+
+bool StagingPool::isIdle(Chunk& chunk) const {
+	if (chunk.inUse || chunk.buffer == VK_NULL_HANDLE) return false;
+	if (chunk.fence != VK_NULL_HANDLE) {
+		if (vkGetFenceStatus(gpu_->device, chunk.fence) != VK_SUCCESS) return false;
+		chunk.fence = VK_NULL_HANDLE;
+	}
+	if (chunk.timeline != VK_NULL_HANDLE) {
+		uint64_t value = 0;
+		if (vkGetSemaphoreCounterValue(gpu_->device, chunk.timeline, &value) != VK_SUCCESS || value < chunk.value) return false;
+		chunk.timeline = VK_NULL_HANDLE;
+	}
+	return true;
+}
+
+void StagingPool::destroyChunk(Chunk& chunk) {
+	if (chunk.buffer == VK_NULL_HANDLE) return;
+
+	gpu_->allocator.destroyBuffer(chunk.buffer, chunk.allocation);
+	chunk = Chunk{};
+}
+
+StagingAllocation StagingPool::acquire(VkDeviceSize size, StagingUsage usage) {
+	StagingAllocation result;
+	if (size == 0) return result;
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (!gpu_ || !gpu_->device) {
+		std::cerr << "StagingPool: Not initialized" << std::endl;
+		return result;
+	}
+
+	VkDeviceSize classSize = getClassSize(size);
+
+	uint32_t index = UINT32_MAX;
+	for (uint32_t i = 0; i < chunks_.size(); i++) {
+		if (chunks_[i].usage == usage && chunks_[i].size >= classSize && chunks_[i].size < classSize * 2 && isIdle(chunks_[i])) {
+			index = i;
+			break;
+		}
+	}
+
+	if (index == UINT32_MAX) {
+		Chunk chunk;
+		chunk.size	= classSize;
+		chunk.usage = usage;
+
+		MemoryUsage memoryUsage = usage == StagingUsage::READBACK ? MemoryUsage::GPU_TO_CPU : MemoryUsage::CPU_ONLY;
+		if (!gpu_->allocator.allocateBuffer(classSize,
+											VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+											memoryUsage,
+											chunk.buffer,
+											chunk.allocation,
+											MemoryCategory::STAGING)) {
+			// Give idle chunks of other classes back and retry once
+			trimLocked(0);
+			if (!gpu_->allocator.allocateBuffer(classSize,
+												VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+												memoryUsage,
+												chunk.buffer,
+												chunk.allocation,
+												MemoryCategory::STAGING)) {
+				std::cerr << "StagingPool: Failed to allocate " << classSize << " bytes" << std::endl;
+				return result;
+			}
+		}
+
+		auto slot = std::find_if(chunks_.begin(), chunks_.end(), [](const Chunk& c) { return c.buffer == VK_NULL_HANDLE; });
+		if (slot != chunks_.end()) {
+			*slot = chunk;
+			index = static_cast<uint32_t>(slot - chunks_.begin());
+		} else {
+			chunks_.push_back(chunk);
+			index = static_cast<uint32_t>(chunks_.size() - 1);
+		}
+	}
+
+	Chunk& chunk = chunks_[index];
+	chunk.inUse	 = true;
+
+	result.buffer = chunk.buffer;
+	result.offset = 0;
+	result.size	  = size;
+	result.data	  = chunk.allocation.mappedData;
+	result.chunk  = index;
+	return result;
+}
+
+void StagingPool::invalidate(const StagingAllocation& allocation) {
+	if (!allocation.isValid()) return;
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (allocation.chunk >= chunks_.size() || chunks_[allocation.chunk].buffer != allocation.buffer) return;
+
+	gpu_->allocator.invalidate(chunks_[allocation.chunk].allocation, allocation.offset, allocation.size);
+}
+
+void StagingPool::release(const StagingAllocation& allocation, VkFence fence) {
+	if (!allocation.isValid()) return;
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (allocation.chunk >= chunks_.size() || chunks_[allocation.chunk].buffer != allocation.buffer) return;
+
+	Chunk& chunk = chunks_[allocation.chunk];
+	chunk.inUse	 = false;
+	chunk.fence	 = fence;
+
+	trimLocked(retainedBytes_);
+}
+
+void StagingPool::release(const StagingAllocation& allocation, VkSemaphore timeline, uint64_t value) {
+	if (!allocation.isValid()) return;
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (allocation.chunk >= chunks_.size() || chunks_[allocation.chunk].buffer != allocation.buffer) return;
+
+	Chunk& chunk   = chunks_[allocation.chunk];
+	chunk.inUse	   = false;
+	chunk.timeline = timeline;
+	chunk.value	   = value;
+
+	trimLocked(retainedBytes_);
+}
+
+void StagingPool::trim() {
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (!gpu_) return;
+	trimLocked(0);
+}
+
+void StagingPool::trimLocked(VkDeviceSize keepBytes) {
+	VkDeviceSize idleBytes = 0;
+	for (auto& chunk : chunks_) {
+		if (!chunk.inUse) idleBytes += chunk.size;
+	}
+
+	// Largest chunks go first, they are the least likely to be reused soon
+	while (idleBytes > keepBytes) {
+		Chunk* largest = nullptr;
+		for (auto& chunk : chunks_) {
+			if (isIdle(chunk) && (!largest || chunk.size > largest->size)) largest = &chunk;
+		}
+		if (!largest) break;
+
+		idleBytes -= largest->size;
+		destroyChunk(*largest);
+	}
+}
+
+VkDeviceSize StagingPool::getChunkBytes() const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	VkDeviceSize bytes = 0;
+	for (const auto& chunk : chunks_) {
+		bytes += chunk.size;
+	}
+	return bytes;
+}
+
+uint32_t StagingPool::getChunkCount() const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return static_cast<uint32_t>(std::count_if(chunks_.begin(), chunks_.end(), [](const Chunk& c) { return c.buffer != VK_NULL_HANDLE; }));
+}
@@ -0,0 +1,90 @@
+#ifndef STAGING_POOL_HPP
+#define STAGING_POOL_HPP
+
+#include "memoryAllocator.hpp"
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+namespace renderApi::device {
+	struct GPU;
+}
+
+namespace renderApi::memory {
+
+	// Readback chunks prefer HOST_CACHED memory, which makes host reads fast but may not be coherent
+	enum class StagingUsage { UPLOAD, READBACK };
+
+	struct StagingAllocation {
+		VkBuffer	 buffer = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+		VkDeviceSize size	= 0;
+		void*		 data	= nullptr;
+		uint32_t	 chunk	= UINT32_MAX;
+
+		bool isValid() const { return data != nullptr; }
+	};
+
+	// Persistently mapped host memory for uploads and readbacks. Requests are rounded up to a size
+	// class (powers of two, then multiples of kLargeChunkSize) and served by a whole chunk of that
+	// class. Released chunks are kept for reuse once the fence of the submission that used them
+	// has signaled, so that steady state transfers never allocate memory.
+	class StagingPool {
+	  public:
+		static constexpr VkDeviceSize kMinChunkSize			= 64 * 1024;
+		static constexpr VkDeviceSize kLargeChunkSize		= 16 * 1024 * 1024;
+		static constexpr VkDeviceSize kDefaultRetainedBytes = 64 * 1024 * 1024;
+
+		StagingPool();
+		~StagingPool();
+
+		StagingPool(const StagingPool&)			   = delete;
+		StagingPool& operator=(const StagingPool&) = delete;
+
+		bool init(device::GPU* gpu);
+		void cleanup();
+
+		StagingAllocation acquire(VkDeviceSize size, StagingUsage usage = StagingUsage::UPLOAD);
+		// Makes what the device wrote to a readback allocation visible to the host
+		void invalidate(const StagingAllocation& allocation);
+
+		// The chunk is handed out again once fence has signaled; the fence must not be reset or
+		// destroyed before that. VK_NULL_HANDLE means the GPU is already done with it.
+		void release(const StagingAllocation& allocation, VkFence fence = VK_NULL_HANDLE);
+		// Same, for a submission that signals the timeline semaphore with value
+		void release(const StagingAllocation& allocation, VkSemaphore timeline, uint64_t value);
+
+		// Free every idle chunk
+		void trim();
+
+		void		 setRetainedBytes(VkDeviceSize bytes) { retainedBytes_ = bytes; }
+		VkDeviceSize getChunkBytes() const;
+		uint32_t	 getChunkCount() const;
+
+	  private:
+		struct Chunk {
+			VkBuffer	   buffer = VK_NULL_HANDLE;
+			AllocationInfo allocation;
+			VkDeviceSize   size		 = 0;
+			StagingUsage   usage	 = StagingUsage::UPLOAD;
+			VkFence		   fence	 = VK_NULL_HANDLE;
+			VkSemaphore	   timeline	 = VK_NULL_HANDLE;
+			uint64_t	   value	 = 0;
+			bool		   inUse	 = false;
+		};
+
+		device::GPU*	   gpu_;
+		std::vector<Chunk> chunks_; // Destroyed chunks leave an empty slot so that indices stay valid
+		VkDeviceSize	   retainedBytes_;
+		mutable std::mutex mutex_;
+
+		bool isIdle(Chunk& chunk) const;
+		void destroyChunk(Chunk& chunk);
+		void trimLocked(VkDeviceSize keepBytes);
+	};
+
+} // namespace renderApi::memory
+
+#endif
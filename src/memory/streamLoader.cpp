@@ -0,0 +1,404 @@
+#include "streamLoader.hpp"
+
+#include "buffer/buffer.hpp"
+#include "image/image.hpp"
+#include "renderDevice.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+using namespace renderApi::memory;
+
+namespace {
+
+	// Read-only mapping of a whole file
+	class MappedFile {
+	  public:
+		~MappedFile() {
+			if (data_) munmap(const_cast<char*>(data_), size_);
+			if (fd_ >= 0) close(fd_);
+		}
+
+		bool open(const std::string& path) {
+			fd_ = ::open(path.c_str(), O_RDONLY);
+			if (fd_ < 0) return false;
+
+			struct stat info;
+			if (fstat(fd_, &info) != 0) return false;
+			size_ = static_cast<size_t>(info.st_size);
+			if (size_ == 0) return true;
+
+			void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+			if (data == MAP_FAILED) return false;
+			data_ = static_cast<const char*>(data);
+
+			madvise(data, size_, MADV_SEQUENTIAL);
+			return true;
+		}
+
+		const char* data() const { return data_; }
+		size_t		size() const { return size_; }
+
+	  private:
+		int			fd_	  = -1;
+		const char* data_ = nullptr;
+		size_t		size_ = 0;
+	};
+
+	// The mapping starts on a page boundary, so rounding the start down stays inside it
+	void advise(const char* begin, VkDeviceSize size, int advice) {
+		if (size == 0) return;
+
+		static const uintptr_t pageSize = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+		uintptr_t			   start	= reinterpret_cast<uintptr_t>(begin) / pageSize * pageSize;
+		uintptr_t			   end		= reinterpret_cast<uintptr_t>(begin) + size;
+		madvise(reinterpret_cast<void*>(start), end - start, advice);
+	}
+
+} // namespace
+
+// ============================================================================
+// StreamLoader Implementation
+// ============================================================================
+
+StreamLoader::StreamLoader()
+	: gpu_(nullptr), queue_(VK_NULL_HANDLE), commandPool_(VK_NULL_HANDLE), chunkSize_(0), loadedBytes_(0), totalBytes_(0) {}
+
+StreamLoader::~StreamLoader() { destroy(); }
+
+bool StreamLoader::create(renderApi::device::GPU* gpu, VkDeviceSize chunkSize) {
+	destroy();
+
+	if (!gpu || !gpu->device || chunkSize == 0) {
+		std::cerr << "StreamLoader: Invalid parameters" << std::endl;
+		return false;
+	}
+
+	// Same family as GPU::oneTimeCommands, so the destinations need no ownership transfer
+	queue_ = !gpu->graphicsQueues.empty() ? gpu->graphicsQueues[0] : !gpu->computeQueues.empty() ? gpu->computeQueues[0] : VK_NULL_HANDLE;
+	if (queue_ == VK_NULL_HANDLE) {
+		std::cerr << "StreamLoader: No graphics or compute queue" << std::endl;
+		return false;
+	}
+
+	gpu_	   = gpu;
+	chunkSize_ = chunkSize;
+
+	VkCommandPoolCreateInfo poolInfo{};
+	poolInfo.sType			  = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.queueFamilyIndex = gpu_->queueFamilies.graphicsFamily >= 0 ? gpu_->queueFamilies.graphicsFamily : gpu_->queueFamilies.computeFamily;
+	poolInfo.flags			  = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+	if (vkCreateCommandPool(gpu_->device, &poolInfo, nullptr, &commandPool_) != VK_SUCCESS) {
+		std::cerr << "StreamLoader: Failed to create command pool" << std::endl;
+		commandPool_ = VK_NULL_HANDLE;
+		return false;
+	}
+
+	for (auto& slot : slots_) {
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType				 = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool		 = commandPool_;
+		allocInfo.level				 = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandBufferCount = 1;
+
+		VkFenceCreateInfo fenceInfo{};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+		if (vkAllocateCommandBuffers(gpu_->device, &allocInfo, &slot.commandBuffer) != VK_SUCCESS ||
+			vkCreateFence(gpu_->device, &fenceInfo, nullptr, &slot.fence) != VK_SUCCESS) {
+			std::cerr << "StreamLoader: Failed to create command buffers" << std::endl;
+			destroy();
+			return false;
+		}
+
+		slot.staging = gpu_->stagingPool.acquire(chunkSize_);
+		if (!slot.staging.isValid()) {
+			std::cerr << "StreamLoader: Failed to allocate " << chunkSize_ << " bytes of staging memory" << std::endl;
+			destroy();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void StreamLoader::destroy() {
+	if (commandPool_ == VK_NULL_HANDLE) return;
+
+	for (auto& slot : slots_) {
+		waitSlot(slot);
+		if (slot.staging.isValid()) {
+			gpu_->stagingPool.release(slot.staging);
+		}
+		if (slot.fence != VK_NULL_HANDLE) {
+			vkDestroyFence(gpu_->device, slot.fence, nullptr);
+		}
+		slot = Slot{};
+	}
+
+	// Frees the command buffers
+	vkDestroyCommandPool(gpu_->device, commandPool_, nullptr);
+	commandPool_ = VK_NULL_HANDLE;
+	queue_		 = VK_NULL_HANDLE;
+	gpu_		 = nullptr;
+}
+
+void StreamLoader::report(VkDeviceSize bytes) {
+	loadedBytes_ += bytes;
+	if (callback_) callback_(loadedBytes_, totalBytes_);
+}
+
+bool StreamLoader::waitSlot(Slot& slot) {
+	if (slot.bytes == 0) return true;
+
+	VkResult result = vkWaitForFences(gpu_->device, 1, &slot.fence, VK_TRUE, UINT64_MAX);
+	vkResetFences(gpu_->device, 1, &slot.fence);
+
+	VkDeviceSize bytes = slot.bytes;
+	slot.bytes		   = 0;
+	if (result != VK_SUCCESS) {
+		std::cerr << "StreamLoader: Failed to wait for a chunk copy" << std::endl;
+		return false;
+	}
+
+	report(bytes);
+	return true;
+}
+
+bool StreamLoader::submit(Slot& slot) {
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType			  = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers	  = &slot.commandBuffer;
+
+	std::lock_guard<std::mutex> lock(gpu_->queueMutex);
+	if (vkQueueSubmit(queue_, 1, &submitInfo, slot.fence) != VK_SUCCESS) {
+		std::cerr << "StreamLoader: Failed to submit a chunk copy" << std::endl;
+		slot.bytes = 0;
+		return false;
+	}
+	return true;
+}
+
+bool StreamLoader::stream(const char* data, VkDeviceSize size, VkDeviceSize granularity, const RecordChunk& record) {
+	VkDeviceSize chunk = chunkSize_ / granularity * granularity;
+	if (chunk == 0) {
+		std::cerr << "StreamLoader: Chunk size is smaller than one row" << std::endl;
+		return false;
+	}
+
+	bool	 success = true;
+	uint32_t next	 = 0;
+	for (VkDeviceSize begin = 0; begin < size && success; begin += chunk) {
+		VkDeviceSize bytes = std::min(chunk, size - begin);
+		Slot&		 slot  = slots_[next];
+		next			   = (next + 1) % static_cast<uint32_t>(slots_.size());
+
+		// The copy that last used this staging chunk must be done; the other one keeps the GPU busy
+		if (!waitSlot(slot)) {
+			success = false;
+			break;
+		}
+
+		// Disk reads of the next chunk overlap with this chunk's memcpy and copy
+		advise(data + begin + bytes, std::min(chunk, size - begin - bytes), MADV_WILLNEED);
+		memcpy(slot.staging.data, data + begin, bytes);
+		// Keeps the resident set at the chunks in flight; the pages stay in the page cache
+		advise(data + begin, bytes, MADV_DONTNEED);
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		vkResetCommandBuffer(slot.commandBuffer, 0);
+		vkBeginCommandBuffer(slot.commandBuffer, &beginInfo);
+		record(slot.commandBuffer, slot.staging, begin, bytes, begin == 0, begin + bytes == size);
+		vkEndCommandBuffer(slot.commandBuffer);
+
+		slot.bytes = bytes;
+		success	   = submit(slot);
+	}
+
+	for (auto& slot : slots_) {
+		success = waitSlot(slot) && success;
+	}
+	return success;
+}
+
+bool StreamLoader::load(const std::string& path, renderApi::Buffer& buffer, VkDeviceSize bufferOffset, VkDeviceSize fileOffset, VkDeviceSize size) {
+	if (!isValid() || !buffer.isValid()) return false;
+
+	MappedFile file;
+	if (!file.open(path)) {
+		std::cerr << "StreamLoader: Failed to map " << path << std::endl;
+		return false;
+	}
+	if (fileOffset > file.size()) {
+		std::cerr << "StreamLoader: Offset is past the end of " << path << std::endl;
+		return false;
+	}
+	if (size == 0) size = file.size() - fileOffset;
+	if (fileOffset + size > file.size() || bufferOffset + size > buffer.getSize()) {
+		std::cerr << "StreamLoader: Load range exceeds file or buffer size" << std::endl;
+		return false;
+	}
+
+	const char* data = file.data() + fileOffset;
+	loadedBytes_	 = 0;
+	totalBytes_		 = size;
+
+	// Copies collected earlier on this thread may target the same buffer
+	if (UploadBatch* batch = gpu_->getUploadBatch()) batch->submit();
+	renderApi::device::UploadLock uploadLock(gpu_);
+
+	if (buffer.usesHostVisibleMapping()) {
+		for (VkDeviceSize begin = 0; begin < size; begin += chunkSize_) {
+			VkDeviceSize bytes = std::min(chunkSize_, size - begin);
+			advise(data + begin + bytes, std::min(chunkSize_, size - begin - bytes), MADV_WILLNEED);
+			if (!buffer.upload(data + begin, bytes, bufferOffset + begin)) return false;
+			advise(data + begin, bytes, MADV_DONTNEED);
+			report(bytes);
+		}
+		return true;
+	}
+
+	VkBuffer dst = buffer.getHandle();
+
+	auto record = [&](VkCommandBuffer cmd, const StagingAllocation& staging, VkDeviceSize begin, VkDeviceSize bytes, bool first, bool last) {
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+
+		if (first) {
+			barrier.srcAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+		}
+
+		VkBufferCopy copyRegion{};
+		copyRegion.srcOffset = staging.offset;
+		copyRegion.dstOffset = bufferOffset + begin;
+		copyRegion.size		 = bytes;
+		vkCmdCopyBuffer(cmd, staging.buffer, dst, 1, &copyRegion);
+
+		// Covers the copies of every earlier chunk as well, they were submitted before on this queue
+		if (last) {
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+			vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+		}
+	};
+
+	return stream(data, size, 1, record);
+}
+
+bool StreamLoader::load(const std::string& path, renderApi::Image& image, VkDeviceSize fileOffset) {
+	if (!isValid() || !image.isValid()) return false;
+
+	MappedFile file;
+	if (!file.open(path)) {
+		std::cerr << "StreamLoader: Failed to map " << path << std::endl;
+		return false;
+	}
+
+	renderApi::FormatBlock block = renderApi::getFormatBlock(image.format_);
+	if (block.size == 0) {
+		std::cerr << "StreamLoader: Unknown texel size for the format of " << path << std::endl;
+		return false;
+	}
+
+	// Every row of blocks of every depth slice of every layer, in that order
+	VkDeviceSize blockRows = (image.height_ + block.height - 1) / block.height;
+	VkDeviceSize rowSize   = static_cast<VkDeviceSize>((image.width_ + block.width - 1) / block.width) * block.size;
+	VkDeviceSize rowCount  = blockRows * image.depth_ * image.arrayLayers_;
+	VkDeviceSize size	   = fileOffset < file.size() ? file.size() - fileOffset : 0;
+	if (size != rowSize * rowCount) {
+		std::cerr << "StreamLoader: " << path << " holds " << size << " bytes, mip level 0 of the image takes " << rowSize * rowCount
+				  << std::endl;
+		return false;
+	}
+
+	const char* data = file.data() + fileOffset;
+	loadedBytes_	 = 0;
+	totalBytes_		 = size;
+
+	if (UploadBatch* batch = gpu_->getUploadBatch()) batch->submit();
+	renderApi::device::UploadLock uploadLock(gpu_);
+
+	VkImageMemoryBarrier barrier{};
+	barrier.sType							= VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcQueueFamilyIndex				= VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex				= VK_QUEUE_FAMILY_IGNORED;
+	barrier.image							= image.image_;
+	barrier.subresourceRange.aspectMask		= image.aspectMask_;
+	barrier.subresourceRange.baseMipLevel	= 0;
+	barrier.subresourceRange.levelCount		= image.mipLevels_;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount		= image.arrayLayers_;
+
+	bool						   transitioned = false;
+	std::vector<VkBufferImageCopy> regions;
+
+	auto record = [&](VkCommandBuffer cmd, const StagingAllocation& staging, VkDeviceSize begin, VkDeviceSize bytes, bool first, bool last) {
+		if (first) {
+			barrier.oldLayout	  = image.convertLayout(image.currentLayout_);
+			barrier.newLayout	  = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			barrier.srcAccessMask = barrier.oldLayout == VK_IMAGE_LAYOUT_UNDEFINED ? 0 : VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+			transitioned = true;
+		}
+
+		// One region per run of rows within a depth slice
+		regions.clear();
+		VkDeviceSize endRow = (begin + bytes) / rowSize;
+		for (VkDeviceSize row = begin / rowSize; row < endRow;) {
+			VkDeviceSize slice = row / blockRows;
+			uint32_t	 y	   = static_cast<uint32_t>(row % blockRows) * block.height;
+			uint32_t	 rows  = static_cast<uint32_t>(std::min<VkDeviceSize>(blockRows - row % blockRows, endRow - row));
+
+			VkBufferImageCopy region{};
+			region.bufferOffset					   = staging.offset + row * rowSize - begin;
+			region.bufferRowLength				   = 0;
+			region.bufferImageHeight			   = 0;
+			region.imageSubresource.aspectMask	   = image.aspectMask_;
+			region.imageSubresource.mipLevel	   = 0;
+			region.imageSubresource.baseArrayLayer = static_cast<uint32_t>(slice / image.depth_);
+			region.imageSubresource.layerCount	   = 1;
+			region.imageOffset					   = {0, static_cast<int32_t>(y), static_cast<int32_t>(slice % image.depth_)};
+			region.imageExtent					   = {image.width_, std::min(rows * block.height, image.height_ - y), 1};
+			regions.push_back(region);
+
+			row += rows;
+		}
+
+		vkCmdCopyBufferToImage(cmd, staging.buffer, image.image_, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.size()), regions.data());
+
+		if (last) {
+			barrier.oldLayout	  = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			barrier.newLayout	  = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+		}
+	};
+
+	bool success = stream(data, size, rowSize, record);
+
+	if (success) {
+		image.currentLayout_ = renderApi::ImageLayout::SHADER_READ_ONLY;
+	} else if (transitioned) {
+		image.currentLayout_ = renderApi::ImageLayout::TRANSFER_DST;
+	}
+	return success;
+}
@@ -0,0 +1,85 @@
+#ifndef STREAM_LOADER_HPP
+#define STREAM_LOADER_HPP
+
+#include "stagingPool.hpp"
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vulkan/vulkan_core.h>
+
+namespace renderApi {
+	class Buffer;
+	class Image;
+} // namespace renderApi
+
+namespace renderApi::device {
+	struct GPU;
+}
+
+namespace renderApi::memory {
+
+	// Loads files into device local resources without reading them into host memory first. The file
+	// is memory-mapped and copied chunk by chunk through two staging chunks: while the GPU copies one,
+	// the next is filled from the mapping, and the kernel reads ahead the chunk after it. Host memory
+	// use stays at two chunks plus the pages being read, whatever the file size.
+	//
+	// Loads are synchronous and a loader is used by one thread at a time.
+	class StreamLoader {
+	  public:
+		// Called after each chunk reached the destination
+		using ProgressCallback = std::function<void(VkDeviceSize loadedBytes, VkDeviceSize totalBytes)>;
+
+		static constexpr VkDeviceSize kDefaultChunkSize = StagingPool::kLargeChunkSize;
+
+		StreamLoader();
+		~StreamLoader();
+
+		StreamLoader(const StreamLoader&)			 = delete;
+		StreamLoader& operator=(const StreamLoader&) = delete;
+
+		bool create(device::GPU* gpu, VkDeviceSize chunkSize = kDefaultChunkSize);
+		void destroy();
+
+		void setProgressCallback(ProgressCallback callback) { callback_ = std::move(callback); }
+
+		// Copies size bytes of the file from fileOffset, or everything after it when size is 0
+		bool load(const std::string& path, Buffer& buffer, VkDeviceSize bufferOffset = 0, VkDeviceSize fileOffset = 0, VkDeviceSize size = 0);
+		// The file holds exactly mip level 0 of every layer, as tightly packed rows of texel blocks.
+		// Leaves the image in SHADER_READ_ONLY layout.
+		bool load(const std::string& path, Image& image, VkDeviceSize fileOffset = 0);
+
+		VkDeviceSize getChunkSize() const { return chunkSize_; }
+		bool		 isValid() const { return commandPool_ != VK_NULL_HANDLE; }
+
+	  private:
+		struct Slot {
+			StagingAllocation staging;
+			VkCommandBuffer	  commandBuffer = VK_NULL_HANDLE;
+			VkFence			  fence			= VK_NULL_HANDLE;
+			VkDeviceSize	  bytes			= 0; // In flight, reported once the fence signaled
+		};
+
+		// Records the copies of the size bytes at begin, staged at the start of staging
+		using RecordChunk = std::function<void(VkCommandBuffer cmd, const StagingAllocation& staging, VkDeviceSize begin, VkDeviceSize size, bool first, bool last)>;
+
+		device::GPU*		gpu_;
+		VkQueue				queue_;
+		VkCommandPool		commandPool_;
+		VkDeviceSize		chunkSize_;
+		std::array<Slot, 2> slots_;
+		VkDeviceSize		loadedBytes_;
+		VkDeviceSize		totalBytes_;
+		ProgressCallback	callback_;
+
+		// Chunks are multiples of granularity
+		bool stream(const char* data, VkDeviceSize size, VkDeviceSize granularity, const RecordChunk& record);
+		void report(VkDeviceSize bytes);
+		bool waitSlot(Slot& slot);
+		bool submit(Slot& slot);
+	};
+
+} // namespace renderApi::memory
+
+#endif
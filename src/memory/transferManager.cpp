@@ -0,0 +1,585 @@
+#include "transferManager.hpp"
+
+#include "buffer/buffer.hpp"
+#include "image/image.hpp"
+#include "renderDevice.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+using namespace renderApi::memory;
+
+namespace {
+
+	// Covers the texel size of every uncompressed format and the block size of compressed ones
+	constexpr VkDeviceSize kStagingAlignment = 16;
+
+	inline VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) { return (value + alignment - 1) / alignment * alignment; }
+
+} // namespace
+
+// ============================================================================
+// TransferManager Implementation
+// ============================================================================
+
+TransferManager::TransferManager()
+	: gpu_(nullptr), queue_(VK_NULL_HANDLE), srcFamily_(0), dstFamily_(0), commandPool_(VK_NULL_HANDLE), semaphore_(VK_NULL_HANDLE),
+	  submittedValue_(0), openBatch_(UINT32_MAX) {}
+
+TransferManager::~TransferManager() { cleanup(); }
+
+bool TransferManager::init(renderApi::device::GPU* gpu) {
+	cleanup();
+
+	if (!gpu || !gpu->device) {
+		std::cerr << "TransferManager: GPU not initialized" << std::endl;
+		return false;
+	}
+
+	gpu_ = gpu;
+
+	// Resources end up owned by the family of the shared command pool, where GpuTasks record
+	int dstFamily = gpu_->queueFamilies.graphicsFamily >= 0 ? gpu_->queueFamilies.graphicsFamily : gpu_->queueFamilies.computeFamily;
+	if (dstFamily < 0) {
+		std::cerr << "TransferManager: No graphics or compute queue family" << std::endl;
+		gpu_ = nullptr;
+		return false;
+	}
+	dstFamily_ = static_cast<uint32_t>(dstFamily);
+
+	if (!gpu_->transferQueues.empty() && gpu_->queueFamilies.transferFamily >= 0) {
+		queue_	   = gpu_->transferQueues[0];
+		srcFamily_ = static_cast<uint32_t>(gpu_->queueFamilies.transferFamily);
+	} else {
+		queue_	   = !gpu_->graphicsQueues.empty() ? gpu_->graphicsQueues[0] : !gpu_->computeQueues.empty() ? gpu_->computeQueues[0] : VK_NULL_HANDLE;
+		srcFamily_ = dstFamily_;
+	}
+	if (queue_ == VK_NULL_HANDLE) {
+		std::cerr << "TransferManager: No queue available" << std::endl;
+		gpu_ = nullptr;
+		return false;
+	}
+
+	VkCommandPoolCreateInfo poolInfo{};
+	poolInfo.sType			  = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.queueFamilyIndex = srcFamily_;
+	poolInfo.flags			  = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+	if (vkCreateCommandPool(gpu_->device, &poolInfo, nullptr, &commandPool_) != VK_SUCCESS) {
+		std::cerr << "TransferManager: Failed to create command pool" << std::endl;
+		commandPool_ = VK_NULL_HANDLE;
+		gpu_		 = nullptr;
+		return false;
+	}
+
+	VkSemaphoreTypeCreateInfo typeInfo{};
+	typeInfo.sType		   = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+	typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	typeInfo.initialValue  = 0;
+
+	VkSemaphoreCreateInfo semaphoreInfo{};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	semaphoreInfo.pNext = &typeInfo;
+
+	if (vkCreateSemaphore(gpu_->device, &semaphoreInfo, nullptr, &semaphore_) != VK_SUCCESS) {
+		std::cerr << "TransferManager: Failed to create timeline semaphore" << std::endl;
+		semaphore_ = VK_NULL_HANDLE;
+		cleanup();
+		return false;
+	}
+
+	submittedValue_ = 0;
+	openBatch_		= UINT32_MAX;
+	return true;
+}
+
+void TransferManager::cleanup() {
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (!gpu_ || !gpu_->device) return;
+
+	if (semaphore_ != VK_NULL_HANDLE) {
+		VkSemaphoreWaitInfo waitInfo{};
+		waitInfo.sType			= VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+		waitInfo.semaphoreCount = 1;
+		waitInfo.pSemaphores	= &semaphore_;
+		waitInfo.pValues		= &submittedValue_;
+		vkWaitSemaphores(gpu_->device, &waitInfo, UINT64_MAX);
+	}
+
+	// The batch still recording was never submitted, its staging memory is free to reuse
+	if (openBatch_ != UINT32_MAX) {
+		for (auto& staging : batches_[openBatch_].staging) {
+			gpu_->stagingPool.release(staging);
+		}
+	}
+
+	if (commandPool_ != VK_NULL_HANDLE) {
+		vkDestroyCommandPool(gpu_->device, commandPool_, nullptr);
+		commandPool_ = VK_NULL_HANDLE;
+	}
+
+	if (semaphore_ != VK_NULL_HANDLE) {
+		vkDestroySemaphore(gpu_->device, semaphore_, nullptr);
+		semaphore_ = VK_NULL_HANDLE;
+	}
+
+	batches_.clear();
+	acquires_.clear();
+	recordedAcquires_.clear();
+	openBatch_ = UINT32_MAX;
+	queue_	   = VK_NULL_HANDLE;
+	gpu_	   = nullptr;
+}
+
+uint64_t TransferManager::getCompletedValue() const {
+	uint64_t value = 0;
+	if (vkGetSemaphoreCounterValue(gpu_->device, semaphore_, &value) != VK_SUCCESS) return 0;
+	return value;
+}
+
+TransferManager::Batch* TransferManager::beginBatch() {
+	if (openBatch_ != UINT32_MAX) return &batches_[openBatch_];
+
+	uint64_t completed = getCompletedValue();
+
+	uint32_t index = UINT32_MAX;
+	for (uint32_t i = 0; i < batches_.size(); i++) {
+		if (batches_[i].value <= completed) {
+			index = i;
+			break;
+		}
+	}
+
+	if (index == UINT32_MAX) {
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType				 = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool		 = commandPool_;
+		allocInfo.level				 = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandBufferCount = 1;
+
+		Batch batch;
+		if (vkAllocateCommandBuffers(gpu_->device, &allocInfo, &batch.commandBuffer) != VK_SUCCESS) {
+			std::cerr << "TransferManager: Failed to allocate command buffer" << std::endl;
+			return nullptr;
+		}
+		batches_.push_back(std::move(batch));
+		index = static_cast<uint32_t>(batches_.size() - 1);
+	}
+
+	Batch& batch = batches_[index];
+	vkResetCommandBuffer(batch.commandBuffer, 0);
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	if (vkBeginCommandBuffer(batch.commandBuffer, &beginInfo) != VK_SUCCESS) {
+		std::cerr << "TransferManager: Failed to begin command buffer" << std::endl;
+		return nullptr;
+	}
+
+	batch.value		  = submittedValue_ + 1;
+	batch.bytes		  = 0;
+	batch.stagingUsed = 0;
+	batch.staging.clear();
+	batch.buffers.clear();
+	batch.images.clear();
+
+	openBatch_ = index;
+	return &batch;
+}
+
+bool TransferManager::allocateStaging(Batch& batch, VkDeviceSize size, StagingAllocation& outStaging) {
+	// Small uploads share the batch's current chunk
+	if (!batch.staging.empty()) {
+		const StagingAllocation& chunk	= batch.staging.back();
+		VkDeviceSize			 offset = alignUp(batch.stagingUsed, kStagingAlignment);
+		if (offset + size <= chunk.size) {
+			outStaging		  = chunk;
+			outStaging.offset = chunk.offset + offset;
+			outStaging.size	  = size;
+			outStaging.data	  = static_cast<char*>(chunk.data) + offset;
+			batch.stagingUsed = offset + size;
+			return true;
+		}
+	}
+
+	StagingAllocation chunk = gpu_->stagingPool.acquire(std::max(size, kBatchStagingSize));
+	if (!chunk.isValid()) return false;
+
+	batch.staging.push_back(chunk);
+	batch.stagingUsed = size;
+
+	outStaging		= chunk;
+	outStaging.size = size;
+	return true;
+}
+
+bool TransferManager::upload(renderApi::Buffer& buffer, const void* data, VkDeviceSize size, VkDeviceSize offset, TransferTicket& outTicket) {
+	outTicket = TransferTicket{};
+	if (!isValid() || !buffer.isValid() || !data || size == 0) return false;
+	if (offset + size > buffer.getSize()) {
+		std::cerr << "TransferManager: Upload size exceeds buffer size" << std::endl;
+		return false;
+	}
+
+	if (buffer.usesHostVisibleMapping()) {
+		return buffer.upload(data, size, offset);
+	}
+
+	// The batch stays open, so the defragmenter sees it as pending work once this returns
+	renderApi::device::UploadLock uploadLock(gpu_);
+	std::lock_guard<std::mutex>	  lock(mutex_);
+
+	Batch* batch = beginBatch();
+	if (!batch) return false;
+
+	StagingAllocation staging;
+	if (!allocateStaging(*batch, size, staging)) {
+		std::cerr << "TransferManager: Failed to allocate " << size << " bytes of staging memory" << std::endl;
+		return false;
+	}
+	memcpy(staging.data, data, size);
+
+	VkBuffer handle = buffer.getHandle();
+	if (std::find(batch->buffers.begin(), batch->buffers.end(), handle) != batch->buffers.end()) {
+		// Ranges of one buffer may overlap within a batch
+		VkMemoryBarrier barrier{};
+		barrier.sType		  = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		vkCmdPipelineBarrier(batch->commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+	} else {
+		batch->buffers.push_back(handle);
+	}
+
+	VkBufferCopy copyRegion{};
+	copyRegion.srcOffset = staging.offset;
+	copyRegion.dstOffset = offset;
+	copyRegion.size		 = size;
+	vkCmdCopyBuffer(batch->commandBuffer, staging.buffer, handle, 1, &copyRegion);
+
+	batch->bytes += size;
+	outTicket.value = batch->value;
+
+	if (batch->bytes >= kMaxBatchBytes) flushLocked();
+	return true;
+}
+
+bool TransferManager::upload(renderApi::Image& image, const void* data, VkDeviceSize size, TransferTicket& outTicket) {
+	outTicket = TransferTicket{};
+	if (!isValid() || !image.isValid() || !data || size == 0) return false;
+
+	// The copy reads all of mip level 0, for every layer
+	VkDeviceSize levelSize = renderApi::getMipLevelSize(image.format_, image.width_, image.height_, image.depth_, 0) * image.arrayLayers_;
+	if (levelSize > 0) {
+		if (size < levelSize) {
+			std::cerr << "TransferManager: Upload of " << size << " bytes is smaller than mip level 0 (" << levelSize << " bytes)" << std::endl;
+			return false;
+		}
+		size = levelSize;
+	}
+
+	renderApi::device::UploadLock uploadLock(gpu_);
+	std::lock_guard<std::mutex>	  lock(mutex_);
+
+	Batch* batch = beginBatch();
+	if (!batch) return false;
+
+	StagingAllocation staging;
+	if (!allocateStaging(*batch, size, staging)) {
+		std::cerr << "TransferManager: Failed to allocate " << size << " bytes of staging memory" << std::endl;
+		return false;
+	}
+	memcpy(staging.data, data, size);
+
+	VkImageMemoryBarrier barrier{};
+	barrier.sType							= VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcQueueFamilyIndex				= VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex				= VK_QUEUE_FAMILY_IGNORED;
+	barrier.image							= image.image_;
+	barrier.subresourceRange.aspectMask		= image.aspectMask_;
+	barrier.subresourceRange.baseMipLevel	= 0;
+	barrier.subresourceRange.levelCount		= image.mipLevels_;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount		= image.arrayLayers_;
+
+	if (std::find(batch->images.begin(), batch->images.end(), &image) != batch->images.end()) {
+		// Already in TRANSFER_DST layout from an earlier upload of this batch
+		barrier.oldLayout	  = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout	  = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		vkCmdPipelineBarrier(batch->commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+	} else {
+		// The previous contents are discarded, which also makes an ownership transfer to this queue unnecessary
+		barrier.oldLayout	  = VK_IMAGE_LAYOUT_UNDEFINED;
+		barrier.newLayout	  = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		vkCmdPipelineBarrier(batch->commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+		batch->images.push_back(&image);
+	}
+
+	VkBufferImageCopy region{};
+	region.bufferOffset					   = staging.offset;
+	region.bufferRowLength				   = 0;
+	region.bufferImageHeight			   = 0;
+	region.imageSubresource.aspectMask	   = image.aspectMask_;
+	region.imageSubresource.mipLevel	   = 0;
+	region.imageSubresource.baseArrayLayer = 0;
+	region.imageSubresource.layerCount	   = image.arrayLayers_;
+	region.imageOffset					   = {0, 0, 0};
+	region.imageExtent					   = {image.width_, image.height_, image.depth_};
+
+	vkCmdCopyBufferToImage(batch->commandBuffer, staging.buffer, image.image_, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+	// Layout the image has once the batch executed and, across families, once it was acquired
+	image.currentLayout_ = renderApi::ImageLayout::SHADER_READ_ONLY;
+
+	batch->bytes += size;
+	outTicket.value = batch->value;
+
+	if (batch->bytes >= kMaxBatchBytes) flushLocked();
+	return true;
+}
+
+void TransferManager::flush() {
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (!isValid()) return;
+	flushLocked();
+}
+
+void TransferManager::flushLocked() {
+	if (openBatch_ == UINT32_MAX) return;
+
+	Batch& batch = batches_[openBatch_];
+	openBatch_	 = UINT32_MAX;
+
+	const bool ownership = transfersOwnership();
+
+	// Buffers are shared with the transfer family and only need their writes made visible; images
+	// are handed over to the other family, all in a single barrier
+	imageBarriers_.clear();
+
+	for (Image* image : batch.images) {
+		VkImageMemoryBarrier barrier{};
+		barrier.sType							= VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.oldLayout						= VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout						= VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barrier.srcAccessMask					= VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask					= ownership ? 0 : VK_ACCESS_SHADER_READ_BIT;
+		barrier.srcQueueFamilyIndex				= ownership ? srcFamily_ : VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex				= ownership ? dstFamily_ : VK_QUEUE_FAMILY_IGNORED;
+		barrier.image							= image->image_;
+		barrier.subresourceRange.aspectMask		= image->aspectMask_;
+		barrier.subresourceRange.baseMipLevel	= 0;
+		barrier.subresourceRange.levelCount		= image->mipLevels_;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount		= image->arrayLayers_;
+		imageBarriers_.push_back(barrier);
+
+		if (ownership) {
+			Acquire acquire;
+			acquire.value = batch.value;
+			acquire.image = barrier.image;
+			acquire.range = barrier.subresourceRange;
+			addAcquire(acquire);
+		}
+	}
+
+	VkMemoryBarrier barrier{};
+	barrier.sType		  = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+	vkCmdPipelineBarrier(batch.commandBuffer,
+						 VK_PIPELINE_STAGE_TRANSFER_BIT,
+						 VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+						 0,
+						 1,
+						 &barrier,
+						 0,
+						 nullptr,
+						 static_cast<uint32_t>(imageBarriers_.size()),
+						 imageBarriers_.data());
+
+	if (vkEndCommandBuffer(batch.commandBuffer) != VK_SUCCESS) {
+		std::cerr << "TransferManager: Failed to end command buffer" << std::endl;
+	}
+
+	VkTimelineSemaphoreSubmitInfo timelineInfo{};
+	timelineInfo.sType					   = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	timelineInfo.signalSemaphoreValueCount = 1;
+	timelineInfo.pSignalSemaphoreValues	   = &batch.value;
+
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType				= VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.pNext				= &timelineInfo;
+	submitInfo.commandBufferCount	= 1;
+	submitInfo.pCommandBuffers		= &batch.commandBuffer;
+	submitInfo.signalSemaphoreCount = 1;
+	submitInfo.pSignalSemaphores	= &semaphore_;
+
+	VkResult result;
+	{
+		std::lock_guard<std::mutex> lock(gpu_->queueMutex);
+		result = vkQueueSubmit(queue_, 1, &submitInfo, VK_NULL_HANDLE);
+	}
+
+	if (result != VK_SUCCESS) {
+		// The uploads are lost; still reach the value so that nothing waits on it forever
+		std::cerr << "TransferManager: Failed to submit batch: " << result << std::endl;
+
+		VkSemaphoreSignalInfo signalInfo{};
+		signalInfo.sType	 = VK_STRUCTURE_TYPE_SEMAPHORE_SIGNAL_INFO;
+		signalInfo.semaphore = semaphore_;
+		signalInfo.value	 = batch.value;
+		vkSignalSemaphore(gpu_->device, &signalInfo);
+	}
+
+	submittedValue_ = batch.value;
+
+	for (auto& staging : batch.staging) {
+		gpu_->stagingPool.release(staging, semaphore_, batch.value);
+	}
+	batch.staging.clear();
+}
+
+void TransferManager::addAcquire(const Acquire& acquire) {
+	// An image released again before it was acquired only needs the latest acquire
+	auto it = std::find_if(acquires_.begin(), acquires_.end(), [&](const Acquire& a) { return a.image == acquire.image; });
+	if (it != acquires_.end()) {
+		*it = acquire;
+	} else {
+		acquires_.push_back(acquire);
+	}
+}
+
+bool TransferManager::hasAcquires(uint64_t value) const {
+	return std::any_of(acquires_.begin(), acquires_.end(), [&](const Acquire& a) { return a.value <= value; });
+}
+
+bool TransferManager::isComplete(TransferTicket ticket) const {
+	if (!ticket.isValid()) return true;
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	return isValid() && ticket.value <= submittedValue_ && getCompletedValue() >= ticket.value;
+}
+
+void TransferManager::acquireCompleted() {
+	uint64_t completed;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (!isValid()) return;
+		completed = std::min(getCompletedValue(), submittedValue_);
+		if (!hasAcquires(completed)) return;
+	}
+	acquire(completed);
+}
+
+void TransferManager::acquire(uint64_t value) {
+	VkCommandBuffer cmd = gpu_->beginOneTimeCommands();
+	prepareWait(cmd, dstFamily_, value);
+	gpu_->endOneTimeCommands(cmd);
+	endWait(cmd, true);
+}
+
+bool TransferManager::isIdle() const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (!isValid()) return true;
+	return openBatch_ == UINT32_MAX && acquires_.empty() && recordedAcquires_.empty() && getCompletedValue() >= submittedValue_;
+}
+
+void TransferManager::prepareWait(VkCommandBuffer cmd, uint32_t queueFamily, uint64_t value) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (!isValid() || value == 0) return;
+
+	if (value > submittedValue_) flushLocked();
+
+	if (!transfersOwnership() || queueFamily != dstFamily_ || acquires_.empty()) return;
+
+	imageBarriers_.clear();
+
+	auto it = acquires_.begin();
+	while (it != acquires_.end()) {
+		if (it->value > value) {
+			++it;
+			continue;
+		}
+
+		VkImageMemoryBarrier barrier{};
+		barrier.sType				= VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.oldLayout			= VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout			= VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barrier.srcAccessMask		= 0;
+		barrier.dstAccessMask		= VK_ACCESS_SHADER_READ_BIT;
+		barrier.srcQueueFamilyIndex = srcFamily_;
+		barrier.dstQueueFamilyIndex = dstFamily_;
+		barrier.image				= it->image;
+		barrier.subresourceRange	= it->range;
+		imageBarriers_.push_back(barrier);
+		recordedAcquires_.push_back({cmd, *it});
+		it = acquires_.erase(it);
+	}
+
+	if (imageBarriers_.empty()) return;
+
+	vkCmdPipelineBarrier(cmd,
+						 VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+						 VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+						 0,
+						 0,
+						 nullptr,
+						 0,
+						 nullptr,
+						 static_cast<uint32_t>(imageBarriers_.size()),
+						 imageBarriers_.data());
+}
+
+void TransferManager::endWait(VkCommandBuffer cmd, bool submitted) {
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	auto it = recordedAcquires_.begin();
+	while (it != recordedAcquires_.end()) {
+		if (it->commandBuffer != cmd) {
+			++it;
+			continue;
+		}
+
+		// An image released again in the meantime only needs its latest acquire
+		if (!submitted && std::none_of(acquires_.begin(), acquires_.end(), [&](const Acquire& a) { return a.image == it->acquire.image; })) {
+			acquires_.push_back(it->acquire);
+		}
+		it = recordedAcquires_.erase(it);
+	}
+}
+
+void TransferManager::wait(TransferTicket ticket) {
+	if (!ticket.isValid() || !isValid()) return;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (ticket.value > submittedValue_) flushLocked();
+	}
+
+	VkSemaphoreWaitInfo waitInfo{};
+	waitInfo.sType			= VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+	waitInfo.semaphoreCount = 1;
+	waitInfo.pSemaphores	= &semaphore_;
+	waitInfo.pValues		= &ticket.value;
+	vkWaitSemaphores(gpu_->device, &waitInfo, UINT64_MAX);
+
+	if (!transfersOwnership()) return;
+
+	bool pending;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		pending = hasAcquires(ticket.value);
+	}
+	if (pending) acquire(ticket.value);
+}
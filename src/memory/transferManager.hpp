@@ -0,0 +1,135 @@
+#ifndef TRANSFER_MANAGER_HPP
+#define TRANSFER_MANAGER_HPP
+
+#include "stagingPool.hpp"
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+namespace renderApi {
+	class Buffer;
+	class Image;
+} // namespace renderApi
+
+namespace renderApi::device {
+	struct GPU;
+}
+
+namespace renderApi::memory {
+
+	// Completion point of an upload: the transfer timeline semaphore reaches value once the copy has
+	// executed. A value of 0 means there is nothing to wait for.
+	struct TransferTicket {
+		uint64_t value = 0;
+
+		bool isValid() const { return value != 0; }
+	};
+
+	// Uploads recorded on the transfer queue without blocking the host or the graphics queue.
+	// Copies are batched into one command buffer until flush(), the batch size limit, or a wait on
+	// one of its tickets. When the transfer queue belongs to its own family, buffers are shared with
+	// it (GPU::setBufferSharing) and each batch releases its images to the family of
+	// GPU::oneTimeCommands. The matching acquire is recorded by prepareWait() in the first submission
+	// that waits on the ticket, or submitted by wait() or acquireCompleted().
+	//
+	// Destination resources must not be in use by the GPU while they are uploaded, must stay alive
+	// until their ticket completed, and images lose their previous contents. Without a dedicated
+	// transfer queue the batches go to the graphics queue.
+	class TransferManager {
+	  public:
+		static constexpr VkDeviceSize kBatchStagingSize = 4 * 1024 * 1024;
+		static constexpr VkDeviceSize kMaxBatchBytes	= 64 * 1024 * 1024;
+
+		TransferManager();
+		~TransferManager();
+
+		TransferManager(const TransferManager&)			   = delete;
+		TransferManager& operator=(const TransferManager&) = delete;
+
+		bool init(device::GPU* gpu);
+		void cleanup();
+
+		// Host visible buffers are written directly and get an empty ticket
+		bool upload(Buffer& buffer, const void* data, VkDeviceSize size, VkDeviceSize offset, TransferTicket& outTicket);
+		// Writes mip level 0 of every layer and leaves the image in SHADER_READ_ONLY layout
+		bool upload(Image& image, const void* data, VkDeviceSize size, TransferTicket& outTicket);
+
+		// Submits the batch being recorded
+		void flush();
+
+		// Non-blocking poll of the transfer timeline. Images of a completed ticket still need their
+		// acquire, recorded by the next submission waiting on it or by acquireCompleted()
+		bool isComplete(TransferTicket ticket) const;
+		// Blocks until the ticket completed and hands its resources over to the graphics queue family
+		void wait(TransferTicket ticket);
+		// Submits the acquires of every completed batch that no submission recorded yet
+		void acquireCompleted();
+		// No batch recording or executing and no resource waiting for its acquire
+		bool isIdle() const;
+
+		// For a submission on queueFamily that waits on getSemaphore() reaching value: submits the
+		// batch if it is still recording and records the acquires of the resources released up to value.
+		// endWait() must follow once cmd was submitted, or failed to be, in which case the acquires
+		// are left for the next submission.
+		void prepareWait(VkCommandBuffer cmd, uint32_t queueFamily, uint64_t value);
+		void endWait(VkCommandBuffer cmd, bool submitted);
+		// Family the images uploaded are handed over to
+		uint32_t getOwnerFamily() const { return dstFamily_; }
+
+		VkSemaphore getSemaphore() const { return semaphore_; }
+		uint32_t	getQueueFamily() const { return srcFamily_; }
+		bool		transfersOwnership() const { return srcFamily_ != dstFamily_; }
+		bool		isValid() const { return semaphore_ != VK_NULL_HANDLE; }
+
+	  private:
+		struct Batch {
+			VkCommandBuffer				   commandBuffer = VK_NULL_HANDLE;
+			uint64_t					   value		 = 0;
+			VkDeviceSize				   bytes		 = 0;
+			VkDeviceSize				   stagingUsed	 = 0; // Write offset in the last staging chunk
+			std::vector<StagingAllocation> staging;
+			std::vector<VkBuffer>		   buffers;
+			std::vector<Image*>			   images; // Leave TRANSFER_DST layout at flush
+		};
+
+		struct Acquire {
+			uint64_t				value = 0;
+			VkImage					image = VK_NULL_HANDLE;
+			VkImageSubresourceRange range{};
+		};
+
+		// Recorded by prepareWait() into a command buffer that was not submitted yet
+		struct RecordedAcquire {
+			VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+			Acquire			acquire;
+		};
+
+		device::GPU*		 gpu_;
+		VkQueue				 queue_;
+		uint32_t			 srcFamily_;
+		uint32_t			 dstFamily_;
+		VkCommandPool		 commandPool_;
+		VkSemaphore			 semaphore_;
+		uint64_t			 submittedValue_;
+		uint32_t			 openBatch_;
+		std::vector<Batch>	 batches_;
+		std::vector<Acquire> acquires_;
+		std::vector<RecordedAcquire> recordedAcquires_;
+		mutable std::mutex	 mutex_;
+		// Scratch of flushLocked() and prepareWait(), under mutex_; keeps its capacity
+		std::vector<VkImageMemoryBarrier> imageBarriers_;
+
+		uint64_t getCompletedValue() const;
+		Batch*	 beginBatch();
+		bool	 allocateStaging(Batch& batch, VkDeviceSize size, StagingAllocation& outStaging);
+		void	 flushLocked();
+		void	 addAcquire(const Acquire& acquire);
+		bool	 hasAcquires(uint64_t value) const; // Any released up to value, under mutex_
+		void	 acquire(uint64_t value);
+	};
+
+} // namespace renderApi::memory
+
+#endif
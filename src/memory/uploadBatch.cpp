@@ -0,0 +1,383 @@
+#include "uploadBatch.hpp"
+
+#include "buffer/buffer.hpp"
+#include "image/image.hpp"
+#include "renderDevice.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+using namespace renderApi::memory;
+
+namespace {
+
+	// Covers the texel size of every uncompressed format and the block size of compressed ones
+	constexpr VkDeviceSize kStagingAlignment = 16;
+
+	inline VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) { return (value + alignment - 1) / alignment * alignment; }
+
+} // namespace
+
+// ============================================================================
+// UploadBatch Implementation
+// ============================================================================
+
+UploadBatch::UploadBatch(renderApi::device::GPU* gpu)
+	: gpu_(gpu), thread_(std::this_thread::get_id()), stagingUsed_(0), pendingBytes_(0), holdsUploads_(false) {
+	if (!gpu_) return;
+
+	// The outermost batch of each thread collects its implicit uploads
+	std::lock_guard<std::mutex> lock(gpu_->uploadBatchMutex);
+	gpu_->uploadBatches.emplace(thread_, this);
+}
+
+UploadBatch::~UploadBatch() {
+	if (!gpu_) return;
+
+	submit();
+
+	std::lock_guard<std::mutex> lock(gpu_->uploadBatchMutex);
+	auto						it = gpu_->uploadBatches.find(thread_);
+	if (it != gpu_->uploadBatches.end() && it->second == this) gpu_->uploadBatches.erase(it);
+}
+
+bool UploadBatch::allocateStaging(VkDeviceSize size, StagingAllocation& outStaging) {
+	if (!staging_.empty()) {
+		const StagingAllocation& chunk	= staging_.back();
+		VkDeviceSize			 offset = alignUp(stagingUsed_, kStagingAlignment);
+		if (offset + size <= chunk.size) {
+			outStaging		  = chunk;
+			outStaging.offset = chunk.offset + offset;
+			outStaging.size	  = size;
+			outStaging.data	  = static_cast<char*>(chunk.data) + offset;
+			stagingUsed_	  = offset + size;
+			return true;
+		}
+	}
+
+	StagingAllocation chunk = gpu_->stagingPool.acquire(std::max(size, kChunkSize));
+	if (!chunk.isValid()) {
+		std::cerr << "UploadBatch: Failed to allocate " << size << " bytes of staging memory" << std::endl;
+		return false;
+	}
+
+	staging_.push_back(chunk);
+	stagingUsed_ = size;
+
+	outStaging		= chunk;
+	outStaging.size = size;
+	return true;
+}
+
+bool UploadBatch::isWritten(VkBuffer buffer) const {
+	return std::any_of(bufferCopies_.begin(), bufferCopies_.end(), [&](const BufferCopy& c) { return c.dst == buffer; });
+}
+
+bool UploadBatch::isRead(VkBuffer buffer) const {
+	return std::any_of(bufferCopies_.begin(), bufferCopies_.end(), [&](const BufferCopy& c) { return c.src == buffer; }) ||
+		   std::any_of(imageCopies_.begin(), imageCopies_.end(), [&](const ImageCopy& c) { return c.src == buffer; });
+}
+
+bool UploadBatch::isWritten(const Image* image) const {
+	return std::any_of(images_.begin(), images_.end(), [&](const ImageTarget& t) { return t.image == image; });
+}
+
+bool UploadBatch::upload(renderApi::Buffer& buffer, const void* data, VkDeviceSize size, VkDeviceSize offset) {
+	if (!gpu_ || !buffer.isValid() || !data || size == 0) return false;
+	if (offset + size > buffer.getSize()) {
+		std::cerr << "UploadBatch: Upload size exceeds buffer size" << std::endl;
+		return false;
+	}
+
+	if (buffer.usesHostVisibleMapping()) {
+		return buffer.upload(data, size, offset);
+	}
+
+	// Copies of one batch are not ordered against each other, so one that reads the buffer would see the new bytes
+	if (isWritten(buffer.getHandle()) || isRead(buffer.getHandle()) || pendingBytes_ + size > kMaxPendingBytes) {
+		if (!submit()) return false;
+	}
+
+	StagingAllocation staging;
+	if (!allocateStaging(size, staging)) return false;
+	memcpy(staging.data, data, size);
+
+	lockUploads();
+
+	BufferCopy copy;
+	copy.src			  = staging.buffer;
+	copy.dst			  = buffer.getHandle();
+	copy.region.srcOffset = staging.offset;
+	copy.region.dstOffset = offset;
+	copy.region.size	  = size;
+	bufferCopies_.push_back(copy);
+
+	pendingBytes_ += size;
+	return true;
+}
+
+bool UploadBatch::upload(renderApi::Image& image, const void* data, VkDeviceSize size) {
+	if (!gpu_ || !image.isValid() || !data || size == 0) return false;
+
+	// The copy reads all of mip level 0, for every layer
+	VkDeviceSize levelSize = getLevelZeroSize(image);
+	if (levelSize > 0) {
+		if (size < levelSize) {
+			std::cerr << "UploadBatch: Upload of " << size << " bytes is smaller than mip level 0 (" << levelSize << " bytes)" << std::endl;
+			return false;
+		}
+		size = levelSize;
+	}
+
+	if (isWritten(&image) || pendingBytes_ + size > kMaxPendingBytes) {
+		if (!submit()) return false;
+	}
+
+	StagingAllocation staging;
+	if (!allocateStaging(size, staging)) return false;
+	memcpy(staging.data, data, size);
+
+	pendingBytes_ += size;
+	return addImageCopy(image, staging.buffer, staging.offset);
+}
+
+bool UploadBatch::upload(renderApi::Image& image, const void* data, VkDeviceSize size, const std::vector<VkBufferImageCopy>& regions) {
+	if (!gpu_ || !image.isValid() || !data || size == 0 || regions.empty()) return false;
+
+	renderApi::FormatBlock block = renderApi::getFormatBlock(image.format_);
+	for (const auto& region : regions) {
+		const VkImageSubresourceLayers& subresource = region.imageSubresource;
+		uint32_t						levelW		= std::max(1u, image.width_ >> subresource.mipLevel);
+		uint32_t						levelH		= std::max(1u, image.height_ >> subresource.mipLevel);
+		uint32_t						levelD		= std::max(1u, image.depth_ >> subresource.mipLevel);
+
+		bool valid = subresource.mipLevel < image.mipLevels_ && subresource.layerCount != 0 &&
+					 subresource.baseArrayLayer + subresource.layerCount <= image.arrayLayers_ && region.imageOffset.x >= 0 &&
+					 region.imageOffset.y >= 0 && region.imageOffset.z >= 0 &&
+					 static_cast<uint64_t>(region.imageOffset.x) + region.imageExtent.width <= levelW &&
+					 static_cast<uint64_t>(region.imageOffset.y) + region.imageExtent.height <= levelH &&
+					 static_cast<uint64_t>(region.imageOffset.z) + region.imageExtent.depth <= levelD;
+		if (!valid || !renderApi::isCopyInBounds(region, block, size)) {
+			std::cerr << "UploadBatch: Upload region for mip " << subresource.mipLevel << ", layer " << subresource.baseArrayLayer
+					  << " lies outside the image or reads past the " << size << " source bytes" << std::endl;
+			return false;
+		}
+	}
+
+	if (isWritten(&image) || pendingBytes_ + size > kMaxPendingBytes) {
+		if (!submit()) return false;
+	}
+
+	StagingAllocation staging;
+	if (!allocateStaging(size, staging)) return false;
+	memcpy(staging.data, data, size);
+
+	lockUploads();
+	for (const auto& region : regions) {
+		ImageCopy copy;
+		copy.src				 = staging.buffer;
+		copy.dst				 = &image;
+		copy.region				 = region;
+		copy.region.bufferOffset = staging.offset + region.bufferOffset;
+		imageCopies_.push_back(copy);
+	}
+
+	images_.push_back({&image, image.convertLayout(image.currentLayout_)});
+	image.currentLayout_ = renderApi::ImageLayout::SHADER_READ_ONLY;
+
+	pendingBytes_ += size;
+	return true;
+}
+
+bool UploadBatch::copy(const renderApi::Buffer& src, renderApi::Buffer& dst, VkDeviceSize size, VkDeviceSize srcOffset, VkDeviceSize dstOffset) {
+	if (!gpu_ || !src.isValid() || !dst.isValid() || size == 0) return false;
+	if (srcOffset + size > src.getSize() || dstOffset + size > dst.getSize()) {
+		std::cerr << "UploadBatch: Copy range exceeds buffer size" << std::endl;
+		return false;
+	}
+
+	if (isWritten(src.getHandle()) || isWritten(dst.getHandle()) || isRead(dst.getHandle())) {
+		if (!submit()) return false;
+	}
+
+	lockUploads();
+
+	BufferCopy copy;
+	copy.src			  = src.getHandle();
+	copy.dst			  = dst.getHandle();
+	copy.region.srcOffset = srcOffset;
+	copy.region.dstOffset = dstOffset;
+	copy.region.size	  = size;
+	bufferCopies_.push_back(copy);
+	return true;
+}
+
+bool UploadBatch::copy(const renderApi::Buffer& src, renderApi::Image& dst, VkDeviceSize srcOffset) {
+	if (!gpu_ || !src.isValid() || !dst.isValid()) return false;
+	VkDeviceSize levelSize = getLevelZeroSize(dst);
+	if (srcOffset >= src.getSize() || levelSize > src.getSize() - srcOffset) {
+		std::cerr << "UploadBatch: Copy range exceeds buffer size" << std::endl;
+		return false;
+	}
+
+	if (isWritten(src.getHandle()) || isWritten(&dst)) {
+		if (!submit()) return false;
+	}
+
+	return addImageCopy(dst, src.getHandle(), srcOffset);
+}
+
+VkDeviceSize UploadBatch::getLevelZeroSize(const renderApi::Image& image) {
+	return renderApi::getMipLevelSize(image.format_, image.width_, image.height_, image.depth_, 0) * image.arrayLayers_;
+}
+
+bool UploadBatch::addImageCopy(renderApi::Image& image, VkBuffer src, VkDeviceSize srcOffset) {
+	lockUploads();
+
+	ImageCopy copy;
+	copy.src								= src;
+	copy.dst								= &image;
+	copy.region.bufferOffset				= srcOffset;
+	copy.region.bufferRowLength				= 0;
+	copy.region.bufferImageHeight			= 0;
+	copy.region.imageSubresource.aspectMask = image.aspectMask_;
+	copy.region.imageSubresource.mipLevel	= 0;
+	copy.region.imageSubresource.baseArrayLayer = 0;
+	copy.region.imageSubresource.layerCount		= image.arrayLayers_;
+	copy.region.imageOffset						= {0, 0, 0};
+	copy.region.imageExtent						= {image.width_, image.height_, image.depth_};
+	imageCopies_.push_back(copy);
+
+	images_.push_back({&image, image.convertLayout(image.currentLayout_)});
+	image.currentLayout_ = renderApi::ImageLayout::SHADER_READ_ONLY;
+	return true;
+}
+
+void UploadBatch::lockUploads() {
+	if (holdsUploads_) return;
+	gpu_->lockUploads();
+	holdsUploads_ = true;
+}
+
+void UploadBatch::unlockUploads() {
+	if (!holdsUploads_) return;
+	gpu_->unlockUploads();
+	holdsUploads_ = false;
+}
+
+void UploadBatch::releaseStaging() {
+	for (auto& staging : staging_) {
+		gpu_->stagingPool.release(staging);
+	}
+	staging_.clear();
+	stagingUsed_ = 0;
+}
+
+bool UploadBatch::submit() {
+	if (!gpu_ || isEmpty()) return true;
+
+	// Take everything first: beginOneTimeCommands flushes the active batch, which is now empty
+	std::vector<BufferCopy>	 bufferCopies;
+	std::vector<ImageCopy>	 imageCopies;
+	std::vector<ImageTarget> images;
+	bufferCopies.swap(bufferCopies_);
+	imageCopies.swap(imageCopies_);
+	images.swap(images_);
+	pendingBytes_ = 0;
+
+	VkCommandBuffer cmd = gpu_->beginOneTimeCommands();
+
+	std::vector<VkImageMemoryBarrier> imageBarriers(images.size());
+	for (size_t i = 0; i < images.size(); i++) {
+		const Image*		  image	  = images[i].image;
+		VkImageMemoryBarrier& barrier = imageBarriers[i];
+		barrier.sType							= VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.oldLayout						= images[i].oldLayout;
+		barrier.newLayout						= VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.srcAccessMask					= images[i].oldLayout == VK_IMAGE_LAYOUT_UNDEFINED ? 0 : VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+		barrier.dstAccessMask					= VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.srcQueueFamilyIndex				= VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex				= VK_QUEUE_FAMILY_IGNORED;
+		barrier.image							= image->image_;
+		barrier.subresourceRange.aspectMask		= image->aspectMask_;
+		barrier.subresourceRange.baseMipLevel	= 0;
+		barrier.subresourceRange.levelCount		= image->mipLevels_;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount		= image->arrayLayers_;
+	}
+
+	VkMemoryBarrier memoryBarrier{};
+	memoryBarrier.sType			= VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	memoryBarrier.srcAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+	memoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(cmd,
+						 VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+						 VK_PIPELINE_STAGE_TRANSFER_BIT,
+						 0,
+						 1,
+						 &memoryBarrier,
+						 0,
+						 nullptr,
+						 static_cast<uint32_t>(imageBarriers.size()),
+						 imageBarriers.data());
+
+	// Consecutive copies between the same pair of buffers share one command
+	std::vector<VkBufferCopy> regions;
+	for (size_t i = 0; i < bufferCopies.size(); i++) {
+		regions.push_back(bufferCopies[i].region);
+		bool last = i + 1 == bufferCopies.size() || bufferCopies[i + 1].src != bufferCopies[i].src || bufferCopies[i + 1].dst != bufferCopies[i].dst;
+		if (last) {
+			vkCmdCopyBuffer(cmd, bufferCopies[i].src, bufferCopies[i].dst, static_cast<uint32_t>(regions.size()), regions.data());
+			regions.clear();
+		}
+	}
+
+	std::vector<VkBufferImageCopy> imageRegions;
+	for (size_t i = 0; i < imageCopies.size(); i++) {
+		imageRegions.push_back(imageCopies[i].region);
+		bool last = i + 1 == imageCopies.size() || imageCopies[i + 1].src != imageCopies[i].src || imageCopies[i + 1].dst != imageCopies[i].dst;
+		if (last) {
+			vkCmdCopyBufferToImage(cmd,
+								   imageCopies[i].src,
+								   imageCopies[i].dst->image_,
+								   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+								   static_cast<uint32_t>(imageRegions.size()),
+								   imageRegions.data());
+			imageRegions.clear();
+		}
+	}
+
+	for (auto& barrier : imageBarriers) {
+		barrier.oldLayout	  = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout	  = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	}
+
+	memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	memoryBarrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+
+	vkCmdPipelineBarrier(cmd,
+						 VK_PIPELINE_STAGE_TRANSFER_BIT,
+						 VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+						 0,
+						 1,
+						 &memoryBarrier,
+						 0,
+						 nullptr,
+						 static_cast<uint32_t>(imageBarriers.size()),
+						 imageBarriers.data());
+
+	gpu_->endOneTimeCommands(cmd);
+	releaseStaging();
+	// Not on the early return above: beginOneTimeCommands() calls submit() again with the batch empty
+	unlockUploads();
+	return true;
+}
@@ -0,0 +1,99 @@
+#ifndef UPLOAD_BATCH_HPP
+#define UPLOAD_BATCH_HPP
+
+#include "stagingPool.hpp"
+
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+namespace renderApi {
+	class Buffer;
+	class Image;
+} // namespace renderApi
+
+namespace renderApi::device {
+	struct GPU;
+}
+
+namespace renderApi::memory {
+
+	// Collects copies and submits them together: one command buffer, one barrier before and one
+	// after all of them. Source data is packed into shared staging chunks when the copy is added.
+	//
+	// While the batch returned by GPU::beginUploadBatch() is alive, Buffer::upload and
+	// Image::uploadData called from the same thread are added to it instead of being submitted one
+	// by one, and any other one-time command submission from that thread flushes it first. The
+	// batch is submitted when it goes out of scope. A resource written twice, or written
+	// after a copy that reads it, is flushed in between. Every thread collects into its own
+	// outermost batch; batches nested in it only take what is added to them directly.
+	class UploadBatch {
+	  public:
+		static constexpr VkDeviceSize kChunkSize	   = StagingPool::kLargeChunkSize;
+		static constexpr VkDeviceSize kMaxPendingBytes = 256 * 1024 * 1024;
+
+		explicit UploadBatch(device::GPU* gpu);
+		~UploadBatch();
+
+		UploadBatch(const UploadBatch&)			   = delete;
+		UploadBatch& operator=(const UploadBatch&) = delete;
+
+		bool upload(Buffer& buffer, const void* data, VkDeviceSize size, VkDeviceSize offset = 0);
+		// Writes mip level 0 of every layer and leaves the image in SHADER_READ_ONLY layout
+		bool upload(Image& image, const void* data, VkDeviceSize size);
+		// Buffer offsets of the regions are relative to data; every region must lie within the image and
+		// read within size bytes
+		bool upload(Image& image, const void* data, VkDeviceSize size, const std::vector<VkBufferImageCopy>& regions);
+		bool copy(const Buffer& src, Buffer& dst, VkDeviceSize size, VkDeviceSize srcOffset = 0, VkDeviceSize dstOffset = 0);
+		bool copy(const Buffer& src, Image& dst, VkDeviceSize srcOffset = 0);
+
+		// Records and submits everything collected so far and waits for it
+		bool submit();
+
+		bool		 isEmpty() const { return bufferCopies_.empty() && imageCopies_.empty(); }
+		VkDeviceSize getPendingBytes() const { return pendingBytes_; }
+		uint32_t	 getCopyCount() const { return static_cast<uint32_t>(bufferCopies_.size() + imageCopies_.size()); }
+
+	  private:
+		struct BufferCopy {
+			VkBuffer	 src;
+			VkBuffer	 dst;
+			VkBufferCopy region;
+		};
+
+		struct ImageCopy {
+			VkBuffer		  src;
+			Image*			  dst;
+			VkBufferImageCopy region;
+		};
+
+		struct ImageTarget {
+			Image*		  image;
+			VkImageLayout oldLayout;
+		};
+
+		device::GPU*				   gpu_;
+		std::thread::id				   thread_; // Whose implicit uploads it may collect
+		std::vector<BufferCopy>		   bufferCopies_;
+		std::vector<ImageCopy>		   imageCopies_;
+		std::vector<ImageTarget>	   images_;
+		std::vector<StagingAllocation> staging_;
+		VkDeviceSize				   stagingUsed_; // Write offset in the last staging chunk
+		VkDeviceSize				   pendingBytes_;
+		bool						   holdsUploads_; // Taken with the first copy, released once they executed
+
+		bool allocateStaging(VkDeviceSize size, StagingAllocation& outStaging);
+		bool isWritten(VkBuffer buffer) const;
+		bool isRead(VkBuffer buffer) const;
+		bool isWritten(const Image* image) const;
+		bool addImageCopy(Image& image, VkBuffer src, VkDeviceSize srcOffset);
+		static VkDeviceSize getLevelZeroSize(const Image& image);
+		void lockUploads();
+		void unlockUploads();
+		void releaseStaging();
+	};
+
+} // namespace renderApi::memory
+
+#endif
@@ -0,0 +1,226 @@
+#include "frameCapture.hpp"
+
+#include "graphicsPipeline.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+	#define popen _popen
+	#define pclose _pclose
+#else
+	#include <csignal>
+	#include <pthread.h>
+#endif
+
+using namespace renderApi::gpuTask;
+
+namespace {
+
+#ifndef _WIN32
+	// Writing to a pipe whose reader exited raises SIGPIPE, which kills the process by default. While
+	// it is blocked on the writing thread the write fails with EPIPE instead, and the signal left
+	// pending is consumed before the previous mask comes back.
+	class SigpipeGuard {
+	  public:
+		SigpipeGuard() {
+			sigemptyset(&set_);
+			sigaddset(&set_, SIGPIPE);
+
+			sigset_t pending;
+			sigpending(&pending);
+			wasPending_ = sigismember(&pending, SIGPIPE) == 1;
+			blocked_	= pthread_sigmask(SIG_BLOCK, &set_, &previous_) == 0;
+		}
+
+		~SigpipeGuard() {
+			if (!blocked_) return;
+
+			sigset_t pending;
+			sigpending(&pending);
+			if (!wasPending_ && sigismember(&pending, SIGPIPE) == 1) {
+				int signal;
+				sigwait(&set_, &signal);
+			}
+			pthread_sigmask(SIG_SETMASK, &previous_, nullptr);
+		}
+
+		SigpipeGuard(const SigpipeGuard&)			 = delete;
+		SigpipeGuard& operator=(const SigpipeGuard&) = delete;
+
+	  private:
+		sigset_t set_;
+		sigset_t previous_;
+		bool	 wasPending_ = false;
+		bool	 blocked_	 = false;
+	};
+#else
+	struct SigpipeGuard {};
+#endif
+
+} // namespace
+
+// ============================================================================
+// FrameCapture Implementation
+// ============================================================================
+
+FrameCapture::FrameCapture() : pipeline_(nullptr), output_(nullptr), written_(0), stopping_(false), failed_(false) {}
+
+FrameCapture::~FrameCapture() { stop(); }
+
+bool FrameCapture::start(GraphicsPipeline& pipeline, const FrameCaptureInfo& info) {
+	stop();
+
+	if (info.output.empty() || info.maxQueuedFrames == 0 || info.frameRate == 0) {
+		std::cerr << "FrameCapture: Invalid parameters" << std::endl;
+		return false;
+	}
+	info_ = info;
+
+	output_ = info.pipe ? popen(info.output.c_str(), "w") : fopen(info.output.c_str(), "wb");
+	if (!output_) {
+		std::cerr << "FrameCapture: Failed to open " << info.output << std::endl;
+		return false;
+	}
+
+	if (info.format == CaptureFormat::Y4M) {
+		// C420jpeg: chroma sits between the luma samples, as the conversion averages 2x2 blocks
+		std::string header = "YUV4MPEG2 W" + std::to_string(pipeline.getWidth()) + " H" + std::to_string(pipeline.getHeight()) + " F" +
+							 std::to_string(info.frameRate) + ":1 Ip A1:1 C420jpeg XCOLORRANGE=LIMITED\n";
+		SigpipeGuard guard;
+		if (fwrite(header.data(), 1, header.size(), output_) != header.size()) {
+			std::cerr << "FrameCapture: Failed to write to " << info.output << std::endl;
+			closeOutput();
+			return false;
+		}
+	}
+
+	// The readback may call onFrame() from another thread as soon as it is enabled, so the state of
+	// a previous capture must be gone and the writer running by then
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		frames_.clear();
+		written_  = 0;
+		stopping_ = false;
+		failed_	  = false;
+	}
+	writer_ = std::thread(&FrameCapture::writerLoop, this);
+
+	ReadbackConversion conversion = info.format == CaptureFormat::RAW_RGBA ? ReadbackConversion::NONE : ReadbackConversion::YUV420;
+	if (!pipeline.enableReadback(info.readbackDepth, [this](const ReadbackFrame& frame) { onFrame(frame); }, conversion)) {
+		stopWriter();
+		closeOutput();
+		return false;
+	}
+
+	pipeline_ = &pipeline;
+	return true;
+}
+
+bool FrameCapture::stop() {
+	if (!pipeline_) return true;
+
+	// Hands the frames still in flight to onFrame() before the ring goes away, after the execute()
+	// running on another thread, if any
+	pipeline_->disableReadback();
+	pipeline_ = nullptr;
+
+	stopWriter();
+
+	frames_.clear();
+	spare_.clear();
+	bool success = !failed_;
+	return closeOutput() && success;
+}
+
+void FrameCapture::stopWriter() {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stopping_ = true;
+	}
+	frameReady_.notify_all();
+	writer_.join();
+}
+
+bool FrameCapture::closeOutput() {
+	if (!output_) return true;
+
+	// Closing flushes what stdio still buffers into the pipe
+	SigpipeGuard guard;
+	int			 result = info_.pipe ? pclose(output_) : fclose(output_);
+	output_	   = nullptr;
+	if (result != 0) {
+		std::cerr << "FrameCapture: Failed to close " << info_.output << std::endl;
+		return false;
+	}
+	return true;
+}
+
+uint64_t FrameCapture::getWrittenFrames() const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return written_;
+}
+
+void FrameCapture::onFrame(const ReadbackFrame& frame) {
+	std::vector<uint8_t> data;
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		// Back-pressure: the render loop waits for the writer rather than dropping the frame
+		frameWritten_.wait(lock, [&]() { return frames_.size() < info_.maxQueuedFrames || failed_; });
+		if (failed_) return;
+
+		if (!spare_.empty()) {
+			data = std::move(spare_.back());
+			spare_.pop_back();
+		}
+	}
+
+	data.resize(frame.size);
+	memcpy(data.data(), frame.data, frame.size);
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		frames_.push_back(std::move(data));
+	}
+	frameReady_.notify_one();
+}
+
+void FrameCapture::writerLoop() {
+	static const char frameHeader[] = "FRAME\n";
+
+	// A reader that exited early turns into failed_ instead of killing the process
+	SigpipeGuard guard;
+
+	for (;;) {
+		std::vector<uint8_t> data;
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			frameReady_.wait(lock, [&]() { return stopping_ || !frames_.empty(); });
+			if (frames_.empty()) return;
+
+			data = std::move(frames_.front());
+			frames_.pop_front();
+		}
+
+		bool success = true;
+		if (info_.format == CaptureFormat::Y4M) success = fwrite(frameHeader, 1, sizeof(frameHeader) - 1, output_) == sizeof(frameHeader) - 1;
+		success = success && fwrite(data.data(), 1, data.size(), output_) == data.size();
+
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			if (success) {
+				written_++;
+			} else if (!failed_) {
+				std::cerr << "FrameCapture: Failed to write to " << info_.output << std::endl;
+				failed_ = true;
+			}
+			spare_.push_back(std::move(data));
+		}
+		frameWritten_.notify_all();
+	}
+}
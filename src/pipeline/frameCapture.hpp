@@ -0,0 +1,81 @@
+#ifndef FRAME_CAPTURE_HPP
+#define FRAME_CAPTURE_HPP
+
+#include "readbackRing.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace renderApi::gpuTask {
+
+	class GraphicsPipeline;
+
+	enum class CaptureFormat {
+		Y4M,		// YUV4MPEG2 4:2:0, read by ffmpeg, mpv and most encoders
+		RAW_YUV420, // The same planes without headers
+		RAW_RGBA	// The color attachment as is, in its own format
+	};
+
+	struct FrameCaptureInfo {
+		std::string	  output;				// File path, or a shell command reading frames on its stdin with pipe
+		bool		  pipe			  = false;
+		CaptureFormat format		  = CaptureFormat::Y4M;
+		uint32_t	  frameRate		  = 60; // Written in the Y4M header only
+		uint32_t	  readbackDepth	  = ReadbackRing::kDefaultDepth;
+		uint32_t	  maxQueuedFrames = 8;	// Frames read back and not written yet before rendering waits
+	};
+
+	// Streams every frame an offscreen GraphicsPipeline renders into a single Y4M or raw file, or into
+	// a pipe such as "ffmpeg -i - out.mp4". The pipeline's readback ring copies each frame from its
+	// own command buffer, after a compute pass turned it into YUV 4:2:0 for the YUV formats; a
+	// background thread writes the frames in order.
+	//
+	// Nothing is dropped: when maxQueuedFrames are waiting for the writer, the thread running
+	// GpuTask::execute() blocks in the readback until the writer caught up, so rendering slows down
+	// to the speed of the output instead.
+	class FrameCapture {
+	  public:
+		FrameCapture();
+		~FrameCapture();
+
+		FrameCapture(const FrameCapture&)			 = delete;
+		FrameCapture& operator=(const FrameCapture&) = delete;
+
+		// The pipeline must be built with an offscreen output; this replaces its readback. start() and
+		// stop() may run while another thread, such as the GPU thread, executes the owning task.
+		bool start(GraphicsPipeline& pipeline, const FrameCaptureInfo& info);
+		// Writes every frame rendered so far, closes the output and disables the readback
+		bool stop();
+
+		uint64_t getWrittenFrames() const;
+		bool	 isCapturing() const { return pipeline_ != nullptr; }
+
+	  private:
+		GraphicsPipeline*				  pipeline_;
+		FrameCaptureInfo				  info_;
+		FILE*							  output_;
+		std::thread						  writer_;
+		mutable std::mutex				  mutex_;
+		std::condition_variable			  frameReady_;
+		std::condition_variable			  frameWritten_;
+		std::deque<std::vector<uint8_t>>  frames_;
+		std::vector<std::vector<uint8_t>> spare_;
+		uint64_t						  written_;
+		bool							  stopping_;
+		bool							  failed_;
+
+		void onFrame(const ReadbackFrame& frame);
+		void writerLoop();
+		void stopWriter();
+		bool closeOutput();
+	};
+
+} // namespace renderApi::gpuTask
+
+#endif
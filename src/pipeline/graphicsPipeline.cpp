@@ -10,6 +10,7 @@
 #include <algorithm>
 #include <cstdint>
 #include <iostream>
+#include <memory>
 #include <optional>
 #include <vector>
 #include <vulkan/vulkan.h>
@@ -100,7 +101,7 @@ GraphicsPipeline::GraphicsPipeline(GraphicsPipeline&& other) noexcept
 	  renderFinishedSemaphores_(std::move(other.renderFinishedSemaphores_)), inFlightFences_(std::move(other.inFlightFences_)),
 	  currentFrame_(other.currentFrame_), maxFramesInFlight_(other.maxFramesInFlight_), renderFence_(other.renderFence_),
 	  vertexAttributes_(std::move(other.vertexAttributes_)), vertexBindings_(std::move(other.vertexBindings_)),
-	  pushConstantRanges_(std::move(other.pushConstantRanges_)) {
+	  pushConstantRanges_(std::move(other.pushConstantRanges_)), readback_(std::move(other.readback_)), executionMutex_(other.executionMutex_) {
 	other.vertexShader_		= VK_NULL_HANDLE;
 	other.fragmentShader_	= VK_NULL_HANDLE;
 	other.pipeline_			= VK_NULL_HANDLE;
@@ -109,7 +110,7 @@ GraphicsPipeline::GraphicsPipeline(GraphicsPipeline&& other) noexcept
 	other.framebuffer_		= VK_NULL_HANDLE;
 	other.depthImage_		= VK_NULL_HANDLE;
 	other.depthImageView_	= VK_NULL_HANDLE;
-	other.depthImageMemory_ = VK_NULL_HANDLE;
+	other.depthImageMemory_ = memory::AllocationInfo{};
 }
 
 GraphicsPipeline& GraphicsPipeline::operator=(GraphicsPipeline&& other) noexcept {
@@ -160,6 +161,8 @@ GraphicsPipeline& GraphicsPipeline::operator=(GraphicsPipeline&& other) noexcept
 		vertexAttributes_		  = std::move(other.vertexAttributes_);
 		vertexBindings_			  = std::move(other.vertexBindings_);
 		pushConstantRanges_		  = std::move(other.pushConstantRanges_);
+		readback_				  = std::move(other.readback_);
+		executionMutex_			  = other.executionMutex_;
 
 		other.vertexShader_		= VK_NULL_HANDLE;
 		other.fragmentShader_	= VK_NULL_HANDLE;
@@ -169,7 +172,7 @@ GraphicsPipeline& GraphicsPipeline::operator=(GraphicsPipeline&& other) noexcept
 		other.framebuffer_		= VK_NULL_HANDLE;
 		other.depthImage_		= VK_NULL_HANDLE;
 		other.depthImageView_	= VK_NULL_HANDLE;
-		other.depthImageMemory_ = VK_NULL_HANDLE;
+		other.depthImageMemory_ = memory::AllocationInfo{};
 		other.surface_			= VK_NULL_HANDLE;
 		other.swapchain_		= VK_NULL_HANDLE;
 		other.renderFence_		= VK_NULL_HANDLE;
@@ -423,7 +426,7 @@ std::optional<Buffer> GraphicsPipeline::getOutputImageToBuffer() {
 
 	VkDeviceSize imageSize = width_ * height_ * 4;
 	Buffer		 outputBuffer;
-	if (!outputBuffer.create(gpu_, imageSize, BufferType::STAGING, BufferUsage::STREAM, BufferMemory::HOST_VISIBLE)) {
+	if (!outputBuffer.create(gpu_, imageSize, BufferType::STAGING, BufferUsage::STREAM, BufferMemory::HOST_READBACK)) {
 		std::cerr << "Failed to create output buffer" << std::endl;
 		return std::nullopt;
 	}
@@ -475,6 +478,38 @@ std::optional<Buffer> GraphicsPipeline::getOutputImageToBuffer() {
 			cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
 
 	gpu_->endOneTimeCommands(cmdBuffer);
+	outputBuffer.invalidate();
 
 	return std::move(outputBuffer);
 }
+
+bool GraphicsPipeline::enableReadback(uint32_t depth, ReadbackRing::Callback callback, ReadbackConversion conversion) {
+	if (!gpu_ || !gpu_->device || colorImages_.empty()) {
+		std::cerr << "GraphicsPipeline: Cannot enable readback before build" << std::endl;
+		return false;
+	}
+	if (outputTarget_ != OutputTarget::BUFFER) {
+		std::cerr << "GraphicsPipeline: Readback requires an offscreen output target" << std::endl;
+		return false;
+	}
+
+	std::unique_lock<std::mutex> executionLock;
+	if (executionMutex_) executionLock = std::unique_lock<std::mutex>(*executionMutex_);
+
+	auto ring = std::make_unique<ReadbackRing>();
+	if (!ring->create(gpu_, depth, width_, height_, colorFormats_[0], conversion, colorImageViews_[0])) {
+		return false;
+	}
+	ring->setCallback(std::move(callback));
+
+	readback_ = std::move(ring);
+	return true;
+}
+
+void GraphicsPipeline::disableReadback() {
+	std::unique_lock<std::mutex> executionLock;
+	if (executionMutex_) executionLock = std::unique_lock<std::mutex>(*executionMutex_);
+
+	if (readback_) readback_->drain();
+	readback_.reset();
+}
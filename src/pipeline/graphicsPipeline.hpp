@@ -2,8 +2,10 @@
 #define GRAPHICS_PIPELINE_HPP
 
 #include "device/renderDevice.hpp"
+#include "readbackRing.hpp"
 
 #include <cstdint>
+#include <memory>
 #include <mutex>
 #include <optional>
 #include <string>
@@ -64,14 +66,14 @@ namespace renderApi::gpuTask {
 		VkFormat	   depthFormat_		 = VK_FORMAT_D32_SFLOAT;
 		VkImage		   depthImage_		 = VK_NULL_HANDLE;
 		VkImageView	   depthImageView_	 = VK_NULL_HANDLE;
-		VkDeviceMemory depthImageMemory_ = VK_NULL_HANDLE;
+		memory::AllocationInfo depthImageMemory_;
 		uint32_t	   width_			 = 0;
 		uint32_t	   height_			 = 0;
 
 		std::vector<VkFormat>		colorFormats_;
 		std::vector<VkImage>		colorImages_;
 		std::vector<VkImageView>	colorImageViews_;
-		std::vector<VkDeviceMemory> colorImageMemories_;
+		std::vector<memory::AllocationInfo> colorImageMemories_;
 		uint32_t					colorAttachmentCount_ = 1;
 
 		bool enabled_		= true;
@@ -95,6 +97,9 @@ namespace renderApi::gpuTask {
 		VkPresentModeKHR preferredPresentMode_ = VK_PRESENT_MODE_IMMEDIATE_KHR;
 		uint32_t		 requestedImageCount_  = 0;
 
+		std::unique_ptr<ReadbackRing> readback_;
+		std::mutex*					  executionMutex_ = nullptr; // The owning task's, see GpuTask::execute()
+
 		bool createDepthResources();
 		void destroyDepthResources();
 		bool createSwapchainFramebuffers();
@@ -182,6 +187,16 @@ namespace renderApi::gpuTask {
 
 		std::optional<Buffer> getOutputImageToBuffer();
 
+		// Reads back every offscreen frame rendered by the owning task without stalling it, see ReadbackRing.
+		// Both calls wait for an execute() of the owning task in progress, so they are safe while it runs
+		// on another thread, but not from a readback callback. disableReadback() first hands the frames
+		// still in flight to the callback.
+		bool		  enableReadback(uint32_t			   depth	  = ReadbackRing::kDefaultDepth,
+									 ReadbackRing::Callback callback   = nullptr,
+									 ReadbackConversion	   conversion = ReadbackConversion::NONE);
+		void		  disableReadback();
+		ReadbackRing* getReadback() const { return readback_.get(); }
+
 		void destroy();
 
 		bool build(VkDescriptorSetLayout descriptorSetLayout, uint32_t width, uint32_t height);
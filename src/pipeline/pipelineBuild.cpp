@@ -146,17 +146,12 @@ bool GraphicsPipeline::build(VkDescriptorSetLayout descriptorSetLayout, uint32_t
 		VkMemoryRequirements memRequirements;
 		vkGetImageMemoryRequirements(gpu_->device, colorImages_[i], &memRequirements);
 
-		VkMemoryAllocateInfo allocInfo{};
-		allocInfo.sType			  = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		allocInfo.allocationSize  = memRequirements.size;
-		allocInfo.memoryTypeIndex = device::findMemoryType(gpu_->physicalDevice, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-		if (vkAllocateMemory(gpu_->device, &allocInfo, nullptr, &colorImageMemories_[i]) != VK_SUCCESS) {
+		if (!gpu_->allocator.allocate(memRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, memory::ResourceKind::OPTIMAL, colorImageMemories_[i], memory::MemoryCategory::RENDER_TARGET)) {
 			std::cerr << "GraphicsPipeline: Failed to allocate color image memory " << i << std::endl;
 			return false;
 		}
 
-		vkBindImageMemory(gpu_->device, colorImages_[i], colorImageMemories_[i], 0);
+		vkBindImageMemory(gpu_->device, colorImages_[i], colorImageMemories_[i].memory, colorImageMemories_[i].offset);
 
 		VkImageViewCreateInfo colorViewInfo{};
 		colorViewInfo.sType							  = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -198,18 +193,12 @@ bool GraphicsPipeline::build(VkDescriptorSetLayout descriptorSetLayout, uint32_t
 	VkMemoryRequirements depthMemRequirements;
 	vkGetImageMemoryRequirements(gpu_->device, depthImage_, &depthMemRequirements);
 
-	VkMemoryAllocateInfo depthAllocInfo{};
-	depthAllocInfo.sType		  = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	depthAllocInfo.allocationSize = depthMemRequirements.size;
-	depthAllocInfo.memoryTypeIndex =
-			device::findMemoryType(gpu_->physicalDevice, depthMemRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-	if (vkAllocateMemory(gpu_->device, &depthAllocInfo, nullptr, &depthImageMemory_) != VK_SUCCESS) {
+	if (!gpu_->allocator.allocate(depthMemRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, memory::ResourceKind::OPTIMAL, depthImageMemory_, memory::MemoryCategory::RENDER_TARGET)) {
 		std::cerr << "GraphicsPipeline: Failed to allocate depth image memory" << std::endl;
 		return false;
 	}
 
-	vkBindImageMemory(gpu_->device, depthImage_, depthImageMemory_, 0);
+	vkBindImageMemory(gpu_->device, depthImage_, depthImageMemory_.memory, depthImageMemory_.offset);
 
 	VkImageViewCreateInfo depthViewInfo{};
 	depthViewInfo.sType							  = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -343,6 +332,8 @@ void GraphicsPipeline::destroy() {
 		return;
 	}
 
+	readback_.reset();
+
 	if (renderFence_ != VK_NULL_HANDLE) {
 		vkDestroyFence(gpu_->device, renderFence_, nullptr);
 		renderFence_ = VK_NULL_HANDLE;
@@ -382,10 +373,8 @@ void GraphicsPipeline::destroy() {
 	}
 	colorImages_.clear();
 
-	for (auto memory : colorImageMemories_) {
-		if (memory != VK_NULL_HANDLE) {
-			vkFreeMemory(gpu_->device, memory, nullptr);
-		}
+	for (auto& allocation : colorImageMemories_) {
+		gpu_->allocator.free(allocation);
 	}
 	colorImageMemories_.clear();
 
@@ -399,10 +388,7 @@ void GraphicsPipeline::destroy() {
 		depthImage_ = VK_NULL_HANDLE;
 	}
 
-	if (depthImageMemory_ != VK_NULL_HANDLE) {
-		vkFreeMemory(gpu_->device, depthImageMemory_, nullptr);
-		depthImageMemory_ = VK_NULL_HANDLE;
-	}
+	gpu_->allocator.free(depthImageMemory_);
 
 	destroySwapchain();
 
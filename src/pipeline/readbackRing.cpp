@@ -0,0 +1,565 @@
+#include "readbackRing.hpp"
+
+#include "buffer/buffer.hpp"
+#include "computePipeline.hpp"
+#include "image/image.hpp"
+#include "renderDevice.hpp"
+
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+using namespace renderApi::gpuTask;
+using namespace renderApi;
+
+namespace {
+
+	// Built from src/pipeline/shaders/rgbToYuv.comp
+	const uint32_t kRgbToYuvSpirv[] =
+#include "rgbToYuv.comp.spv.inc"
+		;
+
+	constexpr uint32_t kBlockWidth	   = 8; // Pixels converted by one invocation, per axis
+	constexpr uint32_t kBlockHeight	   = 2;
+	constexpr uint32_t kWorkgroupSize = 16;
+
+	struct ConversionConstants {
+		int32_t	 sourceWidth;
+		int32_t	 sourceHeight;
+		uint32_t lumaStride;
+		uint32_t chromaRows;
+		uint32_t uOffset;
+		uint32_t vOffset;
+		uint32_t srgb;
+	};
+
+	bool isSrgbFormat(VkFormat format) {
+		switch (format) {
+		case VK_FORMAT_R8G8B8A8_SRGB:
+		case VK_FORMAT_B8G8R8A8_SRGB:
+		case VK_FORMAT_A8B8G8R8_SRGB_PACK32:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+} // namespace
+
+// ============================================================================
+// ReadbackRing Implementation
+// ============================================================================
+
+ReadbackRing::ReadbackRing()
+	: gpu_(nullptr), semaphore_(VK_NULL_HANDLE), next_(0), recordedValue_(0), droppedFrames_(0), width_(0), height_(0), format_(VK_FORMAT_UNDEFINED),
+	  frameSize_(0), conversion_(ReadbackConversion::NONE), setLayout_(VK_NULL_HANDLE), descriptorPool_(VK_NULL_HANDLE),
+	  descriptorSet_(VK_NULL_HANDLE), sourceView_(VK_NULL_HANDLE), planesGeneration_(0), lumaStride_(0), chromaRows_(0) {}
+
+ReadbackRing::~ReadbackRing() { destroy(); }
+
+bool ReadbackRing::create(device::GPU*	   gpu,
+						  uint32_t		   depth,
+						  uint32_t		   width,
+						  uint32_t		   height,
+						  VkFormat		   format,
+						  ReadbackConversion conversion,
+						  VkImageView		   view) {
+	destroy();
+
+	if (!gpu || !gpu->device || depth == 0 || width == 0 || height == 0) {
+		std::cerr << "ReadbackRing: Invalid parameters" << std::endl;
+		return false;
+	}
+
+	// Frames are copied tightly packed, which needs the texel size of the format
+	FormatBlock block = getFormatBlock(format);
+	if (conversion == ReadbackConversion::NONE && (block.size == 0 || block.width != 1 || block.height != 1)) {
+		std::cerr << "ReadbackRing: Unsupported format " << format << std::endl;
+		return false;
+	}
+
+	gpu_		= gpu;
+	width_		= width;
+	height_		= height;
+	format_		= format;
+	conversion_ = conversion;
+	if (conversion_ == ReadbackConversion::YUV420) {
+		VkDeviceSize chromaSize = static_cast<VkDeviceSize>((width + 1) / 2) * ((height + 1) / 2);
+		frameSize_				= static_cast<VkDeviceSize>(width) * height + chromaSize * 2;
+	} else {
+		frameSize_ = static_cast<VkDeviceSize>(width) * height * block.size;
+	}
+
+	VkSemaphoreTypeCreateInfo typeInfo{};
+	typeInfo.sType		   = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+	typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	typeInfo.initialValue  = 0;
+
+	VkSemaphoreCreateInfo semaphoreInfo{};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	semaphoreInfo.pNext = &typeInfo;
+
+	if (vkCreateSemaphore(gpu_->device, &semaphoreInfo, nullptr, &semaphore_) != VK_SUCCESS) {
+		std::cerr << "ReadbackRing: Failed to create timeline semaphore" << std::endl;
+		semaphore_ = VK_NULL_HANDLE;
+		return false;
+	}
+
+	slots_.resize(depth);
+	for (auto& slot : slots_) {
+		if (!slot.buffer.create(gpu_, frameSize_, BufferType::STAGING, BufferUsage::STATIC, BufferMemory::HOST_READBACK)) {
+			std::cerr << "ReadbackRing: Failed to create readback buffer" << std::endl;
+			destroy();
+			return false;
+		}
+	}
+
+	if (conversion_ == ReadbackConversion::YUV420 && !createConverter(view)) {
+		destroy();
+		return false;
+	}
+
+	return true;
+}
+
+void ReadbackRing::destroy() {
+	if (semaphore_ != VK_NULL_HANDLE) {
+		waitFor(recordedValue_);
+		vkDestroySemaphore(gpu_->device, semaphore_, nullptr);
+		semaphore_ = VK_NULL_HANDLE;
+	}
+
+	destroyConverter();
+	slots_.clear();
+	next_		   = 0;
+	recordedValue_ = 0;
+	droppedFrames_ = 0;
+	conversion_	   = ReadbackConversion::NONE;
+}
+
+bool ReadbackRing::createConverter(VkImageView view) {
+	if (view == VK_NULL_HANDLE) {
+		std::cerr << "ReadbackRing: YUV conversion needs a view of the image" << std::endl;
+		return false;
+	}
+	sourceView_ = view;
+
+	// Luma rows padded to whole blocks, chroma rows half as long
+	lumaStride_				  = (width_ + kBlockWidth - 1) / kBlockWidth * kBlockWidth;
+	chromaRows_				  = (height_ + kBlockHeight - 1) / kBlockHeight;
+	VkDeviceSize lumaSize	  = static_cast<VkDeviceSize>(lumaStride_) * chromaRows_ * kBlockHeight;
+	VkDeviceSize chromaStride = lumaStride_ / 2;
+	VkDeviceSize chromaSize	  = chromaStride * chromaRows_;
+	if (!planes_.create(gpu_, lumaSize + chromaSize * 2, BufferType::STORAGE)) {
+		std::cerr << "ReadbackRing: Failed to create YUV plane buffer" << std::endl;
+		return false;
+	}
+
+	VkDescriptorSetLayoutBinding bindings[2]{};
+	bindings[0].binding			= 0;
+	bindings[0].descriptorType	= VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+	bindings[0].descriptorCount = 1;
+	bindings[0].stageFlags		= VK_SHADER_STAGE_COMPUTE_BIT;
+	bindings[1].binding			= 1;
+	bindings[1].descriptorType	= VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	bindings[1].descriptorCount = 1;
+	bindings[1].stageFlags		= VK_SHADER_STAGE_COMPUTE_BIT;
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType		= VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = 2;
+	layoutInfo.pBindings	= bindings;
+	if (vkCreateDescriptorSetLayout(gpu_->device, &layoutInfo, nullptr, &setLayout_) != VK_SUCCESS) {
+		std::cerr << "ReadbackRing: Failed to create descriptor set layout" << std::endl;
+		setLayout_ = VK_NULL_HANDLE;
+		return false;
+	}
+
+	VkDescriptorPoolSize sizes[2]{};
+	sizes[0].type			 = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+	sizes[0].descriptorCount = 1;
+	sizes[1].type			 = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	sizes[1].descriptorCount = 1;
+
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType		   = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.maxSets	   = 1;
+	poolInfo.poolSizeCount = 2;
+	poolInfo.pPoolSizes	   = sizes;
+	if (vkCreateDescriptorPool(gpu_->device, &poolInfo, nullptr, &descriptorPool_) != VK_SUCCESS) {
+		std::cerr << "ReadbackRing: Failed to create descriptor pool" << std::endl;
+		descriptorPool_ = VK_NULL_HANDLE;
+		return false;
+	}
+
+	VkDescriptorSetAllocateInfo allocInfo{};
+	allocInfo.sType				 = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool	 = descriptorPool_;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts		 = &setLayout_;
+	if (vkAllocateDescriptorSets(gpu_->device, &allocInfo, &descriptorSet_) != VK_SUCCESS) {
+		std::cerr << "ReadbackRing: Failed to allocate descriptor set" << std::endl;
+		descriptorSet_ = VK_NULL_HANDLE;
+		return false;
+	}
+	writeDescriptorSet();
+
+	auto converter = std::make_unique<ComputePipeline>(gpu_, "rgbToYuv");
+	converter->setShader(std::vector<uint32_t>(std::begin(kRgbToYuvSpirv), std::end(kRgbToYuvSpirv)));
+	converter->setWorkgroupSize(kWorkgroupSize, kWorkgroupSize);
+	converter->addPushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ConversionConstants));
+	if (!converter->build(setLayout_)) {
+		return false;
+	}
+	converter_ = std::move(converter);
+
+	// The frames are tightly packed: whole planes when rows have no padding, row by row otherwise
+	VkDeviceSize chromaWidth = (width_ + 1) / 2;
+	VkDeviceSize frameU		 = static_cast<VkDeviceSize>(width_) * height_;
+	VkDeviceSize frameV		 = frameU + chromaWidth * chromaRows_;
+	planeCopies_.clear();
+	if (lumaStride_ == width_) {
+		planeCopies_.push_back({0, 0, frameU});
+		planeCopies_.push_back({lumaSize, frameU, chromaSize});
+		planeCopies_.push_back({lumaSize + chromaSize, frameV, chromaSize});
+	} else {
+		for (uint32_t y = 0; y < height_; y++) {
+			planeCopies_.push_back({static_cast<VkDeviceSize>(y) * lumaStride_, static_cast<VkDeviceSize>(y) * width_, width_});
+		}
+		for (uint32_t y = 0; y < chromaRows_; y++) {
+			planeCopies_.push_back({lumaSize + y * chromaStride, frameU + y * chromaWidth, chromaWidth});
+			planeCopies_.push_back({lumaSize + chromaSize + y * chromaStride, frameV + y * chromaWidth, chromaWidth});
+		}
+	}
+	return true;
+}
+
+void ReadbackRing::destroyConverter() {
+	converter_.reset();
+	if (descriptorPool_ != VK_NULL_HANDLE) {
+		vkDestroyDescriptorPool(gpu_->device, descriptorPool_, nullptr);
+		descriptorPool_ = VK_NULL_HANDLE;
+	}
+	if (setLayout_ != VK_NULL_HANDLE) {
+		vkDestroyDescriptorSetLayout(gpu_->device, setLayout_, nullptr);
+		setLayout_ = VK_NULL_HANDLE;
+	}
+	descriptorSet_ = VK_NULL_HANDLE;
+	sourceView_	   = VK_NULL_HANDLE;
+	planes_.destroy();
+	planeCopies_.clear();
+}
+
+void ReadbackRing::writeDescriptorSet() {
+	VkDescriptorImageInfo imageInfo{};
+	imageInfo.imageView	  = sourceView_;
+	imageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+	VkDescriptorBufferInfo bufferInfo{};
+	bufferInfo.buffer = planes_.getHandle();
+	bufferInfo.offset = 0;
+	bufferInfo.range  = VK_WHOLE_SIZE;
+
+	VkWriteDescriptorSet writes[2]{};
+	writes[0].sType			  = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	writes[0].dstSet		  = descriptorSet_;
+	writes[0].dstBinding	  = 0;
+	writes[0].descriptorCount = 1;
+	writes[0].descriptorType  = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+	writes[0].pImageInfo	  = &imageInfo;
+	writes[1].sType			  = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	writes[1].dstSet		  = descriptorSet_;
+	writes[1].dstBinding	  = 1;
+	writes[1].descriptorCount = 1;
+	writes[1].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	writes[1].pBufferInfo	  = &bufferInfo;
+	vkUpdateDescriptorSets(gpu_->device, 2, writes, 0, nullptr);
+
+	planesGeneration_ = planes_.getGeneration();
+}
+
+void ReadbackRing::setCallback(Callback callback) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	callback_ = std::move(callback);
+}
+
+uint64_t ReadbackRing::getCompletedValue() const {
+	uint64_t value = 0;
+	if (vkGetSemaphoreCounterValue(gpu_->device, semaphore_, &value) != VK_SUCCESS) return 0;
+	return value;
+}
+
+void ReadbackRing::waitFor(uint64_t value) const {
+	if (value == 0) return;
+
+	VkSemaphoreWaitInfo waitInfo{};
+	waitInfo.sType			= VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+	waitInfo.semaphoreCount = 1;
+	waitInfo.pSemaphores	= &semaphore_;
+	waitInfo.pValues		= &value;
+	vkWaitSemaphores(gpu_->device, &waitInfo, UINT64_MAX);
+}
+
+ReadbackRing::Slot* ReadbackRing::findOldestComplete() {
+	uint64_t completed = getCompletedValue();
+	Slot*	 oldest	   = nullptr;
+	for (auto& slot : slots_) {
+		if (slot.state == SlotState::PENDING && slot.value <= completed && (!oldest || slot.value < oldest->value)) {
+			oldest = &slot;
+		}
+	}
+	return oldest;
+}
+
+void ReadbackRing::fillFrame(Slot& slot, ReadbackFrame& outFrame) const {
+	slot.buffer.invalidate();
+
+	outFrame.frame	= slot.value;
+	outFrame.data	= slot.buffer.map();
+	outFrame.size	= frameSize_;
+	outFrame.width	= width_;
+	outFrame.height = height_;
+	outFrame.format = conversion_ == ReadbackConversion::YUV420 ? VK_FORMAT_G8_B8_R8_3PLANE_420_UNORM : format_;
+}
+
+void ReadbackRing::deliverCompleteLocked() {
+	if (!callback_) return;
+
+	while (Slot* slot = findOldestComplete()) {
+		ReadbackFrame frame;
+		fillFrame(*slot, frame);
+		callback_(frame);
+		slot->state = SlotState::FREE;
+	}
+}
+
+uint64_t ReadbackRing::record(VkCommandBuffer cmd, VkImage image) {
+	if (!isValid() || image == VK_NULL_HANDLE) return 0;
+
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	deliverCompleteLocked();
+
+	Slot& slot = slots_[next_];
+	if (slot.state == SlotState::HELD) {
+		droppedFrames_++;
+		return 0;
+	}
+	if (slot.state == SlotState::PENDING) {
+		// The GPU is a full ring ahead of the consumer
+		waitFor(slot.value);
+		deliverCompleteLocked();
+		if (slot.state == SlotState::PENDING) {
+			droppedFrames_++;
+		}
+	}
+
+	if (conversion_ == ReadbackConversion::YUV420) {
+		recordConversion(cmd, image, slot);
+	} else {
+		recordCopy(cmd, image, slot);
+	}
+
+	slot.value = ++recordedValue_;
+	slot.state = SlotState::PENDING;
+	next_	   = (next_ + 1) % static_cast<uint32_t>(slots_.size());
+	return slot.value;
+}
+
+void ReadbackRing::recordCopy(VkCommandBuffer cmd, VkImage image, Slot& slot) {
+	VkImageMemoryBarrier barrier{};
+	barrier.sType							= VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.oldLayout						= VK_IMAGE_LAYOUT_GENERAL;
+	barrier.newLayout						= VK_IMAGE_LAYOUT_GENERAL;
+	barrier.srcQueueFamilyIndex				= VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex				= VK_QUEUE_FAMILY_IGNORED;
+	barrier.image							= image;
+	barrier.subresourceRange.aspectMask		= VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.baseMipLevel	= 0;
+	barrier.subresourceRange.levelCount		= 1;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount		= 1;
+	barrier.srcAccessMask					= VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	barrier.dstAccessMask					= VK_ACCESS_TRANSFER_READ_BIT;
+
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+	VkBufferImageCopy region{};
+	region.bufferOffset					   = 0;
+	region.bufferRowLength				   = 0;
+	region.bufferImageHeight			   = 0;
+	region.imageSubresource.aspectMask	   = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.mipLevel	   = 0;
+	region.imageSubresource.baseArrayLayer = 0;
+	region.imageSubresource.layerCount	   = 1;
+	region.imageOffset					   = {0, 0, 0};
+	region.imageExtent					   = {width_, height_, 1};
+
+	vkCmdCopyImageToBuffer(cmd, image, VK_IMAGE_LAYOUT_GENERAL, slot.buffer.getHandle(), 1, &region);
+
+	// The next frame's render pass must not overwrite the image before the copy read it
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	barrier.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+	VkBufferMemoryBarrier bufferBarrier{};
+	bufferBarrier.sType				  = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	bufferBarrier.srcAccessMask		  = VK_ACCESS_TRANSFER_WRITE_BIT;
+	bufferBarrier.dstAccessMask		  = VK_ACCESS_HOST_READ_BIT;
+	bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	bufferBarrier.buffer			  = slot.buffer.getHandle();
+	bufferBarrier.offset			  = 0;
+	bufferBarrier.size				  = VK_WHOLE_SIZE;
+
+	vkCmdPipelineBarrier(cmd,
+						 VK_PIPELINE_STAGE_TRANSFER_BIT,
+						 VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_HOST_BIT,
+						 0,
+						 0,
+						 nullptr,
+						 1,
+						 &bufferBarrier,
+						 1,
+						 &barrier);
+}
+
+void ReadbackRing::recordConversion(VkCommandBuffer cmd, VkImage image, Slot& slot) {
+	// Submissions using the set were all waited for when it has to change
+	if (planes_.getGeneration() != planesGeneration_) {
+		waitFor(recordedValue_);
+		writeDescriptorSet();
+	}
+
+	VkImageMemoryBarrier imageBarrier{};
+	imageBarrier.sType							 = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	imageBarrier.oldLayout						 = VK_IMAGE_LAYOUT_GENERAL;
+	imageBarrier.newLayout						 = VK_IMAGE_LAYOUT_GENERAL;
+	imageBarrier.srcQueueFamilyIndex			 = VK_QUEUE_FAMILY_IGNORED;
+	imageBarrier.dstQueueFamilyIndex			 = VK_QUEUE_FAMILY_IGNORED;
+	imageBarrier.image							 = image;
+	imageBarrier.subresourceRange.aspectMask	 = VK_IMAGE_ASPECT_COLOR_BIT;
+	imageBarrier.subresourceRange.baseMipLevel	 = 0;
+	imageBarrier.subresourceRange.levelCount	 = 1;
+	imageBarrier.subresourceRange.baseArrayLayer = 0;
+	imageBarrier.subresourceRange.layerCount	 = 1;
+	imageBarrier.srcAccessMask					 = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	imageBarrier.dstAccessMask					 = VK_ACCESS_SHADER_READ_BIT;
+
+	// The previous frame's copy out of the planes must be done before they are written again
+	VkBufferMemoryBarrier planesBarrier{};
+	planesBarrier.sType				  = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	planesBarrier.srcAccessMask		  = VK_ACCESS_TRANSFER_READ_BIT;
+	planesBarrier.dstAccessMask		  = VK_ACCESS_SHADER_WRITE_BIT;
+	planesBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	planesBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	planesBarrier.buffer			  = planes_.getHandle();
+	planesBarrier.offset			  = 0;
+	planesBarrier.size				  = VK_WHOLE_SIZE;
+
+	vkCmdPipelineBarrier(cmd,
+						 VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+						 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+						 0,
+						 0,
+						 nullptr,
+						 1,
+						 &planesBarrier,
+						 1,
+						 &imageBarrier);
+
+	ConversionConstants constants{};
+	constants.sourceWidth  = static_cast<int32_t>(width_);
+	constants.sourceHeight = static_cast<int32_t>(height_);
+	constants.lumaStride   = lumaStride_;
+	constants.chromaRows   = chromaRows_;
+	constants.uOffset	   = lumaStride_ * chromaRows_ * kBlockHeight;
+	constants.vOffset	   = constants.uOffset + lumaStride_ / 2 * chromaRows_;
+	constants.srgb		   = isSrgbFormat(format_) ? 1 : 0;
+
+	uint32_t blocksPerRow = lumaStride_ / kBlockWidth;
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, converter_->getPipeline());
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, converter_->getLayout(), 0, 1, &descriptorSet_, 0, nullptr);
+	vkCmdPushConstants(cmd, converter_->getLayout(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+	vkCmdDispatch(cmd, (blocksPerRow + kWorkgroupSize - 1) / kWorkgroupSize, (chromaRows_ + kWorkgroupSize - 1) / kWorkgroupSize, 1);
+
+	planesBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	planesBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+	// The next frame's render pass must not overwrite the image before the shader read it
+	imageBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	imageBarrier.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+	vkCmdPipelineBarrier(cmd,
+						 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+						 VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+						 0,
+						 0,
+						 nullptr,
+						 1,
+						 &planesBarrier,
+						 1,
+						 &imageBarrier);
+
+	vkCmdCopyBuffer(cmd, planes_.getHandle(), slot.buffer.getHandle(), static_cast<uint32_t>(planeCopies_.size()), planeCopies_.data());
+
+	VkBufferMemoryBarrier slotBarrier{};
+	slotBarrier.sType				= VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	slotBarrier.srcAccessMask		= VK_ACCESS_TRANSFER_WRITE_BIT;
+	slotBarrier.dstAccessMask		= VK_ACCESS_HOST_READ_BIT;
+	slotBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	slotBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	slotBarrier.buffer				= slot.buffer.getHandle();
+	slotBarrier.offset				= 0;
+	slotBarrier.size				= VK_WHOLE_SIZE;
+
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &slotBarrier, 0, nullptr);
+}
+
+void ReadbackRing::cancel(uint64_t value) {
+	if (!isValid() || value == 0) return;
+
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	// Later values wait on this one, so it is signaled from the host once the earlier ones were
+	waitFor(value - 1);
+
+	VkSemaphoreSignalInfo signalInfo{};
+	signalInfo.sType	 = VK_STRUCTURE_TYPE_SEMAPHORE_SIGNAL_INFO;
+	signalInfo.semaphore = semaphore_;
+	signalInfo.value	 = value;
+	vkSignalSemaphore(gpu_->device, &signalInfo);
+
+	for (auto& slot : slots_) {
+		if (slot.state == SlotState::PENDING && slot.value == value) {
+			slot.state = SlotState::FREE;
+		}
+	}
+}
+
+bool ReadbackRing::poll(ReadbackFrame& outFrame) {
+	if (!isValid()) return false;
+
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	for (auto& slot : slots_) {
+		if (slot.state == SlotState::HELD) slot.state = SlotState::FREE;
+	}
+
+	Slot* slot = findOldestComplete();
+	if (!slot) return false;
+
+	fillFrame(*slot, outFrame);
+	slot->state = SlotState::HELD;
+	return true;
+}
+
+void ReadbackRing::drain() {
+	if (!isValid()) return;
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	waitFor(recordedValue_);
+	deliverCompleteLocked();
+}
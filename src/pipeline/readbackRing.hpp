@@ -0,0 +1,140 @@
+#ifndef READBACK_RING_HPP
+#define READBACK_RING_HPP
+
+#include "buffer/buffer.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+namespace renderApi::device {
+	struct GPU;
+}
+
+namespace renderApi::gpuTask {
+
+	class ComputePipeline;
+
+	enum class ReadbackConversion {
+		NONE,  // Copies the image as is
+		YUV420 // Planar BT.709 limited range YUV 4:2:0, in frames of format VK_FORMAT_G8_B8_R8_3PLANE_420_UNORM
+	};
+
+	struct ReadbackFrame {
+		uint64_t	 frame	= 0; // Counts the frames read back since the ring was created, starting at 1
+		const void*	 data	= nullptr;
+		VkDeviceSize size	= 0;
+		uint32_t	 width	= 0;
+		uint32_t	 height = 0;
+		VkFormat	 format = VK_FORMAT_UNDEFINED;
+	};
+
+	// N-deep ring of host visible buffers the output of an offscreen pipeline is copied into, inside
+	// the command buffer of the frame that renders it. A submission signals the ring's timeline
+	// semaphore with its frame number; complete frames are handed out in order, either to the
+	// callback from the thread running GpuTask::execute(), or through poll() when there is no callback.
+	//
+	// Frame k is normally delivered while frame k + depth is recorded. When every slot is still in
+	// flight, recording waits for the oldest one. A frame nobody polled before its slot comes round
+	// again is dropped, as is a new frame whose slot is still held by poll().
+	//
+	// With ReadbackConversion::YUV420 a compute pass turns the image into YUV planes in device memory
+	// before the copy, which reads back 1.5 bytes per pixel instead of 4. The Y, U and V planes follow
+	// each other tightly packed, chroma planes being half the size rounded up on each axis. The
+	// command buffer passed to record() must then support compute.
+	class ReadbackRing {
+	  public:
+		using Callback = std::function<void(const ReadbackFrame& frame)>;
+
+		static constexpr uint32_t kDefaultDepth = 3;
+
+		ReadbackRing();
+		~ReadbackRing();
+
+		ReadbackRing(const ReadbackRing&)			 = delete;
+		ReadbackRing& operator=(const ReadbackRing&) = delete;
+
+		// view is the image given to record(), read by the conversion pass
+		bool create(device::GPU*	   gpu,
+					uint32_t		   depth,
+					uint32_t		   width,
+					uint32_t		   height,
+					VkFormat		   format,
+					ReadbackConversion conversion = ReadbackConversion::NONE,
+					VkImageView		   view		  = VK_NULL_HANDLE);
+		void destroy();
+
+		// Frame data passed to the callback is only valid during the call; it must not call poll()
+		void setCallback(Callback callback);
+
+		// Records the copy of image, in GENERAL layout after the render pass, into the next slot.
+		// Returns the value the submission of cmd must signal getSemaphore() with, or 0 if the frame
+		// is not read back.
+		uint64_t record(VkCommandBuffer cmd, VkImage image);
+		// The submission holding value was not made; frees its slot
+		void cancel(uint64_t value);
+
+		// Oldest complete frame not handed out yet. Its data stays valid until the next poll().
+		bool poll(ReadbackFrame& outFrame);
+		// Waits for every frame recorded so far and passes them to the callback
+		void drain();
+
+		VkSemaphore getSemaphore() const { return semaphore_; }
+		ReadbackConversion getConversion() const { return conversion_; }
+		uint32_t	getDepth() const { return static_cast<uint32_t>(slots_.size()); }
+		uint64_t	getDroppedFrames() const { return droppedFrames_; }
+		bool		isValid() const { return semaphore_ != VK_NULL_HANDLE; }
+
+	  private:
+		enum class SlotState { FREE, PENDING, HELD };
+
+		struct Slot {
+			Buffer	  buffer;
+			uint64_t  value = 0;
+			SlotState state = SlotState::FREE;
+		};
+
+		device::GPU*	  gpu_;
+		VkSemaphore		  semaphore_;
+		std::vector<Slot> slots_;
+		uint32_t		  next_;
+		uint64_t		  recordedValue_;
+		uint64_t		  droppedFrames_;
+		uint32_t		  width_;
+		uint32_t		  height_;
+		VkFormat		  format_;
+		VkDeviceSize	  frameSize_;
+		Callback		  callback_;
+		std::mutex		  mutex_;
+
+		// YUV420 conversion
+		ReadbackConversion				 conversion_;
+		std::unique_ptr<ComputePipeline> converter_;
+		VkDescriptorSetLayout			 setLayout_;
+		VkDescriptorPool				 descriptorPool_;
+		VkDescriptorSet					 descriptorSet_;
+		VkImageView						 sourceView_;
+		Buffer							 planes_;		// Rows padded to whole words of the shader
+		uint64_t						 planesGeneration_; // Of planes_ in descriptorSet_, as the defragmenter may move it
+		uint32_t						 lumaStride_;
+		uint32_t						 chromaRows_;
+		std::vector<VkBufferCopy>		 planeCopies_; // planes_ to a slot, dropping the padding
+
+		uint64_t getCompletedValue() const;
+		void	 waitFor(uint64_t value) const;
+		Slot*	 findOldestComplete();
+		void	 deliverCompleteLocked();
+		void	 fillFrame(Slot& slot, ReadbackFrame& outFrame) const;
+		bool	 createConverter(VkImageView view);
+		void	 destroyConverter();
+		void	 writeDescriptorSet();
+		void	 recordCopy(VkCommandBuffer cmd, VkImage image, Slot& slot);
+		void	 recordConversion(VkCommandBuffer cmd, VkImage image, Slot& slot);
+	};
+
+} // namespace renderApi::gpuTask
+
+#endif
@@ -304,18 +304,12 @@ bool GraphicsPipeline::createDepthResources() {
 	VkMemoryRequirements depthMemRequirements;
 	vkGetImageMemoryRequirements(gpu_->device, depthImage_, &depthMemRequirements);
 
-	VkMemoryAllocateInfo depthAllocInfo{};
-	depthAllocInfo.sType		  = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	depthAllocInfo.allocationSize = depthMemRequirements.size;
-	depthAllocInfo.memoryTypeIndex =
-			device::findMemoryType(gpu_->physicalDevice, depthMemRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-	if (vkAllocateMemory(gpu_->device, &depthAllocInfo, nullptr, &depthImageMemory_) != VK_SUCCESS) {
+	if (!gpu_->allocator.allocate(depthMemRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, memory::ResourceKind::OPTIMAL, depthImageMemory_, memory::MemoryCategory::RENDER_TARGET)) {
 		std::cerr << "GraphicsPipeline: Failed to allocate depth image memory" << std::endl;
 		return false;
 	}
 
-	vkBindImageMemory(gpu_->device, depthImage_, depthImageMemory_, 0);
+	vkBindImageMemory(gpu_->device, depthImage_, depthImageMemory_.memory, depthImageMemory_.offset);
 
 	VkImageViewCreateInfo depthViewInfo{};
 	depthViewInfo.sType				 = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -351,10 +345,7 @@ void GraphicsPipeline::destroyDepthResources() {
 		depthImage_ = VK_NULL_HANDLE;
 	}
 
-	if (depthImageMemory_ != VK_NULL_HANDLE) {
-		vkFreeMemory(gpu_->device, depthImageMemory_, nullptr);
-		depthImageMemory_ = VK_NULL_HANDLE;
-	}
+	gpu_->allocator.free(depthImageMemory_);
 }
 
 bool GraphicsPipeline::createSwapchainFramebuffers() {
@@ -1,9 +1,9 @@
 #include "utils.hpp"
 
 #include "buffer/buffer.hpp"
+#include "image/frameWriter.hpp"
 
 #include <cstdint>
-#include <fstream>
 #include <iostream>
 
 bool saveBufferAsPPM(const std::string& filename, renderApi::Buffer& buffer, uint32_t width, uint32_t height) {
@@ -12,39 +12,24 @@ bool saveBufferAsPPM(const std::string& filename, renderApi::Buffer& buffer, uin
 		return false;
 	}
 
-	size_t expectedSize = width * height * 4;
+	size_t expectedSize = static_cast<size_t>(width) * height * 4;
 	if (buffer.getSize() < expectedSize) {
 		std::cerr << "Cannot save PPM: buffer size mismatch (expected " << expectedSize << ", got " << buffer.getSize() << ")" << std::endl;
 		return false;
 	}
 
-	void* data = buffer.map();
+	bool  wasMapped = buffer.isMapped();
+	void* data		= buffer.map();
 	if (!data) {
 		std::cerr << "Cannot save PPM: failed to map buffer" << std::endl;
 		return false;
 	}
+	buffer.invalidate(0, expectedSize);
 
-	std::ofstream file(filename, std::ios::binary);
-	if (!file.is_open()) {
-		std::cerr << "Cannot save PPM: failed to open file " << filename << std::endl;
-		buffer.unmap();
-		return false;
-	}
-
-	file << "P6\n" << width << " " << height << "\n255\n";
-
-	uint8_t* pixels = static_cast<uint8_t*>(data);
-	for (uint32_t y = 0; y < height; ++y) {
-		for (uint32_t x = 0; x < width; ++x) {
-			uint32_t idx = (y * width + x) * 4;
-			file << pixels[idx + 0];
-			file << pixels[idx + 1];
-			file << pixels[idx + 2];
-		}
-	}
-
-	file.close();
-	buffer.unmap();
+	// Swizzles to RGB and writes the file in one call; FrameWriter does the same off the calling thread
+	bool saved = renderApi::writeFrame(filename, data, width, height, renderApi::FrameEncoding::PPM);
+	if (!wasMapped) buffer.unmap();
+	if (!saved) return false;
 
 	std::cout << "Image saved to " << filename << " (" << width << "x" << height << ")" << std::endl;
 	return true;
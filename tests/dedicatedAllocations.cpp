@@ -0,0 +1,77 @@
+#include "buffer/buffer.hpp"
+#include "renderDevice.hpp"
+#include "renderInstance.hpp"
+
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+// Creates buffers larger than half the allocator block size, which get a dedicated block each,
+// and checks that every byte written to them reads back. Sizes cover power of two and odd
+// sizes, host visible and device local memory. Exits with 77 (skipped) when no Vulkan device is
+// available.
+
+using namespace renderApi;
+
+namespace {
+
+	constexpr int		   kSkipped	  = 77;
+	constexpr VkDeviceSize kBlockSize = 16 * 1024 * 1024;
+
+	bool run(device::GPU* gpu, const char* name, size_t size, BufferType type, BufferMemory memory) {
+		Buffer buffer;
+		if (!buffer.create(gpu, size, type, BufferUsage::STATIC, memory)) {
+			std::cerr << name << ": failed to create a " << size << " byte buffer" << std::endl;
+			return false;
+		}
+
+		std::vector<uint8_t> source(size);
+		for (size_t i = 0; i < size; i++) {
+			source[i] = static_cast<uint8_t>(i * 31 + 7);
+		}
+		std::vector<uint8_t> destination(size);
+
+		if (!buffer.upload(source.data(), size) || !buffer.download(destination.data(), size)) {
+			std::cerr << name << ": transfer of " << size << " bytes failed" << std::endl;
+			return false;
+		}
+		if (destination != source) {
+			std::cerr << name << ": " << size << " byte buffer read back different data" << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+} // namespace
+
+int main() {
+	std::unique_ptr<instance::RenderInstance> renderInstance;
+	try {
+		renderInstance = std::make_unique<instance::RenderInstance>(instance::Config::ReleaseDefault("dedicatedAllocations"));
+	} catch (const std::exception& e) {
+		std::cerr << "Skipping: " << e.what() << std::endl;
+		return kSkipped;
+	}
+
+	device::Config gpuConfig;
+	gpuConfig.graphics = 1;
+	if (renderInstance->addGPU(gpuConfig) != device::INIT_DEVICE_SUCCESS) {
+		std::cerr << "Skipping: no usable GPU" << std::endl;
+		return kSkipped;
+	}
+	device::GPU* gpu = renderInstance->getGPU(0);
+	gpu->allocator.setBlockSize(kBlockSize);
+
+	const size_t sizes[] = {kBlockSize / 2 + 1, kBlockSize, kBlockSize * 3 / 4 + 13, kBlockSize * 2};
+
+	bool passed = true;
+	for (size_t size : sizes) {
+		passed &= run(gpu, "HOST_VISIBLE", size, BufferType::STAGING, BufferMemory::HOST_VISIBLE);
+		passed &= run(gpu, "DEVICE_LOCAL", size, BufferType::STORAGE, BufferMemory::DEVICE_LOCAL);
+	}
+
+	return passed ? 0 : 1;
+}
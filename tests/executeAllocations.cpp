@@ -0,0 +1,207 @@
+#include "buffer/buffer.hpp"
+#include "gpuTask.hpp"
+#include "pipeline/computePipeline.hpp"
+#include "pipeline/graphicsPipeline.hpp"
+#include "renderDevice.hpp"
+#include "renderInstance.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+// Runs offscreen graphics and compute tasks until they are warmed up, then counts the operator
+// new calls, in any of their forms, made by any thread during further execute() calls. Exits with 77 (skipped) when no
+// Vulkan device is available.
+
+using namespace renderApi;
+using namespace renderApi::gpuTask;
+
+namespace {
+
+	constexpr int	   kSkipped		 = 77;
+	constexpr uint32_t kWarmupFrames = 16;
+	constexpr uint32_t kFrames		 = 256;
+	constexpr uint32_t kWidth		 = 64;
+	constexpr uint32_t kHeight		 = 64;
+	constexpr uint32_t kValueCount	 = 256;
+
+	std::atomic_bool	 counting{false};
+	std::atomic_uint64_t allocations{0};
+
+	const std::vector<uint32_t> kFullscreenSpirv = {
+#include "fullscreen.vert.spv.inc"
+	};
+	const std::vector<uint32_t> kFillFragSpirv = {
+#include "fill.frag.spv.inc"
+	};
+	const std::vector<uint32_t> kFillCompSpirv = {
+#include "fill.comp.spv.inc"
+	};
+
+	struct Color {
+		float r, g, b, a;
+	};
+
+	// Push constants change every frame so that each frame is recorded again
+	uint64_t countAllocations(GpuTask& task, VkShaderStageFlags stages, uint32_t frames) {
+		for (uint32_t i = 0; i < kWarmupFrames; i++) {
+			Color color{static_cast<float>(i) / kWarmupFrames, 0.0f, 0.0f, 1.0f};
+			task.pushConstants(stages, 0, sizeof(color), &color);
+			task.execute();
+		}
+		task.wait();
+
+		allocations = 0;
+		counting	= true;
+		for (uint32_t i = 0; i < frames; i++) {
+			Color color{0.0f, static_cast<float>(i) / frames, 0.0f, 1.0f};
+			task.pushConstants(stages, 0, sizeof(color), &color);
+			task.execute();
+		}
+		task.wait();
+		counting = false;
+
+		return allocations;
+	}
+
+	bool addGraphicsPipeline(GpuTask& task, const std::string& name) {
+		GraphicsPipeline* pipeline = task.createGraphicsPipeline(name);
+		if (!pipeline) return false;
+		pipeline->setVertexShader(kFullscreenSpirv);
+		pipeline->setFragmentShader(kFillFragSpirv);
+		pipeline->addPushConstantRange(VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(Color));
+		return true;
+	}
+
+	bool report(const char* name, uint64_t count) {
+		std::cout << name << ": " << count << " allocations in " << kFrames << " frames" << std::endl;
+		return count == 0;
+	}
+
+	// Backs every replaced operator new, nullptr when out of memory
+	void* allocate(std::size_t size, std::size_t alignment) noexcept {
+		if (counting.load(std::memory_order_relaxed)) allocations.fetch_add(1, std::memory_order_relaxed);
+		if (size == 0) size = 1;
+		if (alignment <= alignof(std::max_align_t)) return std::malloc(size);
+#ifdef _WIN32
+		return _aligned_malloc(size, alignment);
+#else
+		// aligned_alloc wants a multiple of the alignment
+		return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+#endif
+	}
+
+	void deallocate(void* ptr, std::size_t alignment) noexcept {
+#ifdef _WIN32
+		if (alignment > alignof(std::max_align_t)) {
+			_aligned_free(ptr);
+			return;
+		}
+#endif
+		std::free(ptr);
+	}
+
+	void* allocateOrThrow(std::size_t size, std::size_t alignment) {
+		if (void* ptr = allocate(size, alignment)) return ptr;
+		throw std::bad_alloc();
+	}
+
+} // namespace
+
+// Every replaceable form, so that no allocation made through new goes uncounted
+
+void* operator new(std::size_t size) { return allocateOrThrow(size, alignof(std::max_align_t)); }
+void* operator new[](std::size_t size) { return allocateOrThrow(size, alignof(std::max_align_t)); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept { return allocate(size, alignof(std::max_align_t)); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { return allocate(size, alignof(std::max_align_t)); }
+void* operator new(std::size_t size, std::align_val_t alignment) { return allocateOrThrow(size, static_cast<std::size_t>(alignment)); }
+void* operator new[](std::size_t size, std::align_val_t alignment) { return allocateOrThrow(size, static_cast<std::size_t>(alignment)); }
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+	return allocate(size, static_cast<std::size_t>(alignment));
+}
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+	return allocate(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void* ptr) noexcept { deallocate(ptr, alignof(std::max_align_t)); }
+void operator delete[](void* ptr) noexcept { deallocate(ptr, alignof(std::max_align_t)); }
+void operator delete(void* ptr, std::size_t) noexcept { deallocate(ptr, alignof(std::max_align_t)); }
+void operator delete[](void* ptr, std::size_t) noexcept { deallocate(ptr, alignof(std::max_align_t)); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { deallocate(ptr, alignof(std::max_align_t)); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { deallocate(ptr, alignof(std::max_align_t)); }
+void operator delete(void* ptr, std::align_val_t alignment) noexcept { deallocate(ptr, static_cast<std::size_t>(alignment)); }
+void operator delete[](void* ptr, std::align_val_t alignment) noexcept { deallocate(ptr, static_cast<std::size_t>(alignment)); }
+void operator delete(void* ptr, std::size_t, std::align_val_t alignment) noexcept { deallocate(ptr, static_cast<std::size_t>(alignment)); }
+void operator delete[](void* ptr, std::size_t, std::align_val_t alignment) noexcept { deallocate(ptr, static_cast<std::size_t>(alignment)); }
+void operator delete(void* ptr, std::align_val_t alignment, const std::nothrow_t&) noexcept { deallocate(ptr, static_cast<std::size_t>(alignment)); }
+void operator delete[](void* ptr, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+	deallocate(ptr, static_cast<std::size_t>(alignment));
+}
+
+int main() {
+	std::unique_ptr<instance::RenderInstance> renderInstance;
+	try {
+		renderInstance = std::make_unique<instance::RenderInstance>(instance::Config::ReleaseDefault("executeAllocations"));
+	} catch (const std::exception& e) {
+		std::cerr << "Skipping: " << e.what() << std::endl;
+		return kSkipped;
+	}
+
+	device::Config gpuConfig;
+	gpuConfig.graphics = 1;
+	gpuConfig.compute  = 1;
+	if (renderInstance->addGPU(gpuConfig) != device::INIT_DEVICE_SUCCESS) {
+		std::cerr << "Skipping: no usable GPU" << std::endl;
+		return kSkipped;
+	}
+	device::GPU* gpu = renderInstance->getGPU(0);
+
+	bool passed = true;
+	{
+		Buffer scale = createStorageBuffer(gpu, std::vector<float>{1.0f});
+
+		GpuTask graphics("graphics", gpu);
+		graphics.addBuffer(&scale, VK_SHADER_STAGE_FRAGMENT_BIT);
+		graphics.setDrawParams(3);
+		if (!addGraphicsPipeline(graphics, "fill") || !graphics.build(kWidth, kHeight)) {
+			std::cerr << "Failed to build the graphics task" << std::endl;
+			return 1;
+		}
+		passed &= report("graphics", countAllocations(graphics, VK_SHADER_STAGE_FRAGMENT_BIT, kFrames));
+
+		// Several pipelines go through the parallel secondary command buffer path
+		GpuTask parallel("parallel", gpu);
+		parallel.addBuffer(&scale, VK_SHADER_STAGE_FRAGMENT_BIT);
+		parallel.setDrawParams(3);
+		parallel.setRecordingThreads(2);
+		if (!addGraphicsPipeline(parallel, "fill0") || !addGraphicsPipeline(parallel, "fill1") || !parallel.build(kWidth, kHeight)) {
+			std::cerr << "Failed to build the parallel graphics task" << std::endl;
+			return 1;
+		}
+		passed &= report("parallel graphics", countAllocations(parallel, VK_SHADER_STAGE_FRAGMENT_BIT, kFrames));
+
+		Buffer values = createStorageBuffer(gpu, kValueCount * sizeof(float));
+
+		GpuTask compute("compute", gpu);
+		compute.addBuffer(&values, VK_SHADER_STAGE_COMPUTE_BIT);
+		ComputePipeline* pipeline = compute.createComputePipeline("fill");
+		pipeline->setShader(kFillCompSpirv);
+		pipeline->setWorkgroupSize(kValueCount / 64);
+		pipeline->addPushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(Color));
+		if (!compute.build()) {
+			std::cerr << "Failed to build the compute task" << std::endl;
+			return 1;
+		}
+		passed &= report("compute", countAllocations(compute, VK_SHADER_STAGE_COMPUTE_BIT, kFrames));
+	}
+
+	return passed ? 0 : 1;
+}
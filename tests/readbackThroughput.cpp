@@ -0,0 +1,101 @@
+#include "buffer/buffer.hpp"
+#include "renderDevice.hpp"
+#include "renderInstance.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+// Measures how fast Buffer::download() reads back what the device wrote, for the coherent host
+// visible memory readbacks used before, HOST_READBACK memory and device local buffers read through
+// the staging pool. The device rewrites the buffer before each download so that no host cache
+// holds its contents, and every byte read back is checked against what it wrote. Exits with 77
+// (skipped) when no Vulkan device is available.
+
+using namespace renderApi;
+
+namespace {
+
+	constexpr int	   kSkipped	   = 77;
+	constexpr size_t   kSize	   = 32 * 1024 * 1024;
+	constexpr uint32_t kIterations = 16;
+
+	// Returns the download throughput in GB/s, or a negative value on failure
+	double measure(device::GPU* gpu, Buffer& buffer, std::vector<uint8_t>& destination) {
+		double seconds = 0.0;
+		for (uint32_t i = 0; i < kIterations; i++) {
+			VkCommandBuffer cmd = gpu->beginOneTimeCommands();
+			vkCmdFillBuffer(cmd, buffer.getHandle(), 0, VK_WHOLE_SIZE, i * 0x01010101u);
+
+			VkMemoryBarrier barrier{};
+			barrier.sType		  = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+			vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0,
+								 nullptr, 0, nullptr);
+			gpu->endOneTimeCommands(cmd);
+
+			auto start = std::chrono::steady_clock::now();
+			if (!buffer.download(destination.data(), kSize)) return -1.0;
+			seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			// Checked outside the timed region; any byte the fill did not reach would be stale
+			uint8_t expected = static_cast<uint8_t>(i);
+			auto	mismatch = std::find_if(destination.begin(), destination.end(), [expected](uint8_t value) { return value != expected; });
+			if (mismatch != destination.end()) {
+				std::cerr << "Readback returned stale data at byte " << (mismatch - destination.begin()) << std::endl;
+				return -1.0;
+			}
+		}
+		return static_cast<double>(kSize) * kIterations / seconds / 1e9;
+	}
+
+	bool run(device::GPU* gpu, const char* name, BufferType type, BufferUsage usage, BufferMemory memory, std::vector<uint8_t>& destination) {
+		Buffer buffer;
+		if (!buffer.create(gpu, kSize, type, usage, memory)) {
+			std::cerr << name << ": failed to create the buffer" << std::endl;
+			return false;
+		}
+
+		double throughput = measure(gpu, buffer, destination);
+		if (throughput < 0.0) {
+			std::cerr << name << ": readback failed" << std::endl;
+			return false;
+		}
+		std::cout << name << (buffer.isCoherent() ? " (coherent)" : " (non coherent)") << ": " << throughput << " GB/s" << std::endl;
+		return true;
+	}
+
+} // namespace
+
+int main() {
+	std::unique_ptr<instance::RenderInstance> renderInstance;
+	try {
+		renderInstance = std::make_unique<instance::RenderInstance>(instance::Config::ReleaseDefault("readbackThroughput"));
+	} catch (const std::exception& e) {
+		std::cerr << "Skipping: " << e.what() << std::endl;
+		return kSkipped;
+	}
+
+	device::Config gpuConfig;
+	gpuConfig.graphics = 1;
+	if (renderInstance->addGPU(gpuConfig) != device::INIT_DEVICE_SUCCESS) {
+		std::cerr << "Skipping: no usable GPU" << std::endl;
+		return kSkipped;
+	}
+	device::GPU* gpu = renderInstance->getGPU(0);
+
+	std::vector<uint8_t> destination(kSize);
+
+	bool passed = true;
+	passed &= run(gpu, "HOST_VISIBLE", BufferType::STAGING, BufferUsage::STREAM, BufferMemory::HOST_VISIBLE, destination);
+	passed &= run(gpu, "HOST_READBACK", BufferType::STAGING, BufferUsage::STREAM, BufferMemory::HOST_READBACK, destination);
+	passed &= run(gpu, "DEVICE_LOCAL", BufferType::STORAGE, BufferUsage::STATIC, BufferMemory::DEVICE_LOCAL, destination);
+
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,16 @@
+#version 450
+
+layout(set = 0, binding = 0) readonly buffer Scale {
+	float scale;
+};
+
+layout(push_constant) uniform Params {
+	vec4 color;
+}
+params;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+	outColor = params.color * scale;
+}